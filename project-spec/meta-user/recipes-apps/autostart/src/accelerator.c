@@ -0,0 +1,313 @@
+/*
+ * Network accelerator on the PL side, or the CPU engine if the PL cannot be
+ * opened.
+ * Refer docs/resources/build.md
+ */
+#include "accelerator.h"
+#include "preprocess.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef HAVE_AXITANGXI_IOCTL_H
+#include "axitangxi_ioctl.h"
+#endif
+
+#define ACC_BURST_SIZE 65536
+
+#ifdef HAVE_AXITANGXI_IOCTL_H
+/*
+ * PS DDR -> PL DDR -> PS DDR. A DMA buffer goes to the PL DRAM at tx_addr and
+ * the transform coefficients come back to rx in their DMA buffer.
+ */
+static int transfer(accelerator_t *p_accelerator, void *tx, uint32_t tx_addr,
+                    size_t tx_size, int16_t *rx, size_t rx_size) {
+  size_t size = tx_size > rx_size ? tx_size : rx_size;
+  struct axitangxi_transaction trans = {
+      .tx_data_size = tx_size,
+      .rx_data_size = rx_size,
+      .burst_size = ACC_BURST_SIZE,
+      .burst_count = (size - 1) / (ACC_BURST_SIZE * 16) + 1,
+      .burst_data = ACC_BURST_SIZE * 16,
+      .tx_data_ps_ptr = tx,
+      .rx_data_ps_ptr = (uint32_t *)rx,
+      .tx_data_pl_ptr = tx_addr,
+      .rx_data_pl_ptr = ACC_TRANS_ADDR,
+  };
+  if (ioctl(p_accelerator->fd, AXITANGXI_PSDDR_PLDDR_LOOPBACK, &trans) ==
+      -1) {
+    perror("AXITANGXI_PSDDR_PLDDR_LOOPBACK");
+    return -1;
+  }
+  return 0;
+}
+
+/* like axitangxi_malloc(), every mapping is a new DMA buffer */
+static void *dma_malloc(int fd, size_t size) {
+  void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (buffer == MAP_FAILED) {
+    perror(ACCELERATOR_DEVICE);
+    return NULL;
+  }
+  return buffer;
+}
+#endif
+
+static void *cpu_run(void *arg) {
+  accelerator_t *p_accelerator = arg;
+  p_accelerator->status =
+      engine_run(p_accelerator->p_engine, p_accelerator->result, NULL,
+                 p_accelerator->input, p_accelerator->width,
+                 p_accelerator->height);
+  return NULL;
+}
+
+static void cpu_close(accelerator_t *p_accelerator) {
+  if (p_accelerator->running)
+    pthread_join(p_accelerator->thread, NULL);
+  free(p_accelerator->result);
+  free(p_accelerator->input);
+  free(p_accelerator->picture);
+  free(p_accelerator->trans);
+  if (p_accelerator->p_engine)
+    engine_free(p_accelerator->p_engine);
+  free(p_accelerator->p_engine);
+  p_accelerator->p_engine = NULL;
+}
+
+/* run the networks by the CPU engine, without weights until they are loaded */
+static int cpu_open(accelerator_t *p_accelerator, size_t picture_size,
+                    size_t trans_size) {
+  *p_accelerator = (accelerator_t){
+      .fd = -1,
+      .p_engine = malloc(sizeof(engine_t)),
+      .picture = malloc(picture_size),
+      .input = malloc(picture_size),
+      .trans = malloc(trans_size),
+      .picture_size = picture_size,
+      .trans_size = trans_size,
+  };
+  if (p_accelerator->p_engine == NULL || p_accelerator->picture == NULL ||
+      p_accelerator->input == NULL || p_accelerator->trans == NULL) {
+    perror("accelerator");
+    free(p_accelerator->p_engine);
+    p_accelerator->p_engine = NULL;
+    cpu_close(p_accelerator);
+    return -1;
+  }
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  engine_init(p_accelerator->p_engine, NULL, processors > 0 ? processors : 1);
+  fprintf(stderr, "accelerator: run the networks by the CPU\n");
+  return 0;
+}
+
+/**
+ * @brief open the accelerator and allocate its DMA buffers. If the PL cannot
+ * be opened, the CPU engine is used.
+ *
+ * @param p_accelerator
+ * @param picture_size bytes of the largest picture
+ * @param trans_size bytes of the transform coefficients of all channels
+ * @return 0 or -1
+ */
+int accelerator_open(accelerator_t *p_accelerator, size_t picture_size,
+                     size_t trans_size) {
+#ifdef HAVE_AXITANGXI_IOCTL_H
+  p_accelerator->p_engine = NULL;
+  p_accelerator->fd = open(ACCELERATOR_DEVICE, O_RDWR | O_EXCL);
+  if (p_accelerator->fd == -1) {
+    perror(ACCELERATOR_DEVICE);
+    return cpu_open(p_accelerator, picture_size, trans_size);
+  }
+  p_accelerator->picture = dma_malloc(p_accelerator->fd, picture_size);
+  if (p_accelerator->picture == NULL) {
+    close(p_accelerator->fd);
+    return -1;
+  }
+  p_accelerator->trans = dma_malloc(p_accelerator->fd, trans_size);
+  if (p_accelerator->trans == NULL) {
+    munmap(p_accelerator->picture, picture_size);
+    close(p_accelerator->fd);
+    return -1;
+  }
+  p_accelerator->picture_size = picture_size;
+  p_accelerator->trans_size = trans_size;
+  p_accelerator->weight_size = 0;
+  return 0;
+#else
+  return cpu_open(p_accelerator, picture_size, trans_size);
+#endif
+}
+
+/**
+ * @brief send packed weights to the PL DRAM, they are used by all later
+ * pictures
+ *
+ * @param p_accelerator
+ * @param p_weights see weights_load()
+ * @return 0 or -1
+ */
+int accelerator_load_weights(accelerator_t *p_accelerator,
+                             const weights_t *p_weights) {
+  if (p_accelerator->p_engine) {
+    unsigned threads = p_accelerator->p_engine->threads;
+    engine_free(p_accelerator->p_engine);
+    return engine_init(p_accelerator->p_engine, p_weights, threads);
+  }
+#ifdef HAVE_AXITANGXI_IOCTL_H
+  const uint16_t *weights = p_weights->payload;
+  size_t size = p_weights->payload_size;
+  if (size == 0)
+    return 0;
+  void *buffer = dma_malloc(p_accelerator->fd, size);
+  if (buffer == NULL)
+    return -1;
+  memcpy(buffer, weights, size);
+  int status = transfer(p_accelerator, buffer, ACC_WEIGHT_ADDR, size,
+                        p_accelerator->trans, 0);
+  munmap(buffer, size);
+  if (status == 0)
+    p_accelerator->weight_size = size;
+  return status;
+#else
+  (void)p_weights;
+  errno = ENODEV;
+  return -1;
+#endif
+}
+
+/**
+ * @brief send a preprocessed channel to the PL DRAM and start the
+ * accelerator
+ *
+ * @param p_accelerator
+ * @param picture 16 bit little endian pixels, copied unless it is the
+ * picture DMA buffer
+ * @param width of the channel
+ * @param height of the channel
+ * @return 0 or -1
+ */
+int accelerator_submit(accelerator_t *p_accelerator, const uint16_t *picture,
+                       unsigned width, unsigned height) {
+  size_t size = preprocess_size(width, height) * sizeof(uint16_t);
+  if (size > p_accelerator->picture_size) {
+    errno = ENOBUFS;
+    perror(ACCELERATOR_DEVICE);
+    return -1;
+  }
+  if (p_accelerator->p_engine) {
+    p_accelerator->result = malloc((size_t)width * height * sizeof(int16_t));
+    if (p_accelerator->result == NULL) {
+      perror("accelerator");
+      return -1;
+    }
+    memcpy(p_accelerator->input, picture, size);
+    p_accelerator->width = width;
+    p_accelerator->height = height;
+    /* without a thread, the picture is transformed when it is waited for */
+    p_accelerator->running = pthread_create(&p_accelerator->thread, NULL,
+                                            cpu_run, p_accelerator) == 0;
+    return 0;
+  }
+#ifdef HAVE_AXITANGXI_IOCTL_H
+  if (picture != p_accelerator->picture)
+    memcpy(p_accelerator->picture, picture, size);
+  if (transfer(p_accelerator, p_accelerator->picture, ACC_PICTURE_ADDR, size,
+               p_accelerator->trans, 0) == -1)
+    return -1;
+  struct network_acc_reg reg = {
+      .weight_addr = ACC_WEIGHT_ADDR,
+      .weight_size = p_accelerator->weight_size,
+      .picture_addr = ACC_PICTURE_ADDR,
+      .picture_size = size,
+  };
+  if (ioctl(p_accelerator->fd, NETWORK_ACC_CONFIG, &reg) == -1) {
+    perror("NETWORK_ACC_CONFIG");
+    return -1;
+  }
+  if (ioctl(p_accelerator->fd, NETWORK_ACC_START, &reg) == -1) {
+    perror("NETWORK_ACC_START");
+    return -1;
+  }
+  return 0;
+#else
+  (void)picture;
+  errno = ENODEV;
+  return -1;
+#endif
+}
+
+/**
+ * @brief block until the accelerator raises its interrupt, then fetch the
+ * transform coefficients into the DMA buffer. They are not copied again, so
+ * every channel can be put at its own offset.
+ *
+ * @param p_accelerator
+ * @param offset coefficients before the channel in the DMA buffer
+ * @param size bytes of the 13 subbands of the channel
+ * @return the coefficients in the DMA buffer, see subband_table(), or NULL
+ */
+int16_t *accelerator_wait(accelerator_t *p_accelerator, size_t offset,
+                          size_t size) {
+  if (p_accelerator->p_engine) {
+    if (p_accelerator->running)
+      pthread_join(p_accelerator->thread, NULL);
+    else
+      cpu_run(p_accelerator);
+    p_accelerator->running = 0;
+    int16_t *trans = p_accelerator->trans + offset;
+    if (p_accelerator->status == -1)
+      trans = NULL;
+    else if (offset * sizeof(int16_t) + size > p_accelerator->trans_size ||
+             size > (size_t)p_accelerator->width * p_accelerator->height *
+                        sizeof(int16_t)) {
+      errno = ENOBUFS;
+      perror("accelerator");
+      trans = NULL;
+    } else
+      memcpy(trans, p_accelerator->result, size);
+    free(p_accelerator->result);
+    p_accelerator->result = NULL;
+    return trans;
+  }
+#ifdef HAVE_AXITANGXI_IOCTL_H
+  struct network_acc_reg reg = {0};
+  if (ioctl(p_accelerator->fd, NETWORK_ACC_GET, &reg) == -1) {
+    perror("NETWORK_ACC_GET");
+    return NULL;
+  }
+  if (offset * sizeof(int16_t) + size > p_accelerator->trans_size) {
+    errno = ENOBUFS;
+    perror(ACCELERATOR_DEVICE);
+    return NULL;
+  }
+  int16_t *trans = p_accelerator->trans + offset;
+  if (transfer(p_accelerator, p_accelerator->picture, ACC_PICTURE_ADDR, 0,
+               trans, size) == -1)
+    return NULL;
+  return trans;
+#else
+  (void)offset;
+  (void)size;
+  errno = ENODEV;
+  return NULL;
+#endif
+}
+
+void accelerator_close(accelerator_t *p_accelerator) {
+  if (p_accelerator->p_engine) {
+    cpu_close(p_accelerator);
+    return;
+  }
+#ifdef HAVE_AXITANGXI_IOCTL_H
+  munmap(p_accelerator->picture, p_accelerator->picture_size);
+  munmap(p_accelerator->trans, p_accelerator->trans_size);
+  close(p_accelerator->fd);
+#else
+  (void)p_accelerator;
+#endif
+}
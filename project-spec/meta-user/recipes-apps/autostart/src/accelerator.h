@@ -0,0 +1,57 @@
+#ifndef ACCELERATOR_H
+#define ACCELERATOR_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "engine.h"
+#include "weights.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ACCELERATOR_DEVICE
+#define ACCELERATOR_DEVICE "/dev/axi_tangxi"
+#endif
+
+/* Refer docs/resources/format.md */
+#define ACC_WEIGHT_ADDR 0x10000000
+#define ACC_PICTURE_ADDR 0x20000000
+#define ACC_TRANS_ADDR 0x40000000
+#define ACC_ENTROPY_ADDR 0x41000000
+
+typedef struct {
+  int fd;
+  size_t weight_size;
+  /*
+   * DMA buffers of the input picture and the transform coefficients. The
+   * picture can be written in place once the former one is submitted. The
+   * coefficients of all channels are kept, one channel after another.
+   */
+  uint16_t *picture;
+  size_t picture_size;
+  int16_t *trans;
+  size_t trans_size;
+  /*
+   * The CPU engine runs the networks if the PL cannot be opened, NULL
+   * otherwise. A submitted picture is copied to input and transformed by a
+   * thread into result.
+   */
+  engine_t *p_engine;
+  uint16_t *input;
+  int16_t *result;
+  pthread_t thread;
+  /* thread is transforming a picture */
+  int running;
+  unsigned width;
+  unsigned height;
+  int status;
+} accelerator_t;
+
+int accelerator_open(accelerator_t *, size_t, size_t);
+int accelerator_load_weights(accelerator_t *, const weights_t *);
+int accelerator_submit(accelerator_t *, const uint16_t *, unsigned, unsigned);
+int16_t *accelerator_wait(accelerator_t *, size_t, size_t);
+void accelerator_close(accelerator_t *);
+
+__END_DECLS
+#endif /* accelerator.h */
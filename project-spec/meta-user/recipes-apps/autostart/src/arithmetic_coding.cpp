@@ -18,7 +18,7 @@ void BitOutputStream::close() {
   while (m_numbitsfilled != 0)
     write(0);
 
-  m_bit_out.close();
+  m_bit_out.flush();
 }
 
 int BitInputStream::read() {
@@ -26,13 +26,12 @@ int BitInputStream::read() {
     return -1;
 
   if (m_numbitsremaining == 0) {
-    char temp;
-    if (m_bit_in.eof()) {
+    int temp = m_bit_in.get();
+    if (temp == std::char_traits<char>::eof()) {
       m_currentbyte = -1;
       return -1;
     }
-    m_bit_in.read(&temp, 1);
-    m_currentbyte = (int)temp;
+    m_currentbyte = temp;
     m_numbitsremaining = 8;
   }
   assert(m_numbitsremaining > 0);
@@ -50,7 +49,6 @@ int BitInputStream::read_no_eof() {
 }
 
 void BitInputStream::close() {
-  m_bit_in.close();
   m_currentbyte = -1;
   m_numbitsremaining = 0;
 }
@@ -69,7 +67,7 @@ void ArithmeticCoderBase::update(long long total, long long symlow,
                                  long long symhigh, char symbol) {
   long long low = m_low;
   long long high = m_high;
-  long long range = high - low;
+  long long range = high - low + 1;
   if (total > MAX_TOTAL)
     throw("Cannot code symbol because total is too large");
   long long newlow = low + symlow * range / total;
@@ -107,3 +105,48 @@ void ArithmeticEncoder::shift() {
 }
 
 void ArithmeticEncoder::underflow() { m_num_underflow += 1; }
+
+ArithmeticDecoder::ArithmeticDecoder(BitInputStream &bit_in)
+    : m_bit_in(bit_in), m_code(0) {
+  for (int i = 0; i < STATE_SIZE; i++)
+    m_code = m_code << 1 | read_code_bit();
+}
+
+// freqs[i] is the cumulative frequency of the symbol i, freqs[size] is the
+// total. Return the decoded symbol.
+long long ArithmeticDecoder::read(const long long *freqs, long long size) {
+  long long total = freqs[size];
+  if (total > MAX_TOTAL)
+    throw("Cannot decode symbol because total is too large");
+  long long range = m_high - m_low + 1;
+  long long offset = m_code - m_low;
+  long long value = ((offset + 1) * total - 1) / range;
+
+  // Find highest symbol such that freqs[symbol] <= value.
+  long long start = 0;
+  long long end = size;
+  while (end - start > 1) {
+    long long middle = (start + end) >> 1;
+    if (freqs[middle] > value)
+      end = middle;
+    else
+      start = middle;
+  }
+  update(total, freqs[start], freqs[start + 1], 0);
+  return start;
+}
+
+void ArithmeticDecoder::shift() {
+  m_code = ((m_code << 1) & MASK) | read_code_bit();
+}
+
+void ArithmeticDecoder::underflow() {
+  m_code = (m_code & TOP_MASK) | ((m_code << 1) & (MASK >> 1)) |
+           read_code_bit();
+}
+
+// The end of stream is treated as an infinite number of trailing zeros.
+int ArithmeticDecoder::read_code_bit() {
+  int bit = m_bit_in.read();
+  return bit == -1 ? 0 : bit;
+}
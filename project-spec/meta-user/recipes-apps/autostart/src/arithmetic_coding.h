@@ -6,7 +6,7 @@
 
 class BitOutputStream {
 public:
-  BitOutputStream(std::fstream &file)
+  BitOutputStream(std::ostream &file)
       : m_bit_out(file), m_currentbyte(0), m_numbitsfilled(0){};
   void write(char);
   void close();
@@ -16,12 +16,12 @@ private:
                        // the range [0x00, 0xFF]
   int m_numbitsfilled; // Number of accumulated bits in the current byte, always
                        // between 0 and 7 (inclusive)
-  std::fstream &m_bit_out;
+  std::ostream &m_bit_out;
 };
 
 class BitInputStream {
 public:
-  BitInputStream(std::fstream &file)
+  BitInputStream(std::istream &file)
       : m_bit_in(file), m_currentbyte(0), m_numbitsremaining(0){};
   int read();
   int read_no_eof();
@@ -32,7 +32,7 @@ private:
                      // range [0x00, 0xFF]
   int m_numbitsremaining; // Number of accumulated bits in the current byte,
                           // always between 0 and 7 (inclusive)
-  std::fstream &m_bit_in;
+  std::istream &m_bit_in;
 };
 
 class CountingBitOutputStream {
@@ -115,10 +115,14 @@ private:
 
 class ArithmeticDecoder : public ArithmeticCoderBase {
 public:
-  ArithmeticDecoder(ArithmeticCoderBase &bitin);
-  int read();
+  ArithmeticDecoder(BitInputStream &bit_in);
+  long long read(const long long *, long long);
+  void shift();
+  void underflow();
 
 private:
-  ArithmeticCoderBase &m_bitin;
-  long long code;
+  int read_code_bit();
+  BitInputStream &m_bit_in;
+  long long m_code; // The current raw code bits being buffered, which is
+                    // always in the range [low, high].
 };
@@ -0,0 +1,435 @@
+#include "arq.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
+#include <time.h>
+
+/* milliseconds */
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+static arq_slot_t *slot(arq_t *p_arq, n_frame_t n_frame) {
+  return &p_arq->slots[n_frame % ARQ_SLOT_NUMBER];
+}
+
+/* frames on the way */
+static n_frame_t in_flight(const arq_t *p_arq) {
+  return p_arq->next - p_arq->base;
+}
+
+static void arm(arq_t *p_arq);
+
+/* queue a due TP_CONTROL_SYNC, it asks until the other end is known */
+static void synchronize(arq_t *p_arq) {
+  if (!p_arq->sync)
+    return;
+  cmd_id_t argument = p_arq->session;
+  if (p_arq->peer == 0)
+    argument |= TP_CONTROL_SYNC_ASK;
+  frame_t sync = {.header = TP_HEADER,
+                  .address = p_arq->address,
+                  .frame_type = TP_FRAME_TYPE_CONTROL,
+                  .cmd_id = TP_CONTROL_CMD_ID(TP_CONTROL_SYNC, argument),
+                  .n_frame = p_arq->base};
+  tp_output_frame(&p_arq->output, &sync);
+  p_arq->sync = 0;
+  p_arq->sync_time = now();
+  if (p_arq->peer == 0)
+    arm(p_arq);
+}
+
+/* write the queued frames, and wait for the tty while some are left */
+static void flush(arq_t *p_arq) {
+  synchronize(p_arq);
+  ssize_t rest = tp_output_flush(&p_arq->output);
+  if (rest == -1) {
+    perror("arq");
+    event_loop_stop(p_arq->p_loop);
+    return;
+  }
+  uint32_t events = rest ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  if (events != p_arq->events &&
+      event_loop_modify(p_arq->p_loop, &p_arq->source, events) == 0)
+    p_arq->events = events;
+}
+
+static void transmit(arq_t *p_arq, arq_slot_t *p_slot) {
+  /* the other end learns the session before its frames */
+  synchronize(p_arq);
+  p_slot->time = now();
+  p_slot->transmissions++;
+  tp_output_frame(&p_arq->output, &p_slot->frame);
+}
+
+/* set the timer to the first frame or question to time out, if any */
+static void arm(arq_t *p_arq) {
+  double first = p_arq->peer == 0 ? p_arq->sync_time : 0;
+  for (n_frame_t n = p_arq->base; n != p_arq->next; n++) {
+    const arq_slot_t *p_slot = slot(p_arq, n);
+    if (!p_slot->acked && (first == 0 || p_slot->time < first))
+      first = p_slot->time;
+  }
+  unsigned long timeout = 0;
+  if (p_arq->sync) {
+    timeout = 1;
+  } else if (first != 0) {
+    double rest = first + p_arq->rto - now();
+    /* 0 would disarm the timer */
+    timeout = rest < 1 ? 1 : (unsigned long)rest + 1;
+  }
+  event_timer_set(&p_arq->timer, timeout, 0);
+}
+
+/* update the timeout by a round trip time */
+static void sample(arq_t *p_arq, double rtt) {
+  if (p_arq->srtt == 0) {
+    p_arq->srtt = rtt;
+    p_arq->rttvar = rtt / 2;
+  } else {
+    double error = rtt > p_arq->srtt ? rtt - p_arq->srtt : p_arq->srtt - rtt;
+    p_arq->rttvar = 0.75 * p_arq->rttvar + 0.25 * error;
+    p_arq->srtt = 0.875 * p_arq->srtt + 0.125 * rtt;
+  }
+  p_arq->rto = p_arq->srtt + 4 * p_arq->rttvar;
+  if (p_arq->rto < ARQ_RTO_MIN)
+    p_arq->rto = ARQ_RTO_MIN;
+  if (p_arq->rto > ARQ_RTO_MAX)
+    p_arq->rto = ARQ_RTO_MAX;
+}
+
+static void start(arq_t *p_arq, const frame_t *p_frame) {
+  arq_slot_t *p_slot = slot(p_arq, p_arq->next);
+  p_slot->frame = *p_frame;
+  p_slot->frame.n_frame = p_arq->next++;
+  p_slot->acked = 0;
+  p_slot->fast = 0;
+  p_slot->transmissions = 0;
+  transmit(p_arq, p_slot);
+  p_arq->sent++;
+  if (in_flight(p_arq) == 1)
+    arm(p_arq);
+}
+
+static int push(arq_t *p_arq, const frame_t *p_frame) {
+  if (p_arq->queue_number == p_arq->queue_capacity) {
+    size_t capacity = p_arq->queue_capacity ? 2 * p_arq->queue_capacity : 64;
+    frame_t *queue = malloc(capacity * sizeof(frame_t));
+    if (queue == NULL) {
+      perror("arq");
+      return -1;
+    }
+    for (size_t i = 0; i < p_arq->queue_number; i++)
+      queue[i] = p_arq->queue[(p_arq->queue_first + i) % p_arq->queue_capacity];
+    free(p_arq->queue);
+    p_arq->queue = queue;
+    p_arq->queue_capacity = capacity;
+    p_arq->queue_first = 0;
+  }
+  p_arq->queue[(p_arq->queue_first + p_arq->queue_number++) %
+               p_arq->queue_capacity] = *p_frame;
+  return 0;
+}
+
+/* send queued frames while the window has room */
+static void fill(arq_t *p_arq) {
+  while (p_arq->queue_number && in_flight(p_arq) < p_arq->window) {
+    start(p_arq, &p_arq->queue[p_arq->queue_first]);
+    p_arq->queue_first = (p_arq->queue_first + 1) % p_arq->queue_capacity;
+    p_arq->queue_number--;
+  }
+}
+
+/* send the frames which timed out again, and back off */
+static void expire(void *arg, uint64_t count) {
+  (void)count;
+  arq_t *p_arq = arg;
+  double time = now();
+  int expired = 0;
+  for (n_frame_t n = p_arq->base; n != p_arq->next; n++) {
+    arq_slot_t *p_slot = slot(p_arq, n);
+    if (p_slot->acked || time - p_slot->time < p_arq->rto)
+      continue;
+    transmit(p_arq, p_slot);
+    p_slot->fast = 0;
+    p_arq->retransmitted++;
+    expired = 1;
+  }
+  /* the question was not answered, ask again */
+  if (p_arq->peer == 0 && p_arq->sync_time != 0 &&
+      time - p_arq->sync_time >= p_arq->rto) {
+    p_arq->sync = 1;
+    expired = 1;
+  }
+  if (expired)
+    p_arq->rto = 2 * p_arq->rto < ARQ_RTO_MAX ? 2 * p_arq->rto : ARQ_RTO_MAX;
+  flush(p_arq);
+  arm(p_arq);
+}
+
+/*
+ * acknowledge a frame, and return the time it was sent if it was sent once,
+ * as the time of a sent again frame is ambiguous (Karn's algorithm)
+ */
+static double settle(arq_t *p_arq, n_frame_t n_frame) {
+  arq_slot_t *p_slot = slot(p_arq, n_frame);
+  if (p_slot->acked)
+    return 0;
+  p_slot->acked = 1;
+  return p_slot->transmissions == 1 ? p_slot->time : 0;
+}
+
+static void acknowledge(arq_t *p_arq, const frame_t *p_ack) {
+  n_frame_t cumulative = p_ack->n_frame, number = in_flight(p_arq);
+  cmd_id_t bits = TP_CONTROL_ARGUMENT(p_ack->cmd_id);
+  /* a late acknowledgement */
+  if ((n_frame_t)(cumulative - p_arq->base) > number)
+    return;
+  /* the last frame sent once and acknowledged now gives the sample */
+  double sent = 0, time;
+  for (n_frame_t n = p_arq->base; n != cumulative; n++)
+    if ((time = settle(p_arq, n)) > sent)
+      sent = time;
+  n_frame_t last = 0;
+  for (unsigned i = 0; i < TP_CONTROL_ACK_BITS; i++) {
+    n_frame_t n = cumulative + 1 + i;
+    if (bits >> i & 1 && (n_frame_t)(n - p_arq->base) < number) {
+      if ((time = settle(p_arq, n)) > sent)
+        sent = time;
+      last = i + 1;
+    }
+  }
+  if (sent != 0)
+    sample(p_arq, now() - sent);
+  /* frames before the last acknowledged one are lost, send them once */
+  for (n_frame_t i = 0; i < last; i++) {
+    arq_slot_t *p_slot = slot(p_arq, cumulative + i);
+    if (p_slot->acked || p_slot->fast)
+      continue;
+    p_slot->fast = 1;
+    transmit(p_arq, p_slot);
+    p_arq->retransmitted++;
+  }
+  n_frame_t base = p_arq->base;
+  while (p_arq->base != p_arq->next && slot(p_arq, p_arq->base)->acked)
+    p_arq->base++;
+  if (p_arq->base == base && sent == 0)
+    return;
+  fill(p_arq);
+  arm(p_arq);
+}
+
+/* follow the session of the other end, and answer its question */
+static void follow(arq_t *p_arq, const frame_t *p_sync) {
+  cmd_id_t argument = TP_CONTROL_ARGUMENT(p_sync->cmd_id);
+  cmd_id_t session = TP_CONTROL_SYNC_SESSION(argument);
+  if (session != p_arq->peer) {
+    p_arq->peer = session;
+    p_arq->sessions++;
+    p_arq->expected = p_arq->delivered = p_sync->n_frame;
+    memset(p_arq->received_flags, 0, sizeof(p_arq->received_flags));
+  }
+  if (!(argument & TP_CONTROL_SYNC_ASK))
+    return;
+  p_arq->sync = 1;
+  /* the answer goes before the frames, which were dropped */
+  for (n_frame_t n = p_arq->base; n != p_arq->next; n++) {
+    arq_slot_t *p_slot = slot(p_arq, n);
+    if (p_slot->acked)
+      continue;
+    transmit(p_arq, p_slot);
+    p_slot->fast = 0;
+    p_arq->retransmitted++;
+  }
+  arm(p_arq);
+}
+
+/* take a frame of the parser */
+static void input(void *arg, const frame_t *p_frame) {
+  arq_t *p_arq = arg;
+  if (p_frame->frame_type == TP_FRAME_TYPE_CONTROL &&
+      TP_CONTROL_COMMAND(p_frame->cmd_id) == TP_CONTROL_SYNC) {
+    follow(p_arq, p_frame);
+    return;
+  }
+  /* frames of an unknown session */
+  if (p_arq->peer == 0) {
+    p_arq->sync = 1;
+    return;
+  }
+  if (p_frame->frame_type == TP_FRAME_TYPE_CONTROL &&
+      TP_CONTROL_COMMAND(p_frame->cmd_id) == TP_CONTROL_ACK) {
+    acknowledge(p_arq, p_frame);
+    return;
+  }
+  /* the sender waits for frames from delivered on, they fit the slots */
+  n_frame_t first = p_arq->delivered;
+  unsigned index = p_frame->n_frame % ARQ_SLOT_NUMBER;
+  if ((n_frame_t)(p_frame->n_frame - first) >= ARQ_WINDOW_MAX ||
+      p_arq->received_flags[index]) {
+    p_arq->duplicates++;
+  } else {
+    p_arq->received[index] = *p_frame;
+    p_arq->received_flags[index] = 1;
+  }
+  while (p_arq->received_flags[p_arq->expected % ARQ_SLOT_NUMBER] &&
+         (n_frame_t)(p_arq->expected - first) < ARQ_WINDOW_MAX)
+    p_arq->expected++;
+  p_arq->ack = 1;
+}
+
+/* queue one acknowledgement of the frames of a read */
+static void acknowledge_all(arq_t *p_arq) {
+  frame_t ack = {.header = TP_HEADER,
+                 .address = p_arq->address,
+                 .frame_type = TP_FRAME_TYPE_CONTROL,
+                 .n_frame = p_arq->expected};
+  cmd_id_t bits = 0;
+  for (unsigned i = 0; i < TP_CONTROL_ACK_BITS; i++) {
+    n_frame_t n = p_arq->expected + 1 + i;
+    if ((n_frame_t)(n - p_arq->delivered) < ARQ_WINDOW_MAX &&
+        p_arq->received_flags[n % ARQ_SLOT_NUMBER])
+      bits |= (cmd_id_t)1 << i;
+  }
+  ack.cmd_id = TP_CONTROL_CMD_ID(TP_CONTROL_ACK, bits);
+  tp_output_frame(&p_arq->output, &ack);
+  p_arq->ack = 0;
+}
+
+static void ready(void *arg, uint32_t events) {
+  arq_t *p_arq = arg;
+  if (events & EPOLLIN) {
+    /* receive_frames() gives 0 for no bytes at hand, and for the end */
+    errno = 0;
+    ssize_t n = receive_frames(p_arq->fd, &p_arq->parser);
+    if (n == -1) {
+      perror("arq");
+      event_loop_stop(p_arq->p_loop);
+    } else if (n == 0 && errno == 0) {
+      fprintf(stderr, "arq: hung up\n");
+      event_loop_stop(p_arq->p_loop);
+    }
+  } else if (events & (EPOLLHUP | EPOLLERR)) {
+    fprintf(stderr, "arq: hung up\n");
+    event_loop_stop(p_arq->p_loop);
+  }
+  if (p_arq->ack)
+    acknowledge_all(p_arq);
+  /* acknowledge before the frames are handled, which may take long */
+  flush(p_arq);
+  if (p_arq->delivered == p_arq->expected)
+    return;
+  p_arq->handling = 1;
+  while (p_arq->delivered != p_arq->expected) {
+    unsigned index = p_arq->delivered++ % ARQ_SLOT_NUMBER;
+    p_arq->received_flags[index] = 0;
+    p_arq->callback(p_arq->arg, &p_arq->received[index]);
+  }
+  p_arq->handling = 0;
+  flush(p_arq);
+}
+
+/**
+ * @brief start selective repeat over a descriptor
+ *
+ * @param p_arq
+ * @param p_loop loop of the descriptor and the retransmission timer
+ * @param fd non-blocking
+ * @param address address of acknowledgements
+ * @param window frames on the way, up to ARQ_WINDOW_MAX, 0 for ARQ_WINDOW
+ * @param callback called with every frame in order
+ * @param arg first argument of callback
+ * @return 0, or -1 for an error
+ */
+int arq_init(arq_t *p_arq, event_loop_t *p_loop, int fd, address_t address,
+             unsigned window, tp_callback_t callback, void *arg) {
+  memset(p_arq, 0, sizeof(*p_arq));
+  p_arq->fd = fd;
+  p_arq->address = address;
+  p_arq->window = window == 0 ? ARQ_WINDOW : window;
+  if (p_arq->window > ARQ_WINDOW_MAX)
+    p_arq->window = ARQ_WINDOW_MAX;
+  p_arq->rto = ARQ_RTO_INITIAL;
+  p_arq->callback = callback;
+  p_arq->arg = arg;
+  p_arq->p_loop = p_loop;
+  p_arq->source = (event_source_t){.fd = fd, .callback = ready, .arg = p_arq};
+  p_arq->events = EPOLLIN;
+  tp_parser_init(&p_arq->parser, input, p_arq);
+  if (getrandom(&p_arq->session, sizeof(p_arq->session), 0) == -1)
+    p_arq->session = now();
+  p_arq->session = TP_CONTROL_SYNC_SESSION(p_arq->session);
+  if (p_arq->session == 0)
+    p_arq->session = 1;
+  /* the first TP_CONTROL_SYNC goes with the first frame or soon */
+  p_arq->sync = 1;
+  if (tp_output_init(&p_arq->output, fd) == -1)
+    return -1;
+  if (event_timer_init(p_loop, &p_arq->timer, expire, p_arq) == -1) {
+    tp_output_free(&p_arq->output);
+    return -1;
+  }
+  if (event_loop_add(p_loop, &p_arq->source, p_arq->events) == -1) {
+    event_timer_close(p_loop, &p_arq->timer);
+    tp_output_free(&p_arq->output);
+    return -1;
+  }
+  arm(p_arq);
+  return 0;
+}
+
+/**
+ * @brief send a frame, at once or when the window has room
+ *
+ * @param p_arq
+ * @param p_frame its n_frame is set
+ * @return 0, or -1 for an error
+ */
+int arq_send(arq_t *p_arq, const frame_t *p_frame) {
+  if (p_arq->queue_number || in_flight(p_arq) >= p_arq->window)
+    return push(p_arq, p_frame);
+  start(p_arq, p_frame);
+  if (!p_arq->handling)
+    flush(p_arq);
+  return 0;
+}
+
+/**
+ * @brief drop frames which wait for the window. Frames on the way still go.
+ *
+ * @param p_arq
+ * @param match whether to drop a frame
+ * @param arg first argument of match
+ * @return number of dropped frames
+ */
+size_t arq_cancel(arq_t *p_arq, int (*match)(void *, const frame_t *),
+                  void *arg) {
+  size_t kept = 0;
+  for (size_t i = 0; i < p_arq->queue_number; i++) {
+    const frame_t *p_frame =
+        &p_arq->queue[(p_arq->queue_first + i) % p_arq->queue_capacity];
+    if (!match(arg, p_frame))
+      p_arq->queue[(p_arq->queue_first + kept++) % p_arq->queue_capacity] =
+          *p_frame;
+  }
+  size_t dropped = p_arq->queue_number - kept;
+  p_arq->queue_number = kept;
+  return dropped;
+}
+
+/* whether every frame is acknowledged */
+int arq_idle(const arq_t *p_arq) {
+  return in_flight(p_arq) == 0 && p_arq->queue_number == 0;
+}
+
+void arq_close(arq_t *p_arq, event_loop_t *p_loop) {
+  event_loop_remove(p_loop, &p_arq->source);
+  event_timer_close(p_loop, &p_arq->timer);
+  tp_output_free(&p_arq->output);
+  free(p_arq->queue);
+  p_arq->queue = NULL;
+}
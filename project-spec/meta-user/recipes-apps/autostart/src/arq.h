@@ -0,0 +1,117 @@
+#ifndef ARQ_H
+#define ARQ_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "event_loop.h"
+#include "transmission_protocol.h"
+
+/*
+ * Selective repeat over a tty. Every frame but an acknowledgement or a sync has
+ * its n_frame in order, and up to a window of frames may be on the way. The
+ * receiver answers the frames of every read by an acknowledgement, a control
+ * frame of TP_CONTROL_ACK whose n_frame is the next frame it waits for and
+ * whose argument has bit i set for a received frame n_frame + 1 + i. The sender
+ * sends a missing frame again once a later frame is acknowledged, or when it
+ * is not acknowledged for a retransmission timeout. The receiver keeps the
+ * frames after a missing one and passes all frames on in order, once each.
+ *
+ * The timeout follows the round trip time of the link like TCP does (RFC
+ * 6298): a frame sent once and acknowledged gives a sample R, then
+ *
+ *   RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+ *   SRTT = 7/8 SRTT + 1/8 R
+ *   RTO = SRTT + 4 RTTVAR
+ *
+ * and the timeout doubles every time it expires, until the next sample.
+ *
+ * Every start of an end is a new session with a random ID. An end sends a
+ * control frame of TP_CONTROL_SYNC with its ID and the n_frame of its first
+ * frame on the way, which asks for the ID of the other end as long as it is
+ * unknown. It drops other frames until it knows the other end, and asks
+ * again when they come or the timeout expires. An end which gets a new ID
+ * waits for frames from that n_frame on, and one which is asked answers and
+ * sends its frames on the way again, as the other end dropped them. So either
+ * end may restart without the other.
+ *
+ * The tty is a source of the loop: frames are queued to a tp_output_t, and
+ * the frames queued by a callback go by one writev() when it returns, or when
+ * the tty takes more bytes. The loop stops when the tty fails or hangs up.
+ */
+#define ARQ_WINDOW_MAX (TP_CONTROL_ACK_BITS + 1)
+#define ARQ_WINDOW 16
+/* milliseconds */
+#define ARQ_RTO_INITIAL 1000
+#define ARQ_RTO_MIN 100
+#define ARQ_RTO_MAX 10000
+/* more than ARQ_WINDOW_MAX and a power of 2, for frames by n_frame */
+#define ARQ_SLOT_NUMBER 32
+
+typedef struct {
+  frame_t frame;
+  int acked;
+  /* sent again for a later acknowledged frame */
+  int fast;
+  /* milliseconds of the last transmission */
+  double time;
+  unsigned transmissions;
+} arq_slot_t;
+
+typedef struct {
+  int fd;
+  event_loop_t *p_loop;
+  event_source_t source;
+  /* events of the source */
+  uint32_t events;
+  tp_output_t output;
+  address_t address;
+  unsigned window;
+  /* milliseconds, SRTT is 0 before the first sample */
+  double srtt;
+  double rttvar;
+  double rto;
+  tp_parser_t parser;
+  event_timer_t timer;
+  /* sender: frames [base, next) are on the way */
+  n_frame_t base;
+  n_frame_t next;
+  arq_slot_t slots[ARQ_SLOT_NUMBER];
+  /* frames waiting for the window, a ring */
+  frame_t *queue;
+  size_t queue_capacity;
+  size_t queue_first;
+  size_t queue_number;
+  /* receiver: frames before expected arrived, before delivered are handled */
+  n_frame_t expected;
+  n_frame_t delivered;
+  frame_t received[ARQ_SLOT_NUMBER];
+  int received_flags[ARQ_SLOT_NUMBER];
+  /* IDs of this session and the session of the other end, 0 if unknown */
+  cmd_id_t session;
+  cmd_id_t peer;
+  /* a TP_CONTROL_SYNC is due, and the time of the last one */
+  int sync;
+  double sync_time;
+  /* an acknowledgement is due */
+  int ack;
+  /* frames are passed on, output waits for the end */
+  int handling;
+  tp_callback_t callback;
+  void *arg;
+  /* statistics */
+  unsigned long sent;
+  unsigned long retransmitted;
+  unsigned long duplicates;
+  /* sessions of the other end */
+  unsigned long sessions;
+} arq_t;
+
+int arq_init(arq_t *, event_loop_t *, int, address_t, unsigned, tp_callback_t,
+             void *);
+int arq_send(arq_t *, const frame_t *);
+size_t arq_cancel(arq_t *, int (*)(void *, const frame_t *), void *);
+int arq_idle(const arq_t *);
+void arq_close(arq_t *, event_loop_t *);
+
+__END_DECLS
+#endif /* arq.h */
@@ -1,13 +1,319 @@
 // 跟iwave完全对应:需要求出每一个的概率的原因是需要总的频率和，如果不求出就很难准确求出
 #include "coding.h"
 #include "arithmetic_coding.h"
+#include "stats.h"
 #include <iostream>
 #include <math.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define EM_ITERATIONS 8
+// a subband of integers cannot be sharper than this
+#define STD_MIN 0.2
 
 double normal_cdf(double index, double mean, double std) {
   return 1.0 / 2 * (1 + erf((index - mean) / std / sqrt(2)));
 }
 
+/*
+ * freqs[i] is the cumulative frequency of low_bound + i. Every symbol in
+ * [low_bound, high_bound] keeps a non-zero frequency to be codable. The CDF is
+ * the same on every machine, so the encoder and the decoder agree.
+ */
+static std::vector<long long> cumulative_freqs(const gmm_t *p_gmm) {
+  int size = p_gmm->high_bound - p_gmm->low_bound + 1;
+  std::vector<long long> freqs(size + 1);
+  std::vector<double> cdf(size + 1);
+  stats_gmm_cdf(cdf.data(), p_gmm, p_gmm->low_bound - 0.5, cdf.size());
+  freqs[0] = 0;
+  for (int i = 0; i < size; i++) {
+    long long freq = (long long)((cdf[i + 1] - cdf[i]) * FREQS_RESOLUTION);
+    freqs[i + 1] = freqs[i] + (freq > 0 ? freq : 1);
+  }
+  return freqs;
+}
+
+/**
+ * @brief fit a Gaussian mixture model to the histogram of a subband by EM
+ *
+ * @param coefficients
+ * @param n number of coefficients
+ * @param p_gmm
+ */
+extern "C" void gmm_fit(const int16_t *coefficients, size_t n, gmm_t *p_gmm) {
+  int16_t low_bound, high_bound;
+  stats_bounds(coefficients, n, &low_bound, &high_bound);
+  p_gmm->low_bound = low_bound;
+  p_gmm->high_bound = high_bound;
+
+  std::vector<size_t> hist(high_bound - low_bound + 1);
+  stats_histogram(hist.data(), hist.size(), coefficients, n, low_bound);
+  double sum = 0, square_sum = 0;
+  for (size_t i = 0; i < hist.size(); i++) {
+    double index = low_bound + (double)i;
+    sum += hist[i] * index;
+    square_sum += hist[i] * index * index;
+  }
+  double mean = n ? sum / n : 0;
+  double std = n ? sqrt(fmax(square_sum / n - mean * mean, 0)) : 0;
+  // a sharp, a normal and a flat component
+  const double scales[GMM_NUMBER] = {0.25, 1, 4};
+  for (int k = 0; k < GMM_NUMBER; k++) {
+    p_gmm->prob[k] = 1.0 / GMM_NUMBER;
+    p_gmm->mean[k] = mean;
+    p_gmm->std[k] = fmax(std * scales[k], STD_MIN);
+  }
+
+  for (int iteration = 0; iteration < EM_ITERATIONS && n; iteration++) {
+    double weights[GMM_NUMBER] = {0}, means[GMM_NUMBER] = {0},
+           squares[GMM_NUMBER] = {0};
+    for (size_t i = 0; i < hist.size(); i++) {
+      if (hist[i] == 0)
+        continue;
+      double index = low_bound + (double)i;
+      double responsibilities[GMM_NUMBER], total = 0;
+      for (int k = 0; k < GMM_NUMBER; k++) {
+        double z = (index - p_gmm->mean[k]) / p_gmm->std[k];
+        responsibilities[k] = p_gmm->prob[k] * exp(-z * z / 2) / p_gmm->std[k];
+        total += responsibilities[k];
+      }
+      if (total <= 0)
+        continue;
+      for (int k = 0; k < GMM_NUMBER; k++) {
+        double weight = hist[i] * responsibilities[k] / total;
+        weights[k] += weight;
+        means[k] += weight * index;
+        squares[k] += weight * index * index;
+      }
+    }
+    for (int k = 0; k < GMM_NUMBER; k++) {
+      if (weights[k] <= 0)
+        continue;
+      double mean_k = means[k] / weights[k];
+      p_gmm->prob[k] = weights[k] / n;
+      p_gmm->mean[k] = mean_k;
+      p_gmm->std[k] =
+          fmax(sqrt(fmax(squares[k] / weights[k] - mean_k * mean_k, 0)),
+               STD_MIN);
+    }
+  }
+}
+
+/**
+ * @brief arithmetic code a subband into an independent bit stream
+ *
+ * @param coefficients in [low_bound, high_bound] of p_gmm
+ * @param n number of coefficients
+ * @param p_gmm
+ * @param p_size size of returned bit stream
+ * @return bit stream which should be freed, or NULL
+ */
+extern "C" uint8_t *encode(const int16_t *coefficients, size_t n,
+                           const gmm_t *p_gmm, size_t *p_size) {
+  std::vector<long long> freqs = cumulative_freqs(p_gmm);
+  std::ostringstream stream(std::ios::out | std::ios::binary);
+  try {
+    BitOutputStream bit_out(stream);
+    CountingBitOutputStream c_bit_out(bit_out);
+    ArithmeticEncoder enc(c_bit_out);
+    for (size_t i = 0; i < n; i++) {
+      int index = coefficients[i] - p_gmm->low_bound;
+      enc.write(freqs.back(), freqs[index], freqs[index + 1], 0);
+    }
+    enc.finish();
+    c_bit_out.close();
+  } catch (const char *message) {
+    std::cerr << message << std::endl;
+    return NULL;
+  }
+  std::string bit_stream = stream.str();
+  uint8_t *p_bit_stream = (uint8_t *)malloc(bit_stream.size() + 1);
+  if (p_bit_stream == NULL) {
+    perror("bit_stream");
+    return NULL;
+  }
+  memcpy(p_bit_stream, bit_stream.data(), bit_stream.size());
+  *p_size = bit_stream.size();
+  return p_bit_stream;
+}
+
+/**
+ * @brief decode a bit stream from encode()
+ *
+ * @param bit_stream
+ * @param size bytes of bit stream
+ * @param p_gmm the model used by encode()
+ * @param coefficients decoded subband
+ * @param n number of coefficients
+ * @return 0 or -1
+ */
+extern "C" int decode(const uint8_t *bit_stream, size_t size,
+                      const gmm_t *p_gmm, int16_t *coefficients, size_t n) {
+  if (p_gmm->low_bound > p_gmm->high_bound) {
+    std::cerr << "wrong bounds: " << p_gmm->low_bound << " > "
+              << p_gmm->high_bound << std::endl;
+    return -1;
+  }
+  std::vector<long long> freqs = cumulative_freqs(p_gmm);
+  std::istringstream stream(std::string((const char *)bit_stream, size),
+                            std::ios::in | std::ios::binary);
+  try {
+    BitInputStream bit_in(stream);
+    ArithmeticDecoder dec(bit_in);
+    for (size_t i = 0; i < n; i++)
+      coefficients[i] =
+          p_gmm->low_bound + dec.read(freqs.data(), freqs.size() - 1);
+  } catch (const char *message) {
+    std::cerr << message << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief uniform scalar quantization, rounding to the nearest level
+ *
+ * @param coefficients quantized in place
+ * @param n number of coefficients
+ * @param step 1 is lossless
+ */
+extern "C" void quantize(int16_t *coefficients, size_t n, unsigned step) {
+  if (step <= 1)
+    return;
+  for (size_t i = 0; i < n; i++) {
+    int magnitude = (abs(coefficients[i]) + (int)step / 2) / (int)step;
+    coefficients[i] = coefficients[i] < 0 ? -magnitude : magnitude;
+  }
+}
+
+/**
+ * @brief reconstruct coefficients from quantize()
+ *
+ * @param coefficients dequantized in place
+ * @param n number of coefficients
+ * @param step
+ */
+extern "C" void dequantize(int16_t *coefficients, size_t n, unsigned step) {
+  if (step <= 1)
+    return;
+  for (size_t i = 0; i < n; i++) {
+    int value = coefficients[i] * (int)step;
+    coefficients[i] = value > INT16_MAX   ? INT16_MAX
+                      : value < INT16_MIN ? INT16_MIN
+                                          : value;
+  }
+}
+
+/**
+ * @brief rate-distortion optimized quantization. Every level may move one
+ * step towards 0 if the bits it saves under the model are worth more than the
+ * distortion it adds: (x - l' s)^2 + lambda bits(l') < (x - l s)^2 +
+ * lambda bits(l). The decision only depends on the level and |x|, so it is
+ * reduced to a limit of 2 |x| per level, and the pass over coefficients is a
+ * branchless compare.
+ *
+ * @param levels from quantize(), optimized in place
+ * @param coefficients before quantize()
+ * @param n number of coefficients
+ * @param step 1 is lossless and is kept
+ * @param p_gmm model fitted to levels
+ */
+extern "C" void rdoq(int16_t *levels, const int16_t *coefficients, size_t n,
+                     unsigned step, const gmm_t *p_gmm) {
+  if (step <= 1 || n == 0)
+    return;
+  int low_bound = p_gmm->low_bound < 0 ? p_gmm->low_bound : 0;
+  int high_bound = p_gmm->high_bound > 0 ? p_gmm->high_bound : 0;
+  // bits of every level by the frequencies of encode()
+  std::vector<double> bits(high_bound - low_bound + 1);
+  std::vector<double> cdf(bits.size() + 1);
+  stats_gmm_cdf(cdf.data(), p_gmm, low_bound - 0.5, cdf.size());
+  for (size_t i = 0; i < bits.size(); i++)
+    bits[i] = log2(FREQS_RESOLUTION /
+                   fmax((cdf[i + 1] - cdf[i]) * FREQS_RESOLUTION, 1));
+  // a level moves towards 0 if 2 |x| < limit, which is never for 0
+  std::vector<int32_t> limits(bits.size(), INT32_MIN);
+  for (int level = low_bound; level <= high_bound; level++) {
+    if (level == 0)
+      continue;
+    int toward = level > 0 ? level - 1 : level + 1;
+    double saved = bits[level - low_bound] - bits[toward - low_bound];
+    double limit = (2.0 * abs(level) - 1) * step + RDOQ_LAMBDA * step * saved;
+    limits[level - low_bound] =
+        (int32_t)fmin(fmax(ceil(limit), INT32_MIN), INT32_MAX);
+  }
+  const int32_t *p_limits = limits.data() - low_bound;
+  for (size_t i = 0; i < n; i++) {
+    int level = levels[i];
+    int sign = (level > 0) - (level < 0);
+    levels[i] = level - sign * (2 * abs(coefficients[i]) < p_limits[level]);
+  }
+}
+
+/**
+ * @brief histogram of coefficients, to estimate their size at any step
+ *
+ * @param p_histogram freed by histogram_free()
+ * @param coefficients
+ * @param n number of coefficients
+ * @return 0 or -1
+ */
+extern "C" int histogram_init(histogram_t *p_histogram,
+                              const int16_t *coefficients, size_t n) {
+  int16_t low_bound, high_bound;
+  stats_bounds(coefficients, n, &low_bound, &high_bound);
+  p_histogram->low_bound = low_bound;
+  p_histogram->size = high_bound - low_bound + 1;
+  p_histogram->n = n;
+  p_histogram->counts =
+      (size_t *)calloc(p_histogram->size, sizeof(*p_histogram->counts));
+  if (p_histogram->counts == NULL) {
+    perror("histogram");
+    return -1;
+  }
+  stats_histogram(p_histogram->counts, p_histogram->size, coefficients, n,
+                  low_bound);
+  return 0;
+}
+
+/**
+ * @brief estimate the size of coefficients after quantize() by the empirical
+ * entropy of their histogram, without fitting a model and coding them. The
+ * arithmetic coder with a fitted model is a few percent larger.
+ *
+ * @param p_histogram
+ * @param step
+ * @return bits
+ */
+extern "C" double estimate_bits(const histogram_t *p_histogram,
+                                unsigned step) {
+  if (step == 0)
+    step = 1;
+  int low_bound = p_histogram->low_bound;
+  int high_bound = low_bound + (int)p_histogram->size - 1;
+  // quantization is monotone, so levels are in [level(low), level(high)]
+  auto level = [step](int value) {
+    int magnitude = (abs(value) + (int)step / 2) / (int)step;
+    return value < 0 ? -magnitude : magnitude;
+  };
+  int low_level = level(low_bound);
+  std::vector<size_t> counts(level(high_bound) - low_level + 1);
+  for (size_t i = 0; i < p_histogram->size; i++)
+    counts[level(low_bound + (int)i) - low_level] += p_histogram->counts[i];
+  double bits = 0;
+  for (size_t count : counts)
+    if (count)
+      bits += count * log2((double)p_histogram->n / count);
+  return bits;
+}
+
+extern "C" void histogram_free(histogram_t *p_histogram) {
+  free(p_histogram->counts);
+  p_histogram->counts = NULL;
+}
+
 extern "C" void *coding() {
   double prob1, prob2, prob3; // 权重
   double mean1, mean2, mean3; //
@@ -3,9 +3,47 @@
 #include <sys/cdefs.h>
 __BEGIN_DECLS
 
+#include <stddef.h>
+#include <stdint.h>
+
 #define OUTPUT "/tmp/output.bin"
 
+#define GMM_NUMBER 3
+#define FREQS_RESOLUTION 1000000
+/*
+ * Lagrange multiplier of rate-distortion optimized quantization in units of
+ * step^2, 2 ln(2) / 12 from the high rate slope of a uniform quantizer
+ */
+#define RDOQ_LAMBDA 0.115
+
+/* Gaussian mixture model of a subband */
+typedef struct {
+  int16_t low_bound;
+  int16_t high_bound;
+  float prob[GMM_NUMBER];
+  float mean[GMM_NUMBER];
+  float std[GMM_NUMBER];
+} gmm_t;
+
+/* histogram of a substream for fast rate estimation */
+typedef struct {
+  int16_t low_bound;
+  /* counts[i] is the number of low_bound + i */
+  size_t *counts;
+  size_t size;
+  size_t n;
+} histogram_t;
+
 double normal_cdf(double index, double mean, double std);
+void gmm_fit(const int16_t *, size_t, gmm_t *);
+uint8_t *encode(const int16_t *, size_t, const gmm_t *, size_t *);
+int decode(const uint8_t *, size_t, const gmm_t *, int16_t *, size_t);
+void quantize(int16_t *, size_t, unsigned);
+void dequantize(int16_t *, size_t, unsigned);
+void rdoq(int16_t *, const int16_t *, size_t, unsigned, const gmm_t *);
+int histogram_init(histogram_t *, const int16_t *, size_t);
+double estimate_bits(const histogram_t *, unsigned);
+void histogram_free(histogram_t *);
 void *coding();
 
 __END_DECLS
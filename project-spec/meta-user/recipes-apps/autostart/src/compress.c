@@ -0,0 +1,785 @@
+/*
+ * Compress a raw image by the network accelerator, or its CPU engine, and
+ * entropy coding.
+ * Refer docs/resources/format.md
+ */
+#include "compress.h"
+#include "accelerator.h"
+#include "coding.h"
+#include "container.h"
+#include "image.h"
+#include "preprocess.h"
+#include "roi.h"
+#include "scheduler.h"
+#include "subband.h"
+#include "yuv.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ENTRY_NUMBER (IMAGE_CHANNELS * SUBBAND_NUMBER * 2)
+/* quality of rate control is the step of the finest subbands */
+#define QUALITY_MAX UINT16_MAX
+/* bytes of a substream besides its estimated bits, to flush the coder */
+#define SUBSTREAM_OVERHEAD 5
+/* codings of an image to refine the quality once it is in the budget */
+#define RATE_CONTROL_PASSES 4
+
+typedef struct {
+  const compress_opt_t *p_opt;
+  accelerator_t accelerator;
+  /* planar image */
+  const uint8_t *image;
+  /* image read from the file, NULL if it is received raw */
+  uint8_t *buffer;
+  unsigned width;
+  unsigned height;
+  /* coefficients of every channel in the DMA buffer of the accelerator */
+  int16_t *trans[IMAGE_CHANNELS];
+  /* layout of the coefficients of every channel */
+  subband_t subbands[IMAGE_CHANNELS][SUBBAND_NUMBER];
+  /* tile map of ROI and unchanged tiles, NULL if there is none */
+  roi_t *p_roi;
+  roi_t roi;
+  /* tiles of interest */
+  size_t foreground;
+  /* NULL if not in sequence mode */
+  reference_t *p_reference;
+  /* code against the reference */
+  int delta;
+  /* a foreground and a background substream per subband, NULL if unused */
+  container_entry_t entries[ENTRY_NUMBER];
+  uint8_t *bit_streams[ENTRY_NUMBER];
+  /* coefficients of the substreams before quantization */
+  const int16_t *values[ENTRY_NUMBER];
+  /* values gathered from a region, NULL if values are a whole subband */
+  int16_t *gathered[ENTRY_NUMBER];
+  size_t numbers[ENTRY_NUMBER];
+  /* coded quantization levels of the substreams */
+  int16_t *levels[ENTRY_NUMBER];
+} compressor_t;
+
+/* an entry to code */
+typedef struct {
+  unsigned i;
+  size_t n;
+} job_t;
+
+/* entries coded by threads */
+typedef struct {
+  compressor_t *p_compressor;
+  unsigned quality;
+  job_t jobs[ENTRY_NUMBER];
+  unsigned number;
+  unsigned next;
+  int status;
+  pthread_mutex_t mutex;
+} queue_t;
+
+static size_t channel_size(const compressor_t *p_compressor,
+                           unsigned channel) {
+  return (size_t)channel_width(p_compressor->width, channel) *
+         channel_height(p_compressor->height, channel);
+}
+
+/* bytes of the input picture of a channel */
+static size_t picture_size(const compressor_t *p_compressor,
+                           unsigned channel) {
+  return preprocess_size(channel_width(p_compressor->width, channel),
+                         channel_height(p_compressor->height, channel)) *
+         sizeof(uint16_t);
+}
+
+/*
+ * The scheduler preprocesses a channel after the former one is submitted, so
+ * it is written straight into the DMA buffer of the accelerator. A raw image
+ * is preprocessed while it is received.
+ */
+static int preprocess_channel(void *data, unsigned channel) {
+  compressor_t *p_compressor = data;
+  if (p_compressor->p_opt->p_raw)
+    return 0;
+  preprocess(p_compressor->accelerator.picture,
+             p_compressor->image + channel_offset(p_compressor->width,
+                                                  p_compressor->height,
+                                                  channel),
+             channel_width(p_compressor->width, channel),
+             channel_height(p_compressor->height, channel));
+  return 0;
+}
+
+static int submit_channel(void *data, unsigned channel) {
+  compressor_t *p_compressor = data;
+  const raw_t *p_raw = p_compressor->p_opt->p_raw;
+  return accelerator_submit(&p_compressor->accelerator,
+                            p_raw ? p_raw->pictures[channel]
+                                  : p_compressor->accelerator.picture,
+                            channel_width(p_compressor->width, channel),
+                            channel_height(p_compressor->height, channel));
+}
+
+static int wait_channel(void *data, unsigned channel) {
+  compressor_t *p_compressor = data;
+  p_compressor->trans[channel] = accelerator_wait(
+      &p_compressor->accelerator,
+      channel_offset(p_compressor->width, p_compressor->height, channel),
+      channel_size(p_compressor, channel) * sizeof(int16_t));
+  return p_compressor->trans[channel] ? 0 : -1;
+}
+
+/*
+ * quantization step of a subband at a quality, which is the step of the finest
+ * subbands. Every coarser level halves the step, as its coefficients spread
+ * over twice as many pixels in each direction.
+ */
+static unsigned subband_step(unsigned quality, unsigned subband) {
+  unsigned step = quality >> (subband_level(subband) - 1 + (subband == 0));
+  return step ? step : 1;
+}
+
+static unsigned entry_step(const compressor_t *p_compressor, unsigned i,
+                           unsigned quality) {
+  const container_entry_t *p_entry = &p_compressor->entries[i];
+  unsigned step = subband_step(quality, p_entry->subband);
+  /* background detail subbands are quantized more if there is a ROI */
+  if (p_entry->flags & CONTAINER_ENTRY_BACKGROUND &&
+      p_compressor->foreground && p_entry->subband != 0 &&
+      p_compressor->p_opt->background_step > 1)
+    step *= p_compressor->p_opt->background_step;
+  return step < UINT16_MAX ? step : UINT16_MAX;
+}
+
+/* sum of absolute values of coefficients or their residuals */
+static uint64_t magnitude(const int16_t *coefficients,
+                          const int16_t *predictions, size_t n) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; i++)
+    sum += abs(coefficients[i] - (predictions ? predictions[i] : 0));
+  return sum;
+}
+
+/*
+ * gather a region of a subband into the values of an entry. In sequence mode,
+ * take the residual of the reference if it is smaller.
+ */
+static int prepare_region(compressor_t *p_compressor, unsigned i, int region,
+                          const subband_view_t *p_view,
+                          const subband_view_t *p_reference,
+                          int16_t *predictions) {
+  container_entry_t *p_entry = &p_compressor->entries[i];
+  unsigned channel = p_entry->channel, subband = p_entry->subband;
+  unsigned width = channel_width(p_compressor->width, channel);
+  unsigned height = channel_height(p_compressor->height, channel);
+  size_t n = roi_gather(p_compressor->p_roi, channel, subband, width, height,
+                        region, NULL, 0, NULL);
+  if (n == 0)
+    return 0;
+  int16_t *values = malloc(n * sizeof(int16_t));
+  if (values == NULL) {
+    perror("region");
+    return -1;
+  }
+  roi_gather(p_compressor->p_roi, channel, subband, width, height, region,
+             p_view->data, p_view->stride, values);
+  if (p_compressor->delta) {
+    roi_gather(p_compressor->p_roi, channel, subband, width, height, region,
+               p_reference->data, p_reference->stride, predictions);
+    if (magnitude(values, predictions, n) < magnitude(values, NULL, n)) {
+      p_entry->flags |= CONTAINER_ENTRY_DELTA;
+      for (size_t j = 0; j < n; j++)
+        values[j] -= predictions[j];
+    }
+  }
+  p_compressor->values[i] = p_compressor->gathered[i] = values;
+  p_compressor->numbers[i] = n;
+  return 0;
+}
+
+/*
+ * split every subband into the values of independent substreams. If there is
+ * a ROI, the coefficients of the ROI and the background go into 2
+ * substreams. Unchanged tiles are not coded. A whole subband is coded from
+ * the DMA buffer without a copy.
+ */
+static int prepare_channel(compressor_t *p_compressor, unsigned channel) {
+  const compress_opt_t *p_opt = p_compressor->p_opt;
+  const subband_t *subbands = p_compressor->subbands[channel];
+  int16_t *predictions = NULL;
+  if (p_compressor->delta) {
+    predictions = malloc(channel_size(p_compressor, channel) *
+                         sizeof(int16_t));
+    if (predictions == NULL) {
+      perror("predictions");
+      return -1;
+    }
+  }
+  int status = 0;
+  for (unsigned subband = 0; subband < SUBBAND_NUMBER && status == 0;
+       subband++) {
+    unsigned i = (channel * SUBBAND_NUMBER + subband) * 2;
+    subband_view_t view =
+        subband_view(p_compressor->trans[channel], &subbands[subband]);
+    container_entry_t entry = {
+        .channel = channel,
+        .subband = subband,
+        .step = 1,
+        .layer = p_opt->progressive ? subband_layer(subband) : 0,
+    };
+    p_compressor->entries[i] = entry;
+    if (p_compressor->p_roi == NULL) {
+      p_compressor->values[i] = view.data;
+      p_compressor->numbers[i] = subband_size(&subbands[subband]);
+      continue;
+    }
+    /* background is sent after all layers of the ROI */
+    p_compressor->entries[i].flags = CONTAINER_ENTRY_FOREGROUND;
+    p_compressor->entries[i + 1] = entry;
+    p_compressor->entries[i + 1].flags = CONTAINER_ENTRY_BACKGROUND;
+    if (p_compressor->foreground)
+      p_compressor->entries[i + 1].layer +=
+          p_opt->progressive ? LAYER_NUMBER : 1;
+    subband_view_t reference = {0};
+    if (p_compressor->p_reference)
+      reference = subband_view(p_compressor->p_reference->trans[channel],
+                               &subbands[subband]);
+    if (prepare_region(p_compressor, i, ROI_FOREGROUND, &view, &reference,
+                       predictions) == -1 ||
+        prepare_region(p_compressor, i + 1, ROI_BACKGROUND, &view, &reference,
+                       predictions) == -1)
+      status = -1;
+  }
+  free(predictions);
+  return status;
+}
+
+/*
+ * quantize the values of an entry at a quality and code them. The levels are
+ * kept to reconstruct the reference.
+ */
+static int code_entry(compressor_t *p_compressor, unsigned i,
+                      unsigned quality) {
+  container_entry_t *p_entry = &p_compressor->entries[i];
+  size_t n = p_compressor->numbers[i];
+  if (p_compressor->levels[i] == NULL) {
+    p_compressor->levels[i] = malloc(n * sizeof(int16_t));
+    if (p_compressor->levels[i] == NULL) {
+      perror("levels");
+      return -1;
+    }
+  }
+  int16_t *levels = p_compressor->levels[i];
+  p_entry->step = entry_step(p_compressor, i, quality);
+  memcpy(levels, p_compressor->values[i], n * sizeof(int16_t));
+  quantize(levels, n, p_entry->step);
+  gmm_fit(levels, n, &p_entry->gmm);
+  if (p_compressor->p_opt->rdoq && p_entry->step > 1) {
+    rdoq(levels, p_compressor->values[i], n, p_entry->step, &p_entry->gmm);
+    gmm_fit(levels, n, &p_entry->gmm);
+  }
+  size_t size;
+  free(p_compressor->bit_streams[i]);
+  p_compressor->bit_streams[i] = encode(levels, n, &p_entry->gmm, &size);
+  if (p_compressor->bit_streams[i] == NULL)
+    return -1;
+  p_entry->size = size;
+  return 0;
+}
+
+static void *code_worker(void *arg) {
+  queue_t *p_queue = arg;
+  for (;;) {
+    pthread_mutex_lock(&p_queue->mutex);
+    if (p_queue->next == p_queue->number) {
+      pthread_mutex_unlock(&p_queue->mutex);
+      break;
+    }
+    unsigned i = p_queue->jobs[p_queue->next++].i;
+    pthread_mutex_unlock(&p_queue->mutex);
+    if (code_entry(p_queue->p_compressor, i, p_queue->quality) == -1) {
+      pthread_mutex_lock(&p_queue->mutex);
+      p_queue->status = -1;
+      pthread_mutex_unlock(&p_queue->mutex);
+    }
+  }
+  return NULL;
+}
+
+/* code the largest substreams first to balance the threads */
+static int compare_jobs(const void *p1, const void *p2) {
+  const job_t *p_job1 = p1, *p_job2 = p2;
+  return (p_job1->n < p_job2->n) - (p_job1->n > p_job2->n);
+}
+
+/* code entries [first, last) at a quality, substreams in parallel */
+static int code_entries(compressor_t *p_compressor, unsigned first,
+                        unsigned last, unsigned quality) {
+  queue_t queue = {
+      .p_compressor = p_compressor,
+      .quality = quality,
+      .mutex = PTHREAD_MUTEX_INITIALIZER,
+  };
+  for (unsigned i = first; i < last; i++)
+    if (p_compressor->values[i]) {
+      job_t job = {i, p_compressor->numbers[i]};
+      queue.jobs[queue.number++] = job;
+    }
+  qsort(queue.jobs, queue.number, sizeof(job_t), compare_jobs);
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned threads = processors > 0 ? processors : 1;
+  if (threads > queue.number)
+    threads = queue.number;
+  pthread_t thread_ids[ENTRY_NUMBER];
+  unsigned started = 0;
+  for (; started < threads; started++)
+    if (pthread_create(&thread_ids[started], NULL, code_worker, &queue) != 0) {
+      perror("pthread_create");
+      break;
+    }
+  /* if no thread can be created, code in this thread */
+  if (started == 0)
+    code_worker(&queue);
+  for (unsigned i = 0; i < started; i++)
+    pthread_join(thread_ids[i], NULL);
+  pthread_mutex_destroy(&queue.mutex);
+  return queue.status;
+}
+
+/*
+ * In sequence mode, update the reference with the coefficients the decoder
+ * reconstructs from the substreams of a channel.
+ */
+static int reconstruct_channel(compressor_t *p_compressor, unsigned channel) {
+  unsigned width = channel_width(p_compressor->width, channel);
+  unsigned height = channel_height(p_compressor->height, channel);
+  size_t n = channel_size(p_compressor, channel);
+  int16_t *buffer = malloc((n + 1) * sizeof(int16_t));
+  int16_t *predictions = malloc((n + 1) * sizeof(int16_t));
+  if (buffer == NULL || predictions == NULL) {
+    perror("reconstruct");
+    free(buffer);
+    free(predictions);
+    return -1;
+  }
+  for (unsigned i = channel * SUBBAND_NUMBER * 2;
+       i < (channel + 1) * SUBBAND_NUMBER * 2; i++) {
+    const container_entry_t *p_entry = &p_compressor->entries[i];
+    size_t region_n = p_compressor->numbers[i];
+    if (p_compressor->values[i] == NULL)
+      continue;
+    subband_view_t reference =
+        subband_view(p_compressor->p_reference->trans[channel],
+                     &p_compressor->subbands[channel][p_entry->subband]);
+    int region = p_entry->flags & CONTAINER_ENTRY_FOREGROUND ? ROI_FOREGROUND
+                                                             : ROI_BACKGROUND;
+    memcpy(buffer, p_compressor->levels[i], region_n * sizeof(int16_t));
+    dequantize(buffer, region_n, p_entry->step);
+    if (p_entry->flags & CONTAINER_ENTRY_DELTA) {
+      roi_gather(p_compressor->p_roi, channel, p_entry->subband, width,
+                 height, region, reference.data, reference.stride,
+                 predictions);
+      for (size_t j = 0; j < region_n; j++)
+        buffer[j] += predictions[j];
+    }
+    roi_scatter(p_compressor->p_roi, channel, p_entry->subband, width, height,
+                region, buffer, reference.data, reference.stride);
+  }
+  free(buffer);
+  free(predictions);
+  return 0;
+}
+
+/*
+ * code a channel once the accelerator has transformed it. Under a byte
+ * budget, channels are coded by rate_control() after all are transformed.
+ */
+static int entropy_channel(void *data, unsigned channel) {
+  compressor_t *p_compressor = data;
+  if (prepare_channel(p_compressor, channel) == -1)
+    return -1;
+  if (p_compressor->p_opt->budget)
+    return 0;
+  if (code_entries(p_compressor, channel * SUBBAND_NUMBER * 2,
+                   (channel + 1) * SUBBAND_NUMBER * 2,
+                   p_compressor->p_opt->quality) == -1)
+    return -1;
+  if (p_compressor->p_reference)
+    return reconstruct_channel(p_compressor, channel);
+  return 0;
+}
+
+/* bytes of the container with a payload */
+static size_t container_size(const compressor_t *p_compressor,
+                             size_t payload_size) {
+  container_header_t header = {
+      .width = p_compressor->width,
+      .height = p_compressor->height,
+      .roi_shift = p_compressor->p_roi ? p_compressor->p_roi->shift : 0,
+  };
+  for (unsigned i = 0; i < ENTRY_NUMBER; i++)
+    if (p_compressor->values[i])
+      header.entry_number++;
+  return container_index_size(&header) + payload_size;
+}
+
+/* estimated bytes of the container at a quality */
+static size_t estimate_size(const compressor_t *p_compressor,
+                            const histogram_t *histograms, unsigned quality) {
+  size_t payload_size = 0;
+  for (unsigned i = 0; i < ENTRY_NUMBER; i++)
+    if (p_compressor->values[i])
+      payload_size += (size_t)(estimate_bits(&histograms[i],
+                                             entry_step(p_compressor, i,
+                                                        quality)) /
+                               8) +
+                      SUBSTREAM_OVERHEAD;
+  return container_size(p_compressor, payload_size);
+}
+
+/* the finest quality from low whose estimated size is in a target */
+static unsigned search_quality(const compressor_t *p_compressor,
+                               const histogram_t *histograms, unsigned low,
+                               size_t target) {
+  /* estimated size decreases as quality increases */
+  unsigned high = QUALITY_MAX;
+  while (low < high) {
+    unsigned middle = low + (high - low) / 2;
+    if (estimate_size(p_compressor, histograms, middle) <= target)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return low;
+}
+
+static size_t coded_size(const compressor_t *p_compressor) {
+  size_t payload_size = 0;
+  for (unsigned i = 0; i < ENTRY_NUMBER; i++)
+    if (p_compressor->values[i])
+      payload_size += p_compressor->entries[i].size;
+  return container_size(p_compressor, payload_size);
+}
+
+/*
+ * code the image at the finest quality whose size is in the byte budget.
+ * Estimation misses the model overhead and RDOQ, so after every coding the
+ * target of estimation is corrected by the ratio of budget and coded size,
+ * and the search goes on while it finds a finer quality.
+ */
+static int rate_control(compressor_t *p_compressor) {
+  const compress_opt_t *p_opt = p_compressor->p_opt;
+  histogram_t histograms[ENTRY_NUMBER] = {0};
+  int status = 0;
+  for (unsigned i = 0; i < ENTRY_NUMBER && status == 0; i++)
+    if (p_compressor->values[i])
+      status = histogram_init(&histograms[i], p_compressor->values[i],
+                              p_compressor->numbers[i]);
+  size_t target = p_opt->budget, size = 0;
+  unsigned low = p_opt->quality > 1 ? p_opt->quality : 1;
+  /* the finest quality in the budget, and the quality of the substreams */
+  unsigned best = 0, coded = 0;
+  for (unsigned pass = 0; status == 0; pass++) {
+    unsigned quality = search_quality(p_compressor, histograms, low, target);
+    if (quality == coded ||
+        (best && (quality >= best || pass == RATE_CONTROL_PASSES)))
+      break;
+    status = code_entries(p_compressor, 0, ENTRY_NUMBER, quality);
+    coded = quality;
+    size = coded_size(p_compressor);
+    if (size <= p_opt->budget || quality == QUALITY_MAX)
+      best = quality;
+    else
+      /* finer qualities are over the budget too */
+      low = quality + 1;
+    target = target * p_opt->budget / size;
+  }
+  if (status == 0 && coded != best) {
+    status = code_entries(p_compressor, 0, ENTRY_NUMBER, best);
+    size = coded_size(p_compressor);
+  }
+  for (unsigned i = 0; i < ENTRY_NUMBER; i++)
+    histogram_free(&histograms[i]);
+  if (status == -1)
+    return -1;
+  printf("slave: quality %u, %zu of %zu bytes\n", best, size,
+         p_opt->budget);
+  if (size > p_opt->budget)
+    fprintf(stderr, "slave: %zu bytes are over the budget\n", size);
+  for (unsigned channel = 0;
+       channel < IMAGE_CHANNELS && p_compressor->p_reference; channel++)
+    if (reconstruct_channel(p_compressor, channel) == -1)
+      return -1;
+  return 0;
+}
+
+/* the CPU engine without transform layers gives the linear lifting */
+static uint8_t transform_id(const compressor_t *p_compressor) {
+  const engine_t *p_engine = p_compressor->accelerator.p_engine;
+  return p_engine && p_engine->lifting_number == 0
+             ? CONTAINER_TRANSFORM_LIFTING
+             : CONTAINER_TRANSFORM_NETWORK;
+}
+
+/*
+ * In progressive mode, substreams are put layer by layer. In a layer, Y comes
+ * before U and V, and subbands keep their order.
+ */
+static int write_container(compressor_t *p_compressor, FILE *file) {
+  unsigned layer_number = p_compressor->p_opt->progressive ? LAYER_NUMBER : 1;
+  container_header_t header = {
+      .width = p_compressor->width,
+      .height = p_compressor->height,
+      .channels = IMAGE_CHANNELS,
+      .levels = TRANSFORM_LEVELS,
+      .subbands = SUBBAND_NUMBER,
+      .transform_id = transform_id(p_compressor),
+      .family_id = CONTAINER_FAMILY_GMM,
+      .layer_number =
+          p_compressor->foreground ? 2 * layer_number : layer_number,
+      .flags = p_compressor->delta ? CONTAINER_FLAG_DELTA : 0,
+  };
+  container_entry_t entries[ENTRY_NUMBER];
+  uint8_t *bit_streams[ENTRY_NUMBER];
+  unsigned n = 0;
+  for (unsigned layer = 0; layer < header.layer_number; layer++)
+    for (unsigned i = 0; i < ENTRY_NUMBER; i++)
+      if (p_compressor->bit_streams[i] &&
+          p_compressor->entries[i].layer == layer) {
+        entries[n] = p_compressor->entries[i];
+        bit_streams[n++] = p_compressor->bit_streams[i];
+      }
+  header.entry_number = n;
+  return container_write(file, &header, entries, bit_streams,
+                         p_compressor->p_roi);
+}
+
+/* allocate the reference of sequence mode at the first image */
+static int init_reference(compressor_t *p_compressor) {
+  reference_t *p_reference = p_compressor->p_reference;
+  if (p_reference->image == NULL)
+    p_reference->image = malloc(IMAGE_SIZE);
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++)
+    if (p_reference->trans[channel] == NULL)
+      p_reference->trans[channel] =
+          malloc(channel_size(p_compressor, channel) * sizeof(int16_t));
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++)
+    if (p_reference->image == NULL || p_reference->trans[channel] == NULL) {
+      perror("reference");
+      reference_free(p_reference);
+      return -1;
+    }
+  return 0;
+}
+
+/*
+ * tile map of ROI from the master and the brightness detector, and of
+ * unchanged tiles in sequence mode
+ */
+static int init_roi(compressor_t *p_compressor) {
+  const compress_opt_t *p_opt = p_compressor->p_opt;
+  reference_t *p_reference = p_compressor->p_reference;
+  if (p_opt->rect_number == 0 && p_opt->roi_contrast == 0 &&
+      p_reference == NULL)
+    return 0;
+  roi_t *p_roi = &p_compressor->roi;
+  if (roi_init(p_roi, p_compressor->width, p_compressor->height,
+               ROI_TILE_SHIFT) == -1)
+    return -1;
+  for (unsigned i = 0; i < p_opt->rect_number; i++)
+    roi_add_rect(p_roi, &p_opt->rects[i]);
+  /* Y is the first channel of image */
+  if (p_opt->roi_contrast)
+    roi_detect(p_roi, p_compressor->image, p_compressor->width,
+               p_compressor->height, p_opt->roi_contrast);
+  p_compressor->foreground = roi_count(p_roi, ROI_FOREGROUND);
+  size_t tile_number = (size_t)p_roi->width * p_roi->height;
+  if (p_opt->rect_number || p_opt->roi_contrast)
+    printf("slave: %zu of %zu tiles are of interest\n",
+           p_compressor->foreground, tile_number);
+  if (p_reference) {
+    p_compressor->delta = p_reference->count != 0 &&
+                          p_reference->count < p_opt->key_interval;
+    if (p_compressor->delta)
+      printf("slave: %zu of %zu tiles are unchanged\n",
+             roi_detect_changes(p_roi, p_compressor->image,
+                                p_reference->image, p_compressor->width,
+                                p_compressor->height,
+                                p_opt->change_threshold),
+             tile_number);
+    else
+      printf("slave: key image\n");
+  }
+  if (p_compressor->foreground == 0 && p_reference == NULL)
+    roi_free(p_roi);
+  else
+    p_compressor->p_roi = p_roi;
+  return 0;
+}
+
+static uint8_t *read_image(const char *filename, size_t size) {
+  struct stat file_stat;
+  if (stat(filename, &file_stat) == -1) {
+    perror(filename);
+    return NULL;
+  }
+  if ((size_t)file_stat.st_size != size) {
+    fprintf(stderr, "%s: size %ld is not %zu\n", filename, file_stat.st_size,
+            size);
+    return NULL;
+  }
+  uint8_t *image = malloc(size);
+  if (image == NULL) {
+    perror(filename);
+    return NULL;
+  }
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    perror(filename);
+    free(image);
+    return NULL;
+  }
+  if (fread(image, 1, size, file) != size) {
+    perror(filename);
+    fclose(file);
+    free(image);
+    return NULL;
+  }
+  fclose(file);
+  return image;
+}
+
+/* split a packed image into planar channels, the packed image is freed */
+static uint8_t *planarize(uint8_t *packed, unsigned width, unsigned height,
+                          int format) {
+  uint8_t *image = malloc((size_t)width * height * 2);
+  if (image == NULL) {
+    perror("image");
+    free(packed);
+    return NULL;
+  }
+  yuv_deinterleave(image + channel_offset(width, height, CHANNEL_Y),
+                   image + channel_offset(width, height, CHANNEL_U),
+                   image + channel_offset(width, height, CHANNEL_V), packed,
+                   (size_t)width * height, format);
+  free(packed);
+  return image;
+}
+
+/**
+ * @brief compress a raw image. Channels are pipelined between the
+ * accelerator and the CPU.
+ *
+ * @param input YUV422 raw image in the layout of p_opt->format, unused if
+ * p_opt->p_raw is given
+ * @param output compressed bit stream
+ * @param p_opt NULL for default options
+ * @return 0 or -1
+ */
+int compress(const char *input, const char *output,
+             const compress_opt_t *p_opt) {
+  int status = -1;
+  const compress_opt_t default_compress_opt = {
+      .progressive = 1,
+      .background_step = 1,
+      .quality = 1,
+  };
+  compressor_t compressor = {
+      .p_opt = p_opt ? p_opt : &default_compress_opt,
+      .width = IMAGE_WIDTH,
+      .height = IMAGE_HEIGHT,
+  };
+  compressor.p_reference = compressor.p_opt->p_reference;
+  if (compressor.p_opt->p_raw) {
+    compressor.image = compressor.p_opt->p_raw->image;
+  } else {
+    compressor.buffer = read_image(input, IMAGE_SIZE);
+    if (compressor.buffer && compressor.p_opt->format != YUV_PLANAR)
+      compressor.buffer =
+          planarize(compressor.buffer, compressor.width, compressor.height,
+                    compressor.p_opt->format);
+    if (compressor.buffer == NULL)
+      return -1;
+    compressor.image = compressor.buffer;
+  }
+  if (compressor.p_reference && init_reference(&compressor) == -1)
+    goto free_buffers;
+  if (init_roi(&compressor) == -1)
+    goto free_buffers;
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++)
+    subband_table(compressor.subbands[channel],
+                  channel_width(compressor.width, channel),
+                  channel_height(compressor.height, channel), SUBBAND_PACKED);
+  if (accelerator_open(&compressor.accelerator,
+                       picture_size(&compressor, CHANNEL_Y),
+                       channel_offset(compressor.width, compressor.height,
+                                      IMAGE_CHANNELS) *
+                           sizeof(int16_t)) == -1)
+    goto free_buffers;
+  if (compressor.p_opt->p_weights &&
+      accelerator_load_weights(&compressor.accelerator,
+                               compressor.p_opt->p_weights) == -1)
+    goto close_accelerator;
+
+  const stages_t stages = {
+      .preprocess = preprocess_channel,
+      .submit = submit_channel,
+      .wait = wait_channel,
+      .entropy = entropy_channel,
+  };
+  timestamp_t timestamps[IMAGE_CHANNELS];
+  status = schedule(&stages, &compressor, IMAGE_CHANNELS, timestamps);
+  if (status == -1)
+    goto close_accelerator;
+  print_timestamps(timestamps, IMAGE_CHANNELS);
+  if (compressor.p_opt->budget && rate_control(&compressor) == -1) {
+    status = -1;
+    goto close_accelerator;
+  }
+
+  FILE *file = fopen(output, "w");
+  if (file == NULL) {
+    perror(output);
+    status = -1;
+    goto close_accelerator;
+  }
+  if (write_container(&compressor, file) == -1)
+    status = -1;
+  if (fclose(file) == EOF) {
+    perror(output);
+    status = -1;
+  }
+  if (compressor.p_reference && status == 0) {
+    roi_update_reference(compressor.p_roi, compressor.p_reference->image,
+                         compressor.image, compressor.width,
+                         compressor.height);
+    compressor.p_reference->count =
+        compressor.delta ? compressor.p_reference->count + 1 : 1;
+  }
+close_accelerator:
+  accelerator_close(&compressor.accelerator);
+free_buffers:
+  for (unsigned i = 0; i < ENTRY_NUMBER; i++) {
+    free(compressor.bit_streams[i]);
+    free(compressor.gathered[i]);
+    free(compressor.levels[i]);
+  }
+  if (compressor.p_roi)
+    roi_free(compressor.p_roi);
+  /* the reference is partly updated, the next image must be a key image */
+  if (compressor.p_reference && status == -1)
+    compressor.p_reference->count = 0;
+  free(compressor.buffer);
+  return status;
+}
+
+void reference_free(reference_t *p_reference) {
+  free(p_reference->image);
+  p_reference->image = NULL;
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    free(p_reference->trans[channel]);
+    p_reference->trans[channel] = NULL;
+  }
+  p_reference->count = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "image.h"
+#include "raw.h"
+#include "weights.h"
+#include "roi.h"
+#include "yuv.h"
+
+/*
+ * Reference of sequence mode, kept between images. It holds what the decoder
+ * will have after decoding the last image.
+ */
+typedef struct {
+  /* images since the last key image, 0 if there is no reference */
+  unsigned count;
+  /* pixels of the last coded version of every tile */
+  uint8_t *image;
+  /* reconstructed coefficients, subbands one after another */
+  int16_t *trans[IMAGE_CHANNELS];
+} reference_t;
+
+typedef struct {
+  /* layout of raw images, YUV_PLANAR, YUV_UYVY or YUV_YUYV */
+  int format;
+  /* emit substreams coarse to fine in layers, LL first and Y before U/V */
+  int progressive;
+  /* regions of interest given by the master */
+  roi_rect_t rects[ROI_RECT_MAX];
+  unsigned rect_number;
+  /* detect bright tiles as ROI if not 0, see roi_detect() */
+  unsigned roi_contrast;
+  /* quantization step of background detail subbands if there is a ROI */
+  unsigned background_step;
+  /*
+   * sequence mode if not NULL: code only tiles changed since the reference.
+   * The decoder needs every substream of the reference, so a master which
+   * stops downloading at a layer cannot decode the delta images after it.
+   */
+  reference_t *p_reference;
+  /*
+   * a tile is changed if its mean absolute difference is more than this. It
+   * is compared to the last coded version of the tile, not to the image
+   * before, so errors don't accumulate: at quality 1 the mean absolute error
+   * of the samples of a tile is at most change_threshold. An error of a
+   * sample is larger, around coded tiles the inverse transform mixes them
+   * with the coefficients of unchanged tiles: with 2, noise of 0 to 2 and a
+   * drift of a level an image give errors up to 8.
+   */
+  unsigned change_threshold;
+  /* code a key image without reference every key_interval images */
+  unsigned key_interval;
+  /*
+   * quantization step of the finest subbands, halved every coarser level. 1
+   * is lossless, otherwise near-lossless: every coefficient is within half a
+   * step, or 1.5 steps with rdoq.
+   */
+  unsigned quality;
+  /* rate-distortion optimized quantization if not 0, see rdoq() */
+  int rdoq;
+  /* bytes per image if not 0, rate control chooses the finest quality */
+  size_t budget;
+  /*
+   * if not NULL, a complete raw image of IMAGE_WIDTH x IMAGE_HEIGHT which is
+   * already preprocessed, the input file is not read
+   */
+  const raw_t *p_raw;
+  /* weights sent to the PL DRAM before the image if not NULL */
+  const weights_t *p_weights;
+} compress_opt_t;
+
+int compress(const char *, const char *, const compress_opt_t *);
+void reference_free(reference_t *);
+
+__END_DECLS
+#endif /* compress.h */
@@ -0,0 +1,332 @@
+#include "container.h"
+#include "crc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK_SUM_OFFSET 28
+
+static void put_u16(uint8_t *p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+  put_u16(p, value);
+  put_u16(p + 2, value >> 16);
+}
+
+static void put_float(uint8_t *p, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put_u32(p, bits);
+}
+
+static uint16_t get_u16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint32_t get_u32(const uint8_t *p) {
+  return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+static float get_float(const uint8_t *p) {
+  uint32_t bits = get_u32(p);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void put_header(uint8_t *p, const container_header_t *p_header) {
+  memset(p, 0, CONTAINER_HEADER_SIZE);
+  memcpy(p, CONTAINER_MAGIC, 4);
+  p[4] = p_header->version;
+  p[5] = CONTAINER_HEADER_SIZE;
+  put_u16(p + 6, CONTAINER_ENTRY_SIZE);
+  put_u16(p + 8, p_header->flags);
+  put_u16(p + 10, p_header->width);
+  put_u16(p + 12, p_header->height);
+  p[14] = p_header->channels;
+  p[15] = p_header->levels;
+  p[16] = p_header->subbands;
+  p[17] = p_header->transform_id;
+  p[18] = p_header->family_id;
+  p[19] = p_header->layer_number;
+  put_u16(p + 20, p_header->model_id);
+  put_u16(p + 22, p_header->entry_number);
+  put_u32(p + 24, p_header->payload_size);
+  p[30] = p_header->roi_shift;
+}
+
+static void put_entry(uint8_t *p, const container_entry_t *p_entry) {
+  memset(p, 0, CONTAINER_ENTRY_SIZE);
+  p[0] = p_entry->channel;
+  p[1] = p_entry->subband;
+  put_u16(p + 2, p_entry->flags);
+  put_u32(p + 4, p_entry->offset);
+  put_u32(p + 8, p_entry->size);
+  put_u16(p + 12, p_entry->step);
+  p[14] = p_entry->layer;
+  put_u16(p + 16, p_entry->gmm.low_bound);
+  put_u16(p + 18, p_entry->gmm.high_bound);
+  for (int k = 0; k < GMM_NUMBER; k++) {
+    put_float(p + 20 + 4 * k, p_entry->gmm.prob[k]);
+    put_float(p + 32 + 4 * k, p_entry->gmm.mean[k]);
+    put_float(p + 44 + 4 * k, p_entry->gmm.std[k]);
+  }
+}
+
+static void get_entry(const uint8_t *p, container_entry_t *p_entry) {
+  p_entry->channel = p[0];
+  p_entry->subband = p[1];
+  p_entry->flags = get_u16(p + 2);
+  p_entry->offset = get_u32(p + 4);
+  p_entry->size = get_u32(p + 8);
+  p_entry->step = get_u16(p + 12);
+  p_entry->layer = p[14];
+  p_entry->gmm.low_bound = (int16_t)get_u16(p + 16);
+  p_entry->gmm.high_bound = (int16_t)get_u16(p + 18);
+  for (int k = 0; k < GMM_NUMBER; k++) {
+    p_entry->gmm.prob[k] = get_float(p + 20 + 4 * k);
+    p_entry->gmm.mean[k] = get_float(p + 32 + 4 * k);
+    p_entry->gmm.std[k] = get_float(p + 44 + 4 * k);
+  }
+}
+
+/* bytes of ROI map */
+static size_t roi_map_size(unsigned width, unsigned height, unsigned shift) {
+  if (shift == 0)
+    return 0;
+  size_t tiles = (size_t)((width + (1u << shift) - 1) >> shift) *
+                 ((height + (1u << shift) - 1) >> shift);
+  return (tiles + 3) / 4;
+}
+
+size_t container_index_size(const container_header_t *p_header) {
+  return CONTAINER_HEADER_SIZE +
+         (size_t)p_header->entry_number * CONTAINER_ENTRY_SIZE +
+         roi_map_size(p_header->width, p_header->height, p_header->roi_shift);
+}
+
+/**
+ * @brief get the size of the index of a container from its first bytes, so a
+ * receiver knows when it can call container_read()
+ *
+ * @param data
+ * @param size bytes received
+ * @return size of header and entries, 0 if size is too small to know, -1 if
+ * data is not a container
+ */
+ssize_t container_peek_index_size(const uint8_t *data, size_t size) {
+  if (size < CONTAINER_HEADER_SIZE)
+    return 0;
+  if (memcmp(data, CONTAINER_MAGIC, 4) != 0)
+    return -1;
+  return data[5] + (size_t)get_u16(data + 22) * get_u16(data + 6) +
+         roi_map_size(get_u16(data + 10), get_u16(data + 12), data[30]);
+}
+
+/**
+ * @brief write a container. Offsets of entries and payload size of header are
+ * filled, substreams are written in the order of entries.
+ *
+ * @param file
+ * @param p_header
+ * @param entries
+ * @param substreams substreams[i] belongs to entries[i]
+ * @param p_roi NULL if there is no ROI
+ * @return 0 or -1
+ */
+int container_write(FILE *file, container_header_t *p_header,
+                    container_entry_t *entries, uint8_t *const *substreams,
+                    const roi_t *p_roi) {
+  if (p_header->entry_number > CONTAINER_ENTRY_MAX) {
+    fprintf(stderr, "container: %u entries are more than %u\n",
+            p_header->entry_number, CONTAINER_ENTRY_MAX);
+    return -1;
+  }
+  uint32_t offset = 0;
+  for (unsigned i = 0; i < p_header->entry_number; i++) {
+    entries[i].offset = offset;
+    offset += entries[i].size;
+  }
+  p_header->version = CONTAINER_VERSION;
+  p_header->payload_size = offset;
+  p_header->roi_shift = p_roi ? p_roi->shift : 0;
+
+  size_t size = container_index_size(p_header);
+  uint8_t *index = calloc(size, 1);
+  if (index == NULL) {
+    perror("container");
+    return -1;
+  }
+  put_header(index, p_header);
+  for (unsigned i = 0; i < p_header->entry_number; i++)
+    put_entry(index + CONTAINER_HEADER_SIZE + i * CONTAINER_ENTRY_SIZE,
+              &entries[i]);
+  if (p_roi) {
+    uint8_t *map = index + CONTAINER_HEADER_SIZE +
+                   p_header->entry_number * CONTAINER_ENTRY_SIZE;
+    for (size_t i = 0; i < (size_t)p_roi->width * p_roi->height; i++)
+      map[i / 4] |= (p_roi->map[i] & 3) << i % 4 * 2;
+  }
+  put_u16(index + CHECK_SUM_OFFSET, crc16(index, size));
+  int status = fwrite(index, 1, size, file) == size ? 0 : -1;
+  free(index);
+  for (unsigned i = 0; i < p_header->entry_number && status == 0; i++)
+    if (fwrite(substreams[i], 1, entries[i].size, file) != entries[i].size)
+      status = -1;
+  if (status == -1)
+    perror("container");
+  return status;
+}
+
+/**
+ * @brief parse a container in memory. Substreams are not copied.
+ *
+ * @param p_container entries should be freed by container_free()
+ * @param data
+ * @param size bytes of data, can be less than the whole container if the
+ * payload is truncated, then truncated entries have a size of 0
+ * @return 0 or -1
+ */
+int container_read(container_t *p_container, const uint8_t *data,
+                   size_t size) {
+  container_header_t *p_header = &p_container->header;
+  p_container->entries = NULL;
+  p_container->roi.map = NULL;
+  if (size < CONTAINER_HEADER_SIZE || memcmp(data, CONTAINER_MAGIC, 4) != 0) {
+    fprintf(stderr, "container: wrong magic\n");
+    return -1;
+  }
+  p_header->version = data[4];
+  if (p_header->version != CONTAINER_VERSION) {
+    fprintf(stderr, "container: unsupported version %u\n", p_header->version);
+    return -1;
+  }
+  size_t header_size = data[5];
+  size_t entry_size = get_u16(data + 6);
+  if (header_size < CONTAINER_HEADER_SIZE ||
+      entry_size < CONTAINER_ENTRY_SIZE) {
+    fprintf(stderr, "container: wrong header size %zu or entry size %zu\n",
+            header_size, entry_size);
+    return -1;
+  }
+  p_header->flags = get_u16(data + 8);
+  p_header->width = get_u16(data + 10);
+  p_header->height = get_u16(data + 12);
+  p_header->channels = data[14];
+  p_header->levels = data[15];
+  p_header->subbands = data[16];
+  p_header->transform_id = data[17];
+  p_header->family_id = data[18];
+  /* all substreams are in one layer if the writer doesn't know layers */
+  p_header->layer_number = data[19] ? data[19] : 1;
+  p_header->model_id = get_u16(data + 20);
+  p_header->entry_number = get_u16(data + 22);
+  p_header->payload_size = get_u32(data + 24);
+  p_header->roi_shift = data[30];
+  if (p_header->entry_number > CONTAINER_ENTRY_MAX) {
+    fprintf(stderr, "container: %u entries are more than %u\n",
+            p_header->entry_number, CONTAINER_ENTRY_MAX);
+    return -1;
+  }
+  size_t entries_end = header_size + p_header->entry_number * entry_size;
+  size_t index_size =
+      entries_end + roi_map_size(p_header->width, p_header->height,
+                                 p_header->roi_shift);
+  if (size < index_size) {
+    fprintf(stderr, "container: truncated index\n");
+    return -1;
+  }
+
+  uint8_t *index = malloc(index_size);
+  if (index == NULL) {
+    perror("container");
+    return -1;
+  }
+  memcpy(index, data, index_size);
+  put_u16(index + CHECK_SUM_OFFSET, 0);
+  uint16_t check_sum = crc16(index, index_size);
+  free(index);
+  if (check_sum != get_u16(data + CHECK_SUM_OFFSET)) {
+    fprintf(stderr, "container: incorrect check sum: %d is not %d!\n",
+            get_u16(data + CHECK_SUM_OFFSET), check_sum);
+    return -1;
+  }
+
+  p_container->entries =
+      malloc((p_header->entry_number + 1) * sizeof(container_entry_t));
+  if (p_container->entries == NULL) {
+    perror("container");
+    return -1;
+  }
+  if (p_header->roi_shift) {
+    if (roi_init(&p_container->roi, p_header->width, p_header->height,
+                 p_header->roi_shift) == -1) {
+      container_free(p_container);
+      return -1;
+    }
+    const uint8_t *map = data + entries_end;
+    for (size_t i = 0;
+         i < (size_t)p_container->roi.width * p_container->roi.height; i++)
+      p_container->roi.map[i] = map[i / 4] >> i % 4 * 2 & 3;
+  }
+  p_container->index_size = index_size;
+  p_container->payload = data + index_size;
+  size_t payload_size = size - index_size;
+  for (unsigned i = 0; i < p_header->entry_number; i++) {
+    container_entry_t *p_entry = &p_container->entries[i];
+    get_entry(data + header_size + i * entry_size, p_entry);
+    if (p_entry->channel >= p_header->channels ||
+        p_entry->subband >= p_header->subbands ||
+        p_entry->layer >= p_header->layer_number ||
+        (p_entry->flags & (CONTAINER_ENTRY_FOREGROUND |
+                           CONTAINER_ENTRY_BACKGROUND) &&
+         p_header->roi_shift == 0) ||
+        (p_entry->flags & CONTAINER_ENTRY_DELTA &&
+         !(p_header->flags & CONTAINER_FLAG_DELTA))) {
+      fprintf(stderr, "container: wrong entry %u\n", i);
+      container_free(p_container);
+      return -1;
+    }
+    if (p_entry->offset > payload_size ||
+        p_entry->size > payload_size - p_entry->offset)
+      p_entry->size = 0;
+  }
+  return 0;
+}
+
+/**
+ * @brief find the entry of a subband of a channel
+ *
+ * @return NULL if not found
+ */
+const container_entry_t *container_find(const container_t *p_container,
+                                        unsigned channel, unsigned subband) {
+  for (unsigned i = 0; i < p_container->header.entry_number; i++)
+    if (p_container->entries[i].channel == channel &&
+        p_container->entries[i].subband == subband)
+      return &p_container->entries[i];
+  return NULL;
+}
+
+/**
+ * @brief get the size of the container prefix which holds all substreams of
+ * layers up to the given one
+ *
+ * @param p_container
+ * @param layer
+ * @return bytes from the start of the container to the end of the layer
+ */
+size_t container_layer_end(const container_t *p_container, unsigned layer) {
+  size_t end = p_container->header.payload_size;
+  for (unsigned i = 0; i < p_container->header.entry_number; i++)
+    if (p_container->entries[i].layer > layer &&
+        p_container->entries[i].offset < end)
+      end = p_container->entries[i].offset;
+  return p_container->index_size + end;
+}
+
+void container_free(container_t *p_container) {
+  free(p_container->entries);
+  p_container->entries = NULL;
+  roi_free(&p_container->roi);
+}
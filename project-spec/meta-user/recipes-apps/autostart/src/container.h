@@ -0,0 +1,154 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "coding.h"
+#include "roi.h"
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Compressed image container. All fields are little endian.
+ *
+ * | bytes              | name                                   |
+ * | ------------------ | -------------------------------------- |
+ * | 32                 | header                                 |
+ * | 56 x entry_number  | entries, one per substream             |
+ * | ...                | ROI map if ROI shift is not 0          |
+ * | ...                | substreams in the order of the entries |
+ *
+ * header:
+ *
+ * | offset | bytes | name                                            |
+ * | ------ | ----- | ----------------------------------------------- |
+ * | 0      | 4     | magic "DSDC"                                    |
+ * | 4      | 1     | version                                         |
+ * | 5      | 1     | header size                                     |
+ * | 6      | 2     | entry size                                      |
+ * | 8      | 2     | flags                                           |
+ * | 10     | 2     | width                                           |
+ * | 12     | 2     | height                                          |
+ * | 14     | 1     | channels                                        |
+ * | 15     | 1     | transform levels                                |
+ * | 16     | 1     | subbands per channel                            |
+ * | 17     | 1     | transform ID                                    |
+ * | 18     | 1     | model family ID                                 |
+ * | 19     | 1     | layer number                                    |
+ * | 20     | 2     | model ID                                        |
+ * | 22     | 2     | entry number                                    |
+ * | 24     | 4     | payload size                                    |
+ * | 28     | 2     | CRC-16/MODBUS of header and entries             |
+ * | 30     | 1     | ROI shift, tiles are 2^shift x 2^shift pixels   |
+ * | 31     | 1     | reserved                                        |
+ *
+ * entry:
+ *
+ * | offset | bytes | name                                            |
+ * | ------ | ----- | ----------------------------------------------- |
+ * | 0      | 1     | channel                                         |
+ * | 1      | 1     | subband                                         |
+ * | 2      | 2     | flags, which region the substream covers        |
+ * | 4      | 4     | offset of substream from the start of payload   |
+ * | 8      | 4     | size of substream                               |
+ * | 12     | 2     | quantization step, 1 is lossless                |
+ * | 14     | 1     | layer                                           |
+ * | 15     | 1     | reserved                                        |
+ * | 16     | 2     | low bound                                       |
+ * | 18     | 2     | high bound                                      |
+ * | 20     | 36    | float prob[3], mean[3], std[3]                  |
+ *
+ * The ROI map has 2 bits per tile, ROI_BACKGROUND, ROI_FOREGROUND or
+ * ROI_UNCHANGED, tiles in raster order from LSB to MSB. If there is a ROI map,
+ * a subband can be split into a substream of the coefficients in the ROI and a
+ * substream of the background, both in raster order. Unchanged tiles are in
+ * neither.
+ *
+ * A delta container refers to the image decoded before it. Its unchanged
+ * tiles are copied from the reference, and its substreams flagged delta are
+ * residuals of the reference.
+ *
+ * A progressive container puts its substreams coarse to fine in layers: every
+ * layer comes after all entries of former layers, so any prefix of the payload
+ * which ends at a layer boundary decodes to a complete lower quality image.
+ *
+ * Readers skip unknown trailing bytes of header and entries, so new fields
+ * can be appended without breaking old readers.
+ */
+#define CONTAINER_MAGIC "DSDC"
+/* 2 has the frequencies of the portable CDF of stats_gmm_cdf() */
+#define CONTAINER_VERSION 2
+#define CONTAINER_HEADER_SIZE 32
+#define CONTAINER_ENTRY_SIZE 56
+/*
+ * bounds what a reader allocates for a broken header, far more than the
+ * substreams of any image
+ */
+#define CONTAINER_ENTRY_MAX 1024
+
+/* transform IDs */
+#define CONTAINER_TRANSFORM_NETWORK 0
+/* the linear lifting of wavelet_forward(), the decoder can invert it */
+#define CONTAINER_TRANSFORM_LIFTING 1
+
+/* header flags */
+#define CONTAINER_FLAG_DELTA (1 << 0)
+
+/* entry flags, a substream covers the whole subband without them */
+#define CONTAINER_ENTRY_FOREGROUND (1 << 0)
+#define CONTAINER_ENTRY_BACKGROUND (1 << 1)
+/* the substream is the residual of the reference */
+#define CONTAINER_ENTRY_DELTA (1 << 2)
+
+/* model family IDs */
+/* every substream has its own Gaussian mixture model */
+#define CONTAINER_FAMILY_GMM 0
+
+typedef struct {
+  uint8_t version;
+  uint16_t flags;
+  uint16_t width;
+  uint16_t height;
+  uint8_t channels;
+  uint8_t levels;
+  uint8_t subbands;
+  uint8_t transform_id;
+  uint8_t family_id;
+  uint8_t layer_number;
+  uint16_t model_id;
+  uint16_t entry_number;
+  uint32_t payload_size;
+  uint8_t roi_shift;
+} container_header_t;
+
+typedef struct {
+  uint8_t channel;
+  uint8_t subband;
+  uint16_t flags;
+  uint32_t offset;
+  uint32_t size;
+  uint16_t step;
+  uint8_t layer;
+  gmm_t gmm;
+} container_entry_t;
+
+typedef struct {
+  container_header_t header;
+  container_entry_t *entries;
+  roi_t roi;
+  size_t index_size;
+  const uint8_t *payload;
+} container_t;
+
+size_t container_index_size(const container_header_t *);
+ssize_t container_peek_index_size(const uint8_t *, size_t);
+int container_write(FILE *, container_header_t *, container_entry_t *,
+                    uint8_t *const *, const roi_t *);
+int container_read(container_t *, const uint8_t *, size_t);
+const container_entry_t *container_find(const container_t *, unsigned,
+                                        unsigned);
+size_t container_layer_end(const container_t *, unsigned);
+void container_free(container_t *);
+
+__END_DECLS
+#endif /* container.h */
@@ -0,0 +1,202 @@
+/*
+ * 16 bit convolution kernels of the CPU engine.
+ */
+#include "conv.h"
+#include "simd.h"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* taps of the largest kernel */
+#define TAPS_MAX 9
+
+static const int16_t zeros[TAPS_MAX];
+
+/* columns [first, last) */
+static inline void pair_scalar(int32_t *sums, const int16_t *const *rows0,
+                               const int16_t *const *rows1,
+                               const int16_t *weights0,
+                               const int16_t *weights1, int kh, int kw,
+                               unsigned width, unsigned first,
+                               unsigned last) {
+  int radius = kw / 2;
+  for (unsigned x = first; x < last; x++) {
+    uint32_t sum = sums[x];
+    for (int ky = 0; ky < kh; ky++) {
+      if (rows0[ky] == NULL)
+        continue;
+      for (int kx = 0; kx < kw; kx++) {
+        long column = (long)x + kx - radius;
+        if (column < 0 || column >= (long)width)
+          continue;
+        sum += (uint32_t)(weights0[ky * kw + kx] * rows0[ky][column]);
+        sum += (uint32_t)(weights1[ky * kw + kx] * rows1[ky][column]);
+      }
+    }
+    sums[x] = (int32_t)sum;
+  }
+}
+
+#if defined(__SSE2__)
+/* columns from radius, all taps in the row, and return the next column */
+static inline unsigned pair_sse2(int32_t *sums, const int16_t *const *rows0,
+                                 const int16_t *const *rows1,
+                                 const int16_t *weights0,
+                                 const int16_t *weights1, int kh, int kw,
+                                 unsigned width) {
+  unsigned radius = kw / 2, x = radius;
+  __m128i weights[TAPS_MAX];
+  for (int i = 0; i < kh * kw; i++)
+    weights[i] = _mm_set1_epi32((uint16_t)weights0[i] |
+                                (uint32_t)(uint16_t)weights1[i] << 16);
+  for (; x + 8 + radius <= width; x += 8) {
+    __m128i low = _mm_loadu_si128((const __m128i *)(sums + x));
+    __m128i high = _mm_loadu_si128((const __m128i *)(sums + x + 4));
+    for (int ky = 0; ky < kh; ky++) {
+      if (rows0[ky] == NULL)
+        continue;
+      for (int kx = 0; kx < kw; kx++) {
+        __m128i a =
+            _mm_loadu_si128((const __m128i *)(rows0[ky] + x + kx - radius));
+        __m128i b =
+            _mm_loadu_si128((const __m128i *)(rows1[ky] + x + kx - radius));
+        __m128i w = weights[ky * kw + kx];
+        /* a0 b0 a1 b1 ... times w0 w1 */
+        low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+        high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+      }
+    }
+    _mm_storeu_si128((__m128i *)(sums + x), low);
+    _mm_storeu_si128((__m128i *)(sums + x + 4), high);
+  }
+  return x;
+}
+
+__attribute__((target("avx2"))) static inline unsigned
+pair_avx2(int32_t *sums, const int16_t *const *rows0,
+          const int16_t *const *rows1, const int16_t *weights0,
+          const int16_t *weights1, int kh, int kw, unsigned width) {
+  unsigned radius = kw / 2, x = radius;
+  __m256i weights[TAPS_MAX];
+  for (int i = 0; i < kh * kw; i++)
+    weights[i] = _mm256_set1_epi32((uint16_t)weights0[i] |
+                                   (uint32_t)(uint16_t)weights1[i] << 16);
+  for (; x + 16 + radius <= width; x += 16) {
+    __m256i sums0 = _mm256_loadu_si256((const __m256i *)(sums + x));
+    __m256i sums1 = _mm256_loadu_si256((const __m256i *)(sums + x + 8));
+    /* unpacking works in 128 bit lanes: x0-3 x8-11 and x4-7 x12-15 */
+    __m256i low = _mm256_permute2x128_si256(sums0, sums1, 0x20);
+    __m256i high = _mm256_permute2x128_si256(sums0, sums1, 0x31);
+    for (int ky = 0; ky < kh; ky++) {
+      if (rows0[ky] == NULL)
+        continue;
+      for (int kx = 0; kx < kw; kx++) {
+        __m256i a = _mm256_loadu_si256(
+            (const __m256i *)(rows0[ky] + x + kx - radius));
+        __m256i b = _mm256_loadu_si256(
+            (const __m256i *)(rows1[ky] + x + kx - radius));
+        low = _mm256_add_epi32(low,
+                               _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b),
+                                                 weights[ky * kw + kx]));
+        high = _mm256_add_epi32(high,
+                                _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b),
+                                                  weights[ky * kw + kx]));
+      }
+    }
+    _mm256_storeu_si256((__m256i *)(sums + x),
+                        _mm256_permute2x128_si256(low, high, 0x20));
+    _mm256_storeu_si256((__m256i *)(sums + x + 8),
+                        _mm256_permute2x128_si256(low, high, 0x31));
+  }
+  return x;
+}
+#elif defined(__ARM_NEON)
+static inline unsigned pair_neon(int32_t *sums, const int16_t *const *rows0,
+                                 const int16_t *const *rows1,
+                                 const int16_t *weights0,
+                                 const int16_t *weights1, int kh, int kw,
+                                 unsigned width) {
+  unsigned radius = kw / 2, x = radius;
+  for (; x + 8 + radius <= width; x += 8) {
+    int32x4_t low = vld1q_s32(sums + x), high = vld1q_s32(sums + x + 4);
+    for (int ky = 0; ky < kh; ky++) {
+      if (rows0[ky] == NULL)
+        continue;
+      for (int kx = 0; kx < kw; kx++) {
+        int16x8_t a = vld1q_s16(rows0[ky] + x + kx - radius);
+        int16x8_t b = vld1q_s16(rows1[ky] + x + kx - radius);
+        int16_t w0 = weights0[ky * kw + kx], w1 = weights1[ky * kw + kx];
+        low = vmlal_n_s16(low, vget_low_s16(a), w0);
+        high = vmlal_n_s16(high, vget_high_s16(a), w0);
+        low = vmlal_n_s16(low, vget_low_s16(b), w1);
+        high = vmlal_n_s16(high, vget_high_s16(b), w1);
+      }
+    }
+    vst1q_s32(sums + x, low);
+    vst1q_s32(sums + x + 4, high);
+  }
+  return x;
+}
+#endif
+
+static inline void pair(int32_t *sums, const int16_t *const *rows0,
+                        const int16_t *const *rows1, const int16_t *weights0,
+                        const int16_t *weights1, int kh, int kw,
+                        unsigned width) {
+  if (rows1 == NULL) {
+    rows1 = rows0;
+    weights1 = zeros;
+  }
+  unsigned radius = kw / 2, x = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_AVX2)
+    x = pair_avx2(sums, rows0, rows1, weights0, weights1, kh, kw, width);
+  else if (level >= SIMD_SSE2)
+    x = pair_sse2(sums, rows0, rows1, weights0, weights1, kh, kw, width);
+#elif defined(__ARM_NEON)
+  if (level >= SIMD_NEON)
+    x = pair_neon(sums, rows0, rows1, weights0, weights1, kh, kw, width);
+#endif
+  if (x == 0) {
+    pair_scalar(sums, rows0, rows1, weights0, weights1, kh, kw, width, 0,
+                width);
+    return;
+  }
+  /* SIMD kernels start at the radius and leave a tail */
+  pair_scalar(sums, rows0, rows1, weights0, weights1, kh, kw, width, 0,
+              radius < width ? radius : width);
+  pair_scalar(sums, rows0, rows1, weights0, weights1, kh, kw, width, x, width);
+}
+
+/**
+ * @brief add a pair of inputs of 3x3 kernels to a row of sums
+ *
+ * @param sums width sums of an output channel
+ * @param rows0 3 rows of the first input, NULL out of the picture
+ * @param rows1 3 rows of the second input, or NULL
+ * @param weights0 weights[y][x] of the first input
+ * @param weights1 weights[y][x] of the second input
+ * @param width
+ */
+void conv_3x3(int32_t *sums, const int16_t *const *rows0,
+              const int16_t *const *rows1, const int16_t *weights0,
+              const int16_t *weights1, unsigned width) {
+  pair(sums, rows0, rows1, weights0, weights1, 3, 3, width);
+}
+
+/* like conv_3x3(), for 3 rows and 1 column */
+void conv_3x1(int32_t *sums, const int16_t *const *rows0,
+              const int16_t *const *rows1, const int16_t *weights0,
+              const int16_t *weights1, unsigned width) {
+  pair(sums, rows0, rows1, weights0, weights1, 3, 1, width);
+}
+
+/* like conv_3x3(), for 1 row and 1 column */
+void conv_1x1(int32_t *sums, const int16_t *const *rows0,
+              const int16_t *const *rows1, const int16_t *weights0,
+              const int16_t *weights1, unsigned width) {
+  pair(sums, rows0, rows1, weights0, weights1, 1, 1, width);
+}
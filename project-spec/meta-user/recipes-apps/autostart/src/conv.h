@@ -0,0 +1,36 @@
+#ifndef CONV_H
+#define CONV_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+
+/*
+ * 16 bit convolution kernels with widening multiply-accumulate into 32 bit
+ * sums, dispatched by simd_level(). Sums wrap, so all kernels give the same
+ * bits.
+ *
+ * Like the weights of the PL DRAM, a kernel takes a pair of input channels
+ * and adds them to the sums of a row of an output channel, for a kh x kw
+ * kernel:
+ *
+ *   sums[x] += w0[ky][kx] in0[ky][x + kx - kw / 2]
+ *            + w1[ky][kx] in1[ky][x + kx - kw / 2]
+ *
+ * in0[ky] and in1[ky] are the rows at y + ky - kh / 2 of the inputs, NULL if
+ * they are out of the picture. Columns out of [0, width) are 0. in1 is NULL
+ * for the last input of an odd number of inputs.
+ */
+typedef void (*conv_t)(int32_t *, const int16_t *const *,
+                       const int16_t *const *, const int16_t *,
+                       const int16_t *, unsigned);
+
+void conv_3x3(int32_t *, const int16_t *const *, const int16_t *const *,
+              const int16_t *, const int16_t *, unsigned);
+void conv_3x1(int32_t *, const int16_t *const *, const int16_t *const *,
+              const int16_t *, const int16_t *, unsigned);
+void conv_1x1(int32_t *, const int16_t *const *, const int16_t *const *,
+              const int16_t *, const int16_t *, unsigned);
+
+__END_DECLS
+#endif /* conv.h */
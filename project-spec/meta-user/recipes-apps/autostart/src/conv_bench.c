@@ -0,0 +1,97 @@
+/*
+ * Benchmark of the convolution kernels of the CPU engine, every kernel shape
+ * at every SIMD level of the CPU. A layer of 16 inputs and 16 outputs runs on
+ * rows of a 4K channel.
+ *
+ * Run:
+ * conv_bench [-w WIDTH] [-r ROWS]
+ */
+#include "conv.h"
+#include "simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHANNELS 16
+
+static double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned width = 3840, rows = 64;
+  int c;
+  while ((c = getopt(argc, argv, "w:r:")) != -1)
+    switch (c) {
+    case 'w':
+      width = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      rows = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      printf("usage: %s [-w WIDTH] [-r ROWS]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  if (width == 0 || rows == 0) {
+    printf("usage: %s [-w WIDTH] [-r ROWS]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const struct {
+    const char *name;
+    conv_t conv;
+    unsigned kh;
+    unsigned kw;
+  } shapes[] = {
+      {"3x3", conv_3x3, 3, 3},
+      {"3x1", conv_3x1, 3, 1},
+      {"1x1", conv_1x1, 1, 1},
+  };
+  int16_t *planes = malloc((size_t)CHANNELS * 3 * width * sizeof(int16_t));
+  int32_t *sums = calloc(width, sizeof(int32_t));
+  int16_t weights[CHANNELS * CHANNELS * 9];
+  if (planes == NULL || sums == NULL) {
+    perror("conv_bench");
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < (size_t)CHANNELS * 3 * width; i++)
+    planes[i] = rand() % 512 - 256;
+  for (unsigned i = 0; i < CHANNELS * CHANNELS * 9; i++)
+    weights[i] = rand() % 512 - 256;
+
+  for (unsigned s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+    unsigned taps = shapes[s].kh * shapes[s].kw;
+    for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+      simd_force(level);
+      if (simd_level() != level)
+        continue;
+      double start = now();
+      for (unsigned y = 0; y < rows; y++)
+        for (unsigned output = 0; output < CHANNELS; output++)
+          for (unsigned input = 0; input < CHANNELS; input += 2) {
+            const int16_t *rows0[3], *rows1[3];
+            for (unsigned ky = 0; ky < shapes[s].kh; ky++) {
+              rows0[ky] = planes + ((size_t)input * 3 + ky) * width;
+              rows1[ky] = planes + ((size_t)(input + 1) * 3 + ky) * width;
+            }
+            const int16_t *w = weights + (output * CHANNELS + input) * taps;
+            shapes[s].conv(sums, rows0, rows1, w, w + taps, width);
+          }
+      double seconds = now() - start;
+      double macs = (double)rows * width * CHANNELS * CHANNELS * taps;
+      printf("%s %-6s %8.3f ms %8.1f MMAC/s\n", shapes[s].name,
+             simd_name(level), seconds * 1e3, macs / seconds * 1e-6);
+    }
+  }
+  /* the sums are used, so the kernels are not optimized out */
+  int32_t check = 0;
+  for (unsigned x = 0; x < width; x++)
+    check ^= sums[x];
+  fprintf(stderr, "check %d\n", check);
+  free(planes);
+  free(sums);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/*
+ * Ground decoder for compressed images received by master
+ *
+ * Images are decompressed in batches, see decompress.h. Images of a sequence
+ * are given in order, a delta image refers to the image before it.
+ * Every channel is written as 16 bit little endian samples, where all
+ * subbands are put into one picture, LL at the top left. Images of the linear
+ * lifting can be reconstructed instead: channels of a batch are inverted in
+ * parallel and written as 8 bit YUV422, planar or packed.
+ */
+#include "decoder.h"
+#include "decompress.h"
+#include "yuv.h"
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static opt_t *parse(int argc, char *argv[]) {
+  opt_t *p_opt = malloc(sizeof(opt_t));
+  if (p_opt == NULL) {
+    perror("p_opt");
+    return NULL;
+  }
+  memcpy(p_opt, &default_opt, sizeof(opt_t));
+  int c;
+  char optstring[] = "o:j:f:";
+  while ((c = getopt(argc, argv, optstring)) != -1) {
+    switch (c) {
+    case 'o':
+      p_opt->output_dir = optarg;
+      break;
+    case 'j':
+      p_opt->jobs = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      if (strcmp(optarg, "subbands") == 0)
+        p_opt->format = DECODER_SUBBANDS;
+      else if ((p_opt->format = yuv_format(optarg)) == -1) {
+        fprintf(stderr, "decoder: unknown format %s\n", optarg);
+        free(p_opt);
+        return NULL;
+      }
+      break;
+    }
+  }
+  if (optind == argc) {
+    printf("usage: %s [-o OUTPUT_DIR] [-j JOBS] [-f subbands|planar|uyvy|yuyv] "
+           "COMPRESSED_IMAGE ...\n",
+           argv[0]);
+    free(p_opt);
+    return NULL;
+  }
+  if (p_opt->jobs == 0)
+    p_opt->jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  p_opt->file_number = argc - optind;
+  p_opt->files = argv + optind;
+  return p_opt;
+}
+
+static int write_planes(const compressed_t *p_compressed,
+                        const char *output_dir) {
+  char filename[PATH_MAX];
+  char *name = strdup(p_compressed->name);
+  if (name == NULL) {
+    perror(p_compressed->name);
+    return -1;
+  }
+  snprintf(filename, sizeof(filename), "%s/%s.yuv", output_dir,
+           basename(name));
+  free(name);
+  FILE *file = fopen(filename, "w");
+  if (file == NULL) {
+    perror(filename);
+    return -1;
+  }
+  const container_header_t *p_header = &p_compressed->container.header;
+  size_t image_size = (size_t)p_header->width * p_header->height * 2;
+  if (p_compressed->image &&
+      fwrite(p_compressed->image, 1, image_size, file) != image_size) {
+    perror(filename);
+    fclose(file);
+    return -1;
+  }
+  for (unsigned channel = 0;
+       channel < IMAGE_CHANNELS && p_compressed->image == NULL; channel++) {
+    size_t size = (size_t)channel_width(p_header->width, channel) *
+                  channel_height(p_header->height, channel);
+    if (fwrite(p_compressed->planes[channel], sizeof(int16_t), size, file) !=
+        size) {
+      perror(filename);
+      fclose(file);
+      return -1;
+    }
+  }
+  if (fclose(file) == EOF) {
+    perror(filename);
+    return -1;
+  }
+  printf("decoder: %s -> %s\n", p_compressed->name, filename);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  opt_t *p_opt = parse(argc, argv);
+  if (p_opt == NULL)
+    return EXIT_FAILURE;
+  int status = EXIT_SUCCESS;
+  sequence_t sequence = {.width = 0, .height = 0};
+  size_t batch = p_opt->jobs < BATCH_MAX ? p_opt->jobs : BATCH_MAX;
+  compressed_t *compresseds = malloc(batch * sizeof(compressed_t));
+  if (compresseds == NULL) {
+    perror("compresseds");
+    return EXIT_FAILURE;
+  }
+  for (int start = 0; start < p_opt->file_number; start += batch) {
+    size_t number = p_opt->file_number - start;
+    if (number > batch)
+      number = batch;
+    for (size_t i = 0; i < number; i++)
+      if (decompress_open(&compresseds[i], p_opt->files[start + i]) == -1)
+        compresseds[i].status = -1;
+    if (decompress_batch(compresseds, number, p_opt->jobs) == -1)
+      status = EXIT_FAILURE;
+    /* images of a sequence are in the order of files */
+    decompress_sequence(compresseds, number, &sequence);
+    if (p_opt->format != DECODER_SUBBANDS &&
+        decompress_reconstruct(compresseds, number, p_opt->jobs,
+                               p_opt->format) == -1)
+      status = EXIT_FAILURE;
+    for (size_t i = 0; i < number; i++) {
+      if (compresseds[i].status == -1 ||
+          write_planes(&compresseds[i], p_opt->output_dir) == -1)
+        status = EXIT_FAILURE;
+      decompress_close(&compresseds[i]);
+    }
+  }
+  sequence_free(&sequence);
+  free(compresseds);
+  free(p_opt);
+  return status;
+}
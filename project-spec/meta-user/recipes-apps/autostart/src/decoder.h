@@ -0,0 +1,29 @@
+#ifndef DECODER_H
+#define DECODER_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#ifndef OUTPUT_DIR
+#define OUTPUT_DIR "/tmp"
+#endif
+/* maximum number of images decoded at the same time */
+#define BATCH_MAX 16
+/* output of coefficients, or YUV_PLANAR, YUV_UYVY or YUV_YUYV */
+#define DECODER_SUBBANDS -1
+
+typedef struct {
+  char *output_dir;
+  unsigned jobs;
+  int format;
+  int file_number;
+  char **files;
+} opt_t;
+
+const opt_t default_opt = {
+    .output_dir = OUTPUT_DIR,
+    .jobs = 0,
+    .format = DECODER_SUBBANDS,
+};
+
+__END_DECLS
+#endif /* decoder.h */
@@ -0,0 +1,452 @@
+/*
+ * Decompression of compressed images received by master
+ *
+ * Substreams of all images in a batch are decoded in parallel. Substreams of
+ * the ROI and the background of a subband are put back into one subband.
+ * Images of a sequence are given in order, a delta image refers to the image
+ * before it. Images of the linear lifting can be reconstructed: channels of a
+ * batch are inverted in parallel.
+ */
+#include "decompress.h"
+#include "coding.h"
+#include "roi.h"
+#include "subband.h"
+#include "wavelet.h"
+#include "yuv.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct {
+  compressed_t *p_compressed;
+  const container_entry_t *p_entry;
+  size_t n;
+} job_t;
+
+typedef struct {
+  job_t *jobs;
+  size_t job_number;
+  size_t next;
+  pthread_mutex_t mutex;
+} queue_t;
+
+/* channels of a batch to reconstruct */
+typedef struct {
+  compressed_t *compresseds;
+  size_t number;
+  int format;
+  /* channel next of all images */
+  size_t next;
+  pthread_mutex_t mutex;
+} reconstruction_t;
+
+static unsigned compressed_width(const compressed_t *p_compressed,
+                                 unsigned channel) {
+  return channel_width(p_compressed->container.header.width, channel);
+}
+
+static unsigned compressed_height(const compressed_t *p_compressed,
+                                  unsigned channel) {
+  return channel_height(p_compressed->container.header.height, channel);
+}
+
+int decompress_open(compressed_t *p_compressed, const char *name) {
+  memset(p_compressed, 0, sizeof(*p_compressed));
+  p_compressed->name = name;
+  struct stat file_stat;
+  if (stat(name, &file_stat) == -1) {
+    perror(name);
+    return -1;
+  }
+  size_t size = file_stat.st_size;
+  p_compressed->data = malloc(size);
+  if (p_compressed->data == NULL) {
+    perror(name);
+    return -1;
+  }
+  FILE *file = fopen(name, "r");
+  if (file == NULL) {
+    perror(name);
+    return -1;
+  }
+  if (fread(p_compressed->data, 1, size, file) != size) {
+    perror(name);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+  if (container_read(&p_compressed->container, p_compressed->data, size) ==
+      -1) {
+    fprintf(stderr, "%s: cannot read container\n", name);
+    return -1;
+  }
+  const container_header_t *p_header = &p_compressed->container.header;
+  if (p_header->channels != IMAGE_CHANNELS ||
+      p_header->levels != TRANSFORM_LEVELS ||
+      p_header->subbands != SUBBAND_NUMBER ||
+      p_header->family_id != CONTAINER_FAMILY_GMM) {
+    fprintf(stderr, "%s: unsupported layout or model family\n", name);
+    return -1;
+  }
+  for (unsigned i = 0; i < p_header->entry_number; i++)
+    p_compressed->missing += p_compressed->container.entries[i].size == 0;
+  if (p_compressed->missing)
+    fprintf(stderr, "%s: %u of %u substreams are missing\n", name,
+            p_compressed->missing, p_header->entry_number);
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    /* missing subbands are left as 0 */
+    p_compressed->planes[channel] =
+        calloc((size_t)compressed_width(p_compressed, channel) *
+                   compressed_height(p_compressed, channel),
+               sizeof(int16_t));
+    if (p_compressed->planes[channel] == NULL) {
+      perror(name);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void decompress_close(compressed_t *p_compressed) {
+  container_free(&p_compressed->container);
+  free(p_compressed->data);
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    free(p_compressed->planes[channel]);
+    free(p_compressed->samples[channel]);
+  }
+  free(p_compressed->image);
+}
+
+/* ROI_FOREGROUND, ROI_BACKGROUND, or -1 for a whole subband */
+static int entry_region(const container_entry_t *p_entry) {
+  if (p_entry->flags & CONTAINER_ENTRY_FOREGROUND)
+    return ROI_FOREGROUND;
+  if (p_entry->flags & CONTAINER_ENTRY_BACKGROUND)
+    return ROI_BACKGROUND;
+  return -1;
+}
+
+static int decode_job(const job_t *p_job) {
+  compressed_t *p_compressed = p_job->p_compressed;
+  const container_entry_t *p_entry = p_job->p_entry;
+  unsigned channel = p_entry->channel, subband = p_entry->subband;
+  if (p_entry->size == 0)
+    return 0;
+  unsigned width = compressed_width(p_compressed, channel);
+  unsigned height = compressed_height(p_compressed, channel);
+  subband_t subbands[SUBBAND_NUMBER];
+  subband_table(subbands, width, height, SUBBAND_PICTURE);
+  subband_view_t view =
+      subband_view(p_compressed->planes[channel], &subbands[subband]);
+  int16_t *coefficients = malloc(p_job->n * sizeof(int16_t));
+  if (coefficients == NULL) {
+    perror(p_compressed->name);
+    return -1;
+  }
+  if (decode(p_compressed->container.payload + p_entry->offset,
+             p_entry->size, &p_entry->gmm, coefficients, p_job->n) == -1) {
+    fprintf(stderr, "%s: cannot decode substream %u of channel %u\n",
+            p_compressed->name, subband, channel);
+    free(coefficients);
+    return -1;
+  }
+  dequantize(coefficients, p_job->n, p_entry->step);
+  int region = entry_region(p_entry);
+  if (region != -1)
+    roi_scatter(&p_compressed->container.roi, channel, subband, width, height,
+                region, coefficients, view.data, view.stride);
+  else
+    for (unsigned row = 0; row < view.height; row++)
+      memcpy(subband_row(&view, row), coefficients + (size_t)row * view.width,
+             view.width * sizeof(int16_t));
+  free(coefficients);
+  return 0;
+}
+
+static void *worker(void *arg) {
+  queue_t *p_queue = arg;
+  for (;;) {
+    pthread_mutex_lock(&p_queue->mutex);
+    if (p_queue->next == p_queue->job_number) {
+      pthread_mutex_unlock(&p_queue->mutex);
+      break;
+    }
+    const job_t *p_job = &p_queue->jobs[p_queue->next++];
+    pthread_mutex_unlock(&p_queue->mutex);
+    if (decode_job(p_job) == -1) {
+      pthread_mutex_lock(&p_queue->mutex);
+      p_job->p_compressed->status = -1;
+      pthread_mutex_unlock(&p_queue->mutex);
+    }
+  }
+  return NULL;
+}
+
+/* decode the largest substreams first to balance the threads */
+static int compare_jobs(const void *p1, const void *p2) {
+  const job_t *p_job1 = p1, *p_job2 = p2;
+  return (p_job1->n < p_job2->n) - (p_job1->n > p_job2->n);
+}
+
+int decompress_batch(compressed_t *compresseds, size_t number,
+                     unsigned threads) {
+  queue_t queue = {
+      .job_number = 0,
+      .next = 0,
+      .mutex = PTHREAD_MUTEX_INITIALIZER,
+  };
+  size_t job_number = 0;
+  for (size_t i = 0; i < number; i++)
+    if (compresseds[i].status == 0)
+      job_number += compresseds[i].container.header.entry_number;
+  queue.jobs = malloc((job_number + 1) * sizeof(job_t));
+  if (queue.jobs == NULL) {
+    perror("jobs");
+    return -1;
+  }
+  for (size_t i = 0; i < number; i++) {
+    if (compresseds[i].status == -1)
+      continue;
+    const container_t *p_container = &compresseds[i].container;
+    for (unsigned j = 0; j < p_container->header.entry_number; j++) {
+      const container_entry_t *p_entry = &p_container->entries[j];
+      unsigned width = compressed_width(&compresseds[i], p_entry->channel);
+      unsigned height = compressed_height(&compresseds[i], p_entry->channel);
+      unsigned subband_width, subband_height;
+      subband_shape(width, height, p_entry->subband, &subband_width,
+                    &subband_height);
+      size_t n = (size_t)subband_width * subband_height;
+      int region = entry_region(p_entry);
+      if (region != -1)
+        n = roi_gather(&p_container->roi, p_entry->channel, p_entry->subband,
+                       width, height, region, NULL, 0, NULL);
+      job_t job = {&compresseds[i], p_entry, n};
+      queue.jobs[queue.job_number++] = job;
+    }
+  }
+  qsort(queue.jobs, queue.job_number, sizeof(job_t), compare_jobs);
+  if (threads > queue.job_number)
+    threads = queue.job_number;
+  pthread_t *thread_ids = malloc(threads * sizeof(pthread_t));
+  if (thread_ids == NULL) {
+    perror("threads");
+    free(queue.jobs);
+    return -1;
+  }
+  unsigned started = 0;
+  for (; started < threads; started++)
+    if (pthread_create(&thread_ids[started], NULL, worker, &queue) != 0) {
+      perror("pthread_create");
+      break;
+    }
+  /* if no thread can be created, decode in this thread */
+  if (started == 0)
+    worker(&queue);
+  for (unsigned i = 0; i < started; i++)
+    pthread_join(thread_ids[i], NULL);
+  free(thread_ids);
+  free(queue.jobs);
+  pthread_mutex_destroy(&queue.mutex);
+  return 0;
+}
+
+/*
+ * copy unchanged tiles from the reference and add the reference to residuals,
+ * then keep the planes as the next reference. An image with missing
+ * substreams is no reference: the encoder had the coefficients the decoder
+ * misses.
+ */
+static int apply_reference(compressed_t *p_compressed,
+                           sequence_t *p_reference) {
+  const container_t *p_container = &p_compressed->container;
+  const container_header_t *p_header = &p_container->header;
+  if (p_header->flags & CONTAINER_FLAG_DELTA) {
+    if (p_reference->width != p_header->width ||
+        p_reference->height != p_header->height) {
+      fprintf(stderr, "%s: no reference image\n", p_compressed->name);
+      return -1;
+    }
+    for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+      unsigned width = compressed_width(p_compressed, channel);
+      unsigned height = compressed_height(p_compressed, channel);
+      subband_t subbands[SUBBAND_NUMBER];
+      subband_table(subbands, width, height, SUBBAND_PICTURE);
+      for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+        size_t offset = subbands[subband].offset;
+        roi_apply(&p_container->roi, channel, subband, width, height,
+                  ROI_UNCHANGED, p_reference->planes[channel] + offset,
+                  p_compressed->planes[channel] + offset, width, 0);
+      }
+    }
+    for (unsigned i = 0; i < p_header->entry_number; i++) {
+      const container_entry_t *p_entry = &p_container->entries[i];
+      if (!(p_entry->flags & CONTAINER_ENTRY_DELTA))
+        continue;
+      unsigned channel = p_entry->channel;
+      unsigned width = compressed_width(p_compressed, channel);
+      unsigned height = compressed_height(p_compressed, channel);
+      subband_t subbands[SUBBAND_NUMBER];
+      subband_table(subbands, width, height, SUBBAND_PICTURE);
+      size_t offset = subbands[p_entry->subband].offset;
+      roi_apply(&p_container->roi, channel, p_entry->subband, width, height,
+                entry_region(p_entry), p_reference->planes[channel] + offset,
+                p_compressed->planes[channel] + offset, width, 1);
+    }
+  }
+  if (p_compressed->missing) {
+    fprintf(stderr, "%s: incomplete, the following delta images cannot be "
+                    "decoded until a key image\n",
+            p_compressed->name);
+    p_reference->width = p_reference->height = 0;
+    return 0;
+  }
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    size_t size = (size_t)compressed_width(p_compressed, channel) *
+                  compressed_height(p_compressed, channel) * sizeof(int16_t);
+    int16_t *plane = realloc(p_reference->planes[channel], size);
+    if (plane == NULL) {
+      perror("reference");
+      p_reference->width = p_reference->height = 0;
+      return -1;
+    }
+    memcpy(plane, p_compressed->planes[channel], size);
+    p_reference->planes[channel] = plane;
+  }
+  p_reference->width = p_header->width;
+  p_reference->height = p_header->height;
+  return 0;
+}
+
+int decompress_sequence(compressed_t *compresseds, size_t number,
+                        sequence_t *p_sequence) {
+  for (size_t i = 0; i < number; i++) {
+    if (compresseds[i].status == 0 &&
+        apply_reference(&compresseds[i], p_sequence) == -1)
+      compresseds[i].status = -1;
+    /* a delta image after a broken image cannot be decoded */
+    if (compresseds[i].status == -1)
+      p_sequence->width = p_sequence->height = 0;
+  }
+  return 0;
+}
+
+/*
+ * invert the transform of a channel, and narrow it into the image. Packed
+ * channels are narrowed together by the job of the last channel.
+ */
+static int reconstruct_channel(reconstruction_t *p_reconstruction,
+                               compressed_t *p_compressed, unsigned channel) {
+  const container_header_t *p_header = &p_compressed->container.header;
+  unsigned width = compressed_width(p_compressed, channel);
+  unsigned height = compressed_height(p_compressed, channel);
+  size_t n = (size_t)width * height;
+  int16_t *samples = malloc(n * sizeof(int16_t) + 1);
+  if (samples == NULL) {
+    perror(p_compressed->name);
+    return -1;
+  }
+  p_compressed->samples[channel] = samples;
+  if (wavelet_inverse(samples, p_compressed->planes[channel], width, height,
+                      SUBBAND_PICTURE) == -1)
+    return -1;
+  if (p_reconstruction->format == YUV_PLANAR) {
+    yuv_narrow(p_compressed->image +
+                   channel_offset(p_header->width, p_header->height, channel),
+               samples, n);
+    return 0;
+  }
+  pthread_mutex_lock(&p_reconstruction->mutex);
+  int last = ++p_compressed->reconstructed == IMAGE_CHANNELS;
+  pthread_mutex_unlock(&p_reconstruction->mutex);
+  if (last)
+    yuv_pack(p_compressed->image, p_compressed->samples[CHANNEL_Y],
+             p_compressed->samples[CHANNEL_U], p_compressed->samples[CHANNEL_V],
+             (size_t)p_header->width * p_header->height,
+             p_reconstruction->format);
+  return 0;
+}
+
+static void *reconstruction_worker(void *arg) {
+  reconstruction_t *p_reconstruction = arg;
+  for (;;) {
+    pthread_mutex_lock(&p_reconstruction->mutex);
+    if (p_reconstruction->next == p_reconstruction->number * IMAGE_CHANNELS) {
+      pthread_mutex_unlock(&p_reconstruction->mutex);
+      break;
+    }
+    size_t next = p_reconstruction->next++;
+    compressed_t *p_compressed =
+        &p_reconstruction->compresseds[next / IMAGE_CHANNELS];
+    int skip = p_compressed->status == -1;
+    pthread_mutex_unlock(&p_reconstruction->mutex);
+    if (!skip && reconstruct_channel(p_reconstruction, p_compressed,
+                                     next % IMAGE_CHANNELS) == -1) {
+      pthread_mutex_lock(&p_reconstruction->mutex);
+      p_compressed->status = -1;
+      pthread_mutex_unlock(&p_reconstruction->mutex);
+    }
+  }
+  return NULL;
+}
+
+int decompress_reconstruct(compressed_t *compresseds, size_t number,
+                           unsigned threads, int format) {
+  reconstruction_t reconstruction = {
+      .compresseds = compresseds,
+      .number = number,
+      .format = format,
+      .next = 0,
+      .mutex = PTHREAD_MUTEX_INITIALIZER,
+  };
+  for (size_t i = 0; i < number; i++) {
+    compressed_t *p_compressed = &compresseds[i];
+    const container_header_t *p_header = &p_compressed->container.header;
+    if (p_compressed->status == -1)
+      continue;
+    if (p_header->transform_id != CONTAINER_TRANSFORM_LIFTING) {
+      fprintf(stderr, "%s: transform %u cannot be inverted\n",
+              p_compressed->name, p_header->transform_id);
+      p_compressed->status = -1;
+      continue;
+    }
+    p_compressed->image =
+        malloc((size_t)p_header->width * p_header->height * 2);
+    if (p_compressed->image == NULL) {
+      perror(p_compressed->name);
+      p_compressed->status = -1;
+    }
+  }
+  if (threads > number * IMAGE_CHANNELS)
+    threads = number * IMAGE_CHANNELS;
+  pthread_t *thread_ids = malloc(threads * sizeof(pthread_t));
+  if (thread_ids == NULL) {
+    perror("threads");
+    return -1;
+  }
+  unsigned started = 0;
+  for (; started < threads; started++)
+    if (pthread_create(&thread_ids[started], NULL, reconstruction_worker,
+                       &reconstruction) != 0) {
+      perror("pthread_create");
+      break;
+    }
+  /* if no thread can be created, reconstruct in this thread */
+  if (started == 0)
+    reconstruction_worker(&reconstruction);
+  for (unsigned i = 0; i < started; i++)
+    pthread_join(thread_ids[i], NULL);
+  free(thread_ids);
+  pthread_mutex_destroy(&reconstruction.mutex);
+  return 0;
+}
+
+
+void sequence_free(sequence_t *p_sequence) {
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    free(p_sequence->planes[channel]);
+    p_sequence->planes[channel] = NULL;
+  }
+  p_sequence->width = p_sequence->height = 0;
+}
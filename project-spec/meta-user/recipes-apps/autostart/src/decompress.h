@@ -0,0 +1,79 @@
+#ifndef DECOMPRESS_H
+#define DECOMPRESS_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "container.h"
+#include "image.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* a compressed image of a batch */
+typedef struct {
+  const char *name;
+  uint8_t *data;
+  container_t container;
+  /* coefficients of every channel in SUBBAND_PICTURE */
+  int16_t *planes[IMAGE_CHANNELS];
+  /* reconstructed samples of channels, and the image of the output format */
+  int16_t *samples[IMAGE_CHANNELS];
+  unsigned reconstructed;
+  uint8_t *image;
+  /* substreams which are not received */
+  unsigned missing;
+  /* -1 if the image cannot be decoded, it is skipped by the next steps */
+  int status;
+} compressed_t;
+
+/* decoded planes of the last image, the reference of a delta image */
+typedef struct {
+  /* 0 if there is no reference */
+  unsigned width;
+  unsigned height;
+  int16_t *planes[IMAGE_CHANNELS];
+} sequence_t;
+
+/**
+ * @brief read a compressed image from a file and allocate its planes
+ * @param p_compressed image, to be closed by decompress_close() even on error
+ * @param name file, kept in the image
+ * @return 0 or -1 if the file is not a supported container
+ */
+int decompress_open(compressed_t *p_compressed, const char *name);
+void decompress_close(compressed_t *p_compressed);
+/**
+ * @brief decode the substreams of a batch into the planes, the largest first
+ * @param compresseds images of the batch, those with status -1 are skipped
+ * @param number number of images
+ * @param threads number of decoding threads
+ * @return 0 or -1 if no job can be queued. An image whose substream cannot be
+ * decoded gets status -1.
+ */
+int decompress_batch(compressed_t *compresseds, size_t number,
+                     unsigned threads);
+/**
+ * @brief apply the reference to the delta images of a batch in order, and keep
+ * the planes of the last complete image as the next reference
+ * @param compresseds decoded images of the batch in the order of the sequence
+ * @param number number of images
+ * @param p_sequence reference, reset after a broken or incomplete image
+ * @return 0. A delta image without reference gets status -1.
+ */
+int decompress_sequence(compressed_t *compresseds, size_t number,
+                        sequence_t *p_sequence);
+/**
+ * @brief invert the transform of the images of a batch, every channel by a
+ * thread, into 8 bit YUV422 images
+ * @param compresseds images of the batch, those with status -1 are skipped
+ * @param number number of images
+ * @param threads number of threads
+ * @param format YUV_PLANAR, YUV_UYVY or YUV_YUYV
+ * @return 0 or -1 if no thread can be allocated. An image which cannot be
+ * inverted gets status -1.
+ */
+int decompress_reconstruct(compressed_t *compresseds, size_t number,
+                           unsigned threads, int format);
+void sequence_free(sequence_t *p_sequence);
+
+__END_DECLS
+#endif /* decompress.h */
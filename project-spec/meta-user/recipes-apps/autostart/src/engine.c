@@ -0,0 +1,597 @@
+/*
+ * CPU engine of the transform and entropy networks of the accelerator.
+ * Refer docs/resources/format.md
+ */
+#include "engine.h"
+#include "conv.h"
+#include "image.h"
+#include "preprocess.h"
+#include "subband.h"
+#include "wavelet.h"
+#include <endian.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* output rows of a job of a thread */
+#define BAND_ROWS 16
+#define TILE_SIZE (PREPROCESS_TILE * PREPROCESS_TILE)
+
+/* rows a job works on */
+typedef void (*band_t)(void *, unsigned, unsigned, int16_t *, int32_t *);
+
+/* bands of rows done by threads */
+typedef struct {
+  band_t band;
+  void *arg;
+  unsigned rows;
+  unsigned next;
+  /* int16_t of scratch and int32_t of sums of a thread */
+  size_t scratch_size;
+  size_t sum_size;
+  int status;
+  pthread_mutex_t mutex;
+} queue_t;
+
+/* a lifting step of a level, in place */
+typedef struct {
+  const engine_chain_t *p_chain;
+  int update;
+  int vertical;
+  /* O, or E of an update, becomes H, or L */
+  int16_t *samples;
+  unsigned rows;
+  unsigned width;
+  /* E, or H of an update */
+  const int16_t *source;
+  unsigned source_rows;
+  unsigned source_width;
+} step_t;
+
+/* the entropy network on a subband */
+typedef struct {
+  const engine_chain_t *p_chain;
+  int16_t *parameters;
+  const int16_t *coefficients;
+  unsigned rows;
+  unsigned width;
+} entropy_t;
+
+static unsigned tiles(unsigned n) {
+  return (n + PREPROCESS_TILE - 1) / PREPROCESS_TILE;
+}
+
+/* rows of input around an output row of the layers from the first one */
+static unsigned chain_halo(const engine_chain_t *p_chain, unsigned first) {
+  unsigned halo = 0;
+  for (unsigned i = first; i < p_chain->layer_number; i++)
+    halo += p_chain->layers[i].kernel / 2;
+  return halo;
+}
+
+/* int16_t of scratch to run a chain on BAND_ROWS rows of a width */
+static size_t chain_scratch(const engine_chain_t *p_chain, unsigned width) {
+  unsigned channels = 1;
+  for (unsigned i = 0; i < p_chain->layer_number; i++)
+    if (p_chain->layers[i].outputs > channels)
+      channels = p_chain->layers[i].outputs;
+  return 2 * (size_t)channels * (BAND_ROWS + 2 * chain_halo(p_chain, 0)) *
+         width;
+}
+
+static int16_t narrow(int32_t sum, int relu) {
+  int64_t value = ((int64_t)sum + (1 << (ENGINE_SHIFT - 1))) >> ENGINE_SHIFT;
+  if (relu && value < 0)
+    value = 0;
+  return value > INT16_MAX ? INT16_MAX : value < INT16_MIN ? INT16_MIN : value;
+}
+
+/*
+ * a layer on output rows [first, last). Input channel i of row y is at
+ * in[i * in_plane + (y - in_first) * in_stride], rows out of [in_first,
+ * in_last) are 0. Output channel o of row y goes to out[o * out_plane + (y -
+ * first) * width].
+ */
+static void convolve(const engine_layer_t *p_layer, int relu, int16_t *out,
+                     size_t out_plane, const int16_t *in, size_t in_plane,
+                     size_t in_stride, unsigned in_first, unsigned in_last,
+                     unsigned first, unsigned last, unsigned width,
+                     int32_t *sums) {
+  unsigned kernel = p_layer->kernel, taps = kernel * kernel;
+  conv_t conv = kernel == 3 ? conv_3x3 : conv_1x1;
+  for (unsigned output = 0; output < p_layer->outputs; output++)
+    for (unsigned y = first; y < last; y++) {
+      memset(sums, 0, width * sizeof(*sums));
+      /* input channels in pairs, like the weights of the PL DRAM */
+      for (unsigned input = 0; input < p_layer->inputs; input += 2) {
+        const int16_t *rows[2][3];
+        for (unsigned i = 0; i < 2; i++)
+          for (unsigned ky = 0; ky < kernel; ky++) {
+            long row_y = (long)y + ky - kernel / 2;
+            rows[i][ky] = input + i < p_layer->inputs &&
+                                  row_y >= (long)in_first &&
+                                  row_y < (long)in_last
+                              ? in + (input + i) * in_plane +
+                                    (row_y - in_first) * in_stride
+                              : NULL;
+          }
+        const int16_t *weights =
+            p_layer->weights +
+            ((size_t)output * p_layer->inputs + input) * taps;
+        conv(sums, rows[0], input + 1 < p_layer->inputs ? rows[1] : NULL,
+             weights, weights + taps, width);
+      }
+      int16_t *out_row = out + output * out_plane + (size_t)(y - first) * width;
+      for (unsigned x = 0; x < width; x++)
+        out_row[x] = narrow(sums[x], relu);
+    }
+}
+
+/*
+ * run a chain on output rows [first, last) of a rows x width plane. Output
+ * channel o of row y goes to out[o * out_plane + (y - first) * width].
+ */
+static void run_chain(const engine_chain_t *p_chain, int16_t *out,
+                      size_t out_plane, const int16_t *plane, unsigned rows,
+                      unsigned width, unsigned first, unsigned last,
+                      int16_t *scratch, int32_t *sums) {
+  const int16_t *in = plane;
+  size_t in_plane = (size_t)rows * width;
+  unsigned in_first = 0, in_last = rows;
+  int16_t *buffers[2] = {scratch, scratch + chain_scratch(p_chain, width) / 2};
+  for (unsigned i = 0; i < p_chain->layer_number; i++) {
+    unsigned halo = chain_halo(p_chain, i + 1);
+    unsigned layer_first = first > halo ? first - halo : 0;
+    unsigned layer_last = last + halo < rows ? last + halo : rows;
+    int final = i + 1 == p_chain->layer_number;
+    int16_t *layer_out = final ? out : buffers[i % 2];
+    size_t layer_plane =
+        final ? out_plane : (size_t)(layer_last - layer_first) * width;
+    convolve(&p_chain->layers[i], !final, layer_out, layer_plane, in, in_plane,
+             width, in_first, in_last, layer_first, layer_last, width, sums);
+    in = layer_out;
+    in_plane = layer_plane;
+    in_first = layer_first;
+    in_last = layer_last;
+  }
+}
+
+static void step_band(void *arg, unsigned first, unsigned last,
+                      int16_t *scratch, int32_t *sums) {
+  const step_t *p_step = arg;
+  const int16_t *source = p_step->source;
+  unsigned source_rows = p_step->source_rows,
+           source_width = p_step->source_width;
+  /* rows of the residual of P or U */
+  unsigned residual_last = last < source_rows ? last : source_rows;
+  int16_t *residual = scratch;
+  if (p_step->p_chain && first < residual_last)
+    run_chain(p_step->p_chain, residual, 0, source, source_rows, source_width,
+              first, residual_last, scratch + BAND_ROWS * source_width, sums);
+  for (unsigned y = first; y < last; y++) {
+    int16_t *row = p_step->samples + (size_t)y * p_step->width;
+    for (unsigned x = 0; x < p_step->width; x++) {
+      /* the samples of the source next to this one */
+      unsigned y0 = y, x0 = x, y1 = y, x1 = x;
+      int linear = 0;
+      if (p_step->update) {
+        if (p_step->vertical) {
+          y0 = y ? y - 1 : 0;
+          y1 = y < source_rows ? y : source_rows - 1;
+        } else {
+          x0 = x ? x - 1 : 0;
+          x1 = x < source_width ? x : source_width - 1;
+        }
+        if (source_rows && source_width)
+          linear = (source[(size_t)y0 * source_width + x0] +
+                    source[(size_t)y1 * source_width + x1] + 2) >>
+                   2;
+      } else {
+        if (p_step->vertical)
+          y1 = y + 1 < source_rows ? y + 1 : y;
+        else
+          x1 = x + 1 < source_width ? x + 1 : x;
+        linear = (source[(size_t)y0 * source_width + x0] +
+                  source[(size_t)y1 * source_width + x1]) >>
+                 1;
+      }
+      if (p_step->p_chain && y < source_rows && x < source_width)
+        linear += residual[(size_t)(y - first) * source_width + x];
+      row[x] = p_step->update ? row[x] + linear : row[x] - linear;
+    }
+  }
+}
+
+static void entropy_band(void *arg, unsigned first, unsigned last,
+                         int16_t *scratch, int32_t *sums) {
+  const entropy_t *p_entropy = arg;
+  run_chain(p_entropy->p_chain,
+            p_entropy->parameters + (size_t)first * p_entropy->width,
+            (size_t)p_entropy->rows * p_entropy->width,
+            p_entropy->coefficients, p_entropy->rows, p_entropy->width, first,
+            last, scratch, sums);
+}
+
+static void *worker(void *arg) {
+  queue_t *p_queue = arg;
+  int16_t *scratch = malloc(p_queue->scratch_size * sizeof(int16_t) + 1);
+  int32_t *sums = malloc(p_queue->sum_size * sizeof(int32_t) + 1);
+  if (scratch == NULL || sums == NULL) {
+    perror("engine");
+    pthread_mutex_lock(&p_queue->mutex);
+    p_queue->status = -1;
+    pthread_mutex_unlock(&p_queue->mutex);
+  } else {
+    for (;;) {
+      pthread_mutex_lock(&p_queue->mutex);
+      if (p_queue->next >= p_queue->rows || p_queue->status == -1) {
+        pthread_mutex_unlock(&p_queue->mutex);
+        break;
+      }
+      unsigned first = p_queue->next;
+      p_queue->next += BAND_ROWS;
+      pthread_mutex_unlock(&p_queue->mutex);
+      unsigned last =
+          first + BAND_ROWS < p_queue->rows ? first + BAND_ROWS : p_queue->rows;
+      p_queue->band(p_queue->arg, first, last, scratch, sums);
+    }
+  }
+  free(scratch);
+  free(sums);
+  return NULL;
+}
+
+/* bands of rows in parallel */
+static int run_bands(const engine_t *p_engine, band_t band, void *arg,
+                     unsigned rows, size_t scratch_size, size_t sum_size) {
+  queue_t queue = {
+      .band = band,
+      .arg = arg,
+      .rows = rows,
+      .scratch_size = scratch_size,
+      .sum_size = sum_size,
+      .mutex = PTHREAD_MUTEX_INITIALIZER,
+  };
+  unsigned threads = p_engine->threads;
+  if (threads > (rows + BAND_ROWS - 1) / BAND_ROWS)
+    threads = (rows + BAND_ROWS - 1) / BAND_ROWS;
+  pthread_t thread_ids[ENGINE_THREADS_MAX];
+  unsigned started = 0;
+  for (; threads > 1 && started < threads; started++)
+    if (pthread_create(&thread_ids[started], NULL, worker, &queue) != 0) {
+      perror("pthread_create");
+      break;
+    }
+  /* one band or no thread can be created */
+  if (started == 0)
+    worker(&queue);
+  for (unsigned i = 0; i < started; i++)
+    pthread_join(thread_ids[i], NULL);
+  pthread_mutex_destroy(&queue.mutex);
+  return queue.status;
+}
+
+/* a lifting of E and O in place, they become L and H */
+static int lift(const engine_t *p_engine, int16_t *even, int16_t *odd,
+                unsigned rows, unsigned width, int vertical) {
+  unsigned even_rows = vertical ? (rows + 1) / 2 : rows,
+           odd_rows = vertical ? rows / 2 : rows,
+           even_width = vertical ? width : (width + 1) / 2,
+           odd_width = vertical ? width : width / 2;
+  if (odd_rows == 0 || odd_width == 0)
+    return 0;
+  step_t predict = {
+      .p_chain = p_engine->lifting_number ? &p_engine->lifting[0] : NULL,
+      .vertical = vertical,
+      .samples = odd,
+      .rows = odd_rows,
+      .width = odd_width,
+      .source = even,
+      .source_rows = even_rows,
+      .source_width = even_width,
+  };
+  step_t update = {
+      .p_chain = p_engine->lifting_number ? &p_engine->lifting[1] : NULL,
+      .update = 1,
+      .vertical = vertical,
+      .samples = even,
+      .rows = even_rows,
+      .width = even_width,
+      .source = odd,
+      .source_rows = odd_rows,
+      .source_width = odd_width,
+  };
+  size_t scratch = 0;
+  for (unsigned i = 0; i < p_engine->lifting_number; i++) {
+    size_t size = BAND_ROWS * (size_t)even_width +
+                  chain_scratch(&p_engine->lifting[i], even_width);
+    if (size > scratch)
+      scratch = size;
+  }
+  if (run_bands(p_engine, step_band, &predict, odd_rows, scratch,
+                even_width) == -1)
+    return -1;
+  return run_bands(p_engine, step_band, &update, even_rows, scratch,
+                   even_width);
+}
+
+/* split the columns of a rows x width plane into even and odd planes */
+static void split_columns(int16_t *even, int16_t *odd, const int16_t *plane,
+                          unsigned rows, unsigned width) {
+  unsigned even_width = (width + 1) / 2, odd_width = width / 2;
+  for (unsigned y = 0; y < rows; y++)
+    for (unsigned x = 0; x < width; x++)
+      if (x % 2)
+        odd[(size_t)y * odd_width + x / 2] = plane[(size_t)y * width + x];
+      else
+        even[(size_t)y * even_width + x / 2] = plane[(size_t)y * width + x];
+}
+
+static void put_subband(int16_t *trans, const subband_t *p_subband,
+                        const int16_t *plane) {
+  subband_view_t view = subband_view(trans, p_subband);
+  for (unsigned y = 0; y < view.height; y++)
+    memcpy(subband_row(&view, y), plane + (size_t)y * view.width,
+           view.width * sizeof(int16_t));
+}
+
+/*
+ * the even and odd rows of a picture, row y of a parity goes to rows[parity]
+ * + y * stride
+ */
+static void untile(int16_t *const *rows, size_t stride,
+                   const uint16_t *picture, unsigned width, unsigned height) {
+  size_t tile_row_size = (size_t)tiles(width) * TILE_SIZE;
+  for (unsigned parity = 0; parity < 2; parity++) {
+    const uint16_t *block =
+        picture + parity * preprocess_stripes(height) * tile_row_size;
+    for (unsigned y = 0; y < (height + 1 - parity) / 2; y++)
+      for (unsigned x = 0; x < width; x++)
+        rows[parity][y * stride + x] = le16toh(
+            block[y / PREPROCESS_TILE * tile_row_size +
+                  x / PREPROCESS_TILE * TILE_SIZE +
+                  y % PREPROCESS_TILE * PREPROCESS_TILE + x % PREPROCESS_TILE]);
+  }
+}
+
+/* the linear lifting without transform networks */
+static int transform_linear(int16_t *trans, const uint16_t *picture,
+                            unsigned width, unsigned height) {
+  int16_t *plane = malloc((size_t)width * height * sizeof(int16_t) + 1);
+  if (plane == NULL) {
+    perror("engine");
+    return -1;
+  }
+  int16_t *rows[2] = {plane, plane + width};
+  untile(rows, 2 * (size_t)width, picture, width, height);
+  int status = wavelet_forward(trans, plane, width, height, SUBBAND_PACKED);
+  free(plane);
+  return status;
+}
+
+static int transform(const engine_t *p_engine, int16_t *trans,
+                     const uint16_t *picture, unsigned width,
+                     unsigned height) {
+  if (p_engine->lifting_number == 0)
+    return transform_linear(trans, picture, width, height);
+  subband_t table[SUBBAND_NUMBER];
+  subband_table(table, width, height, SUBBAND_PACKED);
+  size_t half = (size_t)(height + 1) / 2 * width,
+         quarter = (size_t)(height + 1) / 2 * ((width + 1) / 2);
+  int16_t *buffer = malloc((2 * half + 4 * quarter) * sizeof(int16_t) + 1);
+  if (buffer == NULL) {
+    perror("engine");
+    return -1;
+  }
+  int16_t *even = buffer, *odd = even + half, *columns[4];
+  for (unsigned i = 0; i < 4; i++)
+    columns[i] = odd + half + i * quarter;
+  int16_t *rows[2] = {even, odd};
+  untile(rows, width, picture, width, height);
+  int status = 0;
+  for (unsigned level = 1; level <= TRANSFORM_LEVELS; level++) {
+    /* L in even and H in odd */
+    if (lift(p_engine, even, odd, height, width, 1) == -1) {
+      status = -1;
+      break;
+    }
+    unsigned rows[2] = {(height + 1) / 2, height / 2};
+    const int16_t *planes[2] = {even, odd};
+    /* LL, HL from L and LH, HH from H */
+    for (unsigned i = 0; i < 2 && status == 0; i++) {
+      split_columns(columns[2 * i], columns[2 * i + 1], planes[i], rows[i],
+                    width);
+      status = lift(p_engine, columns[2 * i], columns[2 * i + 1], rows[i],
+                    width, 0);
+    }
+    if (status == -1)
+      break;
+    unsigned subband = 1 + 3 * (TRANSFORM_LEVELS - level);
+    put_subband(trans, &table[subband + SUBBAND_HL - 1], columns[1]);
+    put_subband(trans, &table[subband + SUBBAND_LH - 1], columns[2]);
+    put_subband(trans, &table[subband + SUBBAND_HH - 1], columns[3]);
+    width = (width + 1) / 2;
+    height = rows[0];
+    if (level == TRANSFORM_LEVELS) {
+      put_subband(trans, &table[0], columns[0]);
+      break;
+    }
+    /* rows of LL for the next level */
+    for (unsigned y = 0; y < height; y++)
+      memcpy((y % 2 ? odd : even) + (size_t)(y / 2) * width,
+             columns[0] + (size_t)y * width, width * sizeof(int16_t));
+  }
+  free(buffer);
+  return status;
+}
+
+static int run_entropy(const engine_t *p_engine, int16_t *parameters,
+                   const int16_t *trans, unsigned width, unsigned height) {
+  subband_t table[SUBBAND_NUMBER];
+  subband_table(table, width, height, SUBBAND_PACKED);
+  unsigned number = engine_entropy_number(p_engine);
+  for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+    const subband_t *p_subband = &table[subband];
+    if (subband_size(p_subband) == 0)
+      continue;
+    entropy_t arg = {
+        .p_chain = &p_engine->entropy,
+        .parameters = parameters + number * p_subband->offset,
+        .coefficients = trans + p_subband->offset,
+        .rows = p_subband->height,
+        .width = p_subband->width,
+    };
+    if (run_bands(p_engine, entropy_band, &arg, p_subband->height,
+                  chain_scratch(&p_engine->entropy, p_subband->width),
+                  p_subband->width) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/* check and unpack a chain of layers of a network of a blob */
+static int init_chain(engine_chain_t *p_chain, const weights_t *p_weights,
+                      unsigned first, unsigned last) {
+  p_chain->layer_number = 0;
+  p_chain->layers = calloc(last - first + 1, sizeof(engine_layer_t));
+  if (p_chain->layers == NULL) {
+    perror("engine");
+    return -1;
+  }
+  for (unsigned i = first; i < last; i++) {
+    const weights_layer_t *p_source = &p_weights->layers[i];
+    engine_layer_t *p_layer = &p_chain->layers[p_chain->layer_number];
+    unsigned inputs = i == first ? 1 : p_layer[-1].outputs;
+    if (p_source->kernel_height != p_source->kernel_width ||
+        (p_source->kernel_height != 1 && p_source->kernel_height != 3) ||
+        p_source->inputs != inputs || p_source->outputs == 0 ||
+        p_source->size != weights_packed_number(p_source) * sizeof(uint16_t)) {
+      fprintf(stderr, "engine: layer %u does not follow the former layer\n",
+              i);
+      return -1;
+    }
+    p_layer->kernel = p_source->kernel_height;
+    p_layer->inputs = p_source->inputs;
+    p_layer->outputs = p_source->outputs;
+    p_layer->weights =
+        malloc((size_t)p_layer->kernel * p_layer->kernel * p_layer->inputs *
+               p_layer->outputs * sizeof(int16_t));
+    if (p_layer->weights == NULL) {
+      perror("engine");
+      return -1;
+    }
+    weights_unpack(p_layer->weights,
+                   p_weights->payload + p_source->offset / sizeof(uint16_t),
+                   p_source);
+    p_chain->layer_number++;
+  }
+  return 0;
+}
+
+static int init_networks(engine_t *p_engine, const weights_t *p_weights) {
+  /* transform layers come first, then entropy layers */
+  unsigned entropy_first = 0;
+  while (entropy_first < p_weights->layer_number &&
+         p_weights->layers[entropy_first].network == WEIGHTS_TRANSFORM)
+    entropy_first++;
+  for (unsigned i = entropy_first; i < p_weights->layer_number; i++)
+    if (p_weights->layers[i].network != WEIGHTS_ENTROPY) {
+      fprintf(stderr, "engine: layer %u is out of order\n", i);
+      return -1;
+    }
+  unsigned first = 0;
+  for (unsigned i = 0; i < entropy_first; i++) {
+    if (p_weights->layers[i].outputs != 1)
+      continue;
+    if (p_engine->lifting_number == ENGINE_LIFTING) {
+      fprintf(stderr, "engine: more than %d transform chains\n",
+              ENGINE_LIFTING);
+      return -1;
+    }
+    if (init_chain(&p_engine->lifting[p_engine->lifting_number++], p_weights,
+                   first, i + 1) == -1)
+      return -1;
+    first = i + 1;
+  }
+  unsigned chains = p_engine->lifting_number;
+  if (first != entropy_first || (chains && chains != ENGINE_LIFTING)) {
+    fprintf(stderr, "engine: transform layers are not %d chains\n",
+            ENGINE_LIFTING);
+    return -1;
+  }
+  for (unsigned i = entropy_first + 1; i < p_weights->layer_number; i++)
+    if (p_weights->layers[i].kernel_height >
+        p_weights->layers[i - 1].kernel_height) {
+      fprintf(stderr, "engine: 3x3 entropy layer %u after 1x1 layers\n", i);
+      return -1;
+    }
+  return init_chain(&p_engine->entropy, p_weights, entropy_first,
+                    p_weights->layer_number);
+}
+
+/**
+ * @brief check and unpack the networks of a weight blob
+ *
+ * @param p_engine freed by engine_free(), also if it fails
+ * @param p_weights NULL for the linear lifting without entropy network
+ * @param threads of engine_run(), at least 1
+ * @return 0 or -1
+ */
+int engine_init(engine_t *p_engine, const weights_t *p_weights,
+                unsigned threads) {
+  memset(p_engine, 0, sizeof(*p_engine));
+  p_engine->threads = threads == 0                    ? 1
+                      : threads > ENGINE_THREADS_MAX ? ENGINE_THREADS_MAX
+                                                      : threads;
+  if (p_weights == NULL)
+    return 0;
+  return init_networks(p_engine, p_weights);
+}
+
+/* entropy parameters of a coefficient */
+unsigned engine_entropy_number(const engine_t *p_engine) {
+  const engine_chain_t *p_chain = &p_engine->entropy;
+  return p_chain->layer_number
+             ? p_chain->layers[p_chain->layer_number - 1].outputs
+             : 0;
+}
+
+/**
+ * @brief run the networks on a channel like the accelerator
+ *
+ * @param p_engine
+ * @param trans width x height coefficients, the 13 subbands one after
+ * another, see subband_table()
+ * @param entropy engine_entropy_number() x width x height parameters, every
+ * subband after the former one, parameter by parameter in raster order. Not
+ * computed if NULL.
+ * @param picture preprocess_size() pixels, see preprocess()
+ * @param width
+ * @param height
+ * @return 0 or -1
+ */
+int engine_run(const engine_t *p_engine, int16_t *trans, int16_t *entropy,
+               const uint16_t *picture, unsigned width, unsigned height) {
+  if (transform(p_engine, trans, picture, width, height) == -1)
+    return -1;
+  if (entropy == NULL || engine_entropy_number(p_engine) == 0)
+    return 0;
+  return run_entropy(p_engine, entropy, trans, width, height);
+}
+
+static void free_chain(engine_chain_t *p_chain) {
+  if (p_chain->layers)
+    for (unsigned i = 0; i < p_chain->layer_number + 1; i++)
+      free(p_chain->layers[i].weights);
+  free(p_chain->layers);
+  p_chain->layers = NULL;
+  p_chain->layer_number = 0;
+}
+
+void engine_free(engine_t *p_engine) {
+  for (unsigned i = 0; i < ENGINE_LIFTING; i++)
+    free_chain(&p_engine->lifting[i]);
+  p_engine->lifting_number = 0;
+  free_chain(&p_engine->entropy);
+}
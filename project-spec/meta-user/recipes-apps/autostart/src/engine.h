@@ -0,0 +1,71 @@
+#ifndef ENGINE_H
+#define ENGINE_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "weights.h"
+#include <stdint.h>
+
+/*
+ * CPU engine of the networks of the accelerator. It reads the packed weights
+ * of a blob and the preprocessed picture of a channel, and gives the
+ * transform coefficients and the entropy parameters the accelerator puts in
+ * the PL DRAM, so the pipeline runs without the PL.
+ *
+ * The transform network is TRANSFORM_LEVELS levels of 2D lifting, rows then
+ * columns. A lifting splits samples into even E and odd O and computes
+ *
+ *   H[i] = O[i] - (floor((E[i] + E[i + 1]) / 2) + P(E)[i])
+ *   L[i] = E[i] + (floor((H[i - 1] + H[i] + 2) / 4) + U(H)[i])
+ *
+ * with symmetric extension at the ends. The linear parts are the fixed 3x1
+ * kernels, which are not in the blob. P and U are the chains of 3x3 transform
+ * layers of the blob, a chain goes from 1 channel to 1 channel. They are
+ * shared by rows, columns and all levels. Without transform layers they are
+ * 0, and the transform is wavelet_forward().
+ *
+ * The entropy network is the chain of entropy layers, 3x3 then 1x1. It runs
+ * on every subband and gives the channels of its last layer for every
+ * coefficient.
+ *
+ * Layers are fixed point: 16 bit activations and weights, 32 bit wrapping
+ * sums, ENGINE_SHIFT fraction bits of weights rounded off and saturation to
+ * 16 bit. Biases are 0. Every layer but the last of a chain is followed by a
+ * ReLU, and pictures are padded with 0.
+ */
+#define ENGINE_SHIFT 8
+/* P and U */
+#define ENGINE_LIFTING 2
+#define ENGINE_THREADS_MAX 64
+
+typedef struct {
+  /* 1 or 3 */
+  unsigned kernel;
+  unsigned inputs;
+  unsigned outputs;
+  /* weights[output][input][y][x] */
+  int16_t *weights;
+} engine_layer_t;
+
+typedef struct {
+  engine_layer_t *layers;
+  unsigned layer_number;
+} engine_chain_t;
+
+typedef struct {
+  unsigned threads;
+  /* P and U, none without transform layers */
+  engine_chain_t lifting[ENGINE_LIFTING];
+  unsigned lifting_number;
+  /* no layers without entropy layers */
+  engine_chain_t entropy;
+} engine_t;
+
+int engine_init(engine_t *, const weights_t *, unsigned);
+unsigned engine_entropy_number(const engine_t *);
+int engine_run(const engine_t *, int16_t *, int16_t *, const uint16_t *,
+               unsigned, unsigned);
+void engine_free(engine_t *);
+
+__END_DECLS
+#endif /* engine.h */
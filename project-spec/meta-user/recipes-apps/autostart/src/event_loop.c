@@ -0,0 +1,208 @@
+#include "event_loop.h"
+#include <errno.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+/* ready sources handled per wait */
+#define EVENT_NUMBER 16
+
+int event_loop_init(event_loop_t *p_loop) {
+  p_loop->stopped = 0;
+  p_loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (p_loop->epoll_fd == -1) {
+    perror("event_loop");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief watch a source
+ *
+ * @param p_loop
+ * @param p_source valid until it is removed
+ * @param events EPOLLIN, EPOLLOUT, ...
+ * @return 0, or -1 for an error
+ */
+int event_loop_add(event_loop_t *p_loop, event_source_t *p_source,
+                   uint32_t events) {
+  struct epoll_event event = {.events = events, .data.ptr = p_source};
+  if (epoll_ctl(p_loop->epoll_fd, EPOLL_CTL_ADD, p_source->fd, &event) == -1) {
+    perror("event_loop");
+    return -1;
+  }
+  return 0;
+}
+
+/* change the events of a source, e.g. watch EPOLLOUT while output waits */
+int event_loop_modify(event_loop_t *p_loop, event_source_t *p_source,
+                      uint32_t events) {
+  struct epoll_event event = {.events = events, .data.ptr = p_source};
+  if (epoll_ctl(p_loop->epoll_fd, EPOLL_CTL_MOD, p_source->fd, &event) == -1) {
+    perror("event_loop");
+    return -1;
+  }
+  return 0;
+}
+
+/* stop watching a source, its callback may still be called by this round */
+int event_loop_remove(event_loop_t *p_loop, event_source_t *p_source) {
+  if (epoll_ctl(p_loop->epoll_fd, EPOLL_CTL_DEL, p_source->fd, NULL) == -1) {
+    perror("event_loop");
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief wait for ready sources and call their callbacks
+ *
+ * @param p_loop
+ * @param timeout milliseconds, -1 for no timeout
+ * @return number of ready sources, or -1 for an error
+ */
+int event_loop_run_once(event_loop_t *p_loop, int timeout) {
+  struct epoll_event events[EVENT_NUMBER];
+  int n = epoll_wait(p_loop->epoll_fd, events, EVENT_NUMBER, timeout);
+  if (n == -1) {
+    if (errno == EINTR)
+      return 0;
+    perror("event_loop");
+    return -1;
+  }
+  for (int i = 0; i < n; i++) {
+    event_source_t *p_source = events[i].data.ptr;
+    p_source->callback(p_source->arg, events[i].events);
+  }
+  return n;
+}
+
+/* run until event_loop_stop() is called by a callback, or an error */
+int event_loop_run(event_loop_t *p_loop) {
+  p_loop->stopped = 0;
+  while (!p_loop->stopped)
+    if (event_loop_run_once(p_loop, -1) == -1)
+      return -1;
+  return 0;
+}
+
+void event_loop_stop(event_loop_t *p_loop) { p_loop->stopped = 1; }
+
+void event_loop_close(event_loop_t *p_loop) {
+  if (p_loop->epoll_fd != -1)
+    close(p_loop->epoll_fd);
+  p_loop->epoll_fd = -1;
+}
+
+/* read the expirations of a timerfd, none if it was set again meanwhile */
+static void expire(void *arg, uint32_t events) {
+  (void)events;
+  event_timer_t *p_timer = arg;
+  uint64_t count;
+  if (read(p_timer->source.fd, &count, sizeof(count)) != sizeof(count))
+    return;
+  p_timer->callback(p_timer->arg, count);
+}
+
+/* read the signals of an eventfd */
+static void wake(void *arg, uint32_t events) {
+  (void)events;
+  event_notifier_t *p_notifier = arg;
+  uint64_t count;
+  if (read(p_notifier->source.fd, &count, sizeof(count)) != sizeof(count))
+    return;
+  p_notifier->callback(p_notifier->arg, count);
+}
+
+/**
+ * @brief add a disarmed timer to a loop
+ *
+ * @param p_loop
+ * @param p_timer
+ * @param callback called in the loop when the timer expires
+ * @param arg first argument of callback
+ * @return 0, or -1 for an error
+ */
+int event_timer_init(event_loop_t *p_loop, event_timer_t *p_timer,
+                     void (*callback)(void *, uint64_t), void *arg) {
+  p_timer->callback = callback;
+  p_timer->arg = arg;
+  p_timer->source.callback = expire;
+  p_timer->source.arg = p_timer;
+  p_timer->source.fd =
+      timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (p_timer->source.fd == -1) {
+    perror("event_timer");
+    return -1;
+  }
+  if (event_loop_add(p_loop, &p_timer->source, EPOLLIN) == -1) {
+    close(p_timer->source.fd);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief arm or disarm a timer
+ *
+ * @param p_timer
+ * @param timeout milliseconds to the first expiration, 0 disarms the timer
+ * @param interval milliseconds between later expirations, 0 for one
+ * @return 0, or -1 for an error
+ */
+int event_timer_set(event_timer_t *p_timer, unsigned long timeout,
+                    unsigned long interval) {
+  struct itimerspec spec = {
+      .it_interval = {.tv_sec = interval / 1000,
+                      .tv_nsec = interval % 1000 * 1000000},
+      .it_value = {.tv_sec = timeout / 1000,
+                   .tv_nsec = timeout % 1000 * 1000000},
+  };
+  if (timerfd_settime(p_timer->source.fd, 0, &spec, NULL) == -1) {
+    perror("event_timer");
+    return -1;
+  }
+  return 0;
+}
+
+void event_timer_close(event_loop_t *p_loop, event_timer_t *p_timer) {
+  event_loop_remove(p_loop, &p_timer->source);
+  close(p_timer->source.fd);
+}
+
+/* like event_timer_init(), for a notifier */
+int event_notifier_init(event_loop_t *p_loop, event_notifier_t *p_notifier,
+                        void (*callback)(void *, uint64_t), void *arg) {
+  p_notifier->callback = callback;
+  p_notifier->arg = arg;
+  p_notifier->source.callback = wake;
+  p_notifier->source.arg = p_notifier;
+  p_notifier->source.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (p_notifier->source.fd == -1) {
+    perror("event_notifier");
+    return -1;
+  }
+  if (event_loop_add(p_loop, &p_notifier->source, EPOLLIN) == -1) {
+    close(p_notifier->source.fd);
+    return -1;
+  }
+  return 0;
+}
+
+/* wake the loop of a notifier up, from any thread */
+int event_notify(event_notifier_t *p_notifier) {
+  uint64_t count = 1;
+  if (write(p_notifier->source.fd, &count, sizeof(count)) != sizeof(count)) {
+    perror("event_notifier");
+    return -1;
+  }
+  return 0;
+}
+
+void event_notifier_close(event_loop_t *p_loop, event_notifier_t *p_notifier) {
+  event_loop_remove(p_loop, &p_notifier->source);
+  close(p_notifier->source.fd);
+}
@@ -0,0 +1,64 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+
+/*
+ * A loop of epoll, so a program sleeps until a descriptor is ready, a timer
+ * expires or another thread has news. Everything is a source of descriptor:
+ * a timer is a timerfd, and a notifier is an eventfd any thread can signal,
+ * e.g. at the end of an accelerator run. Callbacks run in the thread of the
+ * loop, one at a time, as soon as their sources are ready.
+ */
+
+/* called with the epoll events of a ready source */
+typedef void (*event_callback_t)(void *, uint32_t);
+
+typedef struct {
+  int fd;
+  event_callback_t callback;
+  void *arg;
+} event_source_t;
+
+typedef struct {
+  int epoll_fd;
+  int stopped;
+} event_loop_t;
+
+/* a timer, its callback gets the number of expirations since the last call */
+typedef struct {
+  event_source_t source;
+  void (*callback)(void *, uint64_t);
+  void *arg;
+} event_timer_t;
+
+/* a notifier, its callback gets the number of signals since the last call */
+typedef struct {
+  event_source_t source;
+  void (*callback)(void *, uint64_t);
+  void *arg;
+} event_notifier_t;
+
+int event_loop_init(event_loop_t *);
+int event_loop_add(event_loop_t *, event_source_t *, uint32_t);
+int event_loop_modify(event_loop_t *, event_source_t *, uint32_t);
+int event_loop_remove(event_loop_t *, event_source_t *);
+int event_loop_run_once(event_loop_t *, int);
+int event_loop_run(event_loop_t *);
+void event_loop_stop(event_loop_t *);
+void event_loop_close(event_loop_t *);
+
+int event_timer_init(event_loop_t *, event_timer_t *,
+                     void (*)(void *, uint64_t), void *);
+int event_timer_set(event_timer_t *, unsigned long, unsigned long);
+void event_timer_close(event_loop_t *, event_timer_t *);
+
+int event_notifier_init(event_loop_t *, event_notifier_t *,
+                        void (*)(void *, uint64_t), void *);
+int event_notify(event_notifier_t *);
+void event_notifier_close(event_loop_t *, event_notifier_t *);
+
+__END_DECLS
+#endif /* event_loop.h */
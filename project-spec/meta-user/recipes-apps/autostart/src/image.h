@@ -0,0 +1,124 @@
+#ifndef IMAGE_H
+#define IMAGE_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+/*
+ * Refer docs/resources/format.md
+ *
+ * A raw image is YUV422 stored as three planar channels Y, U, V. U and V are
+ * subsampled horizontally.
+ */
+#ifndef IMAGE_WIDTH
+#define IMAGE_WIDTH 3840
+#endif
+#ifndef IMAGE_HEIGHT
+#define IMAGE_HEIGHT 2160
+#endif
+#define IMAGE_CHANNELS 3
+#define IMAGE_SIZE (IMAGE_WIDTH * IMAGE_HEIGHT * 2)
+
+#define CHANNEL_Y 0
+#define CHANNEL_U 1
+#define CHANNEL_V 2
+
+/* 4 levels 2D decomposition: LL4, HL4, LH4, HH4, HL3, ..., HH1 */
+#define TRANSFORM_LEVELS 4
+#define SUBBAND_NUMBER (3 * TRANSFORM_LEVELS + 1)
+/* progressive layers: LL4, level 4 details, ..., level 1 details */
+#define LAYER_NUMBER (TRANSFORM_LEVELS + 1)
+
+static inline unsigned channel_width(unsigned width, unsigned channel) {
+  return channel == CHANNEL_Y ? width : width / 2;
+}
+
+static inline unsigned channel_height(unsigned height, unsigned channel) {
+  (void)channel;
+  return height;
+}
+
+/* offset of a channel in a planar raw image */
+static inline unsigned long channel_offset(unsigned width, unsigned height,
+                                           unsigned channel) {
+  unsigned long offset = 0;
+  for (unsigned i = 0; i < channel; i++)
+    offset += (unsigned long)channel_width(width, i) *
+              channel_height(height, i);
+  return offset;
+}
+
+/* decomposition level of a subband, LL4 and HL4 are at level 4 */
+static inline unsigned subband_level(unsigned subband) {
+  return subband == 0 ? TRANSFORM_LEVELS
+                      : TRANSFORM_LEVELS - (subband - 1) / 3;
+}
+
+/* layer of a subband in progressive order, coarse to fine */
+static inline unsigned subband_layer(unsigned subband) {
+  return subband == 0 ? 0 : 1 + (subband - 1) / 3;
+}
+
+/*
+ * shape of the subband-th subband of a width x height channel. Every level
+ * splits the low band into ceil(n / 2) low and floor(n / 2) high samples.
+ */
+static inline void subband_shape(unsigned width, unsigned height,
+                                 unsigned subband, unsigned *p_width,
+                                 unsigned *p_height) {
+  unsigned level = subband_level(subband);
+  for (unsigned i = 1; i < level; i++) {
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  if (subband == 0) {
+    *p_width = (width + 1) / 2;
+    *p_height = (height + 1) / 2;
+    return;
+  }
+  switch ((subband - 1) % 3) {
+  case 0: /* HL */
+    *p_width = width / 2;
+    *p_height = (height + 1) / 2;
+    break;
+  case 1: /* LH */
+    *p_width = (width + 1) / 2;
+    *p_height = height / 2;
+    break;
+  default: /* HH */
+    *p_width = width / 2;
+    *p_height = height / 2;
+  }
+}
+
+/*
+ * position of the subband-th subband when all subbands of a channel are put
+ * into one width x height picture. Every level puts LL at the top left, HL at
+ * the top right, LH at the bottom left and HH at the bottom right.
+ */
+static inline void subband_position(unsigned width, unsigned height,
+                                    unsigned subband, unsigned *p_x,
+                                    unsigned *p_y) {
+  unsigned level = subband_level(subband);
+  for (unsigned i = 1; i < level; i++) {
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  *p_x = 0;
+  *p_y = 0;
+  if (subband == 0)
+    return;
+  switch ((subband - 1) % 3) {
+  case 0: /* HL */
+    *p_x = (width + 1) / 2;
+    break;
+  case 1: /* LH */
+    *p_y = (height + 1) / 2;
+    break;
+  default: /* HH */
+    *p_x = (width + 1) / 2;
+    *p_y = (height + 1) / 2;
+  }
+}
+
+__END_DECLS
+#endif /* image.h */
@@ -1,13 +1,16 @@
 #include "main.h"
-#include "coding.h"
+#include "simd.h"
 #include <fcntl.h>
-#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
 #include <unistd.h>
 
+/* reference image of sequence mode */
+static reference_t reference;
+/* packed weights mapped at startup */
+static weights_t weights;
+
 static opt_t *parse(int argc, char *argv[]) {
   opt_t *p_opt = malloc(sizeof(opt_t));
   if (p_opt == NULL) {
@@ -16,7 +19,7 @@ static opt_t *parse(int argc, char *argv[]) {
   }
   memcpy(p_opt, &default_opt, sizeof(opt_t));
   int c;
-  char optstring[] = "t:o:";
+  char optstring[] = "t:o:f:sr:b:d:k:q:B:Rw:W:";
   while ((c = getopt(argc, argv, optstring)) != -1) {
     switch (c) {
     case 't':
@@ -25,6 +28,54 @@ static opt_t *parse(int argc, char *argv[]) {
     case 'o':
       p_opt->output_dir = optarg;
       break;
+    case 'f':
+      p_opt->compress.format = yuv_format(optarg);
+      if (p_opt->compress.format == -1) {
+        fprintf(stderr, "%s: format should be planar, uyvy or yuyv\n",
+                optarg);
+        free(p_opt);
+        return NULL;
+      }
+      break;
+    case 's':
+      /* one layer, not progressive */
+      p_opt->compress.progressive = 0;
+      break;
+    case 'r':
+      p_opt->compress.roi_contrast = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      p_opt->compress.background_step = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      /* sequence mode */
+      p_opt->compress.p_reference = &reference;
+      p_opt->compress.change_threshold = strtoul(optarg, NULL, 0);
+      break;
+    case 'k':
+      p_opt->compress.key_interval = strtoul(optarg, NULL, 0);
+      break;
+    case 'q':
+      p_opt->compress.quality = strtoul(optarg, NULL, 0);
+      break;
+    case 'B':
+      p_opt->compress.budget = strtoul(optarg, NULL, 0);
+      break;
+    case 'R':
+      /* keep every coefficient within half a step */
+      p_opt->compress.rdoq = 0;
+      break;
+    case 'w':
+      weights_unload(&weights);
+      if (weights_load(&weights, optarg) == -1) {
+        free(p_opt);
+        return NULL;
+      }
+      p_opt->compress.p_weights = &weights;
+      break;
+    case 'W':
+      p_opt->window = strtoul(optarg, NULL, 0);
+      break;
     }
   }
   return p_opt;
@@ -35,54 +86,19 @@ int main(int argc, char *argv[]) {
   if (p_opt == NULL) {
     return EXIT_FAILURE;
   }
+  printf("slave: SIMD %s\n", simd_name(simd_level()));
   int fd = open(p_opt->tty, O_RDWR | O_NONBLOCK | O_NOCTTY);
   if (fd == -1) {
     perror(p_opt->tty);
     return EXIT_FAILURE;
   }
-  frame_t input_frame, output_frame = default_frame;
-  send_frame(fd, &output_frame);
-  printf("slave: request data: raw image 0\n");
-  for (;;) {
-    wait_frame(fd, &input_frame, &output_frame);
-
-    switch (input_frame.frame_type) {
-    case TP_FRAME_TYPE_CONTROL:
-      /*! TODO: not implemented yet
-       *  \todo not implemented yet
-       */
-      break;
-    case TP_FRAME_TYPE_REQUEST_DATA:
-      output_frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
-      output_frame.n_file = input_frame.n_file;
-      output_frame.data_len = TP_FRAME_DATA_LEN_MAX;
-      /*! TODO: Create a thread to compress raw image and send a frame after
-       * finishing \todo Create a thread to compress raw image and send a frame
-       * after finishing
-       */
-      break;
-    case TP_FRAME_TYPE_TRANSPORT_DATA:
-      output_frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
-      printf("slave: receive data: raw image %d\n", input_frame.n_file);
-      size_t len = strlen(p_opt->output_dir) + 4 + strlen("/.yuv");
-      char *filename = malloc(len);
-      if (sprintf(filename, "%s/%d.yuv", p_opt->output_dir,
-                  input_frame.n_file) != len) {
-        perror(p_opt->output_dir);
-        break;
-      }
-      FILE *file = fopen(filename, "a");
-      if (file == NULL) {
-        perror(filename);
-        break;
-      }
-      if (fwrite(input_frame.data, 1, input_frame.data_len, file) !=
-          input_frame.data_len) {
-        perror(filename);
-        break;
-      }
-      fclose(file);
-    }
-    output_frame.n_frame++;
-  }
+  slave_t slave;
+  if (slave_init(&slave, p_opt, fd) == -1)
+    return EXIT_FAILURE;
+  if (slave_request(&slave, 0) == -1)
+    perror(p_opt->tty);
+  event_loop_run(&slave.loop);
+  slave_close(&slave);
+  close(fd);
+  return EXIT_FAILURE;
 }
@@ -3,9 +3,8 @@
 #include <sys/cdefs.h>
 __BEGIN_DECLS
 
-#include "transmission_protocol.h"
+#include "slave.h"
 
-#define TP_ADDRESS TP_ADDRESS_SLAVE
 #ifndef TTY
 #define TTY "/tmp/ttyS1"
 #endif
@@ -13,22 +12,19 @@ __BEGIN_DECLS
 #define OUTPUT_DIR "/tmp"
 #endif
 
-typedef struct {
-  char *tty;
-  char *output_dir;
-} opt_t;
-
 const opt_t default_opt = {
     .tty = TTY,
     .output_dir = OUTPUT_DIR,
-};
-
-const frame_t default_frame = {
-    .header = TP_HEADER,
-    .address = TP_ADDRESS,
-    .frame_type = TP_FRAME_TYPE_REQUEST_DATA,
-    .n_file = 0,
-    .n_frame = 0,
+    .window = ARQ_WINDOW,
+    .compress =
+        {
+            .progressive = 1,
+            .background_step = 4,
+            .change_threshold = 2,
+            .key_interval = 16,
+            .quality = 1,
+            .rdoq = 1,
+        },
 };
 
 __END_DECLS
@@ -8,6 +8,7 @@
 #include "master.h"
 #include <fcntl.h>
 #include <libgen.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,7 +25,7 @@ static opt_t *parse(int argc, char *argv[]) {
   }
   memcpy(p_opt, &default_opt, sizeof(opt_t));
   int c;
-  char optstring[] = "t:i:o:";
+  char optstring[] = "t:i:o:l:r:B:W:";
   while ((c = getopt(argc, argv, optstring)) != -1) {
     switch (c) {
     case 't':
@@ -33,12 +34,40 @@ static opt_t *parse(int argc, char *argv[]) {
     case 'o':
       p_opt->output_dir = optarg;
       break;
+    case 'l':
+      p_opt->layer_number = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      if (p_opt->rect_number == ROI_RECT_MAX) {
+        fprintf(stderr, "%s: too many ROI rectangles\n", optarg);
+        return NULL;
+      }
+      roi_rect_t *p_rect = &p_opt->rects[p_opt->rect_number++];
+      if (sscanf(optarg, "%hu,%hu,%hu,%hu", &p_rect->x, &p_rect->y,
+                 &p_rect->width, &p_rect->height) != 4) {
+        fprintf(stderr, "%s: ROI should be X,Y,WIDTH,HEIGHT\n", optarg);
+        return NULL;
+      }
+      break;
+    case 'B':
+      p_opt->budget = strtoul(optarg, NULL, 0);
+      if (p_opt->budget > TP_CONTROL_BUDGET_MAX) {
+        fprintf(stderr, "%s: budget should be at most %u bytes\n", optarg,
+                TP_CONTROL_BUDGET_MAX);
+        return NULL;
+      }
+      break;
+    case 'W':
+      p_opt->window = strtoul(optarg, NULL, 0);
+      break;
     case 'i':
       p_opt->img_number++;
     }
   }
   if (p_opt->img_number == 0) {
-    printf("usage: %s [-t TTY] [-o OUTPUT_DIR] -i IMAGE1 [-i IMAGE2 ...]\n",
+    printf("usage: %s [-t TTY] [-o OUTPUT_DIR] [-l LAYERS] "
+           "[-r X,Y,WIDTH,HEIGHT ...] [-B BUDGET] [-W WINDOW] "
+           "-i IMAGE1 [-i IMAGE2 ...]\n",
            argv[0]);
     return NULL;
   }
@@ -46,6 +75,7 @@ static opt_t *parse(int argc, char *argv[]) {
   p_opt->imgs = malloc(p_opt->img_number * sizeof(img_t));
   int i = 0;
   wordexp_t exp_result;
+  optind = 1;
   while ((c = getopt(argc, argv, optstring)) != -1) {
     switch (c) {
     case 'i':
@@ -63,7 +93,7 @@ static opt_t *parse(int argc, char *argv[]) {
         return NULL;
       }
       FILE *file = fopen(p_opt->imgs[i].name, "r");
-      if (fread(p_opt->imgs[i].name, 1, p_opt->imgs[i].size, file) !=
+      if (fread(p_opt->imgs[i].file, 1, p_opt->imgs[i].size, file) !=
           p_opt->imgs[i].size) {
         perror(p_opt->imgs[i].name);
         return NULL;
@@ -76,6 +106,185 @@ static opt_t *parse(int argc, char *argv[]) {
   return p_opt;
 }
 
+/*
+ * send ROI rectangles in units of TP_CONTROL_ROI_UNIT pixels, and the byte
+ * budget
+ */
+static int send_control(arq_t *p_arq, const opt_t *p_opt, frame_t *p_frame) {
+  p_frame->frame_type = TP_FRAME_TYPE_CONTROL;
+  for (unsigned i = 0; i < p_opt->rect_number; i++) {
+    const roi_rect_t *p_rect = &p_opt->rects[i];
+    unsigned x = p_rect->x / TP_CONTROL_ROI_UNIT;
+    unsigned y = p_rect->y / TP_CONTROL_ROI_UNIT;
+    unsigned width = (p_rect->x + p_rect->width + TP_CONTROL_ROI_UNIT - 1) /
+                         TP_CONTROL_ROI_UNIT -
+                     x;
+    unsigned height = (p_rect->y + p_rect->height + TP_CONTROL_ROI_UNIT - 1) /
+                          TP_CONTROL_ROI_UNIT -
+                      y;
+    p_frame->cmd_id = TP_CONTROL_CMD_ID(
+        TP_CONTROL_ROI, TP_CONTROL_ROI_ARGUMENT(x, y, width, height));
+    if (arq_send(p_arq, p_frame) == -1)
+      return -1;
+    printf("master: control: ROI %ux%u+%u+%u\n", p_rect->width,
+           p_rect->height, p_rect->x, p_rect->y);
+  }
+  if (p_opt->budget) {
+    p_frame->cmd_id = TP_CONTROL_CMD_ID(TP_CONTROL_BUDGET, p_opt->budget);
+    if (arq_send(p_arq, p_frame) == -1)
+      return -1;
+    printf("master: control: budget %lu bytes\n", p_opt->budget);
+  }
+  return 0;
+}
+
+static void reset_download(download_t *p_download, n_file_t n_file) {
+  if (p_download->indexed)
+    container_free(&p_download->container);
+  free(p_download->data);
+  memset(p_download, 0, sizeof(*p_download));
+  p_download->n_file = n_file;
+}
+
+/**
+ * @brief track layer boundaries of a progressive image being downloaded
+ *
+ * @param p_opt
+ * @param p_download
+ * @param data_len bytes received
+ * @return bytes to keep, less than data_len after the last wanted layer
+ */
+static size_t update_download(const opt_t *p_opt, download_t *p_download,
+                              const uint8_t *data, size_t data_len) {
+  if (p_download->stopped)
+    return 0;
+  size_t size = p_download->size + data_len;
+  if (!p_download->indexed) {
+    uint8_t *buffer = realloc(p_download->data, size);
+    if (buffer == NULL) {
+      perror("download");
+      return data_len;
+    }
+    memcpy(buffer + p_download->size, data, data_len);
+    p_download->data = buffer;
+    ssize_t index_size = container_peek_index_size(buffer, size);
+    if (index_size > 0 && size >= (size_t)index_size) {
+      if (container_read(&p_download->container, buffer, size) == 0)
+        p_download->indexed = 1;
+      free(p_download->data);
+      p_download->data = NULL;
+    }
+  }
+  size_t keep = data_len;
+  if (p_download->indexed) {
+    const container_t *p_container = &p_download->container;
+    unsigned layer_number = p_container->header.layer_number;
+    while (p_download->layer < layer_number &&
+           size >= container_layer_end(p_container, p_download->layer))
+      printf("master: receive data: compressed image %d layer [%u/%u]\n",
+             p_download->n_file, ++p_download->layer, layer_number);
+    if (p_opt->layer_number != 0 && p_download->layer >= p_opt->layer_number &&
+        p_download->layer < layer_number) {
+      keep = container_layer_end(p_container, p_opt->layer_number - 1) -
+             p_download->size;
+      p_download->stopped = 1;
+      printf("master: stop downloading compressed image %d\n",
+             p_download->n_file);
+    }
+  }
+  p_download->size = size;
+  return keep;
+}
+
+/* ask the slave not to send the rest of a compressed image */
+static void stop_download(master_t *p_master, n_file_t n_file) {
+  frame_t frame = default_frame;
+  frame.frame_type = TP_FRAME_TYPE_CONTROL;
+  frame.cmd_id = TP_CONTROL_CMD_ID(TP_CONTROL_STOP, n_file);
+  if (arq_send(&p_master->arq, &frame) == -1)
+    perror(p_master->p_opt->tty);
+  printf("master: control: stop compressed image %d\n", n_file);
+}
+
+/* handle a frame from the slave */
+static void handle(void *arg, const frame_t *p_input_frame) {
+  master_t *p_master = arg;
+  const opt_t *p_opt = p_master->p_opt;
+  frame_t *p_output_frame = &p_master->output_frame;
+  char filename[PATH_MAX];
+  switch (p_input_frame->frame_type) {
+  case TP_FRAME_TYPE_REQUEST_DATA:
+    /* the slave goes on after an image it cannot compress */
+    if (p_input_frame->n_file > 0 &&
+        (p_master->download.n_file != p_input_frame->n_file - 1 ||
+         p_master->download.size == 0))
+      fprintf(stderr, "master: compressed image %d is not received\n",
+              p_input_frame->n_file - 1);
+    /* the slave asks for the image after the last one */
+    if (p_input_frame->n_file >= p_opt->img_number) {
+      printf("master: all %zu images are sent\n", p_opt->img_number);
+      p_master->finished = 1;
+      event_loop_stop(&p_master->loop);
+      break;
+    }
+    p_output_frame->frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
+    p_output_frame->n_file = p_input_frame->n_file;
+    img_t img = p_opt->imgs[p_input_frame->n_file];
+    size_t totol_frames = img.size / TP_FRAME_DATA_LEN_MAX +
+                          !!(img.size % TP_FRAME_DATA_LEN_MAX);
+    uint8_t *p_file = img.file;
+    for (size_t i = 0; i < totol_frames; i++) {
+      size_t rest = img.size - i * TP_FRAME_DATA_LEN_MAX;
+      p_output_frame->data_len =
+          rest < TP_FRAME_DATA_LEN_MAX ? rest : TP_FRAME_DATA_LEN_MAX;
+      memcpy(p_output_frame->data, p_file, p_output_frame->data_len);
+      p_file += p_output_frame->data_len;
+      if (arq_send(&p_master->arq, p_output_frame) == -1) {
+        perror(p_opt->tty);
+        break;
+      }
+      printf("master: send data: raw image %d [%ld/%ld]\n",
+             p_input_frame->n_file, i, totol_frames);
+    }
+    p_output_frame->frame_type = TP_FRAME_TYPE_REQUEST_DATA;
+    printf("master: request data: compressed image %d\n",
+           p_input_frame->n_file);
+    if (arq_send(&p_master->arq, p_output_frame) == -1)
+      perror(p_opt->tty);
+    break;
+  case TP_FRAME_TYPE_TRANSPORT_DATA:
+    printf("master: receive data: compressed image %d\n",
+           p_input_frame->n_file);
+    if (p_input_frame->n_file >= p_opt->img_number) {
+      fprintf(stderr, "master: compressed image %d is not sent\n",
+              p_input_frame->n_file);
+      break;
+    }
+    download_t *p_download = &p_master->download;
+    if (p_download->n_file != p_input_frame->n_file)
+      reset_download(p_download, p_input_frame->n_file);
+    int stopped = p_download->stopped;
+    size_t data_len = update_download(p_opt, p_download, p_input_frame->data,
+                                      p_input_frame->data_len);
+    if (!stopped && p_download->stopped)
+      stop_download(p_master, p_input_frame->n_file);
+    if (data_len == 0)
+      break;
+    char *name = basename(p_opt->imgs[p_input_frame->n_file].name);
+    snprintf(filename, sizeof(filename), "%s/%s.bin", p_opt->output_dir, name);
+    FILE *file = fopen(filename, "a");
+    if (file == NULL) {
+      perror(filename);
+      break;
+    }
+    if (fwrite(p_input_frame->data, 1, data_len, file) != data_len) {
+      perror(filename);
+      break;
+    }
+    fclose(file);
+  }
+}
+
 int main(int argc, char *argv[]) {
   opt_t *p_opt = parse(argc, argv);
   if (p_opt == NULL) {
@@ -86,58 +295,19 @@ int main(int argc, char *argv[]) {
     perror(p_opt->tty);
     return EXIT_FAILURE;
   }
-  frame_t input_frame, output_frame = default_frame;
-
-  for (;;) {
-    wait_frame(fd, &input_frame, &output_frame);
+  master_t master = {.p_opt = p_opt,
+                     .output_frame = default_frame,
+                     .download = {.n_file = 0, .data = NULL}};
+  if (event_loop_init(&master.loop) == -1 ||
+      arq_init(&master.arq, &master.loop, fd, TP_ADDRESS, p_opt->window,
+               handle, &master) == -1)
+    return EXIT_FAILURE;
+  if (send_control(&master.arq, p_opt, &master.output_frame) == -1)
+    perror(p_opt->tty);
 
-    switch (input_frame.frame_type) {
-    case TP_FRAME_TYPE_REQUEST_DATA:
-      output_frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
-      output_frame.n_file = input_frame.n_file;
-      output_frame.data_len = TP_FRAME_DATA_LEN_MAX;
-      img_t img = p_opt->imgs[input_frame.n_file];
-      size_t totol_frames = img.size / TP_FRAME_DATA_LEN_MAX +
-                            !!(img.size % TP_FRAME_DATA_LEN_MAX);
-      uint8_t *p_file = img.file;
-      for (size_t i = 0; i < totol_frames; i++) {
-        if (i == totol_frames - 1)
-          output_frame.data_len = img.size % TP_FRAME_DATA_LEN_MAX;
-        memcpy(output_frame.data, p_file, output_frame.data_len);
-        p_file += output_frame.data_len;
-        if (send_frame(fd, &output_frame) == -1) {
-          perror(p_opt->tty);
-          break;
-        }
-        printf("master: send data: raw image %d [%ld/%ld]\n",
-               input_frame.n_file, i, totol_frames);
-      }
-      output_frame.frame_type = TP_FRAME_TYPE_REQUEST_DATA;
-      printf("master: request data: compressed image %d\n", input_frame.n_file);
-      if (send_frame(fd, &output_frame) == -1)
-        perror(p_opt->tty);
-      break;
-    case TP_FRAME_TYPE_TRANSPORT_DATA:
-      printf("master: receive data: compressed image %d\n", input_frame.n_file);
-      char *name = basename(p_opt->imgs[input_frame.n_file].name);
-      size_t len = strlen(p_opt->output_dir) + strlen(name) + strlen("/.bin");
-      char *filename = malloc(len);
-      if (sprintf(filename, "%s/%s.bin", p_opt->output_dir, name) != len) {
-        perror(name);
-        break;
-      }
-      FILE *file = fopen(filename, "a");
-      if (file == NULL) {
-        perror(filename);
-        break;
-      }
-      if (fwrite(input_frame.data, 1, input_frame.data_len, file) !=
-          input_frame.data_len) {
-        perror(filename);
-        break;
-      }
-      fclose(file);
-    }
-    output_frame.n_frame++;
-  }
+  event_loop_run(&master.loop);
+  arq_close(&master.arq, &master.loop);
+  event_loop_close(&master.loop);
+  close(fd);
+  return master.finished ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -3,7 +3,8 @@
 #include <sys/cdefs.h>
 __BEGIN_DECLS
 
-#include "transmission_protocol.h"
+#include "arq.h"
+#include "container.h"
 
 #define TP_ADDRESS TP_ADDRESS_MASTER
 #ifndef TTY
@@ -24,12 +25,53 @@ typedef struct {
   char *output_dir;
   size_t img_number;
   img_t *imgs;
+  /*
+   * stop downloading a progressive image after these layers, 0 means all, and
+   * ask the slave by TP_CONTROL_STOP not to send the rest. It doesn't combine
+   * with the sequence mode of the slave: a truncated image is no reference
+   * for the delta images after it.
+   */
+  unsigned layer_number;
+  /* regions of interest sent to the slave */
+  roi_rect_t rects[ROI_RECT_MAX];
+  unsigned rect_number;
+  /* bytes per compressed image sent to the slave, 0 means none */
+  unsigned long budget;
+  /* frames on the way, see arq.h */
+  unsigned window;
 } opt_t;
 
+/* a compressed image being downloaded */
+typedef struct {
+  n_file_t n_file;
+  /* received bytes before the index is complete */
+  uint8_t *data;
+  size_t size;
+  int indexed;
+  container_t container;
+  /* completed layers */
+  unsigned layer;
+  int stopped;
+} download_t;
+
+/* state of the frame handler */
+typedef struct {
+  const opt_t *p_opt;
+  frame_t output_frame;
+  download_t download;
+  event_loop_t loop;
+  arq_t arq;
+  /* all images are sent and their compressed images received */
+  int finished;
+} master_t;
+
 const opt_t default_opt = {
     .tty = TTY,
     .output_dir = OUTPUT_DIR,
     .img_number = 0,
+    .layer_number = 0,
+    .rect_number = 0,
+    .window = ARQ_WINDOW,
 };
 const frame_t default_frame = {
     .header = TP_HEADER,
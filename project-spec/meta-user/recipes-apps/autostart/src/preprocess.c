@@ -0,0 +1,231 @@
+/*
+ * Convert a channel to the input picture of the accelerator in one pass.
+ * Refer docs/resources/format.md
+ */
+#include "preprocess.h"
+#include "simd.h"
+#include <endian.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define TILE_SIZE (PREPROCESS_TILE * PREPROCESS_TILE)
+
+static unsigned tiles(unsigned n) {
+  return (n + PREPROCESS_TILE - 1) / PREPROCESS_TILE;
+}
+
+/**
+ * @brief size of the input picture of a channel
+ *
+ * @param width
+ * @param height
+ * @return number of 16 bit pixels including padding
+ */
+size_t preprocess_size(unsigned width, unsigned height) {
+  return (size_t)tiles(width) * (tiles((height + 1) / 2) + tiles(height / 2)) *
+         TILE_SIZE;
+}
+
+/*
+ * Kernels cut 8 full lines of a block into the full tiles of a row of tiles,
+ * and return the number of columns they have done.
+ */
+typedef unsigned (*full_tiles_t)(uint16_t *, const uint8_t *const *, unsigned);
+
+static unsigned full_tiles_scalar(uint16_t *picture,
+                                  const uint8_t *const *lines,
+                                  unsigned width) {
+  unsigned x = 0;
+  for (; x + PREPROCESS_TILE <= width; x += PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++)
+      for (unsigned column = 0; column < PREPROCESS_TILE; column++)
+        picture[row * PREPROCESS_TILE + column] =
+            htole16(lines[row][x + column]);
+    picture += TILE_SIZE;
+  }
+  return x;
+}
+
+#if defined(__SSE2__)
+/* widen 8 pixels of a line into a line of a tile */
+static inline void widen(uint16_t *dst, const uint8_t *src) {
+  _mm_storeu_si128((__m128i *)dst,
+                   _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src),
+                                     _mm_setzero_si128()));
+}
+
+/* widen 16 pixels of a line into lines of 2 adjacent tiles */
+static inline void widen2(uint16_t *dst, const uint8_t *src) {
+  __m128i pixels = _mm_loadu_si128((const __m128i *)src);
+  _mm_storeu_si128((__m128i *)dst,
+                   _mm_unpacklo_epi8(pixels, _mm_setzero_si128()));
+  _mm_storeu_si128((__m128i *)(dst + TILE_SIZE),
+                   _mm_unpackhi_epi8(pixels, _mm_setzero_si128()));
+}
+
+/* tiles from column x on, picture is at the tile of column x */
+static inline unsigned widen_from(uint16_t *picture,
+                                  const uint8_t *const *lines, unsigned x,
+                                  unsigned width) {
+  for (; x + 2 * PREPROCESS_TILE <= width; x += 2 * PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++)
+      widen2(picture + row * PREPROCESS_TILE, lines[row] + x);
+    picture += 2 * TILE_SIZE;
+  }
+  for (; x + PREPROCESS_TILE <= width; x += PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++)
+      widen(picture + row * PREPROCESS_TILE, lines[row] + x);
+    picture += TILE_SIZE;
+  }
+  return x;
+}
+
+static unsigned full_tiles_sse2(uint16_t *picture,
+                                const uint8_t *const *lines, unsigned width) {
+  return widen_from(picture, lines, 0, width);
+}
+
+/* 32 pixels of a line go into lines of 4 adjacent tiles */
+__attribute__((target("avx2"))) static unsigned
+full_tiles_avx2(uint16_t *picture, const uint8_t *const *lines,
+                unsigned width) {
+  unsigned x = 0;
+  for (; x + 4 * PREPROCESS_TILE <= width; x += 4 * PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++) {
+      uint16_t *dst = picture + row * PREPROCESS_TILE;
+      __m256i low = _mm256_cvtepu8_epi16(
+          _mm_loadu_si128((const __m128i *)(lines[row] + x)));
+      __m256i high = _mm256_cvtepu8_epi16(
+          _mm_loadu_si128((const __m128i *)(lines[row] + x + 16)));
+      _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(low));
+      _mm_storeu_si128((__m128i *)(dst + TILE_SIZE),
+                       _mm256_extracti128_si256(low, 1));
+      _mm_storeu_si128((__m128i *)(dst + 2 * TILE_SIZE),
+                       _mm256_castsi256_si128(high));
+      _mm_storeu_si128((__m128i *)(dst + 3 * TILE_SIZE),
+                       _mm256_extracti128_si256(high, 1));
+    }
+    picture += 4 * TILE_SIZE;
+  }
+  return widen_from(picture, lines, x, width);
+}
+#elif defined(__ARM_NEON) && __BYTE_ORDER == __LITTLE_ENDIAN
+static unsigned full_tiles_neon(uint16_t *picture,
+                                const uint8_t *const *lines, unsigned width) {
+  unsigned x = 0;
+  for (; x + 2 * PREPROCESS_TILE <= width; x += 2 * PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++) {
+      uint8x16_t pixels = vld1q_u8(lines[row] + x);
+      uint16_t *dst = picture + row * PREPROCESS_TILE;
+      vst1q_u16(dst, vmovl_u8(vget_low_u8(pixels)));
+      vst1q_u16(dst + TILE_SIZE, vmovl_u8(vget_high_u8(pixels)));
+    }
+    picture += 2 * TILE_SIZE;
+  }
+  for (; x + PREPROCESS_TILE <= width; x += PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++)
+      vst1q_u16(picture + row * PREPROCESS_TILE,
+                vmovl_u8(vld1_u8(lines[row] + x)));
+    picture += TILE_SIZE;
+  }
+  return x;
+}
+#endif
+
+static full_tiles_t full_tiles_kernel(void) {
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_AVX2)
+    return full_tiles_avx2;
+  if (level >= SIMD_SSE2)
+    return full_tiles_sse2;
+#elif defined(__ARM_NEON) && __BYTE_ORDER == __LITTLE_ENDIAN
+  if (level >= SIMD_NEON)
+    return full_tiles_neon;
+#endif
+  (void)level;
+  return full_tiles_scalar;
+}
+
+/*
+ * cut n lines of a block into a row of tiles. A row of tiles is the cache
+ * block: its lines are read once, and the tiles are written sequentially.
+ */
+static uint16_t *tile_row(uint16_t *picture, const uint8_t *const *lines,
+                          unsigned n, unsigned width) {
+  unsigned x = 0;
+  if (n == PREPROCESS_TILE) {
+    x = full_tiles_kernel()(picture, lines, width);
+    picture += x / PREPROCESS_TILE * TILE_SIZE;
+  }
+  /* partial tiles */
+  for (; x < width; x += PREPROCESS_TILE) {
+    for (unsigned row = 0; row < PREPROCESS_TILE; row++)
+      for (unsigned column = 0; column < PREPROCESS_TILE; column++)
+        picture[row * PREPROCESS_TILE + column] =
+            row < n && x + column < width ? htole16(lines[row][x + column])
+                                          : 0;
+    picture += TILE_SIZE;
+  }
+  return picture;
+}
+
+/**
+ * @brief number of stripes of a channel
+ *
+ * @param height
+ * @return stripes of PREPROCESS_STRIPE rows, the last one can be partial
+ */
+unsigned preprocess_stripes(unsigned height) {
+  return tiles((height + 1) / 2);
+}
+
+/**
+ * @brief preprocess rows [stripe * PREPROCESS_STRIPE, (stripe + 1) *
+ * PREPROCESS_STRIPE) of a channel into their rows of tiles. Stripes are
+ * independent, so they can be preprocessed as soon as their rows arrive.
+ *
+ * @param picture preprocess_size() pixels
+ * @param pixels 8 bit channel, only rows of the stripe are read
+ * @param width
+ * @param height
+ * @param stripe less than preprocess_stripes()
+ */
+void preprocess_stripe(uint16_t *picture, const uint8_t *pixels,
+                       unsigned width, unsigned height, unsigned stripe) {
+  size_t tile_row_size = (size_t)tiles(width) * TILE_SIZE;
+  for (unsigned parity = 0; parity < 2; parity++) {
+    unsigned rows = (height + 1 - parity) / 2;
+    unsigned y = stripe * PREPROCESS_TILE;
+    if (y >= rows)
+      continue;
+    const uint8_t *lines[PREPROCESS_TILE];
+    unsigned n = rows - y < PREPROCESS_TILE ? rows - y : PREPROCESS_TILE;
+    for (unsigned row = 0; row < n; row++)
+      lines[row] = pixels + (size_t)(2 * (y + row) + parity) * width;
+    /* the block of odd rows follows all rows of tiles of even rows */
+    tile_row(picture +
+                 (parity * preprocess_stripes(height) + stripe) *
+                     tile_row_size,
+             lines, n, width);
+  }
+}
+
+/**
+ * @brief split rows by parity, tile and widen a channel in one pass, without
+ * intermediate images
+ *
+ * @param picture preprocess_size() pixels, usually the DMA buffer of the
+ * accelerator
+ * @param pixels 8 bit channel
+ * @param width
+ * @param height
+ */
+void preprocess(uint16_t *picture, const uint8_t *pixels, unsigned width,
+                unsigned height) {
+  for (unsigned stripe = 0; stripe < preprocess_stripes(height); stripe++)
+    preprocess_stripe(picture, pixels, width, height, stripe);
+}
@@ -0,0 +1,29 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Input picture of the accelerator, refer docs/resources/format.md
+ *
+ * A channel is split into the block of rows 0, 2, 4, ... (the odd rows when
+ * counted from 1) followed by the block of rows 1, 3, 5, .... Every block is
+ * cut into 8 x 8 tiles stored in raster order, pixels of a tile are in raster
+ * order, and every pixel is widened to 16 bits little endian. Partial tiles at
+ * the right and bottom edges are padded with 0.
+ */
+#define PREPROCESS_TILE 8
+/* rows of a stripe, which makes a row of tiles of both blocks */
+#define PREPROCESS_STRIPE (2 * PREPROCESS_TILE)
+
+size_t preprocess_size(unsigned, unsigned);
+unsigned preprocess_stripes(unsigned);
+void preprocess_stripe(uint16_t *, const uint8_t *, unsigned, unsigned,
+                       unsigned);
+void preprocess(uint16_t *, const uint8_t *, unsigned, unsigned);
+
+__END_DECLS
+#endif /* preprocess.h */
@@ -0,0 +1,129 @@
+/*
+ * Preprocess a raw image while it is being received.
+ */
+#include "raw.h"
+#include "preprocess.h"
+#include "yuv.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t raw_size(const raw_t *p_raw) {
+  return (size_t)p_raw->width * p_raw->height * 2;
+}
+
+/**
+ * @brief prepare to receive a raw image
+ *
+ * @param p_raw freed by raw_free()
+ * @param width
+ * @param height
+ * @param format YUV_PLANAR, YUV_UYVY or YUV_YUYV
+ * @return 0 or -1
+ */
+int raw_init(raw_t *p_raw, unsigned width, unsigned height, int format) {
+  memset(p_raw, 0, sizeof(*p_raw));
+  p_raw->width = width;
+  p_raw->height = height;
+  p_raw->format = format;
+  p_raw->image = malloc(raw_size(p_raw));
+  if (p_raw->image == NULL)
+    goto free_raw;
+  if (format != YUV_PLANAR) {
+    p_raw->packed = malloc(raw_size(p_raw));
+    if (p_raw->packed == NULL)
+      goto free_raw;
+  }
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    p_raw->pictures[channel] =
+        malloc(preprocess_size(channel_width(width, channel),
+                               channel_height(height, channel)) *
+               sizeof(uint16_t));
+    if (p_raw->pictures[channel] == NULL)
+      goto free_raw;
+  }
+  return 0;
+free_raw:
+  perror("raw");
+  raw_free(p_raw);
+  return -1;
+}
+
+/* rows of a channel in the first size bytes of a planar image */
+static unsigned planar_rows(const raw_t *p_raw, unsigned channel,
+                            size_t size) {
+  unsigned width = channel_width(p_raw->width, channel);
+  unsigned height = channel_height(p_raw->height, channel);
+  size_t offset = channel_offset(p_raw->width, p_raw->height, channel);
+  if (size <= offset)
+    return 0;
+  size_t rows = (size - offset) / width;
+  return rows < height ? rows : height;
+}
+
+/**
+ * @brief append received bytes, and preprocess all stripes which become
+ * complete
+ *
+ * @param p_raw
+ * @param data
+ * @param size bytes of data
+ * @return 0 or -1 if there are more bytes than the image
+ */
+int raw_append(raw_t *p_raw, const uint8_t *data, size_t size) {
+  if (size > raw_size(p_raw) - p_raw->size) {
+    errno = EFBIG;
+    perror("raw");
+    return -1;
+  }
+  if (p_raw->format == YUV_PLANAR) {
+    memcpy(p_raw->image + p_raw->size, data, size);
+    p_raw->size += size;
+    for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++)
+      p_raw->rows[channel] = planar_rows(p_raw, channel, p_raw->size);
+  } else {
+    /* rows of packed images hold all channels */
+    memcpy(p_raw->packed + p_raw->size, data, size);
+    p_raw->size += size;
+    unsigned rows = p_raw->size / (2 * p_raw->width);
+    unsigned first = p_raw->rows[CHANNEL_Y];
+    size_t pixels = (size_t)(rows - first) * p_raw->width;
+    yuv_deinterleave(
+        p_raw->image + (size_t)first * p_raw->width,
+        p_raw->image + channel_offset(p_raw->width, p_raw->height, CHANNEL_U) +
+            (size_t)first * channel_width(p_raw->width, CHANNEL_U),
+        p_raw->image + channel_offset(p_raw->width, p_raw->height, CHANNEL_V) +
+            (size_t)first * channel_width(p_raw->width, CHANNEL_V),
+        p_raw->packed + (size_t)first * 2 * p_raw->width, pixels,
+        p_raw->format);
+    for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++)
+      p_raw->rows[channel] = rows;
+  }
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    unsigned width = channel_width(p_raw->width, channel);
+    unsigned height = channel_height(p_raw->height, channel);
+    /* the last stripe can be short */
+    unsigned stripes = p_raw->rows[channel] == height
+                           ? preprocess_stripes(height)
+                           : p_raw->rows[channel] / PREPROCESS_STRIPE;
+    for (; p_raw->stripes[channel] < stripes; p_raw->stripes[channel]++)
+      preprocess_stripe(p_raw->pictures[channel],
+                        p_raw->image +
+                            channel_offset(p_raw->width, p_raw->height,
+                                           channel),
+                        width, height, p_raw->stripes[channel]);
+  }
+  return 0;
+}
+
+/* all bytes are received and preprocessed */
+int raw_complete(const raw_t *p_raw) { return p_raw->size == raw_size(p_raw); }
+
+void raw_free(raw_t *p_raw) {
+  free(p_raw->packed);
+  free(p_raw->image);
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++)
+    free(p_raw->pictures[channel]);
+  memset(p_raw, 0, sizeof(*p_raw));
+}
@@ -0,0 +1,40 @@
+#ifndef RAW_H
+#define RAW_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "image.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A raw image received frame by frame. As soon as all rows of a stripe of a
+ * channel have arrived, the stripe is preprocessed into the input picture of
+ * the accelerator, so nothing is left to reformat when the last frame
+ * arrives.
+ */
+typedef struct {
+  unsigned width;
+  unsigned height;
+  /* YUV_PLANAR, YUV_UYVY or YUV_YUYV */
+  int format;
+  /* bytes received */
+  size_t size;
+  /* the image as received if it is packed, otherwise NULL */
+  uint8_t *packed;
+  /* planar image */
+  uint8_t *image;
+  /* preprocess_size() pixels per channel */
+  uint16_t *pictures[IMAGE_CHANNELS];
+  /* complete rows and preprocessed stripes of every channel */
+  unsigned rows[IMAGE_CHANNELS];
+  unsigned stripes[IMAGE_CHANNELS];
+} raw_t;
+
+int raw_init(raw_t *, unsigned, unsigned, int);
+int raw_append(raw_t *, const uint8_t *, size_t);
+int raw_complete(const raw_t *);
+void raw_free(raw_t *);
+
+__END_DECLS
+#endif /* raw.h */
@@ -0,0 +1,382 @@
+#include "roi.h"
+#include "image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * @brief create an empty region of interest, all tiles are background
+ *
+ * @param p_roi should be freed by roi_free()
+ * @param width luma width of image
+ * @param height luma height of image
+ * @param shift tiles are 2^shift x 2^shift
+ * @return 0 or -1
+ */
+int roi_init(roi_t *p_roi, unsigned width, unsigned height, unsigned shift) {
+  p_roi->shift = shift;
+  p_roi->width = (width + (1u << shift) - 1) >> shift;
+  p_roi->height = (height + (1u << shift) - 1) >> shift;
+  p_roi->map = calloc((size_t)p_roi->width * p_roi->height + 1, 1);
+  if (p_roi->map == NULL) {
+    perror("roi");
+    return -1;
+  }
+  return 0;
+}
+
+/* mark all tiles which overlap a rectangle */
+void roi_add_rect(roi_t *p_roi, const roi_rect_t *p_rect) {
+  if (p_rect->width == 0 || p_rect->height == 0)
+    return;
+  unsigned x0 = p_rect->x >> p_roi->shift, y0 = p_rect->y >> p_roi->shift;
+  unsigned x1 = (p_rect->x + p_rect->width - 1u) >> p_roi->shift;
+  unsigned y1 = (p_rect->y + p_rect->height - 1u) >> p_roi->shift;
+  for (unsigned y = y0; y <= y1 && y < p_roi->height; y++)
+    for (unsigned x = x0; x <= x1 && x < p_roi->width; x++)
+      p_roi->map[y * p_roi->width + x] = ROI_FOREGROUND;
+}
+
+/**
+ * @brief mark tiles brighter than the dark background. The background
+ * brightness is the median of mean brightness of all tiles.
+ *
+ * @param p_roi
+ * @param luma 8 bit luma plane
+ * @param width
+ * @param height
+ * @param contrast
+ * @return number of marked tiles
+ */
+size_t roi_detect(roi_t *p_roi, const uint8_t *luma, unsigned width,
+                  unsigned height, unsigned contrast) {
+  size_t tile_number = (size_t)p_roi->width * p_roi->height;
+  uint32_t *sums = calloc(tile_number + 1, sizeof(uint32_t));
+  if (sums == NULL) {
+    perror("roi");
+    return 0;
+  }
+  for (unsigned y = 0; y < height; y++) {
+    uint32_t *row_sums = sums + (size_t)(y >> p_roi->shift) * p_roi->width;
+    const uint8_t *row = luma + (size_t)y * width;
+    for (unsigned x = 0; x < width; x++)
+      row_sums[x >> p_roi->shift] += row[x];
+  }
+  size_t hist[256] = {0};
+  unsigned tile_size = 1u << p_roi->shift;
+  for (unsigned y = 0; y < p_roi->height; y++)
+    for (unsigned x = 0; x < p_roi->width; x++) {
+      /* tiles at the right and bottom edges can be smaller */
+      unsigned tile_width = width - x * tile_size < tile_size
+                                ? width - x * tile_size
+                                : tile_size;
+      unsigned tile_height = height - y * tile_size < tile_size
+                                 ? height - y * tile_size
+                                 : tile_size;
+      size_t i = (size_t)y * p_roi->width + x;
+      sums[i] /= tile_width * tile_height;
+      hist[sums[i]]++;
+    }
+  unsigned median = 0;
+  for (size_t n = 0; median < 255; median++) {
+    n += hist[median];
+    if (2 * n >= tile_number)
+      break;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < tile_number; i++)
+    if (sums[i] >= median + contrast) {
+      p_roi->map[i] = ROI_FOREGROUND;
+      count++;
+    }
+  free(sums);
+  return count;
+}
+
+/* sum of absolute differences */
+static uint32_t sad(const uint8_t *a, const uint8_t *b, size_t n) {
+  uint32_t sum = 0;
+  size_t i = 0;
+#if defined(__SSE2__)
+  __m128i sums = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16)
+    sums = _mm_add_epi64(
+        sums, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + i)),
+                           _mm_loadu_si128((const __m128i *)(b + i))));
+  sum = _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#elif defined(__ARM_NEON)
+  uint32x4_t sums = vdupq_n_u32(0);
+  for (; i + 16 <= n; i += 16)
+    sums = vpadalq_u16(sums, vpaddlq_u8(vabdq_u8(vld1q_u8(a + i),
+                                                 vld1q_u8(b + i))));
+  sum = vgetq_lane_u32(sums, 0) + vgetq_lane_u32(sums, 1) +
+        vgetq_lane_u32(sums, 2) + vgetq_lane_u32(sums, 3);
+#endif
+  for (; i < n; i++)
+    sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+  return sum;
+}
+
+/* a pair of planar YUV422 images */
+typedef struct {
+  uint8_t *dst;
+  const uint8_t *src;
+} images_t;
+
+/*
+ * call fn on every row of the pixels of a tile in all channels of a planar
+ * image. Returns the sum of return values of fn.
+ */
+typedef uint32_t (*row_fn_t)(const images_t *, size_t, size_t);
+
+static uint64_t for_tile_rows(const roi_t *p_roi, unsigned x, unsigned y,
+                              const images_t *p_images, unsigned width,
+                              unsigned height, row_fn_t fn,
+                              size_t *p_pixels) {
+  uint64_t sum = 0;
+  size_t pixels = 0;
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    unsigned w = channel_width(width, channel);
+    unsigned h = channel_height(height, channel);
+    /* chroma is subsampled horizontally */
+    unsigned shift = channel != CHANNEL_Y;
+    unsigned x0 = (x << p_roi->shift) >> shift;
+    unsigned x1 = ((x + 1) << p_roi->shift) >> shift;
+    unsigned y0 = y << p_roi->shift, y1 = (y + 1) << p_roi->shift;
+    if (x1 > w)
+      x1 = w;
+    if (y1 > h)
+      y1 = h;
+    if (x0 >= x1 || y0 >= y1)
+      continue;
+    size_t offset = channel_offset(width, height, channel);
+    for (unsigned row = y0; row < y1; row++) {
+      sum += fn(p_images, offset + (size_t)row * w + x0, x1 - x0);
+    }
+    pixels += (size_t)(x1 - x0) * (y1 - y0);
+  }
+  if (p_pixels)
+    *p_pixels = pixels;
+  return sum;
+}
+
+static uint32_t sad_row(const images_t *p_images, size_t i, size_t n) {
+  return sad(p_images->dst + i, p_images->src + i, n);
+}
+
+static uint32_t copy_row(const images_t *p_images, size_t i, size_t n) {
+  memcpy(p_images->dst + i, p_images->src + i, n);
+  return 0;
+}
+
+/**
+ * @brief mark tiles which are nearly the same as the reference image as
+ * unchanged. The transform of a tile depends on pixels around it, so the
+ * neighbors of changed tiles are kept changed.
+ *
+ * @param p_roi
+ * @param image planar YUV422
+ * @param reference planar YUV422
+ * @param width luma width
+ * @param height luma height
+ * @param threshold a tile is changed if its mean absolute difference is more
+ * than this
+ * @return number of unchanged tiles
+ */
+size_t roi_detect_changes(roi_t *p_roi, const uint8_t *image,
+                          const uint8_t *reference, unsigned width,
+                          unsigned height, unsigned threshold) {
+  size_t tile_number = (size_t)p_roi->width * p_roi->height;
+  uint8_t *changed = calloc(tile_number + 1, 1);
+  if (changed == NULL) {
+    perror("roi");
+    return 0;
+  }
+  /* sad_row() doesn't write dst */
+  images_t images = {(uint8_t *)image, reference};
+  for (unsigned y = 0; y < p_roi->height; y++)
+    for (unsigned x = 0; x < p_roi->width; x++) {
+      size_t pixels;
+      uint64_t sum = for_tile_rows(p_roi, x, y, &images, width, height,
+                                   sad_row, &pixels);
+      if (sum > (uint64_t)threshold * pixels)
+        changed[(size_t)y * p_roi->width + x] = 1;
+    }
+  size_t count = 0;
+  for (unsigned y = 0; y < p_roi->height; y++)
+    for (unsigned x = 0; x < p_roi->width; x++) {
+      int near = 0;
+      for (unsigned j = y ? y - 1 : 0; j <= y + 1 && j < p_roi->height; j++)
+        for (unsigned i = x ? x - 1 : 0; i <= x + 1 && i < p_roi->width; i++)
+          near |= changed[(size_t)j * p_roi->width + i];
+      if (!near) {
+        p_roi->map[(size_t)y * p_roi->width + x] = ROI_UNCHANGED;
+        count++;
+      }
+    }
+  free(changed);
+  return count;
+}
+
+/**
+ * @brief copy the pixels of all coded tiles to the reference image
+ *
+ * @param p_roi
+ * @param reference planar YUV422
+ * @param image planar YUV422
+ * @param width luma width
+ * @param height luma height
+ */
+void roi_update_reference(const roi_t *p_roi, uint8_t *reference,
+                          const uint8_t *image, unsigned width,
+                          unsigned height) {
+  images_t images = {reference, image};
+  for (unsigned y = 0; y < p_roi->height; y++)
+    for (unsigned x = 0; x < p_roi->width; x++)
+      if (p_roi->map[(size_t)y * p_roi->width + x] != ROI_UNCHANGED)
+        for_tile_rows(p_roi, x, y, &images, width, height, copy_row, NULL);
+}
+
+/* number of tiles of a region */
+size_t roi_count(const roi_t *p_roi, int region) {
+  size_t count = 0;
+  for (size_t i = 0; i < (size_t)p_roi->width * p_roi->height; i++)
+    count += p_roi->map[i] == region;
+  return count;
+}
+
+/*
+ * tile of each column of a subband. Chroma is subsampled horizontally, so a
+ * chroma column covers twice luma pixels.
+ */
+static void column_tiles(const roi_t *p_roi, unsigned channel, unsigned level,
+                         unsigned width, unsigned *tiles) {
+  unsigned shift = level + (channel != CHANNEL_Y);
+  for (unsigned x = 0; x < width; x++) {
+    unsigned tile = ((size_t)x << shift) >> p_roi->shift;
+    tiles[x] = tile < p_roi->width ? tile : p_roi->width - 1;
+  }
+}
+
+static const uint8_t *row_map(const roi_t *p_roi, unsigned level,
+                              unsigned y) {
+  unsigned tile = ((size_t)y << level) >> p_roi->shift;
+  if (tile >= p_roi->height)
+    tile = p_roi->height - 1;
+  return p_roi->map + (size_t)tile * p_roi->width;
+}
+
+/**
+ * @brief collect coefficients of a region of a subband in raster order
+ *
+ * @param p_roi
+ * @param channel
+ * @param subband
+ * @param width width of the channel
+ * @param height height of the channel
+ * @param region ROI_FOREGROUND or ROI_BACKGROUND
+ * @param raster subband, unused if values is NULL
+ * @param stride of raster
+ * @param values NULL to count only
+ * @return number of coefficients of the region
+ */
+size_t roi_gather(const roi_t *p_roi, unsigned channel, unsigned subband,
+                  unsigned width, unsigned height, int region,
+                  const int16_t *raster, size_t stride, int16_t *values) {
+  unsigned subband_width, subband_height, level = subband_level(subband);
+  subband_shape(width, height, subband, &subband_width, &subband_height);
+  unsigned *tiles = malloc((subband_width + 1) * sizeof(unsigned));
+  if (tiles == NULL) {
+    perror("roi");
+    return 0;
+  }
+  column_tiles(p_roi, channel, level, subband_width, tiles);
+  size_t n = 0;
+  for (unsigned y = 0; y < subband_height; y++) {
+    const uint8_t *map = row_map(p_roi, level, y);
+    for (unsigned x = 0; x < subband_width; x++)
+      if (map[tiles[x]] == region) {
+        if (values)
+          values[n] = raster[y * stride + x];
+        n++;
+      }
+  }
+  free(tiles);
+  return n;
+}
+
+/**
+ * @brief put coefficients of a region back to a subband, the reverse of
+ * roi_gather()
+ *
+ * @return number of coefficients of the region
+ */
+size_t roi_scatter(const roi_t *p_roi, unsigned channel, unsigned subband,
+                   unsigned width, unsigned height, int region,
+                   const int16_t *values, int16_t *raster, size_t stride) {
+  unsigned subband_width, subband_height, level = subband_level(subband);
+  subband_shape(width, height, subband, &subband_width, &subband_height);
+  unsigned *tiles = malloc((subband_width + 1) * sizeof(unsigned));
+  if (tiles == NULL) {
+    perror("roi");
+    return 0;
+  }
+  column_tiles(p_roi, channel, level, subband_width, tiles);
+  size_t n = 0;
+  for (unsigned y = 0; y < subband_height; y++) {
+    const uint8_t *map = row_map(p_roi, level, y);
+    int16_t *row = raster + y * stride;
+    for (unsigned x = 0; x < subband_width; x++)
+      if (map[tiles[x]] == region)
+        row[x] = values[n++];
+  }
+  free(tiles);
+  return n;
+}
+
+/**
+ * @brief copy or add the coefficients of a region of a reference subband to a
+ * subband
+ *
+ * @param reference raster of the reference subband
+ * @param raster subband
+ * @param stride of reference and raster
+ * @param add add the reference if not 0, or copy it
+ * @return number of coefficients of the region
+ */
+size_t roi_apply(const roi_t *p_roi, unsigned channel, unsigned subband,
+                 unsigned width, unsigned height, int region,
+                 const int16_t *reference, int16_t *raster, size_t stride,
+                 int add) {
+  unsigned subband_width, subband_height, level = subband_level(subband);
+  subband_shape(width, height, subband, &subband_width, &subband_height);
+  unsigned *tiles = malloc((subband_width + 1) * sizeof(unsigned));
+  if (tiles == NULL) {
+    perror("roi");
+    return 0;
+  }
+  column_tiles(p_roi, channel, level, subband_width, tiles);
+  size_t n = 0;
+  for (unsigned y = 0; y < subband_height; y++) {
+    const uint8_t *map = row_map(p_roi, level, y);
+    int16_t *row = raster + y * stride;
+    const int16_t *reference_row = reference + y * stride;
+    for (unsigned x = 0; x < subband_width; x++)
+      if (map[tiles[x]] == region) {
+        row[x] = add ? row[x] + reference_row[x] : reference_row[x];
+        n++;
+      }
+  }
+  free(tiles);
+  return n;
+}
+
+void roi_free(roi_t *p_roi) {
+  free(p_roi->map);
+  p_roi->map = NULL;
+}
@@ -0,0 +1,61 @@
+#ifndef ROI_H
+#define ROI_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Region of interest. The image is divided into tiles of
+ * 2^shift x 2^shift luma pixels, and a tile is either of interest or
+ * background. In sequence mode a tile can also be unchanged since the
+ * reference image. A coefficient of a subband belongs to the tile which
+ * contains the top left pixel it is computed from.
+ */
+/* 64 x 64 */
+#define ROI_TILE_SHIFT 6
+#define ROI_RECT_MAX 16
+/* a tile is of interest if it is brighter than the median tile by this */
+#define ROI_CONTRAST 16
+
+#define ROI_BACKGROUND 0
+#define ROI_FOREGROUND 1
+/* in sequence mode, a tile which is copied from the reference image */
+#define ROI_UNCHANGED 2
+
+/* rectangle in luma pixels */
+typedef struct {
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+} roi_rect_t;
+
+typedef struct {
+  unsigned shift;
+  /* in tiles */
+  unsigned width;
+  unsigned height;
+  /* width x height, ROI_FOREGROUND, ROI_BACKGROUND or ROI_UNCHANGED */
+  uint8_t *map;
+} roi_t;
+
+int roi_init(roi_t *, unsigned, unsigned, unsigned);
+void roi_add_rect(roi_t *, const roi_rect_t *);
+size_t roi_detect(roi_t *, const uint8_t *, unsigned, unsigned, unsigned);
+size_t roi_detect_changes(roi_t *, const uint8_t *, const uint8_t *, unsigned,
+                          unsigned, unsigned);
+void roi_update_reference(const roi_t *, uint8_t *, const uint8_t *, unsigned,
+                          unsigned);
+size_t roi_count(const roi_t *, int);
+size_t roi_gather(const roi_t *, unsigned, unsigned, unsigned, unsigned, int,
+                  const int16_t *, size_t, int16_t *);
+size_t roi_scatter(const roi_t *, unsigned, unsigned, unsigned, unsigned, int,
+                   const int16_t *, int16_t *, size_t);
+size_t roi_apply(const roi_t *, unsigned, unsigned, unsigned, unsigned, int,
+                 const int16_t *, int16_t *, size_t, int);
+void roi_free(roi_t *);
+
+__END_DECLS
+#endif /* roi.h */
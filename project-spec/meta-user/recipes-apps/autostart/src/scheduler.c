@@ -0,0 +1,150 @@
+#include "scheduler.h"
+#include <pthread.h>
+#include <stdio.h>
+
+typedef struct {
+  const stages_t *p_stages;
+  void *data;
+  unsigned channels;
+  timestamp_t *timestamps;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  /* number of channels whose transform is finished */
+  unsigned transformed;
+  int status;
+} scheduler_t;
+
+static double elapsed(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) * 1e3 +
+         (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+static int run(stage_t stage, void *data, unsigned channel,
+               timestamp_t *p_timestamp, unsigned index) {
+  clock_gettime(CLOCK_MONOTONIC, &p_timestamp->start[index]);
+  int status = stage(data, channel);
+  clock_gettime(CLOCK_MONOTONIC, &p_timestamp->end[index]);
+  return status;
+}
+
+static void notify(scheduler_t *p_scheduler, int status) {
+  pthread_mutex_lock(&p_scheduler->mutex);
+  if (status == -1)
+    p_scheduler->status = -1;
+  else
+    p_scheduler->transformed++;
+  pthread_cond_signal(&p_scheduler->cond);
+  pthread_mutex_unlock(&p_scheduler->mutex);
+}
+
+static void *entropy_thread(void *arg) {
+  scheduler_t *p_scheduler = arg;
+  for (unsigned channel = 0; channel < p_scheduler->channels; channel++) {
+    pthread_mutex_lock(&p_scheduler->mutex);
+    while (p_scheduler->transformed <= channel && p_scheduler->status == 0)
+      pthread_cond_wait(&p_scheduler->cond, &p_scheduler->mutex);
+    int status = p_scheduler->status;
+    pthread_mutex_unlock(&p_scheduler->mutex);
+    if (status == -1)
+      break;
+    if (run(p_scheduler->p_stages->entropy, p_scheduler->data, channel,
+            &p_scheduler->timestamps[channel], STAGE_ENTROPY) == -1) {
+      pthread_mutex_lock(&p_scheduler->mutex);
+      p_scheduler->status = -1;
+      pthread_mutex_unlock(&p_scheduler->mutex);
+      break;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * The transform of a channel lasts from its submission to the return of its
+ * wait, so the preprocess of the next channel is hidden behind it.
+ */
+static int transform_channels(scheduler_t *p_scheduler) {
+  const stages_t *p_stages = p_scheduler->p_stages;
+  void *data = p_scheduler->data;
+  timestamp_t *timestamps = p_scheduler->timestamps;
+  if (p_scheduler->channels == 0)
+    return 0;
+  if (run(p_stages->preprocess, data, 0, &timestamps[0], STAGE_PREPROCESS) ==
+      -1)
+    return -1;
+  for (unsigned channel = 0; channel < p_scheduler->channels; channel++) {
+    timestamp_t *p_timestamp = &timestamps[channel];
+    clock_gettime(CLOCK_MONOTONIC, &p_timestamp->start[STAGE_TRANSFORM]);
+    if (p_stages->submit(data, channel) == -1)
+      return -1;
+    if (channel + 1 < p_scheduler->channels &&
+        run(p_stages->preprocess, data, channel + 1, &timestamps[channel + 1],
+            STAGE_PREPROCESS) == -1)
+      return -1;
+    int status = p_stages->wait(data, channel);
+    clock_gettime(CLOCK_MONOTONIC, &p_timestamp->end[STAGE_TRANSFORM]);
+    if (status == -1)
+      return -1;
+    notify(p_scheduler, 0);
+    pthread_mutex_lock(&p_scheduler->mutex);
+    status = p_scheduler->status;
+    pthread_mutex_unlock(&p_scheduler->mutex);
+    if (status == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief run all stages of all channels
+ *
+ * @param p_stages callbacks
+ * @param data passed to callbacks
+ * @param channels number of channels
+ * @param timestamps start and end of every stage of every channel
+ * @return 0 or -1 if any stage fails
+ */
+int schedule(const stages_t *p_stages, void *data, unsigned channels,
+             timestamp_t *timestamps) {
+  scheduler_t scheduler = {
+      .p_stages = p_stages,
+      .data = data,
+      .channels = channels,
+      .timestamps = timestamps,
+      .mutex = PTHREAD_MUTEX_INITIALIZER,
+      .cond = PTHREAD_COND_INITIALIZER,
+      .transformed = 0,
+      .status = 0,
+  };
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, entropy_thread, &scheduler) != 0) {
+    perror("pthread_create");
+    return -1;
+  }
+  if (transform_channels(&scheduler) == -1)
+    notify(&scheduler, -1);
+  pthread_join(thread, NULL);
+  pthread_mutex_destroy(&scheduler.mutex);
+  pthread_cond_destroy(&scheduler.cond);
+  return scheduler.status;
+}
+
+void print_timestamps(const timestamp_t *timestamps, unsigned channels) {
+  if (channels == 0)
+    return;
+  struct timespec start = timestamps[0].start[STAGE_PREPROCESS];
+  double stages = 0;
+  for (unsigned channel = 0; channel < channels; channel++) {
+    const timestamp_t *p = &timestamps[channel];
+    double durations[STAGE_NUMBER];
+    for (unsigned i = 0; i < STAGE_NUMBER; i++) {
+      durations[i] = elapsed(p->start[i], p->end[i]);
+      stages += durations[i];
+    }
+    printf("slave: channel %u: preprocess %.3f ms, transform %.3f ms, "
+           "entropy %.3f ms, finished at %.3f ms\n",
+           channel, durations[STAGE_PREPROCESS], durations[STAGE_TRANSFORM],
+           durations[STAGE_ENTROPY], elapsed(start, p->end[STAGE_ENTROPY]));
+  }
+  printf("slave: latency %.3f ms, sum of stages %.3f ms\n",
+         elapsed(start, timestamps[channels - 1].end[STAGE_ENTROPY]), stages);
+}
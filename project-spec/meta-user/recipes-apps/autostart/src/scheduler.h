@@ -0,0 +1,46 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <time.h>
+
+/*
+ * The network accelerator processes one channel at a time, so channels are
+ * pipelined:
+ *
+ *   accelerator: | Y | U | V |
+ *   cpu:             | Y | U | V |
+ *
+ * While the accelerator transforms a channel, the CPU preprocesses the next
+ * channel and entropy codes the previous one. All callbacks of a channel get
+ * the index of the channel and must use buffers of that channel only.
+ */
+#define STAGE_PREPROCESS 0
+#define STAGE_TRANSFORM 1
+#define STAGE_ENTROPY 2
+#define STAGE_NUMBER 3
+
+typedef int (*stage_t)(void *, unsigned);
+
+typedef struct {
+  /* convert a channel to the input layout of the accelerator */
+  stage_t preprocess;
+  /* start the accelerator, must not block */
+  stage_t submit;
+  /* block until the accelerator finishes and fetch its results */
+  stage_t wait;
+  /* entropy code the results of the accelerator */
+  stage_t entropy;
+} stages_t;
+
+typedef struct {
+  struct timespec start[STAGE_NUMBER];
+  struct timespec end[STAGE_NUMBER];
+} timestamp_t;
+
+int schedule(const stages_t *, void *, unsigned, timestamp_t *);
+void print_timestamps(const timestamp_t *, unsigned);
+
+__END_DECLS
+#endif /* scheduler.h */
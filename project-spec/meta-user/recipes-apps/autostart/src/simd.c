@@ -0,0 +1,117 @@
+/*
+ * Runtime detection of SIMD instruction sets.
+ */
+#include "simd.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#ifndef HWCAP_PMULL
+#define HWCAP_PMULL (1 << 4)
+#endif
+#endif
+
+static const char *const names[SIMD_LEVELS] = {"scalar", "sse2", "sse4",
+                                               "avx2", "neon"};
+static int detected = SIMD_SCALAR;
+static int level = SIMD_SCALAR;
+static int clmul;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void detect(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    detected = SIMD_SSE2;
+  if (__builtin_cpu_supports("sse4.1"))
+    detected = SIMD_SSE4;
+  if (__builtin_cpu_supports("avx2"))
+    detected = SIMD_AVX2;
+  clmul = __builtin_cpu_supports("pclmul");
+#elif defined(__aarch64__)
+  if (getauxval(AT_HWCAP) & HWCAP_ASIMD)
+    detected = SIMD_NEON;
+  clmul = !!(getauxval(AT_HWCAP) & HWCAP_PMULL);
+#elif defined(__ARM_NEON)
+  detected = SIMD_NEON;
+#endif
+  level = detected;
+  const char *name = getenv(SIMD_ENV);
+  if (name == NULL)
+    return;
+  int cap = simd_parse(name);
+  if (cap == -1)
+    fprintf(stderr, "%s: %s should be scalar, sse2, sse4, avx2 or neon\n",
+            name, SIMD_ENV);
+  else if (cap < level)
+    level = cap;
+}
+
+/**
+ * @brief the best level of the CPU
+ *
+ * @return SIMD_SCALAR, SIMD_SSE2, SIMD_SSE4, SIMD_AVX2 or SIMD_NEON
+ */
+int simd_detect(void) {
+  pthread_once(&once, detect);
+  return detected;
+}
+
+/**
+ * @brief the level of kernels in use, the best level of the CPU unless it
+ * is lowered
+ *
+ * @return SIMD_SCALAR, SIMD_SSE2, SIMD_SSE4, SIMD_AVX2 or SIMD_NEON
+ */
+int simd_level(void) {
+  pthread_once(&once, detect);
+  return __atomic_load_n(&level, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief use kernels up to a level, but not above the best level of the CPU
+ *
+ * @param new_level SIMD_SCALAR to force scalar kernels
+ * @return the former level
+ */
+int simd_force(int new_level) {
+  pthread_once(&once, detect);
+  if (new_level > detected)
+    new_level = detected;
+  return __atomic_exchange_n(&level, new_level, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief whether the CPU multiplies 64 bit polynomials, by PCLMULQDQ on x86
+ * or PMULL on aarch64. Kernels using it also need SIMD_SSE4 or SIMD_NEON in
+ * use, so it is off with the scalar kernels.
+ *
+ * @return 0 or 1
+ */
+int simd_clmul(void) {
+  pthread_once(&once, detect);
+  return clmul;
+}
+
+/**
+ * @brief parse the name of a level
+ *
+ * @param name scalar, sse2, sse4, avx2 or neon
+ * @return the level or -1
+ */
+int simd_parse(const char *name) {
+  for (int i = 0; i < SIMD_LEVELS; i++)
+    if (strcmp(name, names[i]) == 0)
+      return i;
+  return -1;
+}
+
+const char *simd_name(int simd_level) {
+  return simd_level >= 0 && simd_level < SIMD_LEVELS ? names[simd_level]
+                                                     : "unknown";
+}
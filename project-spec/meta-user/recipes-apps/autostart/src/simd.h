@@ -0,0 +1,32 @@
+#ifndef SIMD_H
+#define SIMD_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+/*
+ * Levels of SIMD kernels. The level in use is detected from the CPU at the
+ * first call, so one binary runs the best kernels on the board and on the
+ * ground. Every module picks its kernel of the highest level up to the level
+ * in use, and all kernels of a function give the same results.
+ *
+ * The level can be lowered for A/B comparisons by the environment variable
+ * DSD_SIMD, e.g. DSD_SIMD=scalar, or by simd_force().
+ */
+#define SIMD_SCALAR 0
+#define SIMD_SSE2 1
+#define SIMD_SSE4 2
+#define SIMD_AVX2 3
+#define SIMD_NEON 4
+#define SIMD_LEVELS 5
+
+#define SIMD_ENV "DSD_SIMD"
+
+int simd_detect(void);
+int simd_level(void);
+int simd_force(int);
+int simd_clmul(void);
+int simd_parse(const char *);
+const char *simd_name(int);
+
+__END_DECLS
+#endif /* simd.h */
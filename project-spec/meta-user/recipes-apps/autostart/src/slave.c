@@ -0,0 +1,268 @@
+/*
+ * Frame handler of the slave: raw images are received from the master,
+ * compressed by a worker thread while the loop goes on, and sent back.
+ */
+#include "slave.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const frame_t default_frame = {
+    .header = TP_HEADER,
+    .address = TP_ADDRESS_SLAVE,
+    .frame_type = TP_FRAME_TYPE_REQUEST_DATA,
+    .n_file = 0,
+    .n_frame = 0,
+};
+
+static void control(compress_opt_t *p_compress_opt, cmd_id_t cmd_id) {
+  cmd_id_t argument = TP_CONTROL_ARGUMENT(cmd_id);
+  switch (TP_CONTROL_COMMAND(cmd_id)) {
+  case TP_CONTROL_ROI:
+    if (p_compress_opt->rect_number == ROI_RECT_MAX) {
+      fprintf(stderr, "slave: too many ROI rectangles\n");
+      break;
+    }
+    roi_rect_t *p_rect = &p_compress_opt->rects[p_compress_opt->rect_number++];
+    p_rect->x = TP_CONTROL_ROI_FIELD(argument, 0) * TP_CONTROL_ROI_UNIT;
+    p_rect->y = TP_CONTROL_ROI_FIELD(argument, 1) * TP_CONTROL_ROI_UNIT;
+    p_rect->width = TP_CONTROL_ROI_FIELD(argument, 2) * TP_CONTROL_ROI_UNIT;
+    p_rect->height = TP_CONTROL_ROI_FIELD(argument, 3) * TP_CONTROL_ROI_UNIT;
+    printf("slave: ROI %ux%u+%u+%u\n", p_rect->width, p_rect->height,
+           p_rect->x, p_rect->y);
+    break;
+  case TP_CONTROL_ROI_CLEAR:
+    p_compress_opt->rect_number = 0;
+    break;
+  case TP_CONTROL_BUDGET:
+    p_compress_opt->budget = argument;
+    printf("slave: budget %zu bytes\n", p_compress_opt->budget);
+    break;
+  }
+}
+
+/* whether a frame belongs to the compressed image of a TP_CONTROL_STOP */
+static int is_stopped(void *arg, const frame_t *p_frame) {
+  return p_frame->frame_type == TP_FRAME_TYPE_TRANSPORT_DATA &&
+         TP_CONTROL_ARGUMENT(p_frame->n_file) == *(cmd_id_t *)arg;
+}
+
+static int send_file(arq_t *p_arq, frame_t *p_frame, const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    perror(filename);
+    return -1;
+  }
+  size_t n;
+  while ((n = fread(p_frame->data, 1, TP_FRAME_DATA_LEN_MAX, file)) > 0) {
+    p_frame->data_len = n;
+    if (arq_send(p_arq, p_frame) == -1) {
+      fclose(file);
+      return -1;
+    }
+  }
+  fclose(file);
+  return 0;
+}
+
+/* preprocess the stripes of a raw image completed by a frame */
+static void receive_raw(slave_t *p_slave, const frame_t *p_frame, int format) {
+  raw_t *p_raw = &p_slave->raw;
+  if (p_slave->raw_n_file == p_frame->n_file && p_slave->raw_failed)
+    return;
+  if (p_raw->image == NULL || p_slave->raw_n_file != p_frame->n_file) {
+    raw_free(p_raw);
+    p_slave->raw_n_file = p_frame->n_file;
+    p_slave->raw_failed =
+        raw_init(p_raw, IMAGE_WIDTH, IMAGE_HEIGHT, format) == -1;
+    if (p_slave->raw_failed)
+      return;
+  }
+  /* the frames after would be taken for the first rows */
+  if (raw_append(p_raw, p_frame->data, p_frame->data_len) == -1) {
+    raw_free(p_raw);
+    p_slave->raw_failed = 1;
+  }
+}
+
+/* compress a raw image out of the loop, and tell the loop */
+static void *work(void *arg) {
+  slave_t *p_slave = arg;
+  compression_t *p_compression = &p_slave->compression;
+  p_compression->status =
+      compress(p_compression->filename, p_compression->compressed_filename,
+               &p_compression->opt);
+  event_notify(&p_slave->notifier);
+  return NULL;
+}
+
+/* start to compress a raw image, the loop goes on meanwhile */
+static void start_compression(slave_t *p_slave, n_file_t n_file) {
+  opt_t *p_opt = p_slave->p_opt;
+  compression_t *p_compression = &p_slave->compression;
+  raw_t *p_raw = &p_slave->raw;
+  p_compression->n_file = n_file;
+  snprintf(p_compression->filename, sizeof(p_compression->filename),
+           "%s/%d.yuv", p_opt->output_dir, n_file);
+  snprintf(p_compression->compressed_filename,
+           sizeof(p_compression->compressed_filename), "%s/%d.bin",
+           p_opt->output_dir, n_file);
+  printf("slave: compress raw image %d\n", n_file);
+  p_compression->opt = p_opt->compress;
+  /* fall back to the file if the raw image is not received completely */
+  if (p_raw->image && p_slave->raw_n_file == n_file && raw_complete(p_raw)) {
+    p_compression->raw = *p_raw;
+    p_compression->opt.p_raw = &p_compression->raw;
+    memset(p_raw, 0, sizeof(*p_raw));
+  } else {
+    memset(&p_compression->raw, 0, sizeof(p_compression->raw));
+    raw_free(p_raw);
+  }
+  p_slave->raw_failed = 0;
+  p_slave->busy = 1;
+  p_slave->threaded = 1;
+  int error = pthread_create(&p_slave->worker, NULL, work, p_slave);
+  if (error) {
+    fprintf(stderr, "slave: worker: %s\n", strerror(error));
+    p_slave->threaded = 0;
+    work(p_slave);
+  }
+}
+
+/*
+ * send a compressed image and request the next raw image, in the loop. If
+ * the image cannot be compressed, the next one is requested all the same, so
+ * the master doesn't wait for it.
+ */
+static void finish_compression(void *arg, uint64_t count) {
+  (void)count;
+  slave_t *p_slave = arg;
+  opt_t *p_opt = p_slave->p_opt;
+  compression_t *p_compression = &p_slave->compression;
+  frame_t *p_output_frame = &p_slave->output_frame;
+  reference_t *p_reference = p_compression->opt.p_reference;
+  if (p_slave->threaded)
+    pthread_join(p_slave->worker, NULL);
+  p_slave->busy = 0;
+  raw_free(&p_compression->raw);
+  if (p_compression->status == -1) {
+    fprintf(stderr, "slave: raw image %d is not compressed\n",
+            p_compression->n_file);
+    /* the master has not the image, the next one must be a key image */
+    if (p_reference)
+      p_reference->count = 0;
+    if (slave_request(p_slave, p_compression->n_file + 1) == -1)
+      perror(p_opt->tty);
+  } else {
+    p_output_frame->frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
+    p_output_frame->n_file = p_compression->n_file;
+    printf("slave: send data: compressed image %d\n", p_compression->n_file);
+    if (send_file(&p_slave->arq, p_output_frame,
+                  p_compression->compressed_filename) == -1 ||
+        slave_request(p_slave, p_compression->n_file + 1) == -1)
+      perror(p_opt->tty);
+  }
+  if (p_slave->pending) {
+    p_slave->pending = 0;
+    start_compression(p_slave, p_slave->pending_n_file);
+  }
+}
+
+/* handle a frame from the master */
+static void handle(void *arg, const frame_t *p_input_frame) {
+  slave_t *p_slave = arg;
+  opt_t *p_opt = p_slave->p_opt;
+  char filename[PATH_MAX];
+  switch (p_input_frame->frame_type) {
+  case TP_FRAME_TYPE_CONTROL:
+    if (TP_CONTROL_COMMAND(p_input_frame->cmd_id) == TP_CONTROL_STOP) {
+      /* the request of the next image is queued after the frames */
+      cmd_id_t n_file = TP_CONTROL_ARGUMENT(p_input_frame->cmd_id);
+      size_t dropped = arq_cancel(&p_slave->arq, is_stopped, &n_file);
+      printf("slave: stop compressed image %u, %zu frames are not sent\n",
+             n_file, dropped);
+      break;
+    }
+    control(&p_opt->compress, p_input_frame->cmd_id);
+    break;
+  case TP_FRAME_TYPE_REQUEST_DATA:
+    if (p_slave->busy) {
+      printf("slave: compress raw image %d later\n", p_input_frame->n_file);
+      p_slave->pending = 1;
+      p_slave->pending_n_file = p_input_frame->n_file;
+      break;
+    }
+    start_compression(p_slave, p_input_frame->n_file);
+    break;
+  case TP_FRAME_TYPE_TRANSPORT_DATA:
+    printf("slave: receive data: raw image %d\n", p_input_frame->n_file);
+    snprintf(filename, sizeof(filename), "%s/%d.yuv", p_opt->output_dir,
+             p_input_frame->n_file);
+    receive_raw(p_slave, p_input_frame, p_opt->compress.format);
+    FILE *file = fopen(filename, "a");
+    if (file == NULL) {
+      perror(filename);
+      break;
+    }
+    if (fwrite(p_input_frame->data, 1, p_input_frame->data_len, file) !=
+        p_input_frame->data_len) {
+      perror(filename);
+      break;
+    }
+    fclose(file);
+  }
+}
+
+/**
+ * @brief serve the master on a descriptor, in the loop of the slave
+ *
+ * @param p_slave
+ * @param p_opt
+ * @param fd tty or socket to the master
+ * @return 0 or -1
+ */
+int slave_init(slave_t *p_slave, opt_t *p_opt, int fd) {
+  memset(p_slave, 0, sizeof(*p_slave));
+  p_slave->p_opt = p_opt;
+  p_slave->output_frame = default_frame;
+  if (event_loop_init(&p_slave->loop) == -1)
+    return -1;
+  if (event_notifier_init(&p_slave->loop, &p_slave->notifier,
+                          finish_compression, p_slave) == -1) {
+    event_loop_close(&p_slave->loop);
+    return -1;
+  }
+  if (arq_init(&p_slave->arq, &p_slave->loop, fd, TP_ADDRESS_SLAVE,
+               p_opt->window, handle, p_slave) == -1) {
+    event_notifier_close(&p_slave->loop, &p_slave->notifier);
+    event_loop_close(&p_slave->loop);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief ask the master for a raw image
+ *
+ * @param p_slave
+ * @param n_file
+ * @return 0 or -1
+ */
+int slave_request(slave_t *p_slave, n_file_t n_file) {
+  frame_t *p_output_frame = &p_slave->output_frame;
+  p_output_frame->frame_type = TP_FRAME_TYPE_REQUEST_DATA;
+  p_output_frame->n_file = n_file;
+  printf("slave: request data: raw image %d\n", n_file);
+  return arq_send(&p_slave->arq, p_output_frame);
+}
+
+/* wait for the worker, and close the loop */
+void slave_close(slave_t *p_slave) {
+  if (p_slave->busy && p_slave->threaded)
+    pthread_join(p_slave->worker, NULL);
+  raw_free(&p_slave->compression.raw);
+  raw_free(&p_slave->raw);
+  arq_close(&p_slave->arq, &p_slave->loop);
+  event_notifier_close(&p_slave->loop, &p_slave->notifier);
+  event_loop_close(&p_slave->loop);
+}
@@ -0,0 +1,62 @@
+#ifndef SLAVE_H
+#define SLAVE_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "arq.h"
+#include "compress.h"
+#include <limits.h>
+#include <pthread.h>
+
+typedef struct {
+  char *tty;
+  char *output_dir;
+  compress_opt_t compress;
+  /* frames on the way, see arq.h */
+  unsigned window;
+} opt_t;
+
+/* a raw image compressed by the worker, which owns it until it is done */
+typedef struct {
+  n_file_t n_file;
+  char filename[PATH_MAX];
+  char compressed_filename[PATH_MAX];
+  /* options when the request came */
+  compress_opt_t opt;
+  raw_t raw;
+  int status;
+} compression_t;
+
+/* state of the frame handler */
+typedef struct {
+  opt_t *p_opt;
+  frame_t output_frame;
+  event_loop_t loop;
+  arq_t arq;
+  /* the worker tells the loop it is done */
+  event_notifier_t notifier;
+  pthread_t worker;
+  int busy;
+  /* 0 if the compression runs in the loop, as there is no thread */
+  int threaded;
+  compression_t compression;
+  /* a request which came while busy */
+  int pending;
+  n_file_t pending_n_file;
+  /* raw image being received, preprocessed while it arrives */
+  raw_t raw;
+  /* number of the raw image */
+  n_file_t raw_n_file;
+  /*
+   * the raw image overflowed or cannot be allocated: the rest of its frames
+   * are ignored and it is compressed from the file
+   */
+  int raw_failed;
+} slave_t;
+
+int slave_init(slave_t *, opt_t *, int);
+int slave_request(slave_t *, n_file_t);
+void slave_close(slave_t *);
+
+__END_DECLS
+#endif /* slave.h */
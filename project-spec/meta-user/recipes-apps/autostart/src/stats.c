@@ -0,0 +1,482 @@
+/*
+ * Statistics kernels of the entropy coder, dispatched by simd_level().
+ *
+ * The encoder on the board and the decoder on the ground must build the same
+ * frequencies from a model, so the CDF does not use erf() of libm, which can
+ * differ between machines. It is computed by IEEE additions,
+ * multiplications and divisions in the same order by every kernel, and this
+ * file is compiled without contraction into fused multiply-adds.
+ */
+#include "stats.h"
+#include "simd.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#define SQRT1_2 0.70710678118654752440
+#define LOG2E 1.44269504088896340736
+/* ln(2) split so that k * LN2_HI is exact */
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+/* adding and subtracting it rounds to an integer */
+#define ROUND_MAGIC 0x1.8p52
+/* adding it puts k + 1023 into the low bits of the mantissa */
+#define EXPONENT_MAGIC (0x1p52 + 1023)
+/* exp() of less is flushed to about 3e-308 */
+#define EXP_MIN -708.0
+#define EXP_TERMS 12
+#define ERFC_TERMS 10
+/*
+ * sub-histograms counted in turn, so that a run of one value doesn't wait for
+ * its own increments
+ */
+#define HISTOGRAM_SPLIT 4
+
+/* 1 / k! */
+static const double exp_coefficients[EXP_TERMS] = {
+    1.0,
+    1.0,
+    1.0 / 2,
+    1.0 / 6,
+    1.0 / 24,
+    1.0 / 120,
+    1.0 / 720,
+    1.0 / 5040,
+    1.0 / 40320,
+    1.0 / 362880,
+    1.0 / 3628800,
+    1.0 / 39916800,
+};
+
+/*
+ * erfc(a) = t exp(-a^2 + P(t)), t = 1 / (1 + a / 2) for a >= 0, with a
+ * relative error less than 1.2e-7. Numerical Recipes in C, 6.2.
+ */
+static const double erfc_coefficients[ERFC_TERMS] = {
+    -1.26551223, 1.00002368,  0.37409196, 0.09678418, -0.18628806,
+    0.27886807,  -1.13520398, 1.48851587, -0.82215223, 0.17087277,
+};
+
+static void bounds_scalar(const int16_t *values, size_t n, int16_t *p_low,
+                          int16_t *p_high) {
+  int16_t low = INT16_MAX, high = INT16_MIN;
+  for (size_t i = 0; i < n; i++) {
+    if (values[i] < low)
+      low = values[i];
+    if (values[i] > high)
+      high = values[i];
+  }
+  *p_low = low;
+  *p_high = high;
+}
+
+static void histogram_scalar(size_t *counts, const int16_t *values, size_t n,
+                             int16_t low) {
+  for (size_t i = 0; i < n; i++)
+    counts[values[i] - low]++;
+}
+
+static double exp_scalar(double y) {
+  y = y > EXP_MIN ? y : EXP_MIN;
+  double k = (y * LOG2E + ROUND_MAGIC) - ROUND_MAGIC;
+  double r = (y - k * LN2_HI) - k * LN2_LO;
+  double p = exp_coefficients[EXP_TERMS - 1];
+  for (int i = EXP_TERMS - 2; i >= 0; i--)
+    p = p * r + exp_coefficients[i];
+  uint64_t bits;
+  double exponent = k + EXPONENT_MAGIC;
+  memcpy(&bits, &exponent, sizeof(bits));
+  bits <<= 52;
+  double scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+/* standard normal CDF */
+static double phi_scalar(double z) {
+  double a = (z < 0 ? -z : z) * SQRT1_2;
+  double t = 1.0 / (1.0 + 0.5 * a);
+  double p = erfc_coefficients[ERFC_TERMS - 1];
+  for (int i = ERFC_TERMS - 2; i >= 0; i--)
+    p = p * t + erfc_coefficients[i];
+  double half = 0.5 * (t * exp_scalar(-a * a + p));
+  return z < 0 ? half : 1.0 - half;
+}
+
+static void gmm_cdf_scalar(double *cdf, const gmm_t *p_gmm, double first,
+                           size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    double x = first + (double)i, sum = 0;
+    for (int k = 0; k < GMM_NUMBER; k++)
+      sum = sum + (double)p_gmm->prob[k] *
+                      phi_scalar((x - (double)p_gmm->mean[k]) /
+                                 (double)p_gmm->std[k]);
+    cdf[i] = sum;
+  }
+}
+
+#if defined(__SSE2__)
+static size_t bounds_sse2(const int16_t *values, size_t n, int16_t *p_low,
+                          int16_t *p_high) {
+  __m128i low = _mm_set1_epi16(INT16_MAX), high = _mm_set1_epi16(INT16_MIN);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(values + i));
+    low = _mm_min_epi16(low, block);
+    high = _mm_max_epi16(high, block);
+  }
+  int16_t lows[8], highs[8];
+  _mm_storeu_si128((__m128i *)lows, low);
+  _mm_storeu_si128((__m128i *)highs, high);
+  for (unsigned j = 0; j < 8; j++) {
+    if (lows[j] < *p_low)
+      *p_low = lows[j];
+    if (highs[j] > *p_high)
+      *p_high = highs[j];
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+bounds_avx2(const int16_t *values, size_t n, int16_t *p_low,
+            int16_t *p_high) {
+  __m256i low = _mm256_set1_epi16(INT16_MAX),
+          high = _mm256_set1_epi16(INT16_MIN);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(values + i));
+    low = _mm256_min_epi16(low, block);
+    high = _mm256_max_epi16(high, block);
+  }
+  int16_t lows[16], highs[16];
+  _mm256_storeu_si256((__m256i *)lows, low);
+  _mm256_storeu_si256((__m256i *)highs, high);
+  for (unsigned j = 0; j < 16; j++) {
+    if (lows[j] < *p_low)
+      *p_low = lows[j];
+    if (highs[j] > *p_high)
+      *p_high = highs[j];
+  }
+  return i;
+}
+
+/* the offsets of values from low are at most 65535, so 16 bits wrap right */
+static size_t histogram_sse2(uint32_t *sub, size_t size, const int16_t *values,
+                             size_t n, int16_t low) {
+  __m128i offset = _mm_set1_epi16(low);
+  uint16_t bins[8];
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i block = _mm_loadu_si128((const __m128i *)(values + i));
+    _mm_storeu_si128((__m128i *)bins, _mm_sub_epi16(block, offset));
+    for (unsigned j = 0; j < 8; j++)
+      sub[j % HISTOGRAM_SPLIT * size + bins[j]]++;
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+histogram_avx2(uint32_t *sub, size_t size, const int16_t *values, size_t n,
+               int16_t low) {
+  __m256i offset = _mm256_set1_epi16(low);
+  uint16_t bins[16];
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i block = _mm256_loadu_si256((const __m256i *)(values + i));
+    _mm256_storeu_si256((__m256i *)bins, _mm256_sub_epi16(block, offset));
+    for (unsigned j = 0; j < 16; j++)
+      sub[j % HISTOGRAM_SPLIT * size + bins[j]]++;
+  }
+  return i;
+}
+
+__attribute__((target("sse4.1"))) static __m128d exp_sse4(__m128d y) {
+  y = _mm_max_pd(y, _mm_set1_pd(EXP_MIN));
+  __m128d k = _mm_sub_pd(
+      _mm_add_pd(_mm_mul_pd(y, _mm_set1_pd(LOG2E)), _mm_set1_pd(ROUND_MAGIC)),
+      _mm_set1_pd(ROUND_MAGIC));
+  __m128d r = _mm_sub_pd(_mm_sub_pd(y, _mm_mul_pd(k, _mm_set1_pd(LN2_HI))),
+                         _mm_mul_pd(k, _mm_set1_pd(LN2_LO)));
+  __m128d p = _mm_set1_pd(exp_coefficients[EXP_TERMS - 1]);
+  for (int i = EXP_TERMS - 2; i >= 0; i--)
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(exp_coefficients[i]));
+  __m128i bits = _mm_slli_epi64(
+      _mm_castpd_si128(_mm_add_pd(k, _mm_set1_pd(EXPONENT_MAGIC))), 52);
+  return _mm_mul_pd(p, _mm_castsi128_pd(bits));
+}
+
+__attribute__((target("sse4.1"))) static __m128d phi_sse4(__m128d z) {
+  __m128d negative = _mm_cmplt_pd(z, _mm_setzero_pd());
+  __m128d a = _mm_mul_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), z),
+                         _mm_set1_pd(SQRT1_2));
+  __m128d t = _mm_div_pd(
+      _mm_set1_pd(1.0),
+      _mm_add_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), a)));
+  __m128d p = _mm_set1_pd(erfc_coefficients[ERFC_TERMS - 1]);
+  for (int i = ERFC_TERMS - 2; i >= 0; i--)
+    p = _mm_add_pd(_mm_mul_pd(p, t), _mm_set1_pd(erfc_coefficients[i]));
+  __m128d half = _mm_mul_pd(
+      _mm_set1_pd(0.5),
+      _mm_mul_pd(t, exp_sse4(_mm_add_pd(
+                        _mm_sub_pd(_mm_setzero_pd(), _mm_mul_pd(a, a)), p))));
+  return _mm_blendv_pd(_mm_sub_pd(_mm_set1_pd(1.0), half), half, negative);
+}
+
+__attribute__((target("sse4.1"))) static size_t
+gmm_cdf_sse4(double *cdf, const gmm_t *p_gmm, double first, size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d x = _mm_add_pd(_mm_set1_pd(first),
+                           _mm_set_pd((double)(i + 1), (double)i));
+    __m128d sum = _mm_setzero_pd();
+    for (int k = 0; k < GMM_NUMBER; k++) {
+      __m128d z =
+          _mm_div_pd(_mm_sub_pd(x, _mm_set1_pd(p_gmm->mean[k])),
+                     _mm_set1_pd(p_gmm->std[k]));
+      sum = _mm_add_pd(sum,
+                       _mm_mul_pd(_mm_set1_pd(p_gmm->prob[k]), phi_sse4(z)));
+    }
+    _mm_storeu_pd(cdf + i, sum);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static __m256d exp_avx2(__m256d y) {
+  y = _mm256_max_pd(y, _mm256_set1_pd(EXP_MIN));
+  __m256d k =
+      _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(y, _mm256_set1_pd(LOG2E)),
+                                  _mm256_set1_pd(ROUND_MAGIC)),
+                    _mm256_set1_pd(ROUND_MAGIC));
+  __m256d r =
+      _mm256_sub_pd(_mm256_sub_pd(y, _mm256_mul_pd(k, _mm256_set1_pd(LN2_HI))),
+                    _mm256_mul_pd(k, _mm256_set1_pd(LN2_LO)));
+  __m256d p = _mm256_set1_pd(exp_coefficients[EXP_TERMS - 1]);
+  for (int i = EXP_TERMS - 2; i >= 0; i--)
+    p = _mm256_add_pd(_mm256_mul_pd(p, r),
+                      _mm256_set1_pd(exp_coefficients[i]));
+  __m256i bits = _mm256_slli_epi64(
+      _mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(EXPONENT_MAGIC))),
+      52);
+  return _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+}
+
+__attribute__((target("avx2"))) static __m256d phi_avx2(__m256d z) {
+  __m256d negative = _mm256_cmp_pd(z, _mm256_setzero_pd(), _CMP_LT_OQ);
+  __m256d a = _mm256_mul_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), z),
+                            _mm256_set1_pd(SQRT1_2));
+  __m256d t = _mm256_div_pd(
+      _mm256_set1_pd(1.0),
+      _mm256_add_pd(_mm256_set1_pd(1.0),
+                    _mm256_mul_pd(_mm256_set1_pd(0.5), a)));
+  __m256d p = _mm256_set1_pd(erfc_coefficients[ERFC_TERMS - 1]);
+  for (int i = ERFC_TERMS - 2; i >= 0; i--)
+    p = _mm256_add_pd(_mm256_mul_pd(p, t),
+                      _mm256_set1_pd(erfc_coefficients[i]));
+  __m256d half = _mm256_mul_pd(
+      _mm256_set1_pd(0.5),
+      _mm256_mul_pd(
+          t, exp_avx2(_mm256_add_pd(
+                 _mm256_sub_pd(_mm256_setzero_pd(), _mm256_mul_pd(a, a)),
+                 p))));
+  return _mm256_blendv_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), half), half,
+                          negative);
+}
+
+__attribute__((target("avx2"))) static size_t
+gmm_cdf_avx2(double *cdf, const gmm_t *p_gmm, double first, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_add_pd(_mm256_set1_pd(first),
+                              _mm256_set_pd((double)(i + 3), (double)(i + 2),
+                                            (double)(i + 1), (double)i));
+    __m256d sum = _mm256_setzero_pd();
+    for (int k = 0; k < GMM_NUMBER; k++) {
+      __m256d z =
+          _mm256_div_pd(_mm256_sub_pd(x, _mm256_set1_pd(p_gmm->mean[k])),
+                        _mm256_set1_pd(p_gmm->std[k]));
+      sum = _mm256_add_pd(
+          sum, _mm256_mul_pd(_mm256_set1_pd(p_gmm->prob[k]), phi_avx2(z)));
+    }
+    _mm256_storeu_pd(cdf + i, sum);
+  }
+  return i;
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static size_t bounds_neon(const int16_t *values, size_t n, int16_t *p_low,
+                          int16_t *p_high) {
+  int16x8_t low = vdupq_n_s16(INT16_MAX), high = vdupq_n_s16(INT16_MIN);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t block = vld1q_s16(values + i);
+    low = vminq_s16(low, block);
+    high = vmaxq_s16(high, block);
+  }
+  if (vminvq_s16(low) < *p_low)
+    *p_low = vminvq_s16(low);
+  if (vmaxvq_s16(high) > *p_high)
+    *p_high = vmaxvq_s16(high);
+  return i;
+}
+
+static size_t histogram_neon(uint32_t *sub, size_t size, const int16_t *values,
+                             size_t n, int16_t low) {
+  int16x8_t offset = vdupq_n_s16(low);
+  uint16_t bins[8];
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t block = vsubq_s16(vld1q_s16(values + i), offset);
+    vst1q_u16(bins, vreinterpretq_u16_s16(block));
+    for (unsigned j = 0; j < 8; j++)
+      sub[j % HISTOGRAM_SPLIT * size + bins[j]]++;
+  }
+  return i;
+}
+
+static float64x2_t exp_neon(float64x2_t y) {
+  y = vmaxq_f64(y, vdupq_n_f64(EXP_MIN));
+  float64x2_t k = vsubq_f64(
+      vaddq_f64(vmulq_f64(y, vdupq_n_f64(LOG2E)), vdupq_n_f64(ROUND_MAGIC)),
+      vdupq_n_f64(ROUND_MAGIC));
+  float64x2_t r = vsubq_f64(vsubq_f64(y, vmulq_f64(k, vdupq_n_f64(LN2_HI))),
+                            vmulq_f64(k, vdupq_n_f64(LN2_LO)));
+  float64x2_t p = vdupq_n_f64(exp_coefficients[EXP_TERMS - 1]);
+  for (int i = EXP_TERMS - 2; i >= 0; i--)
+    p = vaddq_f64(vmulq_f64(p, r), vdupq_n_f64(exp_coefficients[i]));
+  uint64x2_t bits = vshlq_n_u64(
+      vreinterpretq_u64_f64(vaddq_f64(k, vdupq_n_f64(EXPONENT_MAGIC))), 52);
+  return vmulq_f64(p, vreinterpretq_f64_u64(bits));
+}
+
+static float64x2_t phi_neon(float64x2_t z) {
+  uint64x2_t negative = vcltq_f64(z, vdupq_n_f64(0));
+  float64x2_t a = vmulq_f64(vabsq_f64(z), vdupq_n_f64(SQRT1_2));
+  float64x2_t t = vdivq_f64(
+      vdupq_n_f64(1.0),
+      vaddq_f64(vdupq_n_f64(1.0), vmulq_f64(vdupq_n_f64(0.5), a)));
+  float64x2_t p = vdupq_n_f64(erfc_coefficients[ERFC_TERMS - 1]);
+  for (int i = ERFC_TERMS - 2; i >= 0; i--)
+    p = vaddq_f64(vmulq_f64(p, t), vdupq_n_f64(erfc_coefficients[i]));
+  float64x2_t half = vmulq_f64(
+      vdupq_n_f64(0.5),
+      vmulq_f64(t, exp_neon(vaddq_f64(
+                       vsubq_f64(vdupq_n_f64(0), vmulq_f64(a, a)), p))));
+  return vbslq_f64(negative, half, vsubq_f64(vdupq_n_f64(1.0), half));
+}
+
+static size_t gmm_cdf_neon(double *cdf, const gmm_t *p_gmm, double first,
+                           size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const double offsets[2] = {(double)i, (double)(i + 1)};
+    float64x2_t x = vaddq_f64(vdupq_n_f64(first), vld1q_f64(offsets));
+    float64x2_t sum = vdupq_n_f64(0);
+    for (int k = 0; k < GMM_NUMBER; k++) {
+      float64x2_t z = vdivq_f64(vsubq_f64(x, vdupq_n_f64(p_gmm->mean[k])),
+                                vdupq_n_f64(p_gmm->std[k]));
+      sum = vaddq_f64(sum,
+                      vmulq_f64(vdupq_n_f64(p_gmm->prob[k]), phi_neon(z)));
+    }
+    vst1q_f64(cdf + i, sum);
+  }
+  return i;
+}
+#endif
+
+/**
+ * @brief the least and the greatest of values
+ *
+ * @param values
+ * @param n number of values
+ * @param p_low 0 if n is 0
+ * @param p_high 0 if n is 0
+ */
+void stats_bounds(const int16_t *values, size_t n, int16_t *p_low,
+                  int16_t *p_high) {
+  if (n == 0) {
+    *p_low = *p_high = 0;
+    return;
+  }
+  int16_t low = INT16_MAX, high = INT16_MIN;
+  size_t i = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_AVX2)
+    i = bounds_avx2(values, n, &low, &high);
+  else if (level >= SIMD_SSE2)
+    i = bounds_sse2(values, n, &low, &high);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  if (level >= SIMD_NEON)
+    i = bounds_neon(values, n, &low, &high);
+#endif
+  (void)level;
+  int16_t tail_low, tail_high;
+  bounds_scalar(values + i, n - i, &tail_low, &tail_high);
+  *p_low = tail_low < low ? tail_low : low;
+  *p_high = tail_high > high ? tail_high : high;
+}
+
+/**
+ * @brief add values to their counts. The scalar kernel counts in one
+ * histogram; the others count in HISTOGRAM_SPLIT sub-histograms merged
+ * afterwards, if there are enough values to pay for merging them.
+ *
+ * @param counts size counts, of low, low + 1, ..., low + size - 1
+ * @param size
+ * @param values within the counts
+ * @param n number of values
+ * @param low
+ */
+void stats_histogram(size_t *counts, size_t size, const int16_t *values,
+                     size_t n, int16_t low) {
+  size_t i = 0;
+  int level = simd_level();
+  uint32_t *sub = NULL;
+  if (level != SIMD_SCALAR && n >= HISTOGRAM_SPLIT * size && n <= UINT32_MAX)
+    sub = calloc(HISTOGRAM_SPLIT * size, sizeof(*sub));
+#if defined(__SSE2__)
+  if (sub && level >= SIMD_AVX2)
+    i = histogram_avx2(sub, size, values, n, low);
+  else if (sub && level >= SIMD_SSE2)
+    i = histogram_sse2(sub, size, values, n, low);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  if (sub && level >= SIMD_NEON)
+    i = histogram_neon(sub, size, values, n, low);
+#endif
+  if (sub) {
+    for (size_t j = 0; j < size; j++)
+      for (unsigned k = 0; k < HISTOGRAM_SPLIT; k++)
+        counts[j] += sub[k * size + j];
+    free(sub);
+  }
+  histogram_scalar(counts, values + i, n - i, low);
+}
+
+/**
+ * @brief CDF of a Gaussian mixture model at first, first + 1, ..., first +
+ * n - 1. All kernels give the same bits.
+ *
+ * @param cdf n values
+ * @param p_gmm
+ * @param first
+ * @param n
+ */
+void stats_gmm_cdf(double *cdf, const gmm_t *p_gmm, double first, size_t n) {
+  size_t i = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_AVX2)
+    i = gmm_cdf_avx2(cdf, p_gmm, first, n);
+  else if (level >= SIMD_SSE4)
+    i = gmm_cdf_sse4(cdf, p_gmm, first, n);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  if (level >= SIMD_NEON)
+    i = gmm_cdf_neon(cdf, p_gmm, first, n);
+#endif
+  (void)level;
+  gmm_cdf_scalar(cdf + i, p_gmm, first + (double)i, n - i);
+}
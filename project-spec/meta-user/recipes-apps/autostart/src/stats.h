@@ -0,0 +1,15 @@
+#ifndef STATS_H
+#define STATS_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "coding.h"
+#include <stddef.h>
+#include <stdint.h>
+
+void stats_bounds(const int16_t *, size_t, int16_t *, int16_t *);
+void stats_histogram(size_t *, size_t, const int16_t *, size_t, int16_t);
+void stats_gmm_cdf(double *, const gmm_t *, double, size_t);
+
+__END_DECLS
+#endif /* stats.h */
@@ -0,0 +1,102 @@
+#ifndef SUBBAND_H
+#define SUBBAND_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include "image.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Descriptors of the subbands of a transformed channel, so the layout of
+ * coefficients is known in one place.
+ *
+ * The accelerator puts the 13 subbands one after another in the order of
+ * docs/resources/format.md, every subband in raster order. The decoder puts
+ * all subbands into one picture of the channel, see subband_position().
+ */
+#define SUBBAND_PACKED 0
+#define SUBBAND_PICTURE 1
+
+/* orientations */
+#define SUBBAND_LL 0
+#define SUBBAND_HL 1
+#define SUBBAND_LH 2
+#define SUBBAND_HH 3
+
+typedef struct {
+  /* index of the first coefficient in the channel */
+  size_t offset;
+  unsigned width;
+  unsigned height;
+  /* coefficients from a row to the next */
+  size_t stride;
+  unsigned level;
+  unsigned orientation;
+} subband_t;
+
+/* a subband in place in the coefficients of a channel */
+typedef struct {
+  int16_t *data;
+  unsigned width;
+  unsigned height;
+  size_t stride;
+} subband_view_t;
+
+static inline unsigned subband_orientation(unsigned subband) {
+  return subband == 0 ? SUBBAND_LL : 1 + (subband - 1) % 3;
+}
+
+/*
+ * descriptors of the SUBBAND_NUMBER subbands of a width x height channel in
+ * a layout, SUBBAND_PACKED or SUBBAND_PICTURE
+ */
+static inline void subband_table(subband_t *table, unsigned width,
+                                 unsigned height, int layout) {
+  size_t offset = 0;
+  for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+    subband_t *p_subband = &table[subband];
+    subband_shape(width, height, subband, &p_subband->width,
+                  &p_subband->height);
+    p_subband->level = subband_level(subband);
+    p_subband->orientation = subband_orientation(subband);
+    if (layout == SUBBAND_PACKED) {
+      p_subband->offset = offset;
+      p_subband->stride = p_subband->width;
+      offset += (size_t)p_subband->width * p_subband->height;
+    } else {
+      unsigned x, y;
+      subband_position(width, height, subband, &x, &y);
+      p_subband->offset = (size_t)y * width + x;
+      p_subband->stride = width;
+    }
+  }
+}
+
+/* number of coefficients of a subband */
+static inline size_t subband_size(const subband_t *p_subband) {
+  return (size_t)p_subband->width * p_subband->height;
+}
+
+static inline subband_view_t subband_view(int16_t *coefficients,
+                                          const subband_t *p_subband) {
+  subband_view_t view = {
+      .data = coefficients + p_subband->offset,
+      .width = p_subband->width,
+      .height = p_subband->height,
+      .stride = p_subband->stride,
+  };
+  return view;
+}
+
+static inline int16_t *subband_row(const subband_view_t *p_view, unsigned y) {
+  return p_view->data + (size_t)y * p_view->stride;
+}
+
+/* rows are contiguous, so the subband can be used as an array */
+static inline int subband_contiguous(const subband_view_t *p_view) {
+  return p_view->stride == p_view->width || p_view->height <= 1;
+}
+
+__END_DECLS
+#endif /* subband.h */
@@ -1,169 +1,453 @@
+/*
+ * Frames of docs/resources/serial-transmission-protocol.md, encoded and
+ * decoded in place. Fields are big endian, and the CRC is computed while the
+ * fields are written or read.
+ */
 #include "transmission_protocol.h"
 #include "crc.h"
+#include "simd.h"
+#include <endian.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
-static size_t frame_without_check_sum2bit_stream(frame_t frame,
-                                                 uint8_t *bit_stream) {
-  size_t size;
-  switch (frame.frame_type) {
+static const uint8_t zeros[TP_FRAME_DATA_LEN_MAX];
+
+static uint8_t *put(uint8_t *p, uint16_t *p_crc, const void *field,
+                    size_t size) {
+  memcpy(p, field, size);
+  *p_crc = crc16_update(*p_crc, p, size);
+  return p + size;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t *p_crc, uint16_t value) {
+  value = htobe16(value);
+  return put(p, p_crc, &value, sizeof(value));
+}
+
+static uint8_t *put32(uint8_t *p, uint16_t *p_crc, uint32_t value) {
+  value = htobe32(value);
+  return put(p, p_crc, &value, sizeof(value));
+}
+
+static const uint8_t *get(const uint8_t *p, uint16_t *p_crc, void *field,
+                          size_t size) {
+  memcpy(field, p, size);
+  *p_crc = crc16_update(*p_crc, p, size);
+  return p + size;
+}
+
+static const uint8_t *get16(const uint8_t *p, uint16_t *p_crc,
+                            uint16_t *p_value) {
+  p = get(p, p_crc, p_value, sizeof(*p_value));
+  *p_value = be16toh(*p_value);
+  return p;
+}
+
+static const uint8_t *get32(const uint8_t *p, uint16_t *p_crc,
+                            uint32_t *p_value) {
+  p = get(p, p_crc, p_value, sizeof(*p_value));
+  *p_value = be32toh(*p_value);
+  return p;
+}
+
+/**
+ * @brief size of a frame
+ *
+ * @param frame_type
+ * @return bytes, or 0 for an unknown frame type
+ */
+size_t tp_frame_size(frame_type_t frame_type) {
+  switch (frame_type) {
   case TP_FRAME_TYPE_CONTROL:
-    size = TP_FRAME_SIZE_CONTROL;
+    return TP_FRAME_SIZE_CONTROL;
   case TP_FRAME_TYPE_REQUEST_DATA:
-    size = TP_FRAME_SIZE_REQUEST_DATA;
-  case TP_FRAME_TYPE_TRANSPORT_DATA:
-    size = TP_FRAME_SIZE_TRANSPORT_DATA;
-  }
-  uint8_t *p_bit_stream = bit_stream;
-  memcpy(p_bit_stream, frame.header, sizeof(frame.header));
-  p_bit_stream += sizeof(frame.header);
-  memcpy(p_bit_stream, &frame.address, sizeof(frame.address));
-  p_bit_stream += sizeof(frame.address);
-  memcpy(p_bit_stream, &frame.frame_type, sizeof(frame.frame_type));
-  p_bit_stream += sizeof(frame.frame_type);
-  switch (frame.frame_type) {
-  case TP_FRAME_TYPE_CONTROL:
-    memcpy(p_bit_stream, &frame.cmd_id, sizeof(frame.cmd_id));
-    p_bit_stream += sizeof(frame.cmd_id);
-    break;
-  default:
-    memcpy(p_bit_stream, &frame.n_file, sizeof(frame.n_file));
-    p_bit_stream += sizeof(frame.n_file);
-  }
-  memcpy(p_bit_stream, &frame.n_frame, sizeof(frame.n_frame));
-  p_bit_stream += sizeof(frame.n_frame);
-  switch (frame.frame_type) {
+    return TP_FRAME_SIZE_REQUEST_DATA;
   case TP_FRAME_TYPE_TRANSPORT_DATA:
-    memcpy(p_bit_stream, &frame.data_len, sizeof(frame.data_len));
-    p_bit_stream += sizeof(frame.data_len);
-    memcpy(p_bit_stream, &frame.data, frame.data_len);
-    p_bit_stream += TP_FRAME_DATA_LEN_MAX;
+    return TP_FRAME_SIZE_TRANSPORT_DATA;
   }
-  return p_bit_stream - bit_stream;
+  return 0;
 }
 
-size_t frame2bit_stream(frame_t frame, uint8_t *bit_stream) {
-  size_t size = frame_without_check_sum2bit_stream(frame, bit_stream);
-  uint16_t check_sum = crc16(bit_stream, size);
-  uint8_t *p_bit_stream = bit_stream;
-  p_bit_stream += size;
-  memcpy(p_bit_stream, &check_sum, sizeof(check_sum));
-  size += sizeof(check_sum);
+/**
+ * @brief encode a frame and its CRC in one pass. Data of a transport frame
+ * after data_len bytes is 0.
+ *
+ * @param p_frame
+ * @param bit_stream tp_frame_size() bytes
+ * @return bytes, or 0 for an unknown frame type
+ */
+size_t frame2bit_stream(const frame_t *p_frame, uint8_t *bit_stream) {
+  size_t size = tp_frame_size(p_frame->frame_type);
+  if (size == 0 || (p_frame->frame_type == TP_FRAME_TYPE_TRANSPORT_DATA &&
+                    p_frame->data_len > TP_FRAME_DATA_LEN_MAX))
+    return 0;
+  uint16_t crc = crc16_init();
+  uint8_t *p = put(bit_stream, &crc, p_frame->header, sizeof(tp_header));
+  p = put16(p, &crc, p_frame->address);
+  p = put16(p, &crc, p_frame->frame_type);
+  /* or cmd_id */
+  p = put32(p, &crc, p_frame->n_file);
+  p = put16(p, &crc, p_frame->n_frame);
+  if (p_frame->frame_type == TP_FRAME_TYPE_TRANSPORT_DATA) {
+    p = put16(p, &crc, p_frame->data_len);
+    p = put(p, &crc, p_frame->data, p_frame->data_len);
+    p = put(p, &crc, zeros, TP_FRAME_DATA_LEN_MAX - p_frame->data_len);
+  }
+  put16(p, &crc, crc16_final(crc));
   return size;
 }
 
-frame_t *bit_stream2frame(uint8_t *bit_stream) {
-  frame_t *p_frame = (frame_t *)malloc(sizeof(frame_t));
-  uint8_t *p_bit_stream = bit_stream;
-  memcpy(p_frame->header, p_bit_stream, sizeof(tp_header));
-  if (memcmp(p_frame->header, tp_header, sizeof(tp_header)) != 0) {
-    printf("wrong header: %s is not %s!\n", p_frame->header, tp_header);
-    return NULL;
-  }
-  p_bit_stream += sizeof(tp_header);
-  memcpy(&p_frame->address, p_bit_stream, sizeof(p_frame->address));
-  p_bit_stream += sizeof(p_frame->address);
-  memcpy(&p_frame->frame_type, p_bit_stream, sizeof(p_frame->frame_type));
-  p_bit_stream += sizeof(p_frame->frame_type);
-  switch (p_frame->frame_type) {
-  case TP_FRAME_TYPE_CONTROL:
-    memcpy(&p_frame->cmd_id, p_bit_stream, sizeof(p_frame->cmd_id));
-    p_bit_stream += sizeof(p_frame->cmd_id);
-    break;
-  case TP_FRAME_TYPE_TRANSPORT_DATA:
-    memcpy(&p_frame->data_len, p_bit_stream, sizeof(p_frame->data_len));
-    p_bit_stream += sizeof(p_frame->data_len);
-    memcpy(p_frame->data, p_bit_stream, p_frame->data_len);
-    p_bit_stream += TP_FRAME_DATA_LEN_MAX;
-  case TP_FRAME_TYPE_REQUEST_DATA:
-    memcpy(&p_frame->n_file, p_bit_stream, sizeof(p_frame->n_file));
-    p_bit_stream += sizeof(p_frame->n_file);
-    break;
-  default:
-    printf("unimplemented frame type: %d!\n", p_frame->frame_type);
-    return NULL;
-  }
-  memcpy(&p_frame->n_frame, p_bit_stream, sizeof(p_frame->n_frame));
-  p_bit_stream += sizeof(p_frame->n_frame);
-  memcpy(&p_frame->check_sum, p_bit_stream, sizeof(p_frame->check_sum));
-  uint8_t *temp = malloc(p_bit_stream - bit_stream);
-  if (temp == NULL) {
-    perror("temp");
-    return NULL;
-  }
-  size_t size = frame_without_check_sum2bit_stream(*p_frame, temp);
-  uint16_t check_sum = crc16(temp, size);
+/**
+ * @brief decode a frame and check its CRC in one pass
+ *
+ * @param p_frame
+ * @param bit_stream a whole frame
+ * @return 0, or -1 for a wrong header, frame type, data length or CRC
+ */
+int bit_stream2frame(frame_t *p_frame, const uint8_t *bit_stream) {
+  if (memcmp(bit_stream, tp_header, sizeof(tp_header)) != 0) {
+    fprintf(stderr, "transmission_protocol: wrong header\n");
+    return -1;
+  }
+  uint16_t crc = crc16_init();
+  const uint8_t *p = get(bit_stream, &crc, p_frame->header, sizeof(tp_header));
+  p = get16(p, &crc, &p_frame->address);
+  p = get16(p, &crc, &p_frame->frame_type);
+  if (tp_frame_size(p_frame->frame_type) == 0) {
+    fprintf(stderr, "transmission_protocol: unknown frame type %u\n",
+            p_frame->frame_type);
+    return -1;
+  }
+  p = get32(p, &crc, &p_frame->n_file);
+  p = get16(p, &crc, &p_frame->n_frame);
+  p_frame->data_len = 0;
+  if (p_frame->frame_type == TP_FRAME_TYPE_TRANSPORT_DATA) {
+    p = get16(p, &crc, &p_frame->data_len);
+    p = get(p, &crc, p_frame->data, TP_FRAME_DATA_LEN_MAX);
+    if (p_frame->data_len > TP_FRAME_DATA_LEN_MAX) {
+      fprintf(stderr, "transmission_protocol: %u bytes of data\n",
+              p_frame->data_len);
+      return -1;
+    }
+  }
+  uint16_t check_sum = crc16_final(crc);
+  get16(p, &crc, &p_frame->check_sum);
   if (p_frame->check_sum != check_sum) {
-    printf("incorrect check sum: %d is not %d!\n", p_frame->check_sum,
-           check_sum);
-    return NULL;
+    fprintf(stderr, "transmission_protocol: CRC %04X is not %04X\n",
+            p_frame->check_sum, check_sum);
+    return -1;
   }
-  return p_frame;
+  return 0;
 }
 
-ssize_t send_frame(int fd, frame_t *p_frame) {
-  size_t size;
-  switch (p_frame->frame_type) {
-  case TP_FRAME_TYPE_REQUEST_DATA:
-    size = TP_FRAME_SIZE_REQUEST_DATA;
-    break;
-  case TP_FRAME_TYPE_TRANSPORT_DATA:
-    size = TP_FRAME_SIZE_TRANSPORT_DATA;
-    break;
-  case TP_FRAME_TYPE_CONTROL:
-    size = TP_FRAME_SIZE_CONTROL;
-    break;
+/* first position in [first, size) where the bytes up to size match tp_header */
+static size_t find_header_scalar(const uint8_t *p, size_t first, size_t size) {
+  for (size_t i = first; i < size; i++) {
+    size_t n = size - i < sizeof(tp_header) ? size - i : sizeof(tp_header);
+    if (memcmp(p + i, tp_header, n) == 0)
+      return i;
+  }
+  return size;
+}
+
+#if defined(__SSE2__)
+/* 16 positions at a time, and return the first match or the next position */
+static size_t find_header_sse2(const uint8_t *p, size_t size) {
+  __m128i h0 = _mm_set1_epi8(tp_header[0]), h1 = _mm_set1_epi8(tp_header[1]);
+  __m128i h2 = _mm_set1_epi8(tp_header[2]), h3 = _mm_set1_epi8(tp_header[3]);
+  size_t i = 0;
+  for (; i + 16 + sizeof(tp_header) - 1 <= size; i += 16) {
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(p + i + 1));
+    __m128i b2 = _mm_loadu_si128((const __m128i *)(p + i + 2));
+    __m128i b3 = _mm_loadu_si128((const __m128i *)(p + i + 3));
+    __m128i match = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(b0, h0), _mm_cmpeq_epi8(b1, h1)),
+        _mm_and_si128(_mm_cmpeq_epi8(b2, h2), _mm_cmpeq_epi8(b3, h3)));
+    unsigned mask = _mm_movemask_epi8(match);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+find_header_avx2(const uint8_t *p, size_t size) {
+  __m256i h0 = _mm256_set1_epi8(tp_header[0]);
+  __m256i h1 = _mm256_set1_epi8(tp_header[1]);
+  __m256i h2 = _mm256_set1_epi8(tp_header[2]);
+  __m256i h3 = _mm256_set1_epi8(tp_header[3]);
+  size_t i = 0;
+  for (; i + 32 + sizeof(tp_header) - 1 <= size; i += 32) {
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+    __m256i b2 = _mm256_loadu_si256((const __m256i *)(p + i + 2));
+    __m256i b3 = _mm256_loadu_si256((const __m256i *)(p + i + 3));
+    __m256i match = _mm256_and_si256(
+        _mm256_and_si256(_mm256_cmpeq_epi8(b0, h0), _mm256_cmpeq_epi8(b1, h1)),
+        _mm256_and_si256(_mm256_cmpeq_epi8(b2, h2),
+                         _mm256_cmpeq_epi8(b3, h3)));
+    unsigned mask = _mm256_movemask_epi8(match);
+    if (mask)
+      return i + __builtin_ctz(mask);
   }
-  uint8_t *bit_stream = malloc(size);
-  if (frame2bit_stream(*p_frame, bit_stream) != size) {
+  return i;
+}
+#elif defined(__ARM_NEON)
+static size_t find_header_neon(const uint8_t *p, size_t size) {
+  uint8x16_t h0 = vdupq_n_u8(tp_header[0]), h1 = vdupq_n_u8(tp_header[1]);
+  uint8x16_t h2 = vdupq_n_u8(tp_header[2]), h3 = vdupq_n_u8(tp_header[3]);
+  size_t i = 0;
+  for (; i + 16 + sizeof(tp_header) - 1 <= size; i += 16) {
+    uint8x16_t match =
+        vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(p + i), h0),
+                          vceqq_u8(vld1q_u8(p + i + 1), h1)),
+                 vandq_u8(vceqq_u8(vld1q_u8(p + i + 2), h2),
+                          vceqq_u8(vld1q_u8(p + i + 3), h3)));
+    uint64x2_t lanes = vreinterpretq_u64_u8(match);
+    /* a match is rare, find it by the scalar search */
+    if (vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1))
+      return find_header_scalar(p, i, i + 16);
+  }
+  return i;
+}
+#endif
+
+/*
+ * first position where a header starts, or where a part of a header ends the
+ * bytes, or size
+ */
+static size_t find_header(const uint8_t *p, size_t size) {
+  size_t i = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_AVX2)
+    i = find_header_avx2(p, size);
+  else if (level >= SIMD_SSE2)
+    i = find_header_sse2(p, size);
+#elif defined(__ARM_NEON)
+  if (level >= SIMD_NEON)
+    i = find_header_neon(p, size);
+#else
+  (void)level;
+#endif
+  return find_header_scalar(p, i, size);
+}
+
+/**
+ * @brief start a parser
+ *
+ * @param p_parser
+ * @param callback called with every frame, the frame is valid during the call
+ * @param arg first argument of callback
+ */
+void tp_parser_init(tp_parser_t *p_parser, tp_callback_t callback,
+                    void *arg) {
+  memset(p_parser, 0, sizeof(*p_parser));
+  p_parser->callback = callback;
+  p_parser->arg = arg;
+}
+
+/* report the frames of the buffer and keep the bytes of a frame to come */
+static void parse(tp_parser_t *p_parser) {
+  uint8_t *buffer = p_parser->buffer;
+  size_t first = 0;
+  frame_t frame;
+  for (;;) {
+    size_t i = find_header(buffer + first, p_parser->size - first);
+    p_parser->skipped += i;
+    first += i;
+    size_t rest = p_parser->size - first;
+    if (rest < TP_FRAME_SIZE_CMD_TYPE)
+      break;
+    const uint8_t *type = buffer + first + TP_FRAME_SIZE_CMD_TYPE - 2;
+    size_t size = tp_frame_size(type[0] << 8 | type[1]);
+    if (size != 0 && rest < size)
+      break;
+    if (size != 0 && bit_stream2frame(&frame, buffer + first) == 0) {
+      p_parser->frame_number++;
+      p_parser->callback(p_parser->arg, &frame);
+      first += size;
+      continue;
+    }
+    /* a header in garbage or a broken frame, the next one may start inside */
+    p_parser->broken++;
+    p_parser->skipped++;
+    first++;
+  }
+  memmove(buffer, buffer + first, p_parser->size - first);
+  p_parser->size -= first;
+}
+
+/**
+ * @brief parse bytes of a stream, and call the callback with the frames
+ * completed by them
+ *
+ * @param p_parser
+ * @param bytes
+ * @param size any bytes
+ */
+void tp_parser_feed(tp_parser_t *p_parser, const uint8_t *bytes,
+                    size_t size) {
+  while (size > 0) {
+    /* a frame to come is shorter than a frame, the rest has room for one */
+    size_t n = sizeof(p_parser->buffer) - p_parser->size;
+    if (n > size)
+      n = size;
+    memcpy(p_parser->buffer + p_parser->size, bytes, n);
+    p_parser->size += n;
+    bytes += n;
+    size -= n;
+    parse(p_parser);
+  }
+}
+
+/**
+ * @brief start an empty output ring
+ *
+ * @param p_output
+ * @param fd non-blocking
+ * @return 0, or -1 for an error
+ */
+int tp_output_init(tp_output_t *p_output, int fd) {
+  memset(p_output, 0, sizeof(*p_output));
+  p_output->fd = fd;
+  p_output->buffer = malloc(TP_OUTPUT_CAPACITY);
+  if (p_output->buffer == NULL) {
+    perror("transmission_protocol");
     return -1;
   }
-  return write(fd, bit_stream, size);
+  p_output->capacity = TP_OUTPUT_CAPACITY;
+  return 0;
 }
 
-ssize_t receive_frame(int fd, frame_t *p_frame) {
-  uint8_t temp[TP_FRAME_SIZE_CMD_TYPE];
-  ssize_t n = read(fd, temp, TP_FRAME_SIZE_CMD_TYPE);
-  if (n < TP_FRAME_SIZE_CMD_TYPE)
+/* make room for size more bytes, with the bytes from the start */
+static int reserve(tp_output_t *p_output, size_t size) {
+  if (p_output->size + size <= p_output->capacity)
+    return 0;
+  size_t capacity = p_output->capacity;
+  while (p_output->size + size > capacity)
+    capacity *= 2;
+  uint8_t *buffer = malloc(capacity);
+  if (buffer == NULL) {
+    perror("transmission_protocol");
     return -1;
-  frame_type_t frame_type;
-  memcpy(&frame_type, temp + sizeof(temp) - sizeof(frame_type),
-         sizeof(frame_type));
-  size_t size;
-  switch (frame_type) {
-  case TP_FRAME_TYPE_CONTROL:
-    size = TP_FRAME_SIZE_CONTROL;
-  case TP_FRAME_TYPE_REQUEST_DATA:
-    size = TP_FRAME_SIZE_REQUEST_DATA;
-  case TP_FRAME_TYPE_TRANSPORT_DATA:
-    size = TP_FRAME_SIZE_TRANSPORT_DATA;
-  }
-  uint8_t *buffer = malloc(size);
-  uint8_t *p_buffer = buffer;
-  memcpy(buffer, temp, sizeof(temp));
-  p_buffer += sizeof(temp);
-  n += read(fd, p_buffer, size - TP_FRAME_SIZE_CMD_TYPE);
-  if (n < TP_FRAME_SIZE_CMD_TYPE)
+  }
+  size_t part = p_output->capacity - p_output->first;
+  if (part > p_output->size)
+    part = p_output->size;
+  memcpy(buffer, p_output->buffer + p_output->first, part);
+  memcpy(buffer + part, p_output->buffer, p_output->size - part);
+  free(p_output->buffer);
+  p_output->buffer = buffer;
+  p_output->capacity = capacity;
+  p_output->first = 0;
+  return 0;
+}
+
+/**
+ * @brief queue a frame, without a system call
+ *
+ * @param p_output
+ * @param p_frame
+ * @return 0, or -1 for an unknown frame type or no memory
+ */
+int tp_output_frame(tp_output_t *p_output, const frame_t *p_frame) {
+  uint8_t bit_stream[TP_FRAME_SIZE_MAX];
+  size_t size = frame2bit_stream(p_frame, bit_stream);
+  if (size == 0 || reserve(p_output, size) == -1)
     return -1;
-  memcpy(p_frame, bit_stream2frame(buffer), sizeof(*p_frame));
-  if (p_frame == NULL)
-    return 0;
-  return n;
+  size_t last = (p_output->first + p_output->size) % p_output->capacity;
+  size_t part = p_output->capacity - last;
+  if (part > size)
+    part = size;
+  memcpy(p_output->buffer + last, bit_stream, part);
+  memcpy(p_output->buffer, bit_stream + part, size - part);
+  p_output->size += size;
+  return 0;
 }
 
-void wait_frame(int fd, frame_t *p_input_frame, frame_t *p_output_frame) {
-  ssize_t n = 0;
-  p_output_frame->frame_type = TP_FRAME_TYPE_CONTROL;
-  p_output_frame->cmd_id = TP_CONTROL_RESEND;
-  do {
-    n = receive_frame(fd, p_input_frame);
-    switch (n) {
-    case -1:
+/**
+ * @brief write queued bytes until the descriptor takes no more
+ *
+ * @param p_output
+ * @return bytes left in the ring, or -1 for an error
+ */
+ssize_t tp_output_flush(tp_output_t *p_output) {
+  while (p_output->size) {
+    struct iovec iov[2];
+    size_t part = p_output->capacity - p_output->first;
+    if (part > p_output->size)
+      part = p_output->size;
+    iov[0] = (struct iovec){p_output->buffer + p_output->first, part};
+    iov[1] = (struct iovec){p_output->buffer, p_output->size - part};
+    ssize_t n = writev(p_output->fd, iov, part < p_output->size ? 2 : 1);
+    p_output->writes++;
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n == -1 && errno == EAGAIN)
       break;
-    case 0:
-      send_frame(fd, p_input_frame);
-      p_output_frame->n_frame++;
+    if (n == -1)
+      return -1;
+    p_output->first = (p_output->first + n) % p_output->capacity;
+    p_output->size -= n;
+  }
+  /* the next frames go in one piece */
+  if (p_output->size == 0)
+    p_output->first = 0;
+  return p_output->size;
+}
+
+void tp_output_free(tp_output_t *p_output) {
+  free(p_output->buffer);
+  p_output->buffer = NULL;
+}
+
+/*
+ * write a whole frame, and wait until a non-blocking descriptor takes more
+ * bytes
+ */
+ssize_t send_frame(int fd, frame_t *p_frame) {
+  uint8_t bit_stream[TP_FRAME_SIZE_MAX];
+  size_t size = frame2bit_stream(p_frame, bit_stream);
+  if (size == 0)
+    return -1;
+  size_t n = 0;
+  while (n < size) {
+    ssize_t m = write(fd, bit_stream + n, size - n);
+    if (m > 0) {
+      n += m;
+    } else if (m == -1 && errno == EAGAIN) {
+      struct pollfd pollfd = {.fd = fd, .events = POLLOUT};
+      poll(&pollfd, 1, -1);
+    } else if (m == -1 && errno != EINTR) {
+      return -1;
     }
-  } while (n <= 0);
+  }
+  return n;
+}
+
+/**
+ * @brief read the bytes at hand and feed them to a parser
+ *
+ * @param fd non-blocking
+ * @param p_parser
+ * @return bytes, 0 for none, or -1 for an error
+ */
+ssize_t receive_frames(int fd, tp_parser_t *p_parser) {
+  uint8_t buffer[TP_READ_SIZE];
+  ssize_t n = read(fd, buffer, sizeof(buffer));
+  if (n == -1)
+    return errno == EAGAIN || errno == EINTR ? 0 : -1;
+  tp_parser_feed(p_parser, buffer, n);
+  return n;
 }
@@ -20,8 +20,39 @@ __BEGIN_DECLS
 #define TP_FRAME_SIZE_CMD_TYPE 8
 
 #define TP_FRAME_DATA_LEN_MAX 512
+/* bytes read at a time */
+#define TP_READ_SIZE 4096
+/* initial bytes of an output ring, it grows when full */
+#define TP_OUTPUT_CAPACITY (64 * TP_FRAME_SIZE_MAX)
+
+/* command ID of control frames: command in the high byte, argument below */
+#define TP_CONTROL_CMD_ID(command, argument)                                   \
+  ((cmd_id_t)(command) << 24 | ((argument) & 0xFFFFFF))
+#define TP_CONTROL_COMMAND(cmd_id) ((cmd_id) >> 24)
+#define TP_CONTROL_ARGUMENT(cmd_id) ((cmd_id) & 0xFFFFFF)
 
 #define TP_CONTROL_RESEND 0
+/* add a ROI rectangle: x, y, width, height in units, 6 bits each */
+#define TP_CONTROL_ROI 1
+#define TP_CONTROL_ROI_CLEAR 2
+#define TP_CONTROL_ROI_UNIT 64
+#define TP_CONTROL_ROI_ARGUMENT(x, y, width, height)                           \
+  ((x) << 18 | (y) << 12 | (width) << 6 | (height))
+#define TP_CONTROL_ROI_FIELD(argument, i) ((argument) >> (18 - 6 * (i)) & 0x3F)
+/* bytes per compressed image, 0 for no budget */
+#define TP_CONTROL_BUDGET 3
+#define TP_CONTROL_BUDGET_MAX 0xFFFFFF
+/* acknowledge frames: received frames after n_frame, 1 bit each, see arq.h */
+#define TP_CONTROL_ACK 4
+#define TP_CONTROL_ACK_BITS 24
+/* start a session from n_frame, the argument has its ID, see arq.h */
+#define TP_CONTROL_SYNC 5
+/* the sender doesn't know the session of the receiver, which answers */
+#define TP_CONTROL_SYNC_ASK (1 << 23)
+#define TP_CONTROL_SYNC_SESSION(argument)                                      \
+  ((argument) & (TP_CONTROL_SYNC_ASK - 1))
+/* stop sending a compressed image, the argument has the low bits of n_file */
+#define TP_CONTROL_STOP 6
 
 #include <stdint.h>
 #include <stdlib.h>
@@ -45,15 +76,58 @@ typedef struct {
   };
   n_frame_t n_frame;
   data_len_t data_len;
-  uint8_t data[512];
+  uint8_t data[TP_FRAME_DATA_LEN_MAX];
   uint16_t check_sum;
 } frame_t;
 
-frame_t *bit_stream2frame(uint8_t *);
-size_t frame2bit_stream(frame_t, uint8_t *);
+/* called with every frame found by a parser */
+typedef void (*tp_callback_t)(void *, const frame_t *);
+
+/*
+ * A parser of a byte stream, fed with chunks of any size: frames may be split
+ * across chunks, and a chunk may hold several frames. Bytes before a header
+ * are skipped, and a frame of a wrong type or CRC is skipped from its second
+ * byte, so the parser finds the next frame in any garbage.
+ */
+typedef struct {
+  /* bytes from a header on, twice a frame so a frame always fits */
+  uint8_t buffer[2 * TP_FRAME_SIZE_MAX];
+  size_t size;
+  tp_callback_t callback;
+  void *arg;
+  /* found frames, skipped bytes and skipped frames */
+  unsigned long frame_number;
+  unsigned long skipped;
+  unsigned long broken;
+} tp_parser_t;
+
+/*
+ * Frames waiting for a non-blocking descriptor, encoded to a ring of bytes.
+ * A flush writes as many as the descriptor takes by one writev() of the ring,
+ * so frames queued together go by one system call.
+ */
+typedef struct {
+  int fd;
+  uint8_t *buffer;
+  size_t capacity;
+  /* bytes [first, first + size) modulo capacity */
+  size_t first;
+  size_t size;
+  /* writev() calls */
+  unsigned long writes;
+} tp_output_t;
+
+size_t tp_frame_size(frame_type_t);
+int bit_stream2frame(frame_t *, const uint8_t *);
+size_t frame2bit_stream(const frame_t *, uint8_t *);
+void tp_parser_init(tp_parser_t *, tp_callback_t, void *);
+void tp_parser_feed(tp_parser_t *, const uint8_t *, size_t);
+int tp_output_init(tp_output_t *, int);
+int tp_output_frame(tp_output_t *, const frame_t *);
+ssize_t tp_output_flush(tp_output_t *);
+void tp_output_free(tp_output_t *);
 ssize_t send_frame(int, frame_t *);
-ssize_t receive_frame(int, frame_t *);
-void wait_frame(int, frame_t *, frame_t *);
+ssize_t receive_frames(int, tp_parser_t *);
 
 __END_DECLS
 #endif /* transmission_protocol.h */
@@ -0,0 +1,401 @@
+/*
+ * Line based 5/3 lifting, forward and inverse.
+ * Refer docs/resources/format.md
+ */
+#include "wavelet.h"
+#include "simd.h"
+#include "subband.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * A step of a lifting on n samples:
+ *
+ *   out = in -+ floor((a + b) / 2) of a predict
+ *   out = in +- floor((a + b + 2) / 4) of an update
+ *
+ * the first sign of the forward, the second of the inverse transform.
+ * Kernels return the number of samples they have done.
+ */
+static void step_scalar(int16_t *out, const int16_t *in, const int16_t *a,
+                        const int16_t *b, unsigned n, int update,
+                        int inverse) {
+  for (unsigned x = 0; x < n; x++) {
+    int linear = update ? (a[x] + b[x] + 2) >> 2 : (a[x] + b[x]) >> 1;
+    out[x] = update == inverse ? in[x] - linear : in[x] + linear;
+  }
+}
+
+/* floor((a + b) / 2) and floor((a + b + 2) / 4) without 17 bit sums */
+#if defined(__SSE2__)
+static unsigned step_sse2(int16_t *out, const int16_t *in, const int16_t *a,
+                          const int16_t *b, unsigned n, int update,
+                          int inverse) {
+  const __m128i one = _mm_set1_epi16(1), two = _mm_set1_epi16(2),
+                three = _mm_set1_epi16(3);
+  unsigned x = 0;
+  for (; x + 8 <= n; x += 8) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + x));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+    __m128i linear;
+    if (update) {
+      __m128i rest = _mm_add_epi16(
+          _mm_add_epi16(_mm_and_si128(va, three), _mm_and_si128(vb, three)),
+          two);
+      linear = _mm_add_epi16(
+          _mm_add_epi16(_mm_srai_epi16(va, 2), _mm_srai_epi16(vb, 2)),
+          _mm_srai_epi16(rest, 2));
+    } else {
+      linear = _mm_add_epi16(
+          _mm_add_epi16(_mm_srai_epi16(va, 1), _mm_srai_epi16(vb, 1)),
+          _mm_and_si128(_mm_and_si128(va, vb), one));
+    }
+    __m128i vin = _mm_loadu_si128((const __m128i *)(in + x));
+    _mm_storeu_si128((__m128i *)(out + x), update == inverse
+                                               ? _mm_sub_epi16(vin, linear)
+                                               : _mm_add_epi16(vin, linear));
+  }
+  return x;
+}
+
+__attribute__((target("avx2"))) static unsigned
+step_avx2(int16_t *out, const int16_t *in, const int16_t *a, const int16_t *b,
+          unsigned n, int update, int inverse) {
+  const __m256i one = _mm256_set1_epi16(1), two = _mm256_set1_epi16(2),
+                three = _mm256_set1_epi16(3);
+  unsigned x = 0;
+  for (; x + 16 <= n; x += 16) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + x));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + x));
+    __m256i linear;
+    if (update) {
+      __m256i rest = _mm256_add_epi16(
+          _mm256_add_epi16(_mm256_and_si256(va, three),
+                           _mm256_and_si256(vb, three)),
+          two);
+      linear = _mm256_add_epi16(
+          _mm256_add_epi16(_mm256_srai_epi16(va, 2), _mm256_srai_epi16(vb, 2)),
+          _mm256_srai_epi16(rest, 2));
+    } else {
+      linear = _mm256_add_epi16(
+          _mm256_add_epi16(_mm256_srai_epi16(va, 1), _mm256_srai_epi16(vb, 1)),
+          _mm256_and_si256(_mm256_and_si256(va, vb), one));
+    }
+    __m256i vin = _mm256_loadu_si256((const __m256i *)(in + x));
+    _mm256_storeu_si256((__m256i *)(out + x),
+                        update == inverse ? _mm256_sub_epi16(vin, linear)
+                                          : _mm256_add_epi16(vin, linear));
+  }
+  return x;
+}
+#elif defined(__ARM_NEON)
+static unsigned step_neon(int16_t *out, const int16_t *in, const int16_t *a,
+                          const int16_t *b, unsigned n, int update,
+                          int inverse) {
+  const int16x8_t one = vdupq_n_s16(1), two = vdupq_n_s16(2),
+                  three = vdupq_n_s16(3);
+  unsigned x = 0;
+  for (; x + 8 <= n; x += 8) {
+    int16x8_t va = vld1q_s16(a + x), vb = vld1q_s16(b + x), linear;
+    if (update) {
+      int16x8_t rest =
+          vaddq_s16(vaddq_s16(vandq_s16(va, three), vandq_s16(vb, three)), two);
+      linear = vaddq_s16(vaddq_s16(vshrq_n_s16(va, 2), vshrq_n_s16(vb, 2)),
+                         vshrq_n_s16(rest, 2));
+    } else {
+      linear = vaddq_s16(vaddq_s16(vshrq_n_s16(va, 1), vshrq_n_s16(vb, 1)),
+                         vandq_s16(vandq_s16(va, vb), one));
+    }
+    int16x8_t vin = vld1q_s16(in + x);
+    vst1q_s16(out + x, update == inverse ? vsubq_s16(vin, linear)
+                                         : vaddq_s16(vin, linear));
+  }
+  return x;
+}
+#endif
+
+static void step(int16_t *out, const int16_t *in, const int16_t *a,
+                 const int16_t *b, unsigned n, int update, int inverse) {
+  unsigned x = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_AVX2)
+    x = step_avx2(out, in, a, b, n, update, inverse);
+  else if (level >= SIMD_SSE2)
+    x = step_sse2(out, in, a, b, n, update, inverse);
+#elif defined(__ARM_NEON)
+  if (level >= SIMD_NEON)
+    x = step_neon(out, in, a, b, n, update, inverse);
+#endif
+  step_scalar(out + x, in + x, a + x, b + x, n - x, update, inverse);
+}
+
+/* even and odd samples of a row, and back */
+static void split(int16_t *even, int16_t *odd, const int16_t *row,
+                  unsigned width) {
+  unsigned x = 0;
+#if defined(__SSE2__)
+  if (simd_level() >= SIMD_SSE2)
+    for (; x + 16 <= width; x += 16) {
+      __m128i v0 = _mm_loadu_si128((const __m128i *)(row + x));
+      __m128i v1 = _mm_loadu_si128((const __m128i *)(row + x + 8));
+      /* 16 bit samples in 32 bit lanes, packing does not saturate */
+      __m128i e = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16),
+                                  _mm_srai_epi32(_mm_slli_epi32(v1, 16), 16));
+      __m128i o =
+          _mm_packs_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(v1, 16));
+      _mm_storeu_si128((__m128i *)(even + x / 2), e);
+      _mm_storeu_si128((__m128i *)(odd + x / 2), o);
+    }
+#elif defined(__ARM_NEON)
+  if (simd_level() >= SIMD_NEON)
+    for (; x + 16 <= width; x += 16) {
+      int16x8x2_t v = vld2q_s16(row + x);
+      vst1q_s16(even + x / 2, v.val[0]);
+      vst1q_s16(odd + x / 2, v.val[1]);
+    }
+#endif
+  for (; x < width; x++)
+    (x % 2 ? odd : even)[x / 2] = row[x];
+}
+
+static void merge(int16_t *row, const int16_t *even, const int16_t *odd,
+                  unsigned width) {
+  unsigned x = 0;
+#if defined(__SSE2__)
+  if (simd_level() >= SIMD_SSE2)
+    for (; x + 16 <= width; x += 16) {
+      __m128i e = _mm_loadu_si128((const __m128i *)(even + x / 2));
+      __m128i o = _mm_loadu_si128((const __m128i *)(odd + x / 2));
+      _mm_storeu_si128((__m128i *)(row + x), _mm_unpacklo_epi16(e, o));
+      _mm_storeu_si128((__m128i *)(row + x + 8), _mm_unpackhi_epi16(e, o));
+    }
+#elif defined(__ARM_NEON)
+  if (simd_level() >= SIMD_NEON)
+    for (; x + 16 <= width; x += 16) {
+      int16x8x2_t v = {{vld1q_s16(even + x / 2), vld1q_s16(odd + x / 2)}};
+      vst2q_s16(row + x, v);
+    }
+#endif
+  for (; x < width; x++)
+    row[x] = (x % 2 ? odd : even)[x / 2];
+}
+
+/* predict of odd samples by even ones in place */
+static void predict(int16_t *odd, const int16_t *even, unsigned even_number,
+                    unsigned odd_number, int inverse) {
+  /* the last odd sample has no even sample after it */
+  unsigned inner = even_number > odd_number ? odd_number : odd_number - 1;
+  step(odd, odd, even, even + 1, inner, 0, inverse);
+  if (inner < odd_number)
+    step(odd + inner, odd + inner, even + inner, even + inner, 1, 0, inverse);
+}
+
+/* update of even samples by odd ones in place */
+static void update(int16_t *even, const int16_t *odd, unsigned even_number,
+                   unsigned odd_number, int inverse) {
+  step(even, even, odd, odd, 1, 1, inverse);
+  step(even + 1, even + 1, odd, odd + 1, odd_number - 1, 1, inverse);
+  if (even_number > odd_number)
+    step(even + odd_number, even + odd_number, odd + odd_number - 1,
+         odd + odd_number - 1, 1, 1, inverse);
+}
+
+/* lift a row of a low or high band into two subbands */
+static void forward_row(int16_t *even, int16_t *odd, const int16_t *row,
+                        unsigned width) {
+  split(even, odd, row, width);
+  if (width < 2)
+    return;
+  predict(odd, even, (width + 1) / 2, width / 2, 0);
+  update(even, odd, (width + 1) / 2, width / 2, 0);
+}
+
+/* and back, with a scratch of width samples */
+static void inverse_row(int16_t *row, const int16_t *even, const int16_t *odd,
+                        unsigned width, int16_t *scratch) {
+  unsigned even_width = (width + 1) / 2, odd_width = width / 2;
+  if (width < 2) {
+    merge(row, even, odd, width);
+    return;
+  }
+  memcpy(scratch, even, even_width * sizeof(int16_t));
+  memcpy(scratch + even_width, odd, odd_width * sizeof(int16_t));
+  update(scratch, scratch + even_width, even_width, odd_width, 1);
+  predict(scratch + even_width, scratch, even_width, odd_width, 1);
+  merge(row, scratch, scratch + even_width, width);
+}
+
+/*
+ * a level from a low band to LL, HL, LH and HH views, with a scratch of 3 x
+ * width samples
+ */
+static void forward_level(const subband_view_t *views, const int16_t *band,
+                          size_t stride, unsigned width, unsigned height,
+                          int16_t *scratch) {
+  unsigned even_rows = (height + 1) / 2, odd_rows = height / 2;
+  int16_t *high[2] = {scratch, scratch + width}, *low = scratch + 2 * width;
+  if (odd_rows == 0) {
+    forward_row(subband_row(&views[SUBBAND_LL], 0),
+                subband_row(&views[SUBBAND_HL], 0), band, width);
+    return;
+  }
+  for (unsigned i = 0; i < odd_rows; i++) {
+    const int16_t *even = band + 2 * i * stride, *odd = even + stride,
+                  *next = i + 1 < even_rows ? odd + stride : even;
+    int16_t *h = high[i % 2], *former = i ? high[(i + 1) % 2] : h;
+    step(h, odd, even, next, width, 0, 0);
+    step(low, even, former, h, width, 1, 0);
+    forward_row(subband_row(&views[SUBBAND_LL], i),
+                subband_row(&views[SUBBAND_HL], i), low, width);
+    forward_row(subband_row(&views[SUBBAND_LH], i),
+                subband_row(&views[SUBBAND_HH], i), h, width);
+  }
+  if (even_rows > odd_rows) {
+    const int16_t *h = high[(odd_rows - 1) % 2];
+    step(low, band + 2 * odd_rows * stride, h, h, width, 1, 0);
+    forward_row(subband_row(&views[SUBBAND_LL], odd_rows),
+                subband_row(&views[SUBBAND_HL], odd_rows), low, width);
+  }
+}
+
+/* and back, with a scratch of 3 x width samples */
+static void inverse_level(int16_t *band, size_t stride,
+                          const subband_view_t *views, unsigned width,
+                          unsigned height, int16_t *scratch) {
+  unsigned even_rows = (height + 1) / 2, odd_rows = height / 2;
+  int16_t *high[2] = {scratch, scratch + width}, *row = scratch + 2 * width;
+  inverse_row(band, subband_row(&views[SUBBAND_LL], 0),
+              subband_row(&views[SUBBAND_HL], 0), width, row);
+  if (odd_rows == 0)
+    return;
+  inverse_row(high[0], subband_row(&views[SUBBAND_LH], 0),
+              subband_row(&views[SUBBAND_HH], 0), width, row);
+  step(band, band, high[0], high[0], width, 1, 1);
+  for (unsigned i = 0; i < odd_rows; i++) {
+    int16_t *even = band + 2 * i * stride, *odd = even + stride,
+            *next = even, *h = high[i % 2], *h_next = h;
+    if (i + 1 < odd_rows) {
+      h_next = high[(i + 1) % 2];
+      inverse_row(h_next, subband_row(&views[SUBBAND_LH], i + 1),
+                  subband_row(&views[SUBBAND_HH], i + 1), width, row);
+    }
+    /* the even row after H[i] first, the odd row needs it */
+    if (i + 1 < even_rows) {
+      next = odd + stride;
+      inverse_row(next, subband_row(&views[SUBBAND_LL], i + 1),
+                  subband_row(&views[SUBBAND_HL], i + 1), width, row);
+      step(next, next, h, h_next, width, 1, 1);
+    }
+    step(odd, h, even, next, width, 0, 1);
+  }
+}
+
+/* the LL bands of levels 1 to TRANSFORM_LEVELS - 1 go to 2 buffers */
+static int16_t *buffers(int16_t **p_low, unsigned width, unsigned height) {
+  size_t sizes[2] = {(size_t)((width + 1) / 2) * ((height + 1) / 2),
+                     (size_t)((width + 3) / 4) * ((height + 3) / 4)};
+  int16_t *buffer =
+      malloc((sizes[0] + sizes[1] + 3 * (size_t)width) * sizeof(int16_t) + 1);
+  if (buffer == NULL) {
+    perror("wavelet");
+    return NULL;
+  }
+  p_low[0] = buffer;
+  p_low[1] = buffer + sizes[0];
+  return buffer + sizes[0] + sizes[1];
+}
+
+/* views of LL, HL, LH and HH of a level, LL in a buffer if not the last */
+static void level_views(subband_view_t *views, const subband_t *table,
+                        int16_t *coefficients, int16_t *const *low,
+                        unsigned level) {
+  unsigned subband = 1 + 3 * (TRANSFORM_LEVELS - level);
+  for (unsigned i = SUBBAND_HL; i <= SUBBAND_HH; i++)
+    views[i] = subband_view(coefficients, &table[subband + i - SUBBAND_HL]);
+  views[SUBBAND_LL] = subband_view(coefficients, &table[0]);
+  if (level < TRANSFORM_LEVELS) {
+    /* as wide as LH and as high as HL */
+    views[SUBBAND_LL].data = low[(level - 1) % 2];
+    views[SUBBAND_LL].width = table[subband + 1].width;
+    views[SUBBAND_LL].height = table[subband].height;
+    views[SUBBAND_LL].stride = views[SUBBAND_LL].width;
+  }
+}
+
+/**
+ * @brief forward transform of a channel
+ *
+ * @param coefficients width x height coefficients
+ * @param plane width x height samples in raster order
+ * @param width
+ * @param height
+ * @param layout of coefficients, SUBBAND_PACKED or SUBBAND_PICTURE
+ * @return 0 or -1
+ */
+int wavelet_forward(int16_t *coefficients, const int16_t *plane,
+                    unsigned width, unsigned height, int layout) {
+  subband_t table[SUBBAND_NUMBER];
+  subband_table(table, width, height, layout);
+  int16_t *low[2];
+  int16_t *scratch = buffers(low, width, height);
+  if (scratch == NULL)
+    return -1;
+  const int16_t *band = plane;
+  size_t stride = width;
+  for (unsigned level = 1; level <= TRANSFORM_LEVELS; level++) {
+    subband_view_t views[4];
+    level_views(views, table, coefficients, low, level);
+    if (width && height)
+      forward_level(views, band, stride, width, height, scratch);
+    band = views[SUBBAND_LL].data;
+    stride = views[SUBBAND_LL].stride;
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  free(low[0]);
+  return 0;
+}
+
+/**
+ * @brief inverse transform of a channel
+ *
+ * @param plane width x height samples in raster order
+ * @param coefficients width x height coefficients, see wavelet_forward()
+ * @param width
+ * @param height
+ * @param layout of coefficients, SUBBAND_PACKED or SUBBAND_PICTURE
+ * @return 0 or -1
+ */
+int wavelet_inverse(int16_t *plane, const int16_t *coefficients,
+                    unsigned width, unsigned height, int layout) {
+  subband_t table[SUBBAND_NUMBER];
+  subband_table(table, width, height, layout);
+  int16_t *low[2];
+  int16_t *scratch = buffers(low, width, height);
+  if (scratch == NULL)
+    return -1;
+  unsigned widths[TRANSFORM_LEVELS + 1] = {width},
+           heights[TRANSFORM_LEVELS + 1] = {height};
+  for (unsigned level = 1; level <= TRANSFORM_LEVELS; level++) {
+    widths[level] = (widths[level - 1] + 1) / 2;
+    heights[level] = (heights[level - 1] + 1) / 2;
+  }
+  for (unsigned level = TRANSFORM_LEVELS; level >= 1; level--) {
+    subband_view_t views[4];
+    level_views(views, table, (int16_t *)coefficients, low, level);
+    /* the LL band of the former level, or the plane */
+    int16_t *band = level > 1 ? low[(level - 2) % 2] : plane;
+    if (widths[level - 1] && heights[level - 1])
+      inverse_level(band, widths[level - 1], views, widths[level - 1],
+                    heights[level - 1], scratch);
+  }
+  free(low[0]);
+  return 0;
+}
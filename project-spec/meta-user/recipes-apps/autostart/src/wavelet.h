@@ -0,0 +1,30 @@
+#ifndef WAVELET_H
+#define WAVELET_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+
+/*
+ * Classical 5/3 lifting of TRANSFORM_LEVELS levels, the transform of the CPU
+ * engine without transform networks. A level lifts columns, then rows:
+ *
+ *   H[i] = O[i] - floor((E[i] + E[i + 1]) / 2)
+ *   L[i] = E[i] + floor((H[i - 1] + H[i] + 2) / 4)
+ *
+ * with symmetric extension at the ends, and every sample wraps to 16 bit, so
+ * the inverse gives the bits of any channel back. All SIMD kernels give the
+ * same bits.
+ *
+ * A level is one pass over the rows of its low band: a pair of rows is
+ * lifted as soon as the rows it needs are there and goes to its subbands at
+ * once, so a few rows are in use at a time and stay in the L1 cache.
+ *
+ * The coefficients are the SUBBAND_NUMBER subbands of a layout of
+ * subband_table(), SUBBAND_PACKED is the order of the accelerator.
+ */
+int wavelet_forward(int16_t *, const int16_t *, unsigned, unsigned, int);
+int wavelet_inverse(int16_t *, const int16_t *, unsigned, unsigned, int);
+
+__END_DECLS
+#endif /* wavelet.h */
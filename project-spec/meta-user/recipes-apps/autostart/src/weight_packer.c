@@ -0,0 +1,181 @@
+/*
+ * Offline packer of the weights of the network accelerator
+ * Refer docs/resources/format.md
+ *
+ * The manifest has a layer per line in the order of the network:
+ *
+ * NETWORK KERNEL INPUTS OUTPUTS FILE
+ *
+ * NETWORK is transform or entropy, KERNEL is 3x3, 3x1 or 1x1, and FILE has
+ * the 16 bit little endian weights of the layer as
+ * weights[output][input][y][x]. Lines starting with # are comments. 3x1
+ * kernels are not sent to the PL DRAM, so they are not put into the blob.
+ *
+ * Run:
+ * weight_packer -o weights.bin manifest.txt
+ */
+#include "weights.h"
+#include <endian.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LAYER_MAX 256
+
+typedef struct {
+  weights_layer_t layer;
+  uint16_t *packed;
+} packed_layer_t;
+
+/* read the raw weights of a layer and pack them */
+static uint16_t *pack_file(const char *filename,
+                           const weights_layer_t *p_layer) {
+  size_t n = (size_t)p_layer->kernel_height * p_layer->kernel_width *
+             p_layer->inputs * p_layer->outputs;
+  int16_t *weights = malloc(n * sizeof(int16_t));
+  uint16_t *packed = malloc(weights_packed_number(p_layer) * sizeof(uint16_t));
+  if (weights == NULL || packed == NULL) {
+    perror(filename);
+    goto free_weights;
+  }
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    perror(filename);
+    goto free_weights;
+  }
+  size_t size = fread(weights, sizeof(int16_t), n + 1, file);
+  fclose(file);
+  if (size != n) {
+    fprintf(stderr, "%s: %zu weights are expected\n", filename, n);
+    goto free_weights;
+  }
+  for (size_t i = 0; i < n; i++)
+    weights[i] = le16toh(weights[i]);
+  weights_pack(packed, weights, p_layer);
+  free(weights);
+  return packed;
+free_weights:
+  free(weights);
+  free(packed);
+  return NULL;
+}
+
+/* layers of the manifest, the paths of files are relative to the manifest */
+static int read_manifest(const char *manifest, packed_layer_t *layers,
+                         unsigned *p_layer_number) {
+  FILE *file = fopen(manifest, "r");
+  if (file == NULL) {
+    perror(manifest);
+    return -1;
+  }
+  char copy[PATH_MAX], line[PATH_MAX + 64], network[16], name[PATH_MAX],
+      path[2 * PATH_MAX];
+  strncpy(copy, manifest, sizeof(copy) - 1);
+  copy[sizeof(copy) - 1] = '\0';
+  const char *dir = dirname(copy);
+  unsigned kernel_height, kernel_width, inputs, outputs, number = 0;
+  int status = 0;
+  for (unsigned n = 1; fgets(line, sizeof(line), file); n++) {
+    if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\n")] == 0)
+      continue;
+    if (sscanf(line, "%15s %ux%u %u %u %4095s", network, &kernel_height,
+               &kernel_width, &inputs, &outputs, name) != 6 ||
+        (strcmp(network, "transform") && strcmp(network, "entropy")) ||
+        kernel_height == 0 || kernel_height > UINT8_MAX || kernel_width == 0 ||
+        kernel_width > UINT8_MAX || inputs == 0 || inputs > UINT16_MAX ||
+        outputs == 0 || outputs > UINT16_MAX) {
+      fprintf(stderr, "%s:%u: layer should be NETWORK KERNEL INPUTS OUTPUTS "
+                      "FILE\n",
+              manifest, n);
+      status = -1;
+      break;
+    }
+    if (kernel_height == 3 && kernel_width == 1)
+      continue;
+    if (number == LAYER_MAX) {
+      fprintf(stderr, "%s:%u: too many layers\n", manifest, n);
+      status = -1;
+      break;
+    }
+    weights_layer_t *p_layer = &layers[number].layer;
+    p_layer->network =
+        strcmp(network, "transform") ? WEIGHTS_ENTROPY : WEIGHTS_TRANSFORM;
+    p_layer->kernel_height = kernel_height;
+    p_layer->kernel_width = kernel_width;
+    p_layer->inputs = inputs;
+    p_layer->outputs = outputs;
+    if (name[0] == '/')
+      snprintf(path, sizeof(path), "%s", name);
+    else
+      snprintf(path, sizeof(path), "%s/%s", dir, name);
+    layers[number].packed = pack_file(path, p_layer);
+    if (layers[number].packed == NULL) {
+      status = -1;
+      break;
+    }
+    number++;
+  }
+  fclose(file);
+  *p_layer_number = number;
+  return status;
+}
+
+/*
+ * The PL DRAM has the transform network before the entropy network. In a
+ * network, 3x3 kernels come before 1x1 kernels, and layers keep their order.
+ */
+static unsigned order(const weights_layer_t *p_layer) {
+  return p_layer->network * 2 +
+         (p_layer->kernel_height * p_layer->kernel_width == 1);
+}
+
+int main(int argc, char *argv[]) {
+  const char *output = NULL;
+  int c;
+  while ((c = getopt(argc, argv, "o:")) != -1)
+    if (c == 'o')
+      output = optarg;
+  if (output == NULL || optind != argc - 1) {
+    printf("usage: %s -o WEIGHTS MANIFEST\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  static packed_layer_t layers[LAYER_MAX];
+  unsigned layer_number;
+  int status = read_manifest(argv[optind], layers, &layer_number);
+
+  weights_layer_t ordered[LAYER_MAX];
+  const uint16_t *packed[LAYER_MAX];
+  unsigned number = 0;
+  for (unsigned key = 0; key < 4; key++)
+    for (unsigned i = 0; i < layer_number; i++)
+      if (order(&layers[i].layer) == key) {
+        ordered[number] = layers[i].layer;
+        packed[number++] = layers[i].packed;
+      }
+  if (status == 0) {
+    FILE *file = fopen(output, "w");
+    if (file == NULL) {
+      perror(output);
+      status = -1;
+    } else {
+      status = weights_write(file, ordered, number, packed);
+      if (fclose(file) == EOF) {
+        perror(output);
+        status = -1;
+      }
+    }
+  }
+  if (status == 0)
+    for (unsigned i = 0; i < number; i++)
+      printf("%s %ux%u %u -> %u: %u bytes at %u\n",
+             ordered[i].network == WEIGHTS_TRANSFORM ? "transform"
+                                                     : "entropy",
+             ordered[i].kernel_height, ordered[i].kernel_width,
+             ordered[i].inputs, ordered[i].outputs, ordered[i].size,
+             ordered[i].offset);
+  for (unsigned i = 0; i < layer_number; i++)
+    free(layers[i].packed);
+  return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
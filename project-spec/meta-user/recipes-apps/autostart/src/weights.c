@@ -0,0 +1,334 @@
+/*
+ * Weight blob of the network accelerator.
+ */
+#include "weights.h"
+#include "crc.h"
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHECK_SUM_OFFSET 10
+
+static void put_u16(uint8_t *p, uint16_t value) {
+  p[0] = value;
+  p[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t value) {
+  put_u16(p, value);
+  put_u16(p + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint32_t get_u32(const uint8_t *p) {
+  return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+static size_t block_number(size_t payload_size) {
+  return (payload_size + WEIGHTS_BLOCK_SIZE - 1) / WEIGHTS_BLOCK_SIZE;
+}
+
+static size_t index_size(unsigned layer_number, size_t payload_size) {
+  return WEIGHTS_HEADER_SIZE + layer_number * WEIGHTS_LAYER_SIZE +
+         block_number(payload_size) * 2;
+}
+
+static size_t payload_offset(size_t index_size) {
+  return (index_size + WEIGHTS_ALIGN - 1) / WEIGHTS_ALIGN * WEIGHTS_ALIGN;
+}
+
+/* kernels of 2 input channels are interleaved, except 1x1 kernels */
+static int interleaved(const weights_layer_t *p_layer) {
+  return p_layer->inputs > 1 &&
+         p_layer->kernel_height * p_layer->kernel_width > 1;
+}
+
+/**
+ * @brief number of packed weights of a layer. An odd input channel of
+ * interleaved kernels is padded by a zero kernel.
+ *
+ * @param p_layer
+ * @return number of 16 bit weights
+ */
+size_t weights_packed_number(const weights_layer_t *p_layer) {
+  size_t inputs = interleaved(p_layer) ? (p_layer->inputs + 1) / 2 * 2
+                                       : p_layer->inputs;
+  return (size_t)p_layer->kernel_height * p_layer->kernel_width * inputs *
+         p_layer->outputs;
+}
+
+/**
+ * @brief reorder the weights of a layer for the PL DRAM. Kernels of 1 input
+ * channel and 1x1 kernels are ordered by output channel then input channel.
+ * Otherwise kernels of a pair of input channels are put next to each other,
+ * pair by pair, and output channel by output channel in a pair.
+ *
+ * @param packed weights_packed_number() 16 bit little endian weights
+ * @param weights weights[output][input][y][x]
+ * @param p_layer
+ */
+void weights_pack(uint16_t *packed, const int16_t *weights,
+                  const weights_layer_t *p_layer) {
+  size_t taps = (size_t)p_layer->kernel_height * p_layer->kernel_width;
+  unsigned inputs = p_layer->inputs;
+  if (!interleaved(p_layer)) {
+    for (size_t i = 0; i < taps * inputs * p_layer->outputs; i++)
+      packed[i] = htole16(weights[i]);
+    return;
+  }
+  for (unsigned pair = 0; pair < inputs; pair += 2)
+    for (unsigned output = 0; output < p_layer->outputs; output++)
+      for (unsigned input = pair; input < pair + 2; input++)
+        for (size_t tap = 0; tap < taps; tap++)
+          *packed++ =
+              input < inputs
+                  ? htole16(weights[((size_t)output * inputs + input) * taps +
+                                    tap])
+                  : 0;
+}
+
+/**
+ * @brief the inverse of weights_pack()
+ *
+ * @param weights weights[output][input][y][x]
+ * @param packed weights_packed_number() 16 bit little endian weights
+ * @param p_layer
+ */
+void weights_unpack(int16_t *weights, const uint16_t *packed,
+                    const weights_layer_t *p_layer) {
+  size_t taps = (size_t)p_layer->kernel_height * p_layer->kernel_width;
+  unsigned inputs = p_layer->inputs;
+  if (!interleaved(p_layer)) {
+    for (size_t i = 0; i < taps * inputs * p_layer->outputs; i++)
+      weights[i] = le16toh(packed[i]);
+    return;
+  }
+  for (unsigned pair = 0; pair < inputs; pair += 2)
+    for (unsigned output = 0; output < p_layer->outputs; output++)
+      for (unsigned input = pair; input < pair + 2; input++, packed += taps)
+        if (input < inputs)
+          for (size_t tap = 0; tap < taps; tap++)
+            weights[((size_t)output * inputs + input) * taps + tap] =
+                le16toh(packed[tap]);
+}
+
+/**
+ * @brief write a weight blob
+ *
+ * @param file
+ * @param layers in the order of the PL DRAM, offset and size are computed
+ * @param layer_number
+ * @param packed weights of every layer packed by weights_pack()
+ * @return 0 or -1
+ */
+int weights_write(FILE *file, weights_layer_t *layers, unsigned layer_number,
+                  const uint16_t *const *packed) {
+  size_t payload_size = 0;
+  for (unsigned i = 0; i < layer_number; i++) {
+    layers[i].offset = payload_size;
+    layers[i].size = weights_packed_number(&layers[i]) * sizeof(uint16_t);
+    payload_size += layers[i].size;
+  }
+  size_t size = index_size(layer_number, payload_size);
+  if (size > UINT16_MAX || payload_size > UINT32_MAX) {
+    fprintf(stderr, "weights: too many weights\n");
+    return -1;
+  }
+  size_t offset = payload_offset(size);
+  uint8_t *blob = calloc(offset + payload_size, 1);
+  if (blob == NULL) {
+    perror("weights");
+    return -1;
+  }
+  uint8_t *payload = blob + offset;
+  for (unsigned i = 0; i < layer_number; i++) {
+    uint8_t *p = blob + WEIGHTS_HEADER_SIZE + i * WEIGHTS_LAYER_SIZE;
+    p[0] = layers[i].network;
+    p[1] = layers[i].kernel_height;
+    p[2] = layers[i].kernel_width;
+    put_u16(p + 4, layers[i].inputs);
+    put_u16(p + 6, layers[i].outputs);
+    put_u32(p + 8, layers[i].offset);
+    put_u32(p + 12, layers[i].size);
+    memcpy(payload + layers[i].offset, packed[i], layers[i].size);
+  }
+  uint8_t *crcs =
+      blob + WEIGHTS_HEADER_SIZE + layer_number * WEIGHTS_LAYER_SIZE;
+  for (size_t i = 0; i < block_number(payload_size); i++) {
+    size_t block_size = payload_size - i * WEIGHTS_BLOCK_SIZE;
+    if (block_size > WEIGHTS_BLOCK_SIZE)
+      block_size = WEIGHTS_BLOCK_SIZE;
+    put_u16(crcs + i * 2,
+            crc16(payload + i * WEIGHTS_BLOCK_SIZE, block_size));
+  }
+  memcpy(blob, WEIGHTS_MAGIC, 4);
+  blob[4] = WEIGHTS_VERSION;
+  blob[5] = WEIGHTS_HEADER_SIZE;
+  put_u16(blob + 6, WEIGHTS_LAYER_SIZE);
+  put_u16(blob + 8, layer_number);
+  put_u32(blob + 12, offset);
+  put_u32(blob + 16, payload_size);
+  put_u32(blob + 20, WEIGHTS_BLOCK_SIZE);
+  put_u16(blob + CHECK_SUM_OFFSET, crc16(blob, size));
+  int status = fwrite(blob, 1, offset + payload_size, file) ==
+                       offset + payload_size
+                   ? 0
+                   : -1;
+  if (status == -1)
+    perror("weights");
+  free(blob);
+  return status;
+}
+
+/**
+ * @brief parse and check a weight blob in memory. The payload is not copied.
+ *
+ * @param p_weights layers should be freed by weights_unload()
+ * @param data
+ * @param size bytes of data
+ * @return 0 or -1
+ */
+int weights_read(weights_t *p_weights, const uint8_t *data, size_t size) {
+  p_weights->layers = NULL;
+  if (size < WEIGHTS_HEADER_SIZE || memcmp(data, WEIGHTS_MAGIC, 4) != 0) {
+    fprintf(stderr, "weights: wrong magic\n");
+    return -1;
+  }
+  if (data[4] != WEIGHTS_VERSION) {
+    fprintf(stderr, "weights: unsupported version %u\n", data[4]);
+    return -1;
+  }
+  size_t header_size = data[5];
+  size_t layer_size = get_u16(data + 6);
+  unsigned layer_number = get_u16(data + 8);
+  size_t offset = get_u32(data + 12);
+  size_t payload_size = get_u32(data + 16);
+  size_t block_size = get_u32(data + 20);
+  if (header_size < WEIGHTS_HEADER_SIZE || layer_size < WEIGHTS_LAYER_SIZE ||
+      block_size == 0 || block_size > UINT16_MAX) {
+    fprintf(stderr,
+            "weights: wrong header size %zu, layer size %zu or block size "
+            "%zu\n",
+            header_size, layer_size, block_size);
+    return -1;
+  }
+  size_t crcs_offset = header_size + layer_number * layer_size;
+  size_t blocks = (payload_size + block_size - 1) / block_size;
+  size_t index_size = crcs_offset + blocks * 2;
+  if (index_size > UINT16_MAX || index_size > offset || offset > size ||
+      payload_size > size - offset) {
+    fprintf(stderr, "weights: truncated blob\n");
+    return -1;
+  }
+
+  uint8_t *index = malloc(index_size);
+  if (index == NULL) {
+    perror("weights");
+    return -1;
+  }
+  memcpy(index, data, index_size);
+  put_u16(index + CHECK_SUM_OFFSET, 0);
+  uint16_t check_sum = crc16(index, index_size);
+  free(index);
+  if (check_sum != get_u16(data + CHECK_SUM_OFFSET)) {
+    fprintf(stderr, "weights: incorrect check sum of index\n");
+    return -1;
+  }
+  const uint8_t *payload = data + offset;
+  for (size_t i = 0; i < blocks; i++) {
+    size_t n = payload_size - i * block_size;
+    if (n > block_size)
+      n = block_size;
+    if (crc16((uint8_t *)payload + i * block_size, n) !=
+        get_u16(data + crcs_offset + i * 2)) {
+      fprintf(stderr, "weights: incorrect check sum of block %zu\n", i);
+      return -1;
+    }
+  }
+
+  p_weights->layers = malloc((layer_number + 1) * sizeof(weights_layer_t));
+  if (p_weights->layers == NULL) {
+    perror("weights");
+    return -1;
+  }
+  for (unsigned i = 0; i < layer_number; i++) {
+    const uint8_t *p = data + header_size + i * layer_size;
+    weights_layer_t *p_layer = &p_weights->layers[i];
+    p_layer->network = p[0];
+    p_layer->kernel_height = p[1];
+    p_layer->kernel_width = p[2];
+    p_layer->inputs = get_u16(p + 4);
+    p_layer->outputs = get_u16(p + 6);
+    p_layer->offset = get_u32(p + 8);
+    p_layer->size = get_u32(p + 12);
+    if (p_layer->offset > payload_size ||
+        p_layer->size > payload_size - p_layer->offset) {
+      fprintf(stderr, "weights: layer %u is out of the payload\n", i);
+      free(p_weights->layers);
+      p_weights->layers = NULL;
+      return -1;
+    }
+  }
+  p_weights->layer_number = layer_number;
+  p_weights->payload = (const uint16_t *)payload;
+  p_weights->payload_size = payload_size;
+  return 0;
+}
+
+/**
+ * @brief map a weight blob file and check it. The file is read once here,
+ * the payload can be sent to the PL DRAM from the mapping.
+ *
+ * @param p_weights should be freed by weights_unload()
+ * @param filename
+ * @return 0 or -1
+ */
+int weights_load(weights_t *p_weights, const char *filename) {
+  p_weights->map = NULL;
+  p_weights->layers = NULL;
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    perror(filename);
+    return -1;
+  }
+  struct stat status;
+  if (fstat(fd, &status) == -1) {
+    perror(filename);
+    close(fd);
+    return -1;
+  }
+  if (status.st_size == 0) {
+    errno = EINVAL;
+    perror(filename);
+    close(fd);
+    return -1;
+  }
+  void *map = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                   fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    perror(filename);
+    return -1;
+  }
+  if (weights_read(p_weights, map, status.st_size) == -1) {
+    munmap(map, status.st_size);
+    return -1;
+  }
+  p_weights->map = map;
+  p_weights->map_size = status.st_size;
+  return 0;
+}
+
+void weights_unload(weights_t *p_weights) {
+  free(p_weights->layers);
+  p_weights->layers = NULL;
+  if (p_weights->map)
+    munmap(p_weights->map, p_weights->map_size);
+  p_weights->map = NULL;
+}
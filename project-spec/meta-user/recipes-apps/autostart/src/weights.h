@@ -0,0 +1,95 @@
+#ifndef WEIGHTS_H
+#define WEIGHTS_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Weight blob, weights packed offline in the order of the PL DRAM. Refer
+ * docs/resources/format.md. All fields are little endian.
+ *
+ * | bytes              | name                                         |
+ * | ------------------ | -------------------------------------------- |
+ * | 32                 | header                                       |
+ * | 16 x layer number  | layers in the order of the PL DRAM           |
+ * | 2 x block number   | CRC-16/MODBUS of every block of the payload  |
+ * | ...                | zeros up to the payload offset               |
+ * | ...                | payload, 16 bit weights of all layers        |
+ *
+ * header:
+ *
+ * | offset | bytes | name                                            |
+ * | ------ | ----- | ----------------------------------------------- |
+ * | 0      | 4     | magic "DSDW"                                    |
+ * | 4      | 1     | version                                         |
+ * | 5      | 1     | header size                                     |
+ * | 6      | 2     | layer size                                      |
+ * | 8      | 2     | layer number                                    |
+ * | 10     | 2     | CRC-16/MODBUS of header, layers and block CRCs  |
+ * | 12     | 4     | payload offset, a multiple of WEIGHTS_ALIGN     |
+ * | 16     | 4     | payload size                                    |
+ * | 20     | 4     | block size                                      |
+ * | 24     | 8     | reserved                                        |
+ *
+ * layer:
+ *
+ * | offset | bytes | name                                            |
+ * | ------ | ----- | ----------------------------------------------- |
+ * | 0      | 1     | network, WEIGHTS_TRANSFORM or WEIGHTS_ENTROPY   |
+ * | 1      | 1     | kernel height                                   |
+ * | 2      | 1     | kernel width                                    |
+ * | 3      | 1     | reserved                                        |
+ * | 4      | 2     | input channels                                  |
+ * | 6      | 2     | output channels                                 |
+ * | 8      | 4     | offset of weights from the start of payload     |
+ * | 12     | 4     | size of weights                                 |
+ *
+ * The payload is page aligned, so it can be mapped and sent to the PL DRAM
+ * as it is.
+ */
+#define WEIGHTS_MAGIC "DSDW"
+#define WEIGHTS_VERSION 1
+#define WEIGHTS_HEADER_SIZE 32
+#define WEIGHTS_LAYER_SIZE 16
+#define WEIGHTS_ALIGN 4096
+/* bytes of the payload covered by one CRC */
+#define WEIGHTS_BLOCK_SIZE 32768
+
+/* networks */
+#define WEIGHTS_TRANSFORM 0
+#define WEIGHTS_ENTROPY 1
+
+typedef struct {
+  uint8_t network;
+  uint8_t kernel_height;
+  uint8_t kernel_width;
+  uint16_t inputs;
+  uint16_t outputs;
+  uint32_t offset;
+  uint32_t size;
+} weights_layer_t;
+
+typedef struct {
+  weights_layer_t *layers;
+  unsigned layer_number;
+  /* 16 bit little endian weights in the order of the PL DRAM */
+  const uint16_t *payload;
+  size_t payload_size;
+  /* mapping of the blob file */
+  void *map;
+  size_t map_size;
+} weights_t;
+
+size_t weights_packed_number(const weights_layer_t *);
+void weights_pack(uint16_t *, const int16_t *, const weights_layer_t *);
+void weights_unpack(int16_t *, const uint16_t *, const weights_layer_t *);
+int weights_write(FILE *, weights_layer_t *, unsigned,
+                  const uint16_t *const *);
+int weights_read(weights_t *, const uint8_t *, size_t);
+int weights_load(weights_t *, const char *);
+void weights_unload(weights_t *);
+
+__END_DECLS
+#endif /* weights.h */
@@ -0,0 +1,232 @@
+/*
+ * Convert packed YUV422 to planar channels, and decoded samples back.
+ */
+#include "yuv.h"
+#include "simd.h"
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* pixels of an iteration of SIMD kernels, the scalar loop does the rest */
+#define YUV_BLOCK 32
+
+/**
+ * @brief parse the name of a layout
+ *
+ * @param name planar, uyvy or yuyv
+ * @return YUV_PLANAR, YUV_UYVY, YUV_YUYV or -1
+ */
+int yuv_format(const char *name) {
+  if (strcmp(name, "planar") == 0)
+    return YUV_PLANAR;
+  if (strcmp(name, "uyvy") == 0)
+    return YUV_UYVY;
+  if (strcmp(name, "yuyv") == 0)
+    return YUV_YUYV;
+  return -1;
+}
+
+#if defined(__SSE2__)
+/* split 16 bytes into even and odd bytes, each widened to 16 bits */
+static inline void split(__m128i bytes, __m128i *p_even, __m128i *p_odd) {
+  *p_even = _mm_and_si128(bytes, _mm_set1_epi16(0x00FF));
+  *p_odd = _mm_srli_epi16(bytes, 8);
+}
+
+/* 32 pixels from 64 bytes */
+static inline void deinterleave_block(uint8_t *y, uint8_t *u, uint8_t *v,
+                                      const uint8_t *packed, int format) {
+  __m128i lumas[4], chromas[4];
+  for (unsigned i = 0; i < 4; i++) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(packed + 16 * i));
+    if (format == YUV_UYVY)
+      split(bytes, &chromas[i], &lumas[i]);
+    else
+      split(bytes, &lumas[i], &chromas[i]);
+  }
+  _mm_storeu_si128((__m128i *)y, _mm_packus_epi16(lumas[0], lumas[1]));
+  _mm_storeu_si128((__m128i *)(y + 16), _mm_packus_epi16(lumas[2], lumas[3]));
+  /* U0 V0 U1 V1 ... */
+  __m128i uv0 = _mm_packus_epi16(chromas[0], chromas[1]);
+  __m128i uv1 = _mm_packus_epi16(chromas[2], chromas[3]);
+  __m128i u0, v0, u1, v1;
+  split(uv0, &u0, &v0);
+  split(uv1, &u1, &v1);
+  _mm_storeu_si128((__m128i *)u, _mm_packus_epi16(u0, u1));
+  _mm_storeu_si128((__m128i *)v, _mm_packus_epi16(v0, v1));
+}
+
+static size_t deinterleave_sse2(uint8_t *y, uint8_t *u, uint8_t *v,
+                                const uint8_t *packed, size_t pixels,
+                                int format) {
+  size_t i = 0;
+  for (; i + YUV_BLOCK <= pixels; i += YUV_BLOCK)
+    deinterleave_block(y + i, u + i / 2, v + i / 2, packed + 2 * i, format);
+  return i;
+}
+#elif defined(__ARM_NEON)
+/* 32 pixels from 64 bytes */
+static inline void deinterleave_block(uint8_t *y, uint8_t *u, uint8_t *v,
+                                      const uint8_t *packed, int format) {
+  uint8x16x4_t bytes = vld4q_u8(packed);
+  uint8x16x2_t lumas;
+  if (format == YUV_UYVY) {
+    lumas.val[0] = bytes.val[1];
+    lumas.val[1] = bytes.val[3];
+    vst1q_u8(u, bytes.val[0]);
+    vst1q_u8(v, bytes.val[2]);
+  } else {
+    lumas.val[0] = bytes.val[0];
+    lumas.val[1] = bytes.val[2];
+    vst1q_u8(u, bytes.val[1]);
+    vst1q_u8(v, bytes.val[3]);
+  }
+  vst2q_u8(y, lumas);
+}
+
+static size_t deinterleave_neon(uint8_t *y, uint8_t *u, uint8_t *v,
+                                const uint8_t *packed, size_t pixels,
+                                int format) {
+  size_t i = 0;
+  for (; i + YUV_BLOCK <= pixels; i += YUV_BLOCK)
+    deinterleave_block(y + i, u + i / 2, v + i / 2, packed + 2 * i, format);
+  return i;
+}
+#endif
+
+/**
+ * @brief split packed YUV422 into Y, U and V planes in one pass. Pixels are
+ * in raster order, so planes of the whole image or of some rows can be
+ * converted straight from a receive buffer.
+ *
+ * @param y pixels bytes
+ * @param u pixels / 2 bytes
+ * @param v pixels / 2 bytes
+ * @param packed pixels * 2 bytes
+ * @param pixels number of luma pixels, even
+ * @param format YUV_UYVY or YUV_YUYV
+ */
+void yuv_deinterleave(uint8_t *y, uint8_t *u, uint8_t *v,
+                      const uint8_t *packed, size_t pixels, int format) {
+  size_t i = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_SSE2)
+    i = deinterleave_sse2(y, u, v, packed, pixels, format);
+#elif defined(__ARM_NEON)
+  if (level >= SIMD_NEON)
+    i = deinterleave_neon(y, u, v, packed, pixels, format);
+#endif
+  (void)level;
+  /* offsets of Y0 and U in a macropixel, Y1 and V follow 2 bytes later */
+  unsigned luma = format == YUV_UYVY, chroma = !luma;
+  for (; i + 1 < pixels; i += 2) {
+    const uint8_t *macropixel = packed + 2 * i;
+    y[i] = macropixel[luma];
+    y[i + 1] = macropixel[luma + 2];
+    u[i / 2] = macropixel[chroma];
+    v[i / 2] = macropixel[chroma + 2];
+  }
+}
+
+/* 8 bit saturation of a sample */
+static inline uint8_t clamp(int16_t sample) {
+  return sample < 0 ? 0 : sample > UINT8_MAX ? UINT8_MAX : sample;
+}
+
+/**
+ * @brief narrow decoded samples to 8 bit with saturation
+ *
+ * @param pixels n bytes
+ * @param samples n samples
+ * @param n
+ */
+void yuv_narrow(uint8_t *pixels, const int16_t *samples, size_t n) {
+  size_t i = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_SSE2)
+    for (; i + 16 <= n; i += 16) {
+      __m128i low = _mm_loadu_si128((const __m128i *)(samples + i));
+      __m128i high = _mm_loadu_si128((const __m128i *)(samples + i + 8));
+      _mm_storeu_si128((__m128i *)(pixels + i), _mm_packus_epi16(low, high));
+    }
+#elif defined(__ARM_NEON)
+  if (level >= SIMD_NEON)
+    for (; i + 16 <= n; i += 16) {
+      uint8x8_t low = vqmovun_s16(vld1q_s16(samples + i));
+      uint8x8_t high = vqmovun_s16(vld1q_s16(samples + i + 8));
+      vst1q_u8(pixels + i, vcombine_u8(low, high));
+    }
+#endif
+  (void)level;
+  for (; i < n; i++)
+    pixels[i] = clamp(samples[i]);
+}
+
+/**
+ * @brief narrow decoded Y, U and V samples to 8 bit with saturation and
+ * interleave them into packed YUV422 in one pass, the inverse of
+ * yuv_deinterleave()
+ *
+ * @param packed pixels * 2 bytes
+ * @param y pixels samples
+ * @param u pixels / 2 samples
+ * @param v pixels / 2 samples
+ * @param pixels number of luma pixels, even
+ * @param format YUV_UYVY or YUV_YUYV
+ */
+void yuv_pack(uint8_t *packed, const int16_t *y, const int16_t *u,
+              const int16_t *v, size_t pixels, int format) {
+  size_t i = 0;
+  int level = simd_level();
+#if defined(__SSE2__)
+  if (level >= SIMD_SSE2)
+    for (; i + 16 <= pixels; i += 16) {
+      __m128i lumas =
+          _mm_packus_epi16(_mm_loadu_si128((const __m128i *)(y + i)),
+                           _mm_loadu_si128((const __m128i *)(y + i + 8)));
+      __m128i us = _mm_loadu_si128((const __m128i *)(u + i / 2));
+      __m128i vs = _mm_loadu_si128((const __m128i *)(v + i / 2));
+      /* U0 V0 U1 V1 ... */
+      __m128i chromas = _mm_packus_epi16(_mm_unpacklo_epi16(us, vs),
+                                         _mm_unpackhi_epi16(us, vs));
+      __m128i first = format == YUV_UYVY
+                          ? _mm_unpacklo_epi8(chromas, lumas)
+                          : _mm_unpacklo_epi8(lumas, chromas);
+      __m128i second = format == YUV_UYVY
+                           ? _mm_unpackhi_epi8(chromas, lumas)
+                           : _mm_unpackhi_epi8(lumas, chromas);
+      _mm_storeu_si128((__m128i *)(packed + 2 * i), first);
+      _mm_storeu_si128((__m128i *)(packed + 2 * i + 16), second);
+    }
+#elif defined(__ARM_NEON)
+  if (level >= SIMD_NEON)
+    for (; i + 16 <= pixels; i += 16) {
+      int16x8x2_t lumas = vld2q_s16(y + i);
+      uint8x8_t y0 = vqmovun_s16(lumas.val[0]), y1 = vqmovun_s16(lumas.val[1]);
+      uint8x8_t u0 = vqmovun_s16(vld1q_s16(u + i / 2));
+      uint8x8_t v0 = vqmovun_s16(vld1q_s16(v + i / 2));
+      uint8x8x4_t bytes = {{y0, u0, y1, v0}};
+      if (format == YUV_UYVY) {
+        bytes.val[0] = u0;
+        bytes.val[1] = y0;
+        bytes.val[2] = v0;
+        bytes.val[3] = y1;
+      }
+      vst4_u8(packed + 2 * i, bytes);
+    }
+#endif
+  (void)level;
+  unsigned luma = format == YUV_UYVY, chroma = !luma;
+  for (; i + 1 < pixels; i += 2) {
+    uint8_t *macropixel = packed + 2 * i;
+    macropixel[luma] = clamp(y[i]);
+    macropixel[luma + 2] = clamp(y[i + 1]);
+    macropixel[chroma] = clamp(u[i / 2]);
+    macropixel[chroma + 2] = clamp(v[i / 2]);
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef YUV_H
+#define YUV_H 1
+#include <sys/cdefs.h>
+__BEGIN_DECLS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Layouts of a YUV422 raw image. Planar is what the accelerator consumes,
+ * refer docs/resources/format.md. Packed layouts store 2 pixels in 4 bytes.
+ */
+/* Y plane, then U plane, then V plane */
+#define YUV_PLANAR 0
+/* U0 Y0 V0 Y1 */
+#define YUV_UYVY 1
+/* Y0 U0 Y1 V0 */
+#define YUV_YUYV 2
+
+int yuv_format(const char *);
+void yuv_deinterleave(uint8_t *, uint8_t *, uint8_t *, const uint8_t *, size_t,
+                      int);
+void yuv_narrow(uint8_t *, const int16_t *, size_t);
+void yuv_pack(uint8_t *, const int16_t *, const int16_t *, const int16_t *,
+              size_t, int);
+
+__END_DECLS
+#endif /* yuv.h */
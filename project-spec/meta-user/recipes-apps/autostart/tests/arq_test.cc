@@ -0,0 +1,302 @@
+#include "../src/arq.h"
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+/*
+ * bytes from one socket to another after a delay in milliseconds, with every
+ * period-th byte flipped
+ */
+struct relay {
+  event_source_t source;
+  int to;
+  unsigned long period;
+  unsigned long offset;
+  double delay;
+  unsigned long bytes;
+  event_timer_t timer;
+  std::deque<std::pair<double, std::vector<uint8_t>>> chunks;
+};
+
+static void flush(void *arg, uint64_t count) {
+  (void)count;
+  relay *p_relay = static_cast<relay *>(arg);
+  while (!p_relay->chunks.empty() &&
+         p_relay->chunks.front().first <= now()) {
+    std::vector<uint8_t> &chunk = p_relay->chunks.front().second;
+    ASSERT_EQ(write(p_relay->to, chunk.data(), chunk.size()),
+              (ssize_t)chunk.size());
+    p_relay->chunks.pop_front();
+  }
+}
+
+static void forward(void *arg, uint32_t events) {
+  (void)events;
+  relay *p_relay = static_cast<relay *>(arg);
+  uint8_t buffer[4096];
+  ssize_t n = read(p_relay->source.fd, buffer, sizeof(buffer));
+  for (ssize_t i = 0; i < n; i++, p_relay->bytes++)
+    if (p_relay->period && p_relay->bytes % p_relay->period == p_relay->offset)
+      buffer[i] ^= 0x10;
+  if (n > 0)
+    p_relay->chunks.emplace_back(now() + p_relay->delay,
+                                 std::vector<uint8_t>(buffer, buffer + n));
+  flush(p_relay, 0);
+}
+
+struct end {
+  arq_t arq;
+  std::vector<frame_t> frames;
+};
+
+static void collect(void *arg, const frame_t *p_frame) {
+  static_cast<end *>(arg)->frames.push_back(*p_frame);
+}
+
+static frame_t make_frame(unsigned i) {
+  frame_t frame = {};
+  memcpy(frame.header, tp_header, sizeof(tp_header));
+  frame.address = TP_ADDRESS_MASTER;
+  frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
+  frame.n_file = i / 100;
+  frame.data_len = i % (TP_FRAME_DATA_LEN_MAX + 1);
+  for (unsigned j = 0; j < frame.data_len; j++)
+    frame.data[j] = i + j;
+  return frame;
+}
+
+/* run the loop until both ends know the session of the other */
+static void handshake(event_loop_t *p_loop, const end *p_a, const end *p_b) {
+  time_t start = time(NULL);
+  while (!(p_a->arq.peer && p_b->arq.peer) && time(NULL) - start < 10)
+    event_loop_run_once(p_loop, 10);
+  EXPECT_EQ(p_a->arq.peer, p_b->arq.session);
+  EXPECT_EQ(p_b->arq.peer, p_a->arq.session);
+}
+
+/*
+ * send frames from a to b through relays which flip bytes, and return the
+ * frames sent again
+ */
+static unsigned long transfer(unsigned window, unsigned long period,
+                              n_frame_t first, unsigned number,
+                              double delay = 0, double *p_srtt = NULL) {
+  event_loop_t loop;
+  EXPECT_EQ(event_loop_init(&loop), 0);
+  int ab[2], ba[2];
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, ab), 0);
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, ba), 0);
+  /* a writes ab[0], the relays move ab[1] to ba[1] and back, b has ba[0] */
+  relay to_b = {{ab[1], forward, &to_b}, ba[1], period, 7, delay, 0, {}, {}};
+  relay to_a = {{ba[1], forward, &to_a}, ab[1], period, 3, delay, 0, {}, {}};
+  for (relay *p_relay : {&to_b, &to_a}) {
+    EXPECT_EQ(event_timer_init(&loop, &p_relay->timer, flush, p_relay), 0);
+    EXPECT_EQ(event_timer_set(&p_relay->timer, 1, 1), 0);
+  }
+  end a, b;
+  EXPECT_EQ(arq_init(&a.arq, &loop, ab[0], TP_ADDRESS_MASTER, window, collect,
+                     &a),
+            0);
+  EXPECT_EQ(
+      arq_init(&b.arq, &loop, ba[0], TP_ADDRESS_SLAVE, window, collect, &b), 0);
+  /* b follows by the TP_CONTROL_SYNC of a */
+  a.arq.base = a.arq.next = first;
+  for (event_source_t *p_source : {&to_b.source, &to_a.source})
+    EXPECT_EQ(event_loop_add(&loop, p_source, EPOLLIN), 0);
+  handshake(&loop, &a, &b);
+
+  for (unsigned i = 0; i < number; i++) {
+    frame_t frame = make_frame(i);
+    EXPECT_EQ(arq_send(&a.arq, &frame), 0);
+  }
+  time_t start = time(NULL);
+  while (!arq_idle(&a.arq) && time(NULL) - start < 10)
+    event_loop_run_once(&loop, 10);
+  EXPECT_TRUE(arq_idle(&a.arq));
+
+  EXPECT_EQ(b.frames.size(), number);
+  for (unsigned i = 0; i < b.frames.size(); i++) {
+    frame_t frame = make_frame(i);
+    EXPECT_EQ(b.frames[i].n_frame, (n_frame_t)(first + i));
+    EXPECT_EQ(b.frames[i].n_file, frame.n_file);
+    EXPECT_EQ(b.frames[i].data_len, frame.data_len);
+    EXPECT_EQ(memcmp(b.frames[i].data, frame.data, frame.data_len), 0);
+  }
+  /* acknowledgements are not passed on */
+  EXPECT_TRUE(a.frames.empty());
+  EXPECT_EQ(a.arq.sent, number);
+  /* frames sent together go by one write */
+  if (window > 1 && period == 0 && delay == 0) {
+    EXPECT_LT(a.arq.output.writes, number / 2);
+  }
+  if (period == 0) {
+    EXPECT_EQ(b.arq.duplicates, 0u);
+  }
+  if (p_srtt)
+    *p_srtt = a.arq.srtt;
+  unsigned long retransmitted = a.arq.retransmitted;
+  for (relay *p_relay : {&to_b, &to_a})
+    event_timer_close(&loop, &p_relay->timer);
+  arq_close(&a.arq, &loop);
+  arq_close(&b.arq, &loop);
+  for (int fd : {ab[0], ab[1], ba[0], ba[1]})
+    close(fd);
+  event_loop_close(&loop);
+  return retransmitted;
+}
+
+TEST(arq, clean) {
+  EXPECT_EQ(transfer(ARQ_WINDOW, 0, 0, 300), 0u);
+  EXPECT_EQ(transfer(1, 0, 0, 50), 0u);
+}
+
+/* n_frame wraps around */
+TEST(arq, wrap) { EXPECT_EQ(transfer(ARQ_WINDOW_MAX, 0, 65500, 300), 0u); }
+
+/* broken frames and acknowledgements are sent again */
+TEST(arq, corruption) {
+  EXPECT_GT(transfer(ARQ_WINDOW, 5000, 65000, 300), 0u);
+  EXPECT_GT(transfer(1, 3000, 0, 30), 0u);
+  EXPECT_GT(transfer(ARQ_WINDOW_MAX, 20000, 0, 500), 0u);
+}
+
+/* the timeout follows a slow link, and nothing is sent again for nothing */
+TEST(arq, round_trip_time) {
+  double srtt;
+  EXPECT_EQ(transfer(ARQ_WINDOW, 0, 0, 100, 50, &srtt), 0u);
+  EXPECT_GE(srtt, 100);
+  EXPECT_LT(srtt, 200);
+  EXPECT_GT(transfer(ARQ_WINDOW, 20000, 0, 200, 50), 0u);
+}
+
+/* either end may restart, and the other follows its new session */
+TEST(arq, restart) {
+  for (int restarted = 0; restarted < 2; restarted++) {
+    event_loop_t loop;
+    ASSERT_EQ(event_loop_init(&loop), 0);
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    end ends[2];
+    for (int i = 0; i < 2; i++)
+      ASSERT_EQ(arq_init(&ends[i].arq, &loop, fds[i], TP_ADDRESS_MASTER,
+                         ARQ_WINDOW, collect, &ends[i]),
+                0);
+    for (int round = 0; round < 2; round++) {
+      if (round) {
+        end *p_end = &ends[restarted];
+        arq_close(&p_end->arq, &loop);
+        p_end->frames.clear();
+        ASSERT_EQ(arq_init(&p_end->arq, &loop, fds[restarted],
+                           TP_ADDRESS_MASTER, ARQ_WINDOW, collect, p_end),
+                  0);
+      }
+      /* frames go before the other end knows the session */
+      for (unsigned i = 0; i < 40; i++)
+        for (end &e : ends) {
+          frame_t frame = make_frame(i);
+          EXPECT_EQ(arq_send(&e.arq, &frame), 0);
+        }
+      time_t start = time(NULL);
+      while (!(arq_idle(&ends[0].arq) && arq_idle(&ends[1].arq)) &&
+             time(NULL) - start < 10)
+        event_loop_run_once(&loop, 10);
+      for (int i = 0; i < 2; i++) {
+        const end &other = ends[1 - i];
+        ASSERT_TRUE(arq_idle(&ends[i].arq));
+        EXPECT_EQ(ends[i].arq.peer, other.arq.session);
+        /* a restarted end may get the last frames before it again */
+        ASSERT_GE(ends[i].frames.size(),
+                  i == restarted ? 40u : (round + 1) * 40u);
+        size_t offset = ends[i].frames.size() - 40;
+        for (unsigned j = 0; j < 40; j++) {
+          const frame_t &frame = ends[i].frames[offset + j];
+          EXPECT_EQ(frame.n_frame, (n_frame_t)(other.arq.next - 40 + j));
+          EXPECT_EQ(frame.data_len, make_frame(j).data_len);
+        }
+      }
+    }
+    EXPECT_EQ(ends[1 - restarted].arq.sessions, 2u);
+    for (end &e : ends)
+      arq_close(&e.arq, &loop);
+    close(fds[0]);
+    close(fds[1]);
+    event_loop_close(&loop);
+  }
+}
+
+/* the timeout doubles while nothing is acknowledged */
+TEST(arq, backoff) {
+  event_loop_t loop;
+  ASSERT_EQ(event_loop_init(&loop), 0);
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+  end a;
+  ASSERT_EQ(
+      arq_init(&a.arq, &loop, fds[0], TP_ADDRESS_MASTER, 1, collect, &a), 0);
+  a.arq.rto = ARQ_RTO_MIN;
+  frame_t frame = make_frame(1);
+  ASSERT_EQ(arq_send(&a.arq, &frame), 0);
+  double start = now();
+  while (now() - start < ARQ_RTO_MIN * 6.5)
+    event_loop_run_once(&loop, 10);
+  /* at 1, 3 and 7 times ARQ_RTO_MIN */
+  EXPECT_EQ(a.arq.retransmitted, 2u);
+  EXPECT_EQ(a.arq.rto, ARQ_RTO_MIN * 4);
+  arq_close(&a.arq, &loop);
+  close(fds[0]);
+  close(fds[1]);
+  event_loop_close(&loop);
+}
+
+static int is_odd(void *arg, const frame_t *p_frame) {
+  (void)arg;
+  return p_frame->n_file % 2;
+}
+
+/* frames waiting for the window can be dropped, the others go in order */
+TEST(arq, cancel) {
+  event_loop_t loop;
+  ASSERT_EQ(event_loop_init(&loop), 0);
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+  end a, b;
+  ASSERT_EQ(
+      arq_init(&a.arq, &loop, fds[0], TP_ADDRESS_MASTER, 4, collect, &a), 0);
+  ASSERT_EQ(
+      arq_init(&b.arq, &loop, fds[1], TP_ADDRESS_SLAVE, 4, collect, &b), 0);
+  handshake(&loop, &a, &b);
+  for (unsigned i = 0; i < 600; i++) {
+    frame_t frame = make_frame(i);
+    ASSERT_EQ(arq_send(&a.arq, &frame), 0);
+  }
+  /* the first 4 frames are on the way, all of them have n_file 0 */
+  EXPECT_EQ(arq_cancel(&a.arq, is_odd, NULL), 300u);
+  EXPECT_EQ(arq_cancel(&a.arq, is_odd, NULL), 0u);
+  time_t start = time(NULL);
+  while (!arq_idle(&a.arq) && time(NULL) - start < 10)
+    event_loop_run_once(&loop, 10);
+  ASSERT_EQ(b.frames.size(), 300u);
+  for (unsigned i = 0; i < b.frames.size(); i++) {
+    frame_t frame = make_frame(i / 100 * 200 + i % 100);
+    EXPECT_EQ(b.frames[i].n_frame, (n_frame_t)i);
+    EXPECT_EQ(b.frames[i].n_file, frame.n_file);
+    EXPECT_EQ(b.frames[i].data_len, frame.data_len);
+  }
+  arq_close(&a.arq, &loop);
+  arq_close(&b.arq, &loop);
+  close(fds[0]);
+  close(fds[1]);
+  event_loop_close(&loop);
+}
@@ -0,0 +1,116 @@
+#include "../src/coding.h"
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static std::vector<int16_t> laplacian(size_t n, double scale) {
+  std::vector<int16_t> coefficients(n);
+  srand(0);
+  for (size_t i = 0; i < n; i++) {
+    double u = (rand() + 0.5) / (RAND_MAX + 1.0) - 0.5;
+    coefficients[i] =
+        (int16_t)lround(-scale * copysign(log(1 - 2 * fabs(u)), u));
+  }
+  return coefficients;
+}
+
+TEST(coding, gmm_fit) {
+  std::vector<int16_t> coefficients = laplacian(10000, 4);
+  gmm_t gmm;
+  gmm_fit(coefficients.data(), coefficients.size(), &gmm);
+  float prob = 0;
+  for (int k = 0; k < GMM_NUMBER; k++) {
+    EXPECT_GT(gmm.std[k], 0);
+    prob += gmm.prob[k];
+  }
+  EXPECT_NEAR(prob, 1, 1e-3);
+  EXPECT_LE(gmm.low_bound, gmm.high_bound);
+}
+
+TEST(coding, encode_decode) {
+  std::vector<int16_t> coefficients = laplacian(100000, 8);
+  coefficients[0] = INT16_MIN;
+  coefficients[1] = INT16_MAX;
+  gmm_t gmm;
+  gmm_fit(coefficients.data(), coefficients.size(), &gmm);
+  size_t size;
+  uint8_t *bit_stream =
+      encode(coefficients.data(), coefficients.size(), &gmm, &size);
+  ASSERT_NE(bit_stream, nullptr);
+  EXPECT_LT(size, coefficients.size() * sizeof(int16_t));
+  std::vector<int16_t> result(coefficients.size());
+  EXPECT_EQ(decode(bit_stream, size, &gmm, result.data(), result.size()), 0);
+  EXPECT_EQ(result, coefficients);
+  free(bit_stream);
+}
+
+TEST(coding, constant) {
+  std::vector<int16_t> coefficients(1000, -3);
+  gmm_t gmm;
+  gmm_fit(coefficients.data(), coefficients.size(), &gmm);
+  size_t size;
+  uint8_t *bit_stream =
+      encode(coefficients.data(), coefficients.size(), &gmm, &size);
+  ASSERT_NE(bit_stream, nullptr);
+  std::vector<int16_t> result(coefficients.size());
+  EXPECT_EQ(decode(bit_stream, size, &gmm, result.data(), result.size()), 0);
+  EXPECT_EQ(result, coefficients);
+  free(bit_stream);
+}
+
+TEST(coding, quantize) {
+  std::vector<int16_t> coefficients = {0, 1, 2, -2, 5, -6, INT16_MAX};
+  quantize(coefficients.data(), coefficients.size(), 4);
+  EXPECT_EQ(coefficients, std::vector<int16_t>({0, 0, 1, -1, 1, -2, 8192}));
+  dequantize(coefficients.data(), coefficients.size(), 4);
+  EXPECT_EQ(coefficients,
+            std::vector<int16_t>({0, 0, 4, -4, 4, -8, INT16_MAX}));
+}
+
+TEST(coding, estimate_bits) {
+  std::vector<int16_t> coefficients = laplacian(100000, 8);
+  histogram_t histogram;
+  ASSERT_EQ(
+      histogram_init(&histogram, coefficients.data(), coefficients.size()), 0);
+  double last_bits = INFINITY;
+  for (unsigned step = 1; step <= 16; step *= 2) {
+    double bits = estimate_bits(&histogram, step);
+    EXPECT_LT(bits, last_bits);
+    last_bits = bits;
+    std::vector<int16_t> quantized = coefficients;
+    quantize(quantized.data(), quantized.size(), step);
+    gmm_t gmm;
+    gmm_fit(quantized.data(), quantized.size(), &gmm);
+    size_t size;
+    uint8_t *bit_stream =
+        encode(quantized.data(), quantized.size(), &gmm, &size);
+    ASSERT_NE(bit_stream, nullptr);
+    EXPECT_NEAR(bits / 8, size, size * 0.1);
+    free(bit_stream);
+  }
+  histogram_free(&histogram);
+}
+
+TEST(coding, rdoq) {
+  const unsigned step = 4;
+  std::vector<int16_t> coefficients = laplacian(100000, 8);
+  std::vector<int16_t> levels = coefficients;
+  quantize(levels.data(), levels.size(), step);
+  gmm_t gmm;
+  gmm_fit(levels.data(), levels.size(), &gmm);
+  size_t size;
+  uint8_t *bit_stream = encode(levels.data(), levels.size(), &gmm, &size);
+  ASSERT_NE(bit_stream, nullptr);
+  free(bit_stream);
+
+  rdoq(levels.data(), coefficients.data(), levels.size(), step, &gmm);
+  for (size_t i = 0; i < levels.size(); i++)
+    EXPECT_LT(abs(coefficients[i] - levels[i] * (int)step), 1.5 * step);
+  gmm_fit(levels.data(), levels.size(), &gmm);
+  size_t rdoq_size;
+  bit_stream = encode(levels.data(), levels.size(), &gmm, &rdoq_size);
+  ASSERT_NE(bit_stream, nullptr);
+  EXPECT_LT(rdoq_size, size);
+  free(bit_stream);
+}
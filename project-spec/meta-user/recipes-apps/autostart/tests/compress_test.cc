@@ -0,0 +1,244 @@
+#include "../src/compress.h"
+#include "../src/decompress.h"
+#include "../src/subband.h"
+#include "../src/wavelet.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * sky with a gradient, noise and stars, and a bright moving body. If noisy,
+ * the noise changes in every frame and the sky brightens by a level a frame.
+ */
+static std::vector<uint8_t> scene(unsigned frame, int noisy = 0) {
+  std::vector<uint8_t> image(IMAGE_SIZE);
+  unsigned seed = noisy ? frame + 1 : 0;
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    unsigned width = channel_width(IMAGE_WIDTH, channel);
+    uint8_t *plane =
+        image.data() + channel_offset(IMAGE_WIDTH, IMAGE_HEIGHT, channel);
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y++)
+      for (unsigned x = 0; x < width; x++)
+        plane[y * width + x] =
+            channel == CHANNEL_Y
+                ? 20 + x / 16 + y / 16 + rand_r(&seed) % 3 + noisy * frame
+                : 128;
+  }
+  srand(0);
+  for (unsigned star = 0; star < 40; star++)
+    image[rand() % (IMAGE_HEIGHT * IMAGE_WIDTH)] = 200 + rand() % 56;
+  for (unsigned y = 48; y < 72; y++)
+    for (unsigned x = 16 + 40 * frame; x < 40 + 40 * frame; x++)
+      image[y * IMAGE_WIDTH + x] = 240;
+  return image;
+}
+
+/* compress a frame of the scene into a file, 0 or -1 */
+static int compress_scene(unsigned frame, const compress_opt_t *p_opt,
+                          const char *output, int noisy = 0) {
+  char input[] = "/tmp/compress_testXXXXXX";
+  int fd = mkstemp(input);
+  EXPECT_NE(fd, -1);
+  std::vector<uint8_t> image = scene(frame, noisy);
+  EXPECT_EQ(write(fd, image.data(), image.size()), (ssize_t)image.size());
+  close(fd);
+  int status = compress(input, output, p_opt);
+  unlink(input);
+  return status;
+}
+
+/*
+ * 100 times the mean absolute error of the samples of all channels in a tile,
+ * like roi_detect_changes(), and the largest error of a sample
+ */
+static unsigned tile_error(const uint8_t *image, const uint8_t *decoded,
+                           unsigned x, unsigned y, unsigned *p_error) {
+  unsigned tile = 1 << ROI_TILE_SHIFT, sum = 0, n = 0;
+  *p_error = 0;
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    unsigned width = channel_width(IMAGE_WIDTH, channel);
+    unsigned shift = channel != CHANNEL_Y;
+    size_t offset = channel_offset(IMAGE_WIDTH, IMAGE_HEIGHT, channel);
+    for (unsigned j = y; j < y + tile; j++)
+      for (unsigned i = x >> shift; i < (x + tile) >> shift; i++) {
+        size_t k = offset + (size_t)j * width + i;
+        unsigned e = abs(image[k] - decoded[k]);
+        sum += e;
+        n++;
+        *p_error = e > *p_error ? e : *p_error;
+      }
+  }
+  return 100 * sum / n;
+}
+
+/* decompress a compressed image of a sequence like the decoder, 0 or -1 */
+static int decompress_scene(compressed_t *p_compressed, const char *name,
+                            sequence_t *p_sequence) {
+  if (decompress_open(p_compressed, name) == -1)
+    p_compressed->status = -1;
+  decompress_batch(p_compressed, 1, 4);
+  decompress_sequence(p_compressed, 1, p_sequence);
+  decompress_reconstruct(p_compressed, 1, IMAGE_CHANNELS, YUV_PLANAR);
+  return p_compressed->status;
+}
+
+/* samples of a channel of an image */
+static std::vector<int16_t> channel_samples(const std::vector<uint8_t> &image,
+                                            unsigned channel) {
+  size_t offset = channel_offset(IMAGE_WIDTH, IMAGE_HEIGHT, channel);
+  size_t n = (size_t)channel_width(IMAGE_WIDTH, channel) *
+             channel_height(IMAGE_HEIGHT, channel);
+  return std::vector<int16_t>(image.begin() + offset,
+                              image.begin() + offset + n);
+}
+
+/*
+ * a key image and delta images under a budget: the compressed images are in
+ * the budget and every coefficient is within half the largest step of its
+ * subband since the key image, as unchanged tiles are copied from the images
+ * before
+ */
+TEST(compress, budget) {
+  static reference_t reference;
+  compress_opt_t opt = {};
+  opt.progressive = 1;
+  opt.background_step = 1;
+  opt.p_reference = &reference;
+  opt.key_interval = 16;
+  opt.quality = 1;
+  opt.budget = 6000;
+  char output[] = "/tmp/compress_testXXXXXX";
+  close(mkstemp(output));
+  sequence_t sequence = {};
+  unsigned steps[IMAGE_CHANNELS][SUBBAND_NUMBER] = {};
+  for (unsigned frame = 0; frame < 3; frame++) {
+    ASSERT_EQ(compress_scene(frame, &opt, output), 0) << frame;
+    struct stat file_stat;
+    ASSERT_EQ(stat(output, &file_stat), 0);
+    EXPECT_LE((size_t)file_stat.st_size, opt.budget) << frame;
+    compressed_t compressed;
+    ASSERT_EQ(decompress_scene(&compressed, output, &sequence), 0) << frame;
+    const container_t *p_container = &compressed.container;
+    EXPECT_EQ(!!(p_container->header.flags & CONTAINER_FLAG_DELTA),
+              frame != 0)
+        << frame;
+    unsigned step_max = 0;
+    for (unsigned i = 0; i < p_container->header.entry_number; i++) {
+      const container_entry_t *p_entry = &p_container->entries[i];
+      unsigned *p_step = &steps[p_entry->channel][p_entry->subband];
+      *p_step = p_entry->step > *p_step ? p_entry->step : *p_step;
+      step_max = p_entry->step > step_max ? p_entry->step : step_max;
+    }
+    std::vector<uint8_t> image = scene(frame);
+    for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+      unsigned width = channel_width(IMAGE_WIDTH, channel);
+      unsigned height = channel_height(IMAGE_HEIGHT, channel);
+      std::vector<int16_t> samples = channel_samples(image, channel);
+      std::vector<int16_t> expected(samples.size());
+      ASSERT_EQ(wavelet_forward(expected.data(), samples.data(), width,
+                                height, SUBBAND_PICTURE),
+                0);
+      subband_t subbands[SUBBAND_NUMBER];
+      subband_table(subbands, width, height, SUBBAND_PICTURE);
+      for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+        subband_view_t view =
+            subband_view(compressed.planes[channel], &subbands[subband]);
+        subband_view_t expected_view =
+            subband_view(expected.data(), &subbands[subband]);
+        int bound = steps[channel][subband] / 2;
+        for (unsigned row = 0; row < view.height; row++)
+          for (unsigned x = 0; x < view.width; x++)
+            EXPECT_LE(abs(subband_row(&view, row)[x] -
+                          subband_row(&expected_view, row)[x]),
+                      bound)
+                << frame << " " << channel << " " << subband;
+      }
+    }
+    /* the budget is below the lossless size */
+    EXPECT_GT(step_max, 1u) << frame;
+    decompress_close(&compressed);
+  }
+  sequence_free(&sequence);
+  reference_free(&reference);
+  unlink(output);
+}
+
+/*
+ * a sequence in a budget of lossless images: delta images decode against the
+ * image before them and reconstruct to the pixels
+ */
+TEST(compress, lossless) {
+  static reference_t reference;
+  compress_opt_t opt = {};
+  opt.progressive = 1;
+  opt.background_step = 1;
+  opt.p_reference = &reference;
+  opt.key_interval = 16;
+  opt.quality = 1;
+  opt.budget = 1 << 20;
+  char output[] = "/tmp/compress_testXXXXXX";
+  close(mkstemp(output));
+  sequence_t sequence = {};
+  for (unsigned frame = 0; frame < 3; frame++) {
+    ASSERT_EQ(compress_scene(frame, &opt, output), 0) << frame;
+    compressed_t compressed;
+    ASSERT_EQ(decompress_scene(&compressed, output, &sequence), 0) << frame;
+    EXPECT_EQ(!!(compressed.container.header.flags & CONTAINER_FLAG_DELTA),
+              frame != 0)
+        << frame;
+    std::vector<uint8_t> image = scene(frame);
+    EXPECT_EQ(memcmp(compressed.image, image.data(), image.size()), 0)
+        << frame;
+    decompress_close(&compressed);
+  }
+  sequence_free(&sequence);
+  reference_free(&reference);
+  unlink(output);
+}
+
+/*
+ * a lossy sequence whose small changes are not coded: the error is bounded as
+ * in compress.h and does not grow while the sky drifts below the threshold
+ */
+TEST(compress, threshold) {
+  static reference_t reference;
+  compress_opt_t opt = {};
+  opt.progressive = 1;
+  opt.background_step = 1;
+  opt.p_reference = &reference;
+  opt.key_interval = 16;
+  opt.quality = 1;
+  opt.change_threshold = 2;
+  char output[] = "/tmp/compress_testXXXXXX";
+  close(mkstemp(output));
+  sequence_t sequence = {};
+  unsigned tile = 1 << ROI_TILE_SHIFT;
+  for (unsigned frame = 0; frame < 10; frame++) {
+    ASSERT_EQ(compress_scene(frame, &opt, output, 1), 0) << frame;
+    compressed_t compressed;
+    ASSERT_EQ(decompress_scene(&compressed, output, &sequence), 0) << frame;
+    const roi_t *p_roi = &compressed.container.roi;
+    /* the moving body is coded, the sky around it is not */
+    if (frame != 0)
+      EXPECT_GT(roi_count(p_roi, ROI_UNCHANGED), 0u) << frame;
+    std::vector<uint8_t> image = scene(frame, 1);
+    unsigned mean_max = 0, error_max = 0;
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y += tile)
+      for (unsigned x = 0; x < IMAGE_WIDTH; x += tile) {
+        unsigned error;
+        unsigned mean =
+            tile_error(image.data(), compressed.image, x, y, &error);
+        mean_max = mean > mean_max ? mean : mean_max;
+        error_max = error > error_max ? error : error_max;
+      }
+    EXPECT_LE(mean_max, 100 * opt.change_threshold) << frame;
+    EXPECT_LE(error_max, 4 * opt.change_threshold) << frame;
+    decompress_close(&compressed);
+  }
+  sequence_free(&sequence);
+  reference_free(&reference);
+  unlink(output);
+}
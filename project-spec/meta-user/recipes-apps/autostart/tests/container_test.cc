@@ -0,0 +1,193 @@
+#include "../src/container.h"
+#include "../src/crc.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+static std::vector<uint8_t> write(container_header_t *p_header,
+                                  container_entry_t *entries,
+                                  uint8_t *const *substreams,
+                                  const roi_t *p_roi = NULL) {
+  char *data;
+  size_t size;
+  FILE *file = open_memstream(&data, &size);
+  EXPECT_EQ(container_write(file, p_header, entries, substreams, p_roi), 0);
+  fclose(file);
+  std::vector<uint8_t> container(data, data + size);
+  free(data);
+  return container;
+}
+
+class container : public testing::Test {
+protected:
+  container_header_t header = {};
+  container_entry_t entries[2] = {};
+  uint8_t substream0[3] = {1, 2, 3};
+  uint8_t substream1[2] = {4, 5};
+  uint8_t *substreams[2] = {substream0, substream1};
+
+  void SetUp() override {
+    header.width = 64;
+    header.height = 32;
+    header.channels = 3;
+    header.levels = 4;
+    header.subbands = 13;
+    header.layer_number = 2;
+    header.entry_number = 2;
+    entries[0].channel = 0;
+    entries[0].subband = 0;
+    entries[0].size = sizeof(substream0);
+    entries[0].step = 1;
+    entries[0].gmm.low_bound = -3;
+    entries[0].gmm.high_bound = 5;
+    entries[0].gmm.std[1] = 0.5;
+    entries[1].channel = 2;
+    entries[1].subband = 12;
+    entries[1].size = sizeof(substream1);
+    entries[1].step = 2;
+    entries[1].layer = 1;
+  }
+};
+
+TEST_F(container, write_read) {
+  std::vector<uint8_t> data = write(&header, entries, substreams);
+  ASSERT_EQ(data.size(), container_index_size(&header) + 5);
+  EXPECT_EQ(header.payload_size, 5);
+  EXPECT_EQ(entries[1].offset, 3);
+
+  container_t c;
+  ASSERT_EQ(container_read(&c, data.data(), data.size()), 0);
+  EXPECT_EQ(c.header.width, 64);
+  EXPECT_EQ(c.header.height, 32);
+  EXPECT_EQ(c.header.entry_number, 2);
+  const container_entry_t *p_entry = container_find(&c, 0, 0);
+  ASSERT_NE(p_entry, nullptr);
+  EXPECT_EQ(p_entry->gmm.low_bound, -3);
+  EXPECT_EQ(p_entry->gmm.high_bound, 5);
+  EXPECT_EQ(p_entry->gmm.std[1], 0.5);
+  p_entry = container_find(&c, 2, 12);
+  ASSERT_NE(p_entry, nullptr);
+  EXPECT_EQ(p_entry->step, 2);
+  EXPECT_EQ(memcmp(c.payload + p_entry->offset, substream1, 2), 0);
+  EXPECT_EQ(container_find(&c, 1, 0), nullptr);
+  container_free(&c);
+}
+
+TEST_F(container, check_sum) {
+  std::vector<uint8_t> data = write(&header, entries, substreams);
+  data[CONTAINER_HEADER_SIZE + 1] ^= 1;
+  container_t c;
+  EXPECT_EQ(container_read(&c, data.data(), data.size()), -1);
+}
+
+TEST_F(container, truncated) {
+  std::vector<uint8_t> data = write(&header, entries, substreams);
+  container_t c;
+  ASSERT_EQ(container_read(&c, data.data(), data.size() - 1), 0);
+  EXPECT_EQ(c.entries[0].size, 3);
+  EXPECT_EQ(c.entries[1].size, 0);
+  container_free(&c);
+  EXPECT_EQ(container_read(&c, data.data(), CONTAINER_HEADER_SIZE), -1);
+}
+
+/* a newer writer appends fields to header and entries */
+TEST_F(container, forward_compatible) {
+  std::vector<uint8_t> data = write(&header, entries, substreams);
+  const size_t extra = 4;
+  std::vector<uint8_t> newer(data.begin(),
+                             data.begin() + CONTAINER_HEADER_SIZE);
+  newer.insert(newer.end(), extra, 0xAA);
+  for (int i = 0; i < 2; i++) {
+    auto entry = data.begin() + CONTAINER_HEADER_SIZE +
+                 i * CONTAINER_ENTRY_SIZE;
+    newer.insert(newer.end(), entry, entry + CONTAINER_ENTRY_SIZE);
+    newer.insert(newer.end(), extra, 0xBB);
+  }
+  newer.insert(newer.end(), data.end() - 5, data.end());
+  newer[5] = CONTAINER_HEADER_SIZE + extra;
+  newer[6] = CONTAINER_ENTRY_SIZE + extra;
+  newer[28] = newer[29] = 0;
+  uint16_t check_sum = crc16(newer.data(), newer.size() - 5);
+  newer[28] = check_sum;
+  newer[29] = check_sum >> 8;
+
+  container_t c;
+  ASSERT_EQ(container_read(&c, newer.data(), newer.size()), 0);
+  EXPECT_EQ(c.entries[1].channel, 2);
+  EXPECT_EQ(c.entries[1].step, 2);
+  EXPECT_EQ(memcmp(c.payload + c.entries[1].offset, substream1, 2), 0);
+  container_free(&c);
+}
+
+TEST_F(container, layer) {
+  std::vector<uint8_t> data = write(&header, entries, substreams);
+  size_t index_size = container_index_size(&header);
+  EXPECT_EQ(container_peek_index_size(data.data(), CONTAINER_HEADER_SIZE - 1),
+            0);
+  EXPECT_EQ(container_peek_index_size(data.data(), CONTAINER_HEADER_SIZE),
+            index_size);
+
+  /* stop after the first layer */
+  container_t c;
+  ASSERT_EQ(container_read(&c, data.data(), index_size + 3), 0);
+  EXPECT_EQ(c.header.layer_number, 2);
+  EXPECT_EQ(container_layer_end(&c, 0), index_size + 3);
+  EXPECT_EQ(container_layer_end(&c, 1), index_size + 5);
+  EXPECT_EQ(c.entries[0].size, 3);
+  EXPECT_EQ(c.entries[1].size, 0);
+  container_free(&c);
+}
+
+TEST_F(container, roi) {
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, header.width, header.height, 4), 0);
+  roi_rect_t rect = {20, 0, 10, 10};
+  roi_add_rect(&roi, &rect);
+  entries[0].flags = CONTAINER_ENTRY_FOREGROUND;
+  std::vector<uint8_t> data = write(&header, entries, substreams, &roi);
+  EXPECT_EQ(header.roi_shift, 4);
+  EXPECT_EQ(data.size(), container_index_size(&header) + 5);
+  EXPECT_EQ(container_peek_index_size(data.data(), data.size()),
+            container_index_size(&header));
+
+  container_t c;
+  ASSERT_EQ(container_read(&c, data.data(), data.size()), 0);
+  ASSERT_EQ(c.roi.width, 4);
+  ASSERT_EQ(c.roi.height, 2);
+  EXPECT_EQ(std::vector<uint8_t>(c.roi.map, c.roi.map + 8),
+            std::vector<uint8_t>(roi.map, roi.map + 8));
+  EXPECT_EQ(c.entries[0].flags, CONTAINER_ENTRY_FOREGROUND);
+  EXPECT_EQ(memcmp(c.payload + c.entries[1].offset, substream1, 2), 0);
+  container_free(&c);
+  roi_free(&roi);
+}
+
+/* the index may be larger than 64 KiB, but not have too many entries */
+TEST_F(container, entry_max) {
+  header.width = header.height = 1024;
+  header.entry_number = CONTAINER_ENTRY_MAX;
+  std::vector<container_entry_t> many(CONTAINER_ENTRY_MAX);
+  std::vector<uint8_t *> empty(CONTAINER_ENTRY_MAX, substream0);
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, header.width, header.height, 1), 0);
+  std::vector<uint8_t> data = write(&header, many.data(), empty.data(), &roi);
+  ASSERT_GT(container_index_size(&header), UINT16_MAX);
+  ASSERT_EQ(data.size(), container_index_size(&header));
+  container_t c;
+  ASSERT_EQ(container_read(&c, data.data(), data.size()), 0);
+  EXPECT_EQ(c.header.entry_number, CONTAINER_ENTRY_MAX);
+  container_free(&c);
+
+  /* a reader refuses what a writer refuses */
+  data.insert(data.begin() + CONTAINER_HEADER_SIZE, CONTAINER_ENTRY_SIZE, 0);
+  data[22] = (CONTAINER_ENTRY_MAX + 1) & 0xFF;
+  data[23] = (CONTAINER_ENTRY_MAX + 1) >> 8;
+  EXPECT_EQ(container_read(&c, data.data(), data.size()), -1);
+  header.entry_number = CONTAINER_ENTRY_MAX + 1;
+  many.resize(CONTAINER_ENTRY_MAX + 1);
+  FILE *file = tmpfile();
+  EXPECT_EQ(container_write(file, &header, many.data(), empty.data(), &roi),
+            -1);
+  fclose(file);
+  roi_free(&roi);
+}
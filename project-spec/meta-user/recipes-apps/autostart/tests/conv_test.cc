@@ -0,0 +1,74 @@
+#include "../src/conv.h"
+#include "../src/simd.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+/* one tap after another with wrapping sums */
+static void reference(std::vector<int32_t> &sums, const int16_t *const *rows0,
+                      const int16_t *const *rows1, const int16_t *weights0,
+                      const int16_t *weights1, int kh, int kw) {
+  int width = sums.size();
+  for (int x = 0; x < width; x++) {
+    uint32_t sum = sums[x];
+    for (int ky = 0; ky < kh; ky++)
+      for (int kx = 0; kx < kw; kx++) {
+        int column = x + kx - kw / 2;
+        if (rows0[ky] == NULL || column < 0 || column >= width)
+          continue;
+        sum += (uint32_t)(weights0[ky * kw + kx] * rows0[ky][column]);
+        if (rows1)
+          sum += (uint32_t)(weights1[ky * kw + kx] * rows1[ky][column]);
+      }
+    sums[x] = sum;
+  }
+}
+
+TEST(conv, shapes) {
+  const struct {
+    conv_t conv;
+    int kh;
+    int kw;
+  } shapes[] = {{conv_3x3, 3, 3}, {conv_3x1, 3, 1}, {conv_1x1, 1, 1}};
+  srand(0);
+  int former = simd_force(SIMD_SCALAR);
+  for (auto shape : shapes)
+    for (unsigned width : {1u, 2u, 7u, 8u, 9u, 17u, 33u, 100u})
+      for (int missing = 0; missing < 3; missing++) {
+        std::vector<int16_t> planes(6 * width);
+        for (auto &value : planes)
+          value = rand();
+        /* the largest products wrap */
+        planes[0] = INT16_MIN;
+        int16_t weights[18];
+        for (auto &weight : weights)
+          weight = rand();
+        weights[0] = weights[9] = INT16_MIN;
+        const int16_t *rows0[3], *rows1[3];
+        for (int ky = 0; ky < 3; ky++) {
+          rows0[ky] = planes.data() + ky * width;
+          rows1[ky] = planes.data() + (3 + ky) * width;
+        }
+        /* the first row is out of the picture, or there is no second input */
+        if (missing == 1 && shape.kh == 3)
+          rows0[0] = rows1[0] = NULL;
+        const int16_t *const *p_rows1 = missing == 2 ? NULL : rows1;
+        std::vector<int32_t> initial(width);
+        for (auto &sum : initial)
+          sum = rand() - RAND_MAX / 2;
+        std::vector<int32_t> expected = initial;
+        reference(expected, rows0, p_rows1, weights, weights + 9, shape.kh,
+                  shape.kw);
+        for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+          simd_force(level);
+          std::vector<int32_t> sums = initial;
+          shape.conv(sums.data(), rows0, p_rows1, weights, weights + 9,
+                     width);
+          EXPECT_EQ(sums, expected) << shape.kh << "x" << shape.kw << " "
+                                    << width << " " << missing << " "
+                                    << simd_name(level);
+        }
+        simd_force(SIMD_SCALAR);
+      }
+  simd_force(former);
+}
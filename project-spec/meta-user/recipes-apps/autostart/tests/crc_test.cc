@@ -0,0 +1,62 @@
+#include "../src/crc.h"
+#include "../src/simd.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+/* bit by bit */
+static uint16_t reference(const uint8_t *buffer, size_t size) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= buffer[i];
+    for (int bit = 0; bit < 8; bit++)
+      crc = crc & 1 ? crc >> 1 ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+TEST(crc, check) {
+  const char check[] = "123456789";
+  EXPECT_EQ(crc16((const uint8_t *)check, sizeof(check) - 1), 0x4B37);
+  EXPECT_EQ(crc16(NULL, 0), 0xFFFF);
+}
+
+/* every size around the slices, in one call and in two pieces */
+TEST(crc, pieces) {
+  std::vector<uint8_t> buffer(100);
+  srand(0);
+  for (auto &byte : buffer)
+    byte = rand();
+  for (size_t size = 0; size <= buffer.size(); size++) {
+    uint16_t expected = reference(buffer.data(), size);
+    EXPECT_EQ(crc16(buffer.data(), size), expected) << size;
+    for (size_t split = 0; split <= size; split += 3) {
+      uint16_t crc = crc16_update(crc16_init(), buffer.data(), split);
+      crc = crc16_update(crc, buffer.data() + split, size - split);
+      EXPECT_EQ(crc16_final(crc), expected) << size << " " << split;
+    }
+  }
+}
+
+/* every level, with and without folding, in one call and in two pieces */
+TEST(crc, levels) {
+  std::vector<uint8_t> buffer(1000);
+  srand(1);
+  for (auto &byte : buffer)
+    byte = rand();
+  int former = simd_force(SIMD_SCALAR);
+  for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+    simd_force(level);
+    for (size_t size = 0; size <= buffer.size(); size += 7) {
+      uint16_t expected = reference(buffer.data(), size);
+      EXPECT_EQ(crc16(buffer.data(), size), expected)
+          << simd_name(level) << " " << size;
+      size_t split = size / 3;
+      uint16_t crc = crc16_update(crc16_init(), buffer.data(), split);
+      crc = crc16_update(crc, buffer.data() + split, size - split);
+      EXPECT_EQ(crc16_final(crc), expected)
+          << simd_name(level) << " " << size << " " << split;
+    }
+  }
+  simd_force(former);
+}
@@ -0,0 +1,154 @@
+#include "../src/engine.h"
+#include "../src/preprocess.h"
+#include <endian.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+/* a blob of layers with weights[output][input][y][x] */
+class networks : public testing::Test {
+protected:
+  std::vector<weights_layer_t> layers;
+  std::vector<std::vector<int16_t>> weights;
+  std::vector<uint8_t> blob;
+  weights_t parsed = {};
+
+  void add(uint8_t network, uint8_t kernel, uint16_t inputs, uint16_t outputs,
+           std::vector<int16_t> values = {}) {
+    weights_layer_t layer = {network, kernel, kernel, inputs, outputs, 0, 0};
+    if (values.empty()) {
+      values.resize((size_t)kernel * kernel * inputs * outputs);
+      for (auto &value : values)
+        value = rand() % 129 - 64;
+    }
+    layers.push_back(layer);
+    weights.push_back(values);
+  }
+
+  const weights_t *read() {
+    std::vector<std::vector<uint16_t>> packed;
+    std::vector<const uint16_t *> pointers;
+    for (size_t i = 0; i < layers.size(); i++) {
+      packed.emplace_back(weights_packed_number(&layers[i]));
+      weights_pack(packed.back().data(), weights[i].data(), &layers[i]);
+    }
+    for (auto &p : packed)
+      pointers.push_back(p.data());
+    char *data;
+    size_t size;
+    FILE *file = open_memstream(&data, &size);
+    EXPECT_EQ(weights_write(file, layers.data(), layers.size(),
+                            pointers.data()),
+              0);
+    fclose(file);
+    blob.assign(data, data + size);
+    free(data);
+    EXPECT_EQ(weights_read(&parsed, blob.data(), blob.size()), 0);
+    return &parsed;
+  }
+
+  void TearDown() override { free(parsed.layers); }
+};
+
+static std::vector<uint16_t> picture(const std::vector<uint8_t> &pixels,
+                                     unsigned width, unsigned height) {
+  std::vector<uint16_t> picture(preprocess_size(width, height));
+  preprocess(picture.data(), pixels.data(), width, height);
+  return picture;
+}
+
+TEST(engine, constant) {
+  const unsigned width = 40, height = 24;
+  engine_t engine;
+  ASSERT_EQ(engine_init(&engine, NULL, 2), 0);
+  EXPECT_EQ(engine_entropy_number(&engine), 0u);
+  std::vector<uint8_t> pixels(width * height, 77);
+  std::vector<int16_t> trans(width * height);
+  ASSERT_EQ(engine_run(&engine, trans.data(), NULL,
+                       picture(pixels, width, height).data(), width, height),
+            0);
+  /* LL4 keeps the pixels and detail subbands are 0 */
+  size_t low = (size_t)((width + 15) / 16) * ((height + 15) / 16);
+  for (size_t i = 0; i < trans.size(); i++)
+    EXPECT_EQ(trans[i], i < low ? 77 : 0) << i;
+  engine_free(&engine);
+}
+
+/* LL4, HL1, LH1, HH1 of a 2 x 2 channel by the 5/3 lifting */
+TEST(engine, linear) {
+  engine_t engine;
+  ASSERT_EQ(engine_init(&engine, NULL, 1), 0);
+  std::vector<uint8_t> pixels = {10, 20, 30, 60};
+  std::vector<int16_t> trans(4);
+  ASSERT_EQ(
+      engine_run(&engine, trans.data(), NULL, picture(pixels, 2, 2).data(), 2,
+                 2),
+      0);
+  EXPECT_EQ(trans, std::vector<int16_t>({30, 20, 30, 20}));
+  engine_free(&engine);
+}
+
+/* P is identity and U is 0 */
+TEST_F(networks, lifting) {
+  std::vector<int16_t> identity(9), zero(9);
+  identity[4] = 1 << ENGINE_SHIFT;
+  add(WEIGHTS_TRANSFORM, 3, 1, 1, identity);
+  add(WEIGHTS_TRANSFORM, 3, 1, 1, zero);
+  engine_t engine;
+  ASSERT_EQ(engine_init(&engine, read(), 1), 0);
+  std::vector<uint8_t> pixels = {10, 20, 30, 60};
+  std::vector<int16_t> trans(4);
+  ASSERT_EQ(
+      engine_run(&engine, trans.data(), NULL, picture(pixels, 2, 2).data(), 2,
+                 2),
+      0);
+  EXPECT_EQ(trans, std::vector<int16_t>({15, 0, 10, 0}));
+  engine_free(&engine);
+}
+
+/* threads give the bits of one thread */
+TEST_F(networks, threads) {
+  const unsigned width = 75, height = 83;
+  srand(0);
+  add(WEIGHTS_TRANSFORM, 3, 1, 4);
+  add(WEIGHTS_TRANSFORM, 3, 4, 1);
+  add(WEIGHTS_TRANSFORM, 3, 1, 3);
+  add(WEIGHTS_TRANSFORM, 3, 3, 1);
+  add(WEIGHTS_ENTROPY, 3, 1, 5);
+  add(WEIGHTS_ENTROPY, 3, 5, 4);
+  add(WEIGHTS_ENTROPY, 1, 4, 9);
+  const weights_t *p_weights = read();
+  std::vector<uint8_t> pixels(width * height);
+  for (auto &pixel : pixels)
+    pixel = rand();
+  std::vector<uint16_t> input = picture(pixels, width, height);
+
+  std::vector<int16_t> trans[2], entropy[2];
+  for (unsigned i = 0; i < 2; i++) {
+    engine_t engine;
+    ASSERT_EQ(engine_init(&engine, p_weights, i ? 7 : 1), 0);
+    ASSERT_EQ(engine_entropy_number(&engine), 9u);
+    trans[i].resize(width * height);
+    entropy[i].resize(9 * width * height);
+    ASSERT_EQ(engine_run(&engine, trans[i].data(), entropy[i].data(),
+                         input.data(), width, height),
+              0);
+    engine_free(&engine);
+  }
+  EXPECT_EQ(trans[1], trans[0]);
+  EXPECT_EQ(entropy[1], entropy[0]);
+}
+
+TEST_F(networks, wrong_chains) {
+  add(WEIGHTS_TRANSFORM, 3, 1, 4);
+  add(WEIGHTS_TRANSFORM, 3, 4, 1);
+  engine_t engine;
+  /* U is missing */
+  EXPECT_EQ(engine_init(&engine, read(), 1), -1);
+  engine_free(&engine);
+  free(parsed.layers);
+  add(WEIGHTS_TRANSFORM, 3, 2, 1);
+  /* 1 output to 2 inputs */
+  EXPECT_EQ(engine_init(&engine, read(), 1), -1);
+  engine_free(&engine);
+}
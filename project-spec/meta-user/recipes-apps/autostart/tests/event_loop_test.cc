@@ -0,0 +1,105 @@
+#include "../src/event_loop.h"
+#include <gtest/gtest.h>
+#include <sys/epoll.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+}
+
+struct counter {
+  event_loop_t *p_loop;
+  uint64_t count;
+  uint64_t stop;
+};
+
+static void count(void *arg, uint64_t n) {
+  counter *p_counter = static_cast<counter *>(arg);
+  p_counter->count += n;
+  if (p_counter->count >= p_counter->stop)
+    event_loop_stop(p_counter->p_loop);
+}
+
+TEST(event_loop, timer) {
+  event_loop_t loop;
+  ASSERT_EQ(event_loop_init(&loop), 0);
+  counter counter = {&loop, 0, 3};
+  event_timer_t timer;
+  ASSERT_EQ(event_timer_init(&loop, &timer, count, &counter), 0);
+  /* a disarmed timer never expires */
+  EXPECT_EQ(event_loop_run_once(&loop, 20), 0);
+  double start = now();
+  ASSERT_EQ(event_timer_set(&timer, 10, 5), 0);
+  ASSERT_EQ(event_loop_run(&loop), 0);
+  EXPECT_GE(counter.count, 3u);
+  EXPECT_GE(now() - start, 19);
+  ASSERT_EQ(event_timer_set(&timer, 0, 0), 0);
+  counter.count = 0;
+  EXPECT_EQ(event_loop_run_once(&loop, 20), 0);
+  EXPECT_EQ(counter.count, 0u);
+  event_timer_close(&loop, &timer);
+  event_loop_close(&loop);
+}
+
+TEST(event_loop, notifier) {
+  event_loop_t loop;
+  ASSERT_EQ(event_loop_init(&loop), 0);
+  counter counter = {&loop, 0, 100};
+  event_notifier_t notifier;
+  ASSERT_EQ(event_notifier_init(&loop, &notifier, count, &counter), 0);
+  std::thread thread([&notifier] {
+    for (int i = 0; i < 100; i++)
+      event_notify(&notifier);
+  });
+  ASSERT_EQ(event_loop_run(&loop), 0);
+  thread.join();
+  EXPECT_EQ(counter.count, 100u);
+  event_notifier_close(&loop, &notifier);
+  event_loop_close(&loop);
+}
+
+struct pipe_state {
+  event_loop_t *p_loop;
+  event_source_t source;
+  uint32_t events;
+  char byte;
+};
+
+static void ready(void *arg, uint32_t events) {
+  pipe_state *p_state = static_cast<pipe_state *>(arg);
+  p_state->events |= events;
+  if (events & EPOLLIN) {
+    EXPECT_EQ(read(p_state->source.fd, &p_state->byte, 1), 1);
+  }
+}
+
+TEST(event_loop, descriptors) {
+  event_loop_t loop;
+  ASSERT_EQ(event_loop_init(&loop), 0);
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  pipe_state reader = {&loop, {fds[0], ready, &reader}, 0, 0};
+  pipe_state writer = {&loop, {fds[1], ready, &writer}, 0, 0};
+  ASSERT_EQ(event_loop_add(&loop, &reader.source, EPOLLIN), 0);
+  ASSERT_EQ(event_loop_add(&loop, &writer.source, 0), 0);
+  EXPECT_EQ(event_loop_run_once(&loop, 0), 0);
+  /* a pipe with room is ready for output once it is watched */
+  ASSERT_EQ(event_loop_modify(&loop, &writer.source, EPOLLOUT), 0);
+  EXPECT_EQ(event_loop_run_once(&loop, 0), 1);
+  EXPECT_TRUE(writer.events & EPOLLOUT);
+  ASSERT_EQ(event_loop_modify(&loop, &writer.source, 0), 0);
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  EXPECT_EQ(event_loop_run_once(&loop, 100), 1);
+  EXPECT_TRUE(reader.events & EPOLLIN);
+  EXPECT_EQ(reader.byte, 'x');
+  EXPECT_EQ(event_loop_remove(&loop, &reader.source), 0);
+  ASSERT_EQ(write(fds[1], "y", 1), 1);
+  EXPECT_EQ(event_loop_run_once(&loop, 0), 0);
+  close(fds[0]);
+  close(fds[1]);
+  event_loop_close(&loop);
+}
@@ -0,0 +1,55 @@
+#include "../src/preprocess.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+/* split rows by parity, then tile, then widen, one step after another */
+static std::vector<uint16_t> reference(const std::vector<uint8_t> &pixels,
+                                       unsigned width, unsigned height) {
+  std::vector<uint16_t> picture;
+  for (unsigned parity = 0; parity < 2; parity++) {
+    std::vector<uint8_t> block;
+    for (unsigned y = parity; y < height; y += 2)
+      block.insert(block.end(), pixels.begin() + y * width,
+                   pixels.begin() + (y + 1) * width);
+    unsigned rows = block.size() / width;
+    for (unsigned y = 0; y < rows; y += PREPROCESS_TILE)
+      for (unsigned x = 0; x < width; x += PREPROCESS_TILE)
+        for (unsigned row = y; row < y + PREPROCESS_TILE; row++)
+          for (unsigned column = x; column < x + PREPROCESS_TILE; column++)
+            picture.push_back(row < rows && column < width
+                                  ? block[row * width + column]
+                                  : 0);
+  }
+  return picture;
+}
+
+TEST(preprocess, layout) {
+  const unsigned shapes[][2] = {{32, 16}, {40, 16}, {37, 21}, {8, 2}, {3, 1}};
+  srand(0);
+  for (auto shape : shapes) {
+    unsigned width = shape[0], height = shape[1];
+    std::vector<uint8_t> pixels(width * height);
+    for (auto &pixel : pixels)
+      pixel = rand();
+    std::vector<uint16_t> expected = reference(pixels, width, height);
+    ASSERT_EQ(preprocess_size(width, height), expected.size());
+    std::vector<uint16_t> picture(expected.size(), 0xFFFF);
+    preprocess(picture.data(), pixels.data(), width, height);
+    EXPECT_EQ(picture, expected) << width << "x" << height;
+  }
+}
+
+TEST(preprocess, little_endian) {
+  uint8_t pixels[PREPROCESS_TILE * 2];
+  for (unsigned i = 0; i < sizeof(pixels); i++)
+    pixels[i] = 0x80 + i;
+  std::vector<uint16_t> picture(preprocess_size(PREPROCESS_TILE, 2));
+  preprocess(picture.data(), pixels, PREPROCESS_TILE, 2);
+  const uint8_t *bytes = (const uint8_t *)picture.data();
+  EXPECT_EQ(bytes[0], 0x80);
+  EXPECT_EQ(bytes[1], 0);
+  /* row 1 is the first line of the second block */
+  EXPECT_EQ(bytes[PREPROCESS_TILE * PREPROCESS_TILE * 2], 0x80 + 8);
+  EXPECT_EQ(bytes[PREPROCESS_TILE * PREPROCESS_TILE * 2 + 1], 0);
+}
@@ -0,0 +1,83 @@
+#include "../src/preprocess.h"
+#include "../src/raw.h"
+#include "../src/yuv.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+#define WIDTH 38
+#define HEIGHT 37
+
+static std::vector<uint8_t> planar_image() {
+  std::vector<uint8_t> image(WIDTH * HEIGHT * 2);
+  srand(0);
+  for (auto &pixel : image)
+    pixel = rand();
+  return image;
+}
+
+/* append in chunks which do not end at rows, and check every picture */
+static void check(const std::vector<uint8_t> &data,
+                  const std::vector<uint8_t> &image, int format) {
+  raw_t raw;
+  ASSERT_EQ(raw_init(&raw, WIDTH, HEIGHT, format), 0);
+  for (size_t i = 0; i < data.size(); i += 7) {
+    EXPECT_FALSE(raw_complete(&raw));
+    size_t size = data.size() - i < 7 ? data.size() - i : 7;
+    ASSERT_EQ(raw_append(&raw, data.data() + i, size), 0);
+  }
+  EXPECT_TRUE(raw_complete(&raw));
+  EXPECT_EQ(std::vector<uint8_t>(raw.image, raw.image + image.size()), image);
+  for (unsigned channel = 0; channel < IMAGE_CHANNELS; channel++) {
+    unsigned width = channel_width(WIDTH, channel);
+    EXPECT_EQ(raw.stripes[channel], preprocess_stripes(HEIGHT));
+    std::vector<uint16_t> expected(preprocess_size(width, HEIGHT));
+    preprocess(expected.data(),
+               image.data() + channel_offset(WIDTH, HEIGHT, channel), width,
+               HEIGHT);
+    EXPECT_EQ(std::vector<uint16_t>(raw.pictures[channel],
+                                    raw.pictures[channel] + expected.size()),
+              expected)
+        << "channel " << channel;
+  }
+  raw_free(&raw);
+}
+
+TEST(raw, planar) {
+  std::vector<uint8_t> image = planar_image();
+  check(image, image, YUV_PLANAR);
+}
+
+TEST(raw, packed) {
+  std::vector<uint8_t> image = planar_image();
+  const uint8_t *y = image.data();
+  const uint8_t *u = y + channel_offset(WIDTH, HEIGHT, CHANNEL_U);
+  const uint8_t *v = y + channel_offset(WIDTH, HEIGHT, CHANNEL_V);
+  std::vector<uint8_t> packed;
+  for (unsigned i = 0; i < WIDTH * HEIGHT / 2; i++)
+    packed.insert(packed.end(), {u[i], y[2 * i], v[i], y[2 * i + 1]});
+  check(packed, image, YUV_UYVY);
+}
+
+TEST(raw, stripes) {
+  std::vector<uint8_t> image = planar_image();
+  raw_t raw;
+  ASSERT_EQ(raw_init(&raw, WIDTH, HEIGHT, YUV_PLANAR), 0);
+  ASSERT_EQ(raw_append(&raw, image.data(), WIDTH * PREPROCESS_STRIPE - 1), 0);
+  EXPECT_EQ(raw.stripes[CHANNEL_Y], 0u);
+  ASSERT_EQ(raw_append(&raw, image.data() + WIDTH * PREPROCESS_STRIPE - 1, 1),
+            0);
+  EXPECT_EQ(raw.stripes[CHANNEL_Y], 1u);
+  EXPECT_EQ(raw.stripes[CHANNEL_U], 0u);
+  raw_free(&raw);
+}
+
+TEST(raw, overflow) {
+  std::vector<uint8_t> image = planar_image();
+  image.push_back(0);
+  raw_t raw;
+  ASSERT_EQ(raw_init(&raw, WIDTH, HEIGHT, YUV_PLANAR), 0);
+  EXPECT_EQ(raw_append(&raw, image.data(), image.size()), -1);
+  EXPECT_EQ(raw.size, 0u);
+  raw_free(&raw);
+}
@@ -0,0 +1,126 @@
+#include "../src/image.h"
+#include "../src/roi.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(roi, add_rect) {
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, 100, 50, 4), 0);
+  EXPECT_EQ(roi.width, 7);
+  EXPECT_EQ(roi.height, 4);
+  roi_rect_t rect = {15, 16, 2, 20};
+  roi_add_rect(&roi, &rect);
+  EXPECT_EQ(roi_count(&roi, ROI_FOREGROUND), 4);
+  EXPECT_EQ(roi.map[1 * 7 + 0], ROI_FOREGROUND);
+  EXPECT_EQ(roi.map[2 * 7 + 1], ROI_FOREGROUND);
+  EXPECT_EQ(roi.map[3 * 7 + 1], ROI_BACKGROUND);
+  roi_free(&roi);
+}
+
+TEST(roi, detect) {
+  const unsigned width = 64, height = 48;
+  std::vector<uint8_t> luma(width * height, 10);
+  /* a bright object in the tile at (2, 1) and a hot pixel */
+  for (unsigned y = 20; y < 28; y++)
+    for (unsigned x = 36; x < 44; x++)
+      luma[y * width + x] = 200;
+  luma[40 * width + 5] = 255;
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, width, height, 4), 0);
+  EXPECT_EQ(roi_detect(&roi, luma.data(), width, height, ROI_CONTRAST), 1);
+  EXPECT_EQ(roi.map[1 * 4 + 2], ROI_FOREGROUND);
+  roi_free(&roi);
+}
+
+TEST(roi, gather_scatter) {
+  const unsigned width = 64, height = 64;
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, width * 2, height, 5), 0);
+  roi_rect_t rect = {32, 0, 32, 32};
+  roi_add_rect(&roi, &rect);
+  for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+    unsigned subband_width, subband_height;
+    subband_shape(width, height, subband, &subband_width, &subband_height);
+    std::vector<int16_t> raster(subband_width * subband_height);
+    for (size_t i = 0; i < raster.size(); i++)
+      raster[i] = i;
+    /* U of a 128 x 64 image */
+    std::vector<int16_t> foreground(raster.size()), background(raster.size());
+    size_t n_foreground =
+        roi_gather(&roi, CHANNEL_U, subband, width, height, ROI_FOREGROUND,
+                   raster.data(), subband_width, foreground.data());
+    size_t n_background =
+        roi_gather(&roi, CHANNEL_U, subband, width, height, ROI_BACKGROUND,
+                   raster.data(), subband_width, background.data());
+    EXPECT_EQ(n_foreground + n_background, raster.size());
+    EXPECT_EQ(n_foreground, raster.size() / 8);
+    EXPECT_EQ(roi_gather(&roi, CHANNEL_U, subband, width, height,
+                         ROI_FOREGROUND, NULL, 0, NULL),
+              n_foreground);
+
+    std::vector<int16_t> result(raster.size());
+    roi_scatter(&roi, CHANNEL_U, subband, width, height, ROI_FOREGROUND,
+                foreground.data(), result.data(), subband_width);
+    roi_scatter(&roi, CHANNEL_U, subband, width, height, ROI_BACKGROUND,
+                background.data(), result.data(), subband_width);
+    EXPECT_EQ(result, raster);
+  }
+  roi_free(&roi);
+}
+
+TEST(roi, detect_changes) {
+  /* 5 x 3 tiles, the last column and row are narrower */
+  const unsigned width = 72, height = 40, size = width * height * 2;
+  std::vector<uint8_t> reference(size), image(size);
+  for (unsigned i = 0; i < size; i++)
+    reference[i] = image[i] = i * 7;
+  /* noise below threshold */
+  image[5] ^= 1;
+  /* a change in V of the tile at (4, 0): chroma columns 32 to 35 */
+  for (unsigned x = 32; x < 36; x++)
+    image[width * height * 3 / 2 + 2 * width / 2 + x] += 100;
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, width, height, 4), 0);
+  roi.map[0] = ROI_FOREGROUND;
+  EXPECT_EQ(roi_detect_changes(&roi, image.data(), reference.data(), width,
+                               height, 1),
+            15 - 4);
+  /* the changed tile and its neighbors are kept */
+  EXPECT_EQ(roi.map[3], ROI_BACKGROUND);
+  EXPECT_EQ(roi.map[4], ROI_BACKGROUND);
+  EXPECT_EQ(roi.map[5 + 3], ROI_BACKGROUND);
+  EXPECT_EQ(roi.map[5 + 4], ROI_BACKGROUND);
+  EXPECT_EQ(roi.map[0], ROI_UNCHANGED);
+  EXPECT_EQ(roi.map[2], ROI_UNCHANGED);
+
+  roi_update_reference(&roi, reference.data(), image.data(), width, height);
+  EXPECT_EQ(reference[5], (uint8_t)(5 * 7));
+  EXPECT_EQ(reference[width * height * 3 / 2 + 2 * width / 2 + 33],
+            image[width * height * 3 / 2 + 2 * width / 2 + 33]);
+  roi_free(&roi);
+}
+
+TEST(roi, apply) {
+  const unsigned width = 32, height = 32;
+  roi_t roi;
+  ASSERT_EQ(roi_init(&roi, width, height, 4), 0);
+  roi.map[1] = ROI_UNCHANGED;
+  std::vector<int16_t> reference(width * height, 3), plane(width * height, 1);
+  for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+    unsigned x, y;
+    subband_position(width, height, subband, &x, &y);
+    size_t offset = y * width + x;
+    roi_apply(&roi, CHANNEL_Y, subband, width, height, ROI_UNCHANGED,
+              reference.data() + offset, plane.data() + offset, width, 0);
+    roi_apply(&roi, CHANNEL_Y, subband, width, height, ROI_BACKGROUND,
+              reference.data() + offset, plane.data() + offset, width, 1);
+  }
+  size_t copied = 0, added = 0;
+  for (int16_t coefficient : plane) {
+    copied += coefficient == 3;
+    added += coefficient == 4;
+  }
+  EXPECT_EQ(copied, width * height / 4);
+  EXPECT_EQ(added, width * height * 3 / 4);
+  roi_free(&roi);
+}
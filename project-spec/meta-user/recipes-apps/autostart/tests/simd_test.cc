@@ -0,0 +1,132 @@
+#include "../src/preprocess.h"
+#include "../src/simd.h"
+#include "../src/stats.h"
+#include "../src/yuv.h"
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+TEST(simd, name) {
+  for (int level = 0; level < SIMD_LEVELS; level++)
+    EXPECT_EQ(simd_parse(simd_name(level)), level);
+  EXPECT_EQ(simd_parse("avx512"), -1);
+  EXPECT_LE(simd_level(), simd_detect());
+}
+
+TEST(simd, force) {
+  int former = simd_force(SIMD_SCALAR);
+  EXPECT_EQ(simd_level(), SIMD_SCALAR);
+  /* never above the CPU */
+  simd_force(SIMD_LEVELS);
+  EXPECT_EQ(simd_level(), simd_detect());
+  simd_force(former);
+}
+
+/* every level gives the bits of the scalar kernels */
+TEST(simd, kernels) {
+  const unsigned width = 77, height = 37;
+  const size_t pixels = 2 * 32 * 3 + 6;
+  std::vector<uint8_t> image(width * height), packed(2 * pixels);
+  std::vector<int16_t> values(1000);
+  srand(0);
+  for (auto &pixel : image)
+    pixel = rand();
+  for (auto &byte : packed)
+    byte = rand();
+  for (auto &value : values)
+    value = rand() % 2001 - 1000;
+  values[613] = INT16_MIN;
+  values[998] = INT16_MAX;
+  gmm_t gmm = {-60, 60, {0.5, 0.3, 0.2}, {0.1f, -3, 7}, {0.6f, 4, 25}};
+
+  int former = simd_force(SIMD_SCALAR);
+  std::vector<uint16_t> picture(preprocess_size(width, height));
+  preprocess(picture.data(), image.data(), width, height);
+  std::vector<uint8_t> y(pixels), u(pixels / 2), v(pixels / 2);
+  yuv_deinterleave(y.data(), u.data(), v.data(), packed.data(), pixels,
+                   YUV_UYVY);
+  std::vector<double> cdf(123);
+  stats_gmm_cdf(cdf.data(), &gmm, -61.5, cdf.size());
+
+  for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+    simd_force(level);
+    std::vector<uint16_t> picture2(picture.size());
+    preprocess(picture2.data(), image.data(), width, height);
+    EXPECT_EQ(picture2, picture) << simd_name(level);
+    std::vector<uint8_t> y2(pixels), u2(pixels / 2), v2(pixels / 2);
+    yuv_deinterleave(y2.data(), u2.data(), v2.data(), packed.data(), pixels,
+                     YUV_UYVY);
+    EXPECT_EQ(y2, y) << simd_name(level);
+    EXPECT_EQ(u2, u) << simd_name(level);
+    EXPECT_EQ(v2, v) << simd_name(level);
+    std::vector<double> cdf2(cdf.size());
+    stats_gmm_cdf(cdf2.data(), &gmm, -61.5, cdf2.size());
+    EXPECT_EQ(memcmp(cdf2.data(), cdf.data(), cdf.size() * sizeof(double)),
+              0)
+        << simd_name(level);
+    for (size_t n : {(size_t)0, (size_t)1, (size_t)17, values.size()}) {
+      int16_t low, high;
+      stats_bounds(values.data(), n, &low, &high);
+      int16_t expected_low = 0, expected_high = 0;
+      if (n) {
+        expected_low = *std::min_element(values.begin(), values.begin() + n);
+        expected_high = *std::max_element(values.begin(), values.begin() + n);
+      }
+      EXPECT_EQ(low, expected_low) << simd_name(level) << " " << n;
+      EXPECT_EQ(high, expected_high) << simd_name(level) << " " << n;
+    }
+  }
+  simd_force(former);
+}
+
+TEST(simd, cdf) {
+  gmm_t gmm = {-100, 100, {0.25, 0.5, 0.25}, {0, 1.5f, -20}, {0.2f, 3, 40}};
+  std::vector<double> cdf(401);
+  stats_gmm_cdf(cdf.data(), &gmm, -200, cdf.size());
+  for (size_t i = 0; i < cdf.size(); i++) {
+    double x = -200 + (double)i, expected = 0;
+    for (int k = 0; k < GMM_NUMBER; k++)
+      expected += gmm.prob[k] * 0.5 *
+                  erfc(-(x - gmm.mean[k]) / gmm.std[k] * M_SQRT1_2);
+    EXPECT_NEAR(cdf[i], expected, 1e-7) << x;
+    if (i) {
+      EXPECT_GE(cdf[i], cdf[i - 1]) << x;
+    }
+  }
+}
+
+/* every level counts like one loop, with and without sub-histograms */
+TEST(simd, histogram) {
+  std::vector<int16_t> values(4 * 65536 + 5);
+  srand(0);
+  for (auto &value : values)
+    value = rand();
+  values[7] = INT16_MIN;
+  values[values.size() - 1] = INT16_MAX;
+  std::vector<int16_t> narrow(1000);
+  for (auto &value : narrow)
+    value = rand() % 9 - 4 + (rand() % 8 == 0) * 50;
+  narrow[0] = -4;
+
+  int former = simd_force(SIMD_SCALAR);
+  for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+    simd_force(level);
+    for (size_t n : {(size_t)0, (size_t)1, (size_t)23, (size_t)1000}) {
+      std::vector<size_t> counts(59, 1), expected(59, 1);
+      for (size_t i = 0; i < n; i++)
+        expected[narrow[i] + 4]++;
+      stats_histogram(counts.data(), counts.size(), narrow.data(), n, -4);
+      EXPECT_EQ(counts, expected) << simd_name(level) << " " << n;
+    }
+    for (size_t n : {(size_t)1000, values.size()}) {
+      std::vector<size_t> counts(65536), expected(65536);
+      for (size_t i = 0; i < n; i++)
+        expected[values[i] - INT16_MIN]++;
+      stats_histogram(counts.data(), counts.size(), values.data(), n,
+                      INT16_MIN);
+      EXPECT_EQ(counts, expected) << simd_name(level) << " " << n;
+    }
+  }
+  simd_force(former);
+}
@@ -0,0 +1,82 @@
+#include "../src/slave.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+struct master {
+  arq_t arq;
+  std::vector<frame_t> frames;
+};
+
+static void collect(void *arg, const frame_t *p_frame) {
+  static_cast<master *>(arg)->frames.push_back(*p_frame);
+}
+
+/* run the loop until the master has a frame of a type, at most 10 seconds */
+static const frame_t *wait_frame(event_loop_t *p_loop, master *p_master,
+                                 uint8_t frame_type) {
+  time_t start = time(NULL);
+  while (time(NULL) - start < 10) {
+    for (const frame_t &frame : p_master->frames)
+      if (frame.frame_type == frame_type)
+        return &frame;
+    event_loop_run_once(p_loop, 10);
+  }
+  return NULL;
+}
+
+/* a raw image which cannot be compressed is skipped, not waited for */
+TEST(slave, short_image) {
+  char output_dir[] = "/tmp/slave_testXXXXXX";
+  ASSERT_NE(mkdtemp(output_dir), nullptr);
+  opt_t opt = {};
+  opt.tty = output_dir;
+  opt.output_dir = output_dir;
+  opt.compress.progressive = 1;
+  opt.compress.background_step = 1;
+  opt.compress.quality = 1;
+  opt.window = ARQ_WINDOW;
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+  slave_t slave;
+  ASSERT_EQ(slave_init(&slave, &opt, fds[1]), 0);
+  master master;
+  ASSERT_EQ(arq_init(&master.arq, &slave.loop, fds[0], TP_ADDRESS_MASTER,
+                     ARQ_WINDOW, collect, &master),
+            0);
+  ASSERT_EQ(slave_request(&slave, 0), 0);
+
+  const frame_t *p_request =
+      wait_frame(&slave.loop, &master, TP_FRAME_TYPE_REQUEST_DATA);
+  ASSERT_NE(p_request, nullptr);
+  EXPECT_EQ(p_request->n_file, 0u);
+  master.frames.clear();
+  frame_t frame = {};
+  memcpy(frame.header, tp_header, sizeof(tp_header));
+  frame.address = TP_ADDRESS_MASTER;
+  frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
+  frame.data_len = TP_FRAME_DATA_LEN_MAX;
+  for (unsigned i = 0; i < 3; i++)
+    ASSERT_EQ(arq_send(&master.arq, &frame), 0);
+  frame.frame_type = TP_FRAME_TYPE_REQUEST_DATA;
+  frame.data_len = 0;
+  ASSERT_EQ(arq_send(&master.arq, &frame), 0);
+
+  p_request = wait_frame(&slave.loop, &master, TP_FRAME_TYPE_REQUEST_DATA);
+  ASSERT_NE(p_request, nullptr);
+  EXPECT_EQ(p_request->n_file, 1u);
+  for (const frame_t &frame : master.frames)
+    EXPECT_NE(frame.frame_type, TP_FRAME_TYPE_TRANSPORT_DATA);
+
+  arq_close(&master.arq, &slave.loop);
+  slave_close(&slave);
+  close(fds[0]);
+  close(fds[1]);
+  unlink((std::string(output_dir) + "/0.yuv").c_str());
+  rmdir(output_dir);
+}
@@ -0,0 +1,40 @@
+#include "../src/subband.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(subband, packed) {
+  subband_t subbands[SUBBAND_NUMBER];
+  subband_table(subbands, 37, 21, SUBBAND_PACKED);
+  size_t offset = 0;
+  for (unsigned i = 0; i < SUBBAND_NUMBER; i++) {
+    EXPECT_EQ(subbands[i].offset, offset);
+    EXPECT_EQ(subbands[i].stride, subbands[i].width);
+    offset += subband_size(&subbands[i]);
+  }
+  EXPECT_EQ(offset, 37u * 21);
+  EXPECT_EQ(subbands[0].orientation, SUBBAND_LL);
+  EXPECT_EQ(subbands[1].orientation, SUBBAND_HL);
+  EXPECT_EQ(subbands[1].level, 4u);
+  EXPECT_EQ(subbands[12].orientation, SUBBAND_HH);
+  EXPECT_EQ(subbands[12].level, 1u);
+  EXPECT_EQ(subbands[12].width, 18u);
+  EXPECT_EQ(subbands[12].height, 10u);
+}
+
+/* views of all subbands cover every coefficient of the picture once */
+TEST(subband, picture) {
+  const unsigned width = 37, height = 21;
+  subband_t subbands[SUBBAND_NUMBER];
+  subband_table(subbands, width, height, SUBBAND_PICTURE);
+  std::vector<int16_t> picture(width * height, 0);
+  for (unsigned i = 0; i < SUBBAND_NUMBER; i++) {
+    subband_view_t view = subband_view(picture.data(), &subbands[i]);
+    EXPECT_EQ(view.stride, width);
+    EXPECT_FALSE(subband_contiguous(&view) && view.height > 1);
+    for (unsigned y = 0; y < view.height; y++)
+      for (unsigned x = 0; x < view.width; x++)
+        subband_row(&view, y)[x]++;
+  }
+  for (auto coefficient : picture)
+    EXPECT_EQ(coefficient, 1);
+}
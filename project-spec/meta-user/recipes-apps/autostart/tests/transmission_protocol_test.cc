@@ -1,6 +1,8 @@
+#include "../src/simd.h"
 #include "../src/transmission_protocol.h"
 #include <fcntl.h>
 #include <gtest/gtest.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,20 +26,146 @@ void is_same_frame(frame_t frame1, frame_t frame2) {
             std::vector<uint8_t>(frame2.data, frame2.data + frame2.data_len));
 }
 
+/* fields are big endian, and so is the CRC */
 TEST(transmission_protocol, frame2bit_stream) {
-  uint8_t expected[] = "\xEB\x90\xEB\x90\x1\0\x3\0\x1\0\0\0*\0\x14\xFD";
-  frame_t frame;
+  uint8_t expected[] = "\xEB\x90\xEB\x90\0\x1\0\x3\0\0\0\x1\0*\x13\xF5";
+  frame_t frame = {};
   memcpy(frame.header, tp_header, sizeof(tp_header));
   frame.address = TP_ADDRESS_SLAVE;
   frame.frame_type = TP_FRAME_TYPE_REQUEST_DATA;
   frame.n_file = 1;
   frame.n_frame = 42;
-  uint8_t *bit_stream = (uint8_t *)malloc(sizeof(expected) - 1);
-  frame2bit_stream(frame, bit_stream);
+  uint8_t bit_stream[TP_FRAME_SIZE_MAX];
+  EXPECT_EQ(frame2bit_stream(&frame, bit_stream), sizeof(expected) - 1);
   EXPECT_EQ(std::vector<uint8_t>(bit_stream, bit_stream + sizeof(expected) - 1),
             std::vector<uint8_t>(expected, expected + sizeof(expected) - 1));
-  frame_t *p_frame = bit_stream2frame(bit_stream);
-  is_same_frame(*p_frame, frame);
+  frame_t result;
+  ASSERT_EQ(bit_stream2frame(&result, bit_stream), 0);
+  is_same_frame(result, frame);
+}
+
+TEST(transmission_protocol, transport_data) {
+  frame_t frame = {};
+  memcpy(frame.header, tp_header, sizeof(tp_header));
+  frame.address = TP_ADDRESS_SLAVE;
+  frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
+  frame.n_file = 0x01020304;
+  frame.n_frame = 0x0506;
+  frame.data_len = 3;
+  memset(frame.data, 0xAA, sizeof(frame.data));
+  uint8_t bit_stream[TP_FRAME_SIZE_MAX];
+  ASSERT_EQ(frame2bit_stream(&frame, bit_stream), TP_FRAME_SIZE_TRANSPORT_DATA);
+  EXPECT_EQ(std::vector<uint8_t>(bit_stream + 8, bit_stream + 19),
+            std::vector<uint8_t>({1, 2, 3, 4, 5, 6, 0, 3, 0xAA, 0xAA, 0xAA}));
+  /* data after data_len is padded with 0 */
+  EXPECT_EQ(std::vector<uint8_t>(bit_stream + 19, bit_stream + 528),
+            std::vector<uint8_t>(509, 0));
+  frame_t result;
+  ASSERT_EQ(bit_stream2frame(&result, bit_stream), 0);
+  is_same_frame(result, frame);
+  bit_stream[100] ^= 1;
+  EXPECT_EQ(bit_stream2frame(&result, bit_stream), -1);
+}
+
+TEST(transmission_protocol, wrong_frames) {
+  frame_t frame = {};
+  memcpy(frame.header, tp_header, sizeof(tp_header));
+  frame.frame_type = 4;
+  uint8_t bit_stream[TP_FRAME_SIZE_MAX] = {};
+  EXPECT_EQ(frame2bit_stream(&frame, bit_stream), 0u);
+  frame.frame_type = TP_FRAME_TYPE_TRANSPORT_DATA;
+  frame.data_len = TP_FRAME_DATA_LEN_MAX + 1;
+  EXPECT_EQ(frame2bit_stream(&frame, bit_stream), 0u);
+  frame_t result;
+  EXPECT_EQ(bit_stream2frame(&result, bit_stream), -1);
+  memcpy(bit_stream, tp_header, sizeof(tp_header));
+  bit_stream[7] = 4;
+  EXPECT_EQ(bit_stream2frame(&result, bit_stream), -1);
+}
+
+static void collect(void *arg, const frame_t *p_frame) {
+  static_cast<std::vector<frame_t> *>(arg)->push_back(*p_frame);
+}
+
+static frame_t make_frame(frame_type_t frame_type, n_frame_t n_frame) {
+  frame_t frame = {};
+  memcpy(frame.header, tp_header, sizeof(tp_header));
+  frame.address = TP_ADDRESS_SLAVE;
+  frame.frame_type = frame_type;
+  frame.n_file = 7;
+  frame.n_frame = n_frame;
+  if (frame_type == TP_FRAME_TYPE_TRANSPORT_DATA) {
+    frame.data_len = n_frame % TP_FRAME_DATA_LEN_MAX;
+    for (unsigned i = 0; i < frame.data_len; i++)
+      frame.data[i] = i * 7 + n_frame;
+  }
+  return frame;
+}
+
+static void append(std::vector<uint8_t> &stream, const frame_t &frame) {
+  uint8_t bit_stream[TP_FRAME_SIZE_MAX];
+  size_t size = frame2bit_stream(&frame, bit_stream);
+  stream.insert(stream.end(), bit_stream, bit_stream + size);
+}
+
+/* frames split at any chunk size, back to back and in garbage */
+TEST(transmission_protocol, parser) {
+  std::vector<frame_t> expected;
+  std::vector<uint8_t> stream;
+  const uint8_t garbage[] = {0xEB, 0x90, 0xEB, 0x90, 0xEB, 0x90, 0, 9, 0xEB,
+                             0xEB, 0x90, 0xEB, 0};
+  for (n_frame_t i = 0; i < 12; i++) {
+    static const frame_type_t types[] = {TP_FRAME_TYPE_CONTROL,
+                                         TP_FRAME_TYPE_REQUEST_DATA,
+                                         TP_FRAME_TYPE_TRANSPORT_DATA};
+    expected.push_back(make_frame(types[i % 3], i * 100 + 1));
+    append(stream, expected.back());
+    if (i % 4 == 3)
+      stream.insert(stream.end(), garbage, garbage + sizeof(garbage));
+  }
+  int former = simd_level();
+  for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+    simd_force(level);
+    for (size_t chunk : {1, 2, 3, 7, 64, 529, 1000, 100000}) {
+      std::vector<frame_t> frames;
+      tp_parser_t parser;
+      tp_parser_init(&parser, collect, &frames);
+      for (size_t i = 0; i < stream.size(); i += chunk)
+        tp_parser_feed(&parser, stream.data() + i,
+                       std::min(chunk, stream.size() - i));
+      ASSERT_EQ(frames.size(), expected.size())
+          << "level " << level << " chunk " << chunk;
+      for (size_t i = 0; i < frames.size(); i++)
+        is_same_frame(frames[i], expected[i]);
+      EXPECT_EQ(parser.frame_number, expected.size());
+      EXPECT_EQ(parser.size, 0u);
+    }
+  }
+  simd_force(former);
+}
+
+/* a broken frame is skipped, and the frame inside it or after it is found */
+TEST(transmission_protocol, parser_resynchronizes) {
+  std::vector<uint8_t> stream;
+  append(stream, make_frame(TP_FRAME_TYPE_TRANSPORT_DATA, 300));
+  /* a whole frame in the data of a broken frame */
+  std::vector<uint8_t> inner;
+  append(inner, make_frame(TP_FRAME_TYPE_CONTROL, 1));
+  std::copy(inner.begin(), inner.end(), stream.begin() + 100);
+  append(stream, make_frame(TP_FRAME_TYPE_REQUEST_DATA, 2));
+  /* a broken frame at the end */
+  append(stream, make_frame(TP_FRAME_TYPE_REQUEST_DATA, 3));
+  stream.back() ^= 1;
+  std::vector<frame_t> frames;
+  tp_parser_t parser;
+  tp_parser_init(&parser, collect, &frames);
+  tp_parser_feed(&parser, stream.data(), stream.size());
+  ASSERT_EQ(frames.size(), 2u);
+  is_same_frame(frames[0], make_frame(TP_FRAME_TYPE_CONTROL, 1));
+  is_same_frame(frames[1], make_frame(TP_FRAME_TYPE_REQUEST_DATA, 2));
+  EXPECT_EQ(parser.broken, 2u);
+  EXPECT_EQ(parser.skipped, stream.size() - 2 * TP_FRAME_SIZE_CONTROL);
+  EXPECT_EQ(parser.size, 0u);
 }
 
 TEST(transmission_protocol, send_frame) {
@@ -48,7 +176,7 @@ TEST(transmission_protocol, send_frame) {
     return;
   }
   int fd = open("/tmp/ttyS0", O_RDWR | O_NONBLOCK | O_NOCTTY);
-  frame_t frame;
+  frame_t frame = {};
   memcpy(frame.header, tp_header, sizeof(tp_header));
   frame.address = TP_ADDRESS_SLAVE;
   frame.frame_type = TP_FRAME_TYPE_REQUEST_DATA;
@@ -57,7 +185,50 @@ TEST(transmission_protocol, send_frame) {
   EXPECT_NE(send_frame(fd, &frame), -1);
   close(fd);
   fd = open("/tmp/ttyS1", O_RDWR | O_NONBLOCK | O_NOCTTY);
-  frame_t result;
-  EXPECT_GT(receive_frame(fd, &result), 0);
-  is_same_frame(frame, result);
+  std::vector<frame_t> frames;
+  tp_parser_t parser;
+  tp_parser_init(&parser, collect, &frames);
+  /* the bytes go through socat */
+  struct pollfd pollfd = {fd, POLLIN, 0};
+  EXPECT_EQ(poll(&pollfd, 1, 1000), 1);
+  EXPECT_GT(receive_frames(fd, &parser), 0);
+  ASSERT_EQ(frames.size(), 1u);
+  is_same_frame(frame, frames[0]);
+}
+
+/* frames wait in the ring while the pipe is full, and go in order */
+TEST(transmission_protocol, output) {
+  int fds[2];
+  ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+  fcntl(fds[1], F_SETPIPE_SZ, 4096);
+  tp_output_t output;
+  ASSERT_EQ(tp_output_init(&output, fds[1]), 0);
+  std::vector<uint8_t> expected, received;
+  uint8_t buffer[TP_OUTPUT_CAPACITY];
+  for (unsigned round = 0; round < 4; round++) {
+    for (unsigned i = 0; i < 100; i++) {
+      frame_t frame = make_frame(TP_FRAME_TYPE_TRANSPORT_DATA, round * 100 + i);
+      uint8_t bit_stream[TP_FRAME_SIZE_MAX];
+      size_t size = frame2bit_stream(&frame, bit_stream);
+      expected.insert(expected.end(), bit_stream, bit_stream + size);
+      ASSERT_EQ(tp_output_frame(&output, &frame), 0);
+    }
+    unsigned long writes = output.writes;
+    ssize_t rest = tp_output_flush(&output);
+    /* the pipe takes a part only */
+    ASSERT_GT(rest, 0);
+    EXPECT_LE(output.writes - writes, 2u);
+    do {
+      ssize_t n = read(fds[0], buffer, sizeof(buffer));
+      ASSERT_GT(n, 0);
+      received.insert(received.end(), buffer, buffer + n);
+    } while ((rest = tp_output_flush(&output)) > 0);
+    ASSERT_EQ(rest, 0);
+    for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;)
+      received.insert(received.end(), buffer, buffer + n);
+  }
+  EXPECT_EQ(received, expected);
+  tp_output_free(&output);
+  close(fds[0]);
+  close(fds[1]);
 }
@@ -0,0 +1,99 @@
+#include "../src/engine.h"
+#include "../src/preprocess.h"
+#include "../src/simd.h"
+#include "../src/subband.h"
+#include "../src/wavelet.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+static const unsigned sizes[][2] = {{1, 1},  {2, 1},   {1, 5},  {2, 2},
+                                    {17, 3}, {40, 24}, {75, 83}, {96, 33}};
+
+/* the lifting of the engine with transform networks of 0 */
+TEST(wavelet, engine) {
+  int16_t zero = 0;
+  engine_layer_t layer = {1, 1, 1, &zero};
+  engine_t engine = {};
+  engine.threads = 1;
+  engine.lifting_number = ENGINE_LIFTING;
+  for (auto &chain : engine.lifting)
+    chain = {&layer, 1};
+  srand(0);
+  int former = simd_level();
+  for (auto size : sizes) {
+    unsigned width = size[0], height = size[1];
+    std::vector<uint8_t> pixels(width * height);
+    for (auto &pixel : pixels)
+      pixel = rand();
+    std::vector<uint16_t> picture(preprocess_size(width, height));
+    preprocess(picture.data(), pixels.data(), width, height);
+    std::vector<int16_t> expected(width * height);
+    ASSERT_EQ(engine_run(&engine, expected.data(), NULL, picture.data(), width,
+                         height),
+              0);
+    std::vector<int16_t> plane(pixels.begin(), pixels.end());
+    for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+      simd_force(level);
+      std::vector<int16_t> trans(width * height);
+      ASSERT_EQ(wavelet_forward(trans.data(), plane.data(), width, height,
+                                SUBBAND_PACKED),
+                0);
+      EXPECT_EQ(trans, expected) << width << "x" << height << " "
+                                 << simd_name(level);
+    }
+  }
+  simd_force(former);
+}
+
+/* any samples come back, also when they wrap */
+TEST(wavelet, inverse) {
+  srand(1);
+  int former = simd_level();
+  for (auto size : sizes)
+    for (int layout : {SUBBAND_PACKED, SUBBAND_PICTURE}) {
+      unsigned width = size[0], height = size[1];
+      std::vector<int16_t> plane(width * height);
+      for (auto &sample : plane)
+        sample = rand();
+      for (int level = SIMD_SCALAR; level <= simd_detect(); level++) {
+        simd_force(level);
+        std::vector<int16_t> trans(width * height), back(width * height);
+        ASSERT_EQ(wavelet_forward(trans.data(), plane.data(), width, height,
+                                  layout),
+                  0);
+        ASSERT_EQ(wavelet_inverse(back.data(), trans.data(), width, height,
+                                  layout),
+                  0);
+        EXPECT_EQ(back, plane) << width << "x" << height << " " << layout
+                               << " " << simd_name(level);
+      }
+    }
+  simd_force(former);
+}
+
+/* the layouts have the same subbands */
+TEST(wavelet, layouts) {
+  const unsigned width = 75, height = 83;
+  std::vector<int16_t> plane(width * height);
+  for (unsigned i = 0; i < plane.size(); i++)
+    plane[i] = i % 251;
+  std::vector<int16_t> packed(plane.size()), picture(plane.size());
+  ASSERT_EQ(wavelet_forward(packed.data(), plane.data(), width, height,
+                            SUBBAND_PACKED),
+            0);
+  ASSERT_EQ(wavelet_forward(picture.data(), plane.data(), width, height,
+                            SUBBAND_PICTURE),
+            0);
+  subband_t tables[2][SUBBAND_NUMBER];
+  subband_table(tables[0], width, height, SUBBAND_PACKED);
+  subband_table(tables[1], width, height, SUBBAND_PICTURE);
+  for (unsigned subband = 0; subband < SUBBAND_NUMBER; subband++) {
+    subband_view_t views[2] = {subband_view(packed.data(), &tables[0][subband]),
+                               subband_view(picture.data(),
+                                            &tables[1][subband])};
+    for (unsigned y = 0; y < views[0].height; y++)
+      for (unsigned x = 0; x < views[0].width; x++)
+        EXPECT_EQ(subband_row(&views[0], y)[x], subband_row(&views[1], y)[x]);
+  }
+}
@@ -0,0 +1,123 @@
+#include "../src/weights.h"
+#include <endian.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+static std::vector<uint8_t> write(weights_layer_t *layers, unsigned number,
+                                  const uint16_t *const *packed) {
+  char *data;
+  size_t size;
+  FILE *file = open_memstream(&data, &size);
+  EXPECT_EQ(weights_write(file, layers, number, packed), 0);
+  fclose(file);
+  std::vector<uint8_t> blob(data, data + size);
+  free(data);
+  return blob;
+}
+
+TEST(weights, pack_one_input) {
+  weights_layer_t layer = {WEIGHTS_TRANSFORM, 3, 3, 1, 2, 0, 0};
+  std::vector<int16_t> weights(18);
+  for (unsigned i = 0; i < weights.size(); i++)
+    weights[i] = i - 9;
+  ASSERT_EQ(weights_packed_number(&layer), 18u);
+  std::vector<uint16_t> packed(18);
+  weights_pack(packed.data(), weights.data(), &layer);
+  for (unsigned i = 0; i < packed.size(); i++)
+    EXPECT_EQ((int16_t)le16toh(packed[i]), weights[i]);
+}
+
+/* W(1,1), W(2,1), W(1,2), W(2,2), ..., W(3,1), W(3,2), ... */
+TEST(weights, pack_input_pairs) {
+  const unsigned inputs = 3, outputs = 2;
+  weights_layer_t layer = {WEIGHTS_ENTROPY, 3, 3, inputs, outputs, 0, 0};
+  std::vector<int16_t> weights(9 * inputs * outputs);
+  for (unsigned i = 0; i < weights.size(); i++)
+    weights[i] = i;
+  ASSERT_EQ(weights_packed_number(&layer), 9u * 4 * outputs);
+  std::vector<uint16_t> packed(weights_packed_number(&layer));
+  weights_pack(packed.data(), weights.data(), &layer);
+  size_t i = 0;
+  for (unsigned pair = 0; pair < 4; pair += 2)
+    for (unsigned output = 0; output < outputs; output++)
+      for (unsigned input = pair; input < pair + 2; input++)
+        for (unsigned tap = 0; tap < 9; tap++, i++)
+          EXPECT_EQ(le16toh(packed[i]),
+                    input < inputs ? (output * inputs + input) * 9 + tap : 0)
+              << i;
+}
+
+TEST(weights, pack_1x1) {
+  weights_layer_t layer = {WEIGHTS_ENTROPY, 1, 1, 3, 2, 0, 0};
+  const int16_t weights[] = {1, 2, 3, 4, 5, 6};
+  ASSERT_EQ(weights_packed_number(&layer), 6u);
+  uint16_t packed[6];
+  weights_pack(packed, weights, &layer);
+  for (unsigned i = 0; i < 6; i++)
+    EXPECT_EQ(le16toh(packed[i]), weights[i]);
+}
+
+class blob : public testing::Test {
+protected:
+  weights_layer_t layers[2] = {{WEIGHTS_TRANSFORM, 3, 3, 1, 16, 0, 0},
+                               {WEIGHTS_ENTROPY, 1, 1, 16, 2, 0, 0}};
+  std::vector<uint16_t> packed0 = std::vector<uint16_t>(9 * 16);
+  std::vector<uint16_t> packed1 = std::vector<uint16_t>(16 * 2);
+  const uint16_t *packed[2] = {packed0.data(), packed1.data()};
+
+  void SetUp() override {
+    for (unsigned i = 0; i < packed0.size(); i++)
+      packed0[i] = htole16(i);
+    for (unsigned i = 0; i < packed1.size(); i++)
+      packed1[i] = htole16(0x8000 + i);
+  }
+};
+
+TEST_F(blob, write_read) {
+  std::vector<uint8_t> data = write(layers, 2, packed);
+  EXPECT_EQ(layers[1].offset, packed0.size() * 2);
+  EXPECT_EQ(layers[1].size, packed1.size() * 2);
+  ASSERT_EQ(data.size(), WEIGHTS_ALIGN + (packed0.size() + packed1.size()) * 2);
+
+  weights_t weights;
+  ASSERT_EQ(weights_read(&weights, data.data(), data.size()), 0);
+  EXPECT_EQ(weights.layer_number, 2u);
+  EXPECT_EQ(weights.payload_size, (packed0.size() + packed1.size()) * 2);
+  EXPECT_EQ((const uint8_t *)weights.payload, data.data() + WEIGHTS_ALIGN);
+  EXPECT_EQ(weights.layers[0].outputs, 16);
+  EXPECT_EQ(weights.layers[1].network, WEIGHTS_ENTROPY);
+  EXPECT_EQ(weights.layers[1].inputs, 16);
+  EXPECT_EQ(memcmp(weights.payload + weights.layers[1].offset / 2,
+                   packed1.data(), layers[1].size),
+            0);
+  weights_unload(&weights);
+}
+
+TEST_F(blob, corruption) {
+  std::vector<uint8_t> data = write(layers, 2, packed);
+  weights_t weights;
+  data[data.size() - 1] ^= 1;
+  EXPECT_EQ(weights_read(&weights, data.data(), data.size()), -1);
+  data[data.size() - 1] ^= 1;
+  data[WEIGHTS_HEADER_SIZE + 4] ^= 1;
+  EXPECT_EQ(weights_read(&weights, data.data(), data.size()), -1);
+  data[WEIGHTS_HEADER_SIZE + 4] ^= 1;
+  EXPECT_EQ(weights_read(&weights, data.data(), data.size() - 1), -1);
+}
+
+TEST_F(blob, load) {
+  char filename[] = "/tmp/weights_testXXXXXX";
+  int fd = mkstemp(filename);
+  ASSERT_NE(fd, -1);
+  std::vector<uint8_t> data = write(layers, 2, packed);
+  ASSERT_EQ(::write(fd, data.data(), data.size()), (ssize_t)data.size());
+  close(fd);
+  weights_t weights;
+  ASSERT_EQ(weights_load(&weights, filename), 0);
+  unlink(filename);
+  EXPECT_EQ(weights.layer_number, 2u);
+  EXPECT_EQ(memcmp(weights.payload, packed0.data(), layers[0].size), 0);
+  weights_unload(&weights);
+}
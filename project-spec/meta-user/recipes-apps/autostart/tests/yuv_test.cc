@@ -0,0 +1,72 @@
+#include "../src/yuv.h"
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <vector>
+
+TEST(yuv, format) {
+  EXPECT_EQ(yuv_format("planar"), YUV_PLANAR);
+  EXPECT_EQ(yuv_format("uyvy"), YUV_UYVY);
+  EXPECT_EQ(yuv_format("yuyv"), YUV_YUYV);
+  EXPECT_EQ(yuv_format("nv12"), -1);
+}
+
+TEST(yuv, deinterleave) {
+  /* SIMD blocks and a scalar tail */
+  const size_t pixels = 3 * 32 + 6;
+  std::vector<uint8_t> y(pixels), u(pixels / 2), v(pixels / 2);
+  srand(0);
+  for (size_t i = 0; i < pixels; i++)
+    y[i] = rand();
+  for (size_t i = 0; i < pixels / 2; i++) {
+    u[i] = rand();
+    v[i] = rand();
+  }
+  std::vector<uint8_t> uyvy, yuyv;
+  for (size_t i = 0; i < pixels / 2; i++) {
+    uyvy.insert(uyvy.end(), {u[i], y[2 * i], v[i], y[2 * i + 1]});
+    yuyv.insert(yuyv.end(), {y[2 * i], u[i], y[2 * i + 1], v[i]});
+  }
+  for (int format : {YUV_UYVY, YUV_YUYV}) {
+    std::vector<uint8_t> y2(pixels), u2(pixels / 2), v2(pixels / 2);
+    yuv_deinterleave(y2.data(), u2.data(), v2.data(),
+                     (format == YUV_UYVY ? uyvy : yuyv).data(), pixels,
+                     format);
+    EXPECT_EQ(y2, y) << format;
+    EXPECT_EQ(u2, u) << format;
+    EXPECT_EQ(v2, v) << format;
+  }
+}
+
+static uint8_t saturate(int16_t sample) {
+  return sample < 0 ? 0 : sample > 255 ? 255 : sample;
+}
+
+/* decoded samples out of 8 bit, packed back like the input of deinterleave */
+TEST(yuv, pack) {
+  const size_t pixels = 3 * 16 + 6;
+  std::vector<int16_t> y(pixels), u(pixels / 2), v(pixels / 2);
+  srand(1);
+  for (auto *p_plane : {&y, &u, &v})
+    for (auto &sample : *p_plane)
+      sample = rand() % 400 - 72;
+  y[0] = INT16_MIN;
+  u[0] = INT16_MAX;
+  std::vector<uint8_t> planar(2 * pixels), uyvy, yuyv;
+  yuv_narrow(planar.data(), y.data(), pixels);
+  yuv_narrow(planar.data() + pixels, u.data(), pixels / 2);
+  yuv_narrow(planar.data() + pixels * 3 / 2, v.data(), pixels / 2);
+  for (size_t i = 0; i < pixels; i++)
+    EXPECT_EQ(planar[i], saturate(y[i])) << i;
+  for (size_t i = 0; i < pixels / 2; i++) {
+    EXPECT_EQ(planar[pixels + i], saturate(u[i])) << i;
+    uint8_t chromas[2] = {saturate(u[i]), saturate(v[i])};
+    uint8_t lumas[2] = {saturate(y[2 * i]), saturate(y[2 * i + 1])};
+    uyvy.insert(uyvy.end(), {chromas[0], lumas[0], chromas[1], lumas[1]});
+    yuyv.insert(yuyv.end(), {lumas[0], chromas[0], lumas[1], chromas[1]});
+  }
+  for (int format : {YUV_UYVY, YUV_YUYV}) {
+    std::vector<uint8_t> packed(2 * pixels);
+    yuv_pack(packed.data(), y.data(), u.data(), v.data(), pixels, format);
+    EXPECT_EQ(packed, format == YUV_UYVY ? uyvy : yuyv) << format;
+  }
+}